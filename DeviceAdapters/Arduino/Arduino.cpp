@@ -13,6 +13,7 @@
 //
 
 #include "Arduino.h"
+#include "ArduinoSequence.h"
 #include "ModuleInterface.h"
 #include <sstream>
 #include <cstdio>
@@ -539,14 +540,10 @@ int CArduinoSwitch::WriteToPort(long value)
    if (ret != DEVICE_OK)
       return ret;
 
-   MM::MMTime startTime = GetCurrentMMTime();
-   unsigned long bytesRead = 0;
    unsigned char answer[1];
-   while ((bytesRead < 1) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-      ret = hub->ReadFromComPortH(answer, 1, bytesRead);
-      if (ret != DEVICE_OK)
-         return ret;
-   }
+   ret = hub->ReadExactlyFromComPortH(answer, 1, 250);
+   if (ret != DEVICE_OK)
+      return ret;
    if (answer[0] != 1)
       return ERR_COMMUNICATION;
 
@@ -555,65 +552,49 @@ int CArduinoSwitch::WriteToPort(long value)
    return DEVICE_OK;
 }
 
-int CArduinoSwitch::LoadSequence(unsigned size, unsigned char* seq)
+namespace {
+
+class HubPort : public ArduinoPort
 {
-   CArduinoHub* hub = static_cast<CArduinoHub*>(GetParentHub());
-   if (!hub || !hub->IsPortAvailable())
-      return ERR_NO_PORT_SET;
+public:
+   HubPort(CArduinoHub* hub) : hub_(hub) {}
 
-   hub->PurgeComPortH();
+   int Write(const unsigned char* data, unsigned len)
+   {
+      return hub_->WriteToComPortH(data, len);
+   }
 
-   for (unsigned i=0; i < size; i++)
+   int ReadExactly(unsigned char* data, unsigned len, long timeoutMs)
    {
-      unsigned char value = seq[i];
+      return hub_->ReadExactlyFromComPortH(data, len, timeoutMs);
+   }
 
-      value = 63 & value;
-      if (hub->IsLogicInverted())
-         value = ~value;
+private:
+   CArduinoHub* hub_;
+};
 
-      unsigned char command[3];
-      command[0] = 5;
-      command[1] = (unsigned char) i;
-      command[2] = value;
-      int ret = hub->WriteToComPortH((const unsigned char*) command, 3);
-      if (ret != DEVICE_OK)
-         return ret;
+} // anonymous namespace
 
+int CArduinoSwitch::LoadSequence(unsigned size, unsigned char* seq)
+{
+   CArduinoHub* hub = static_cast<CArduinoHub*>(GetParentHub());
+   if (!hub || !hub->IsPortAvailable())
+      return ERR_NO_PORT_SET;
 
-      MM::MMTime startTime = GetCurrentMMTime();
-      unsigned long bytesRead = 0;
-      unsigned char answer[3];
-      while ((bytesRead < 3) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-         unsigned long br;
-         ret = hub->ReadFromComPortH(answer + bytesRead, 3, br);
-      if (ret != DEVICE_OK)
-         return ret;
-      bytesRead += br;
-      }
-      if (answer[0] != 5)
-         return ERR_COMMUNICATION;
+   MMThreadGuard myLock(hub->GetLock());
 
-   }
+   hub->PurgeComPortH();
 
-   unsigned char command[2];
-   command[0] = 6;
-   command[1] = (unsigned char) size;
-   int ret = hub->WriteToComPortH((const unsigned char*) command, 2);
+   MM::MMTime startTime = GetCurrentMMTime();
+   HubPort port(hub);
+   int ret = UploadSwitchSequence(port, seq, size, hub->IsLogicInverted(), 250);
    if (ret != DEVICE_OK)
       return ret;
 
-   MM::MMTime startTime = GetCurrentMMTime();
-   unsigned long bytesRead = 0;
-   unsigned char answer[2];
-   while ((bytesRead < 2) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-      unsigned long br;
-      ret = hub->ReadFromComPortH(answer + bytesRead, 2, br);
-      if (ret != DEVICE_OK)
-         return ret;
-      bytesRead += br;
-   }
-   if (answer[0] != 6)
-      return ERR_COMMUNICATION;
+   std::ostringstream os;
+   os << "Loaded " << size << " patterns in " <<
+      (GetCurrentMMTime() - startTime).getMsec() << " ms";
+   LogMessage(os.str().c_str(), true);
 
    return DEVICE_OK;
 }
@@ -662,10 +643,9 @@ int CArduinoSwitch::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
          seq[i] = (unsigned char) val;
       }                                                                      
       int ret = LoadSequence((unsigned) sequence.size(), seq);
-      if (ret != DEVICE_OK)                                                  
-         return ret;                                                         
-                                                                             
-      delete[] seq;                                                          
+      delete[] seq;
+      if (ret != DEVICE_OK)
+         return ret;
    }                                                                         
    else if (eAct == MM::StartSequence)
    { 
@@ -678,16 +658,10 @@ int CArduinoSwitch::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
       if (ret != DEVICE_OK)
          return ret;
 
-      MM::MMTime startTime = GetCurrentMMTime();
-      unsigned long bytesRead = 0;
       unsigned char answer[1];
-      while ((bytesRead < 1) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-         unsigned long br;
-         ret = hub->ReadFromComPortH(answer + bytesRead, 1, br);
-         if (ret != DEVICE_OK)
-            return ret;
-         bytesRead += br;
-      }
+      ret = hub->ReadExactlyFromComPortH(answer, 1, 250);
+      if (ret != DEVICE_OK)
+         return ret;
       if (answer[0] != 8)
          return ERR_COMMUNICATION;
    }
@@ -701,16 +675,10 @@ int CArduinoSwitch::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
       if (ret != DEVICE_OK)
          return ret;
 
-      MM::MMTime startTime = GetCurrentMMTime();
-      unsigned long bytesRead = 0;
       unsigned char answer[2];
-      while ((bytesRead < 2) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-         unsigned long br;
-         ret = hub->ReadFromComPortH(answer + bytesRead, 2, br);
-         if (ret != DEVICE_OK)
-            return ret;
-         bytesRead += br;
-      }
+      ret = hub->ReadExactlyFromComPortH(answer, 2, 250);
+      if (ret != DEVICE_OK)
+         return ret;
       if (answer[0] != 9)
          return ERR_COMMUNICATION;
 
@@ -771,16 +739,10 @@ int CArduinoSwitch::OnStartTimedOutput(MM::PropertyBase* pProp, MM::ActionType e
          if (ret != DEVICE_OK)
             return ret;
 
-         MM::MMTime startTime = GetCurrentMMTime();
-         unsigned long bytesRead = 0;
          unsigned char answer[1];
-         while ((bytesRead < 1) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-            unsigned long br;
-            ret = hub->ReadFromComPortH(answer + bytesRead, 1, br);
-            if (ret != DEVICE_OK)
-               return ret;
-            bytesRead += br;
-         }
+         ret = hub->ReadExactlyFromComPortH(answer, 1, 250);
+         if (ret != DEVICE_OK)
+            return ret;
          if (answer[0] != 12)
             return ERR_COMMUNICATION;
          hub->SetTimedOutput(true);
@@ -791,16 +753,10 @@ int CArduinoSwitch::OnStartTimedOutput(MM::PropertyBase* pProp, MM::ActionType e
          if (ret != DEVICE_OK)
             return ret;
 
-         MM::MMTime startTime = GetCurrentMMTime();
-         unsigned long bytesRead = 0;
          unsigned char answer[2];
-         while ((bytesRead < 2) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-            unsigned long br;
-            ret = hub->ReadFromComPortH(answer + bytesRead, 2, br);
-            if (ret != DEVICE_OK)
-               return ret;
-            bytesRead += br;
-         }
+         ret = hub->ReadExactlyFromComPortH(answer, 2, 250);
+         if (ret != DEVICE_OK)
+            return ret;
          if (answer[0] != 9)
             return ERR_COMMUNICATION;
          hub->SetTimedOutput(false);
@@ -837,16 +793,10 @@ int CArduinoSwitch::OnBlanking(MM::PropertyBase* pProp, MM::ActionType eAct)
          if (ret != DEVICE_OK)
             return ret;
 
-         MM::MMTime startTime = GetCurrentMMTime();
-         unsigned long bytesRead = 0;
          unsigned char answer[1];
-         while ((bytesRead < 1) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-            unsigned long br;
-            ret = hub->ReadFromComPortH(answer + bytesRead, 1, br);
-            if (ret != DEVICE_OK)
-               return ret;
-            bytesRead += br;
-         }
+         ret = hub->ReadExactlyFromComPortH(answer, 1, 250);
+         if (ret != DEVICE_OK)
+            return ret;
          if (answer[0] != 20)
             return ERR_COMMUNICATION;
          blanking_ = true;
@@ -860,16 +810,10 @@ int CArduinoSwitch::OnBlanking(MM::PropertyBase* pProp, MM::ActionType eAct)
          if (ret != DEVICE_OK)
             return ret;
 
-         MM::MMTime startTime = GetCurrentMMTime();
-         unsigned long bytesRead = 0;
          unsigned char answer[2];
-         while ((bytesRead < 2) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-            unsigned long br;
-            ret = hub->ReadFromComPortH(answer + bytesRead, 2, br);
-            if (ret != DEVICE_OK)
-               return ret;
-            bytesRead += br;
-         }
+         ret = hub->ReadExactlyFromComPortH(answer, 2, 250);
+         if (ret != DEVICE_OK)
+            return ret;
          if (answer[0] != 21)
             return ERR_COMMUNICATION;
          blanking_ = false;
@@ -909,16 +853,10 @@ int CArduinoSwitch::OnBlankingTriggerDirection(MM::PropertyBase* pProp, MM::Acti
       if (ret != DEVICE_OK)
          return ret;
 
-      MM::MMTime startTime = GetCurrentMMTime();
-      unsigned long bytesRead = 0;
       unsigned char answer[1];
-      while ((bytesRead < 1) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-         unsigned long br;
-         ret = hub->ReadFromComPortH(answer + bytesRead, 1, br);
-         if (ret != DEVICE_OK)
-            return ret;
-         bytesRead += br;
-      }
+      ret = hub->ReadExactlyFromComPortH(answer, 1, 250);
+      if (ret != DEVICE_OK)
+         return ret;
       if (answer[0] != 22)
          return ERR_COMMUNICATION;
 
@@ -966,16 +904,10 @@ int CArduinoSwitch::OnRepeatTimedPattern(MM::PropertyBase* pProp, MM::ActionType
       if (ret != DEVICE_OK)
          return ret;
 
-      MM::MMTime startTime = GetCurrentMMTime();
-      unsigned long bytesRead = 0;
       unsigned char answer[2];
-      while ((bytesRead < 2) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-         unsigned long br;
-         ret = hub->ReadFromComPortH(answer + bytesRead, 2, br);
-         if (ret != DEVICE_OK)
-            return ret;
-         bytesRead += br;
-      }
+      ret = hub->ReadExactlyFromComPortH(answer, 2, 250);
+      if (ret != DEVICE_OK)
+         return ret;
       if (answer[0] != 11)
          return ERR_COMMUNICATION;
 
@@ -1101,16 +1033,10 @@ int CArduinoDA::WriteToPort(unsigned long value)
    if (ret != DEVICE_OK)
       return ret;
 
-   MM::MMTime startTime = GetCurrentMMTime();
-   unsigned long bytesRead = 0;
    unsigned char answer[4];
-   while ((bytesRead < 4) && ( (GetCurrentMMTime() - startTime).getMsec() < 2500)) {
-      unsigned long bR;
-      ret = hub->ReadFromComPortH(answer + bytesRead, 4 - bytesRead, bR);
-      if (ret != DEVICE_OK)
-         return ret;
-      bytesRead += bR;
-   }
+   ret = hub->ReadExactlyFromComPortH(answer, 4, 2500);
+   if (ret != DEVICE_OK)
+      return ret;
    if (answer[0] != 3)
       return ERR_COMMUNICATION;
 
@@ -1352,14 +1278,10 @@ int CArduinoShutter::WriteToPort(long value)
    if (ret != DEVICE_OK)
       return ret;
 
-   MM::MMTime startTime = GetCurrentMMTime();
-   unsigned long bytesRead = 0;
    unsigned char answer[1];
-   while ((bytesRead < 1) && ( (GetCurrentMMTime() - startTime).getMsec() < 250)) {
-      ret = hub->ReadFromComPortH(answer, 1, bytesRead);
-      if (ret != DEVICE_OK)
-         return ret;
-   }
+   ret = hub->ReadExactlyFromComPortH(answer, 1, 250);
+   if (ret != DEVICE_OK)
+      return ret;
    if (answer[0] != 1)
       return ERR_COMMUNICATION;
 
@@ -1564,6 +1486,11 @@ int CArduinoInput::ReportStateChange(long newState)
    return OnPropertyChanged("DigitalInput", os.str().c_str());
 }
 
+void CArduinoInput::ReportReadTimeout()
+{
+   LogMessage("Timed out reading the digital input; will try again", true);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Action handlers
@@ -1655,17 +1582,11 @@ int CArduinoInput::SetPullUp(int pin, int state)
 
 int CArduinoInput::ReadNBytes(CArduinoHub* hub, unsigned int n, unsigned char* answer)
 {
-   MM::MMTime startTime = GetCurrentMMTime();
-   unsigned long bytesRead = 0;
-   while ((bytesRead < n) && ( (GetCurrentMMTime() - startTime).getMsec() < 500)) {
-      unsigned long bR;
-      int ret = hub->ReadFromComPortH(answer + bytesRead, n - bytesRead, bR);
-      if (ret != DEVICE_OK)
-         return ret;
-      bytesRead += bR;
-   }
-
-   return DEVICE_OK;
+   int ret = hub->ReadExactlyFromComPortH(answer, n, 500);
+   // Discard a partial answer, so that it is not taken for the next one
+   if (ret == DEVICE_SERIAL_TIMEOUT)
+      hub->PurgeComPortH();
+   return ret;
 }
 
 ArduinoInputMonitorThread::ArduinoInputMonitorThread(CArduinoInput& aInput) :
@@ -1686,6 +1607,13 @@ int ArduinoInputMonitorThread::svc()
    {
       long state;
       int ret = aInput_.GetDigitalInput(&state);
+      if (ret == DEVICE_SERIAL_TIMEOUT)
+      {
+         // A lost answer does not end monitoring
+         aInput_.ReportReadTimeout();
+         CDeviceUtils::SleepMs(500);
+         continue;
+      }
       if (ret != DEVICE_OK)
       {
          stop_ = true;
@@ -68,6 +68,11 @@ public:
    {
       return ReadFromComPort(port_.c_str(), answer, maxLen, bytesRead);
    }
+   int ReadExactlyFromComPortH(unsigned char* answer, unsigned len, long timeoutMs)
+   {
+      unsigned long bytesRead;
+      return ReadExactlyFromComPort(port_.c_str(), answer, len, timeoutMs, bytesRead);
+   }
    static MMThreadLock& GetLock() {return lock_;}
    void SetShutterState(unsigned state) {shutterState_ = state;}
    void SetSwitchState(unsigned state) {switchState_ = state;}
@@ -231,6 +236,7 @@ public:
 
    int GetDigitalInput(long* state);
    int ReportStateChange(long newState);
+   void ReportReadTimeout();
 
 private:
    int ReadNBytes(CArduinoHub* h, unsigned int n, unsigned char* answer);
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ArduinoSequence.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Upload of digital output pattern sequences to the Arduino
+//                firmware, independent of the serial port implementation
+// LICENSE:       LGPL
+//
+
+#include "ArduinoSequence.h"
+#include "Arduino.h"
+
+#include <vector>
+
+
+int UploadSwitchSequence(ArduinoPort& port, const unsigned char* seq,
+      unsigned size, bool invertedLogic, long timeoutMs)
+{
+   std::vector<unsigned char> command;
+   std::vector<unsigned char> expected;
+   command.reserve(3 * size + 2);
+   expected.reserve(3 * size + 2);
+
+   for (unsigned i = 0; i < size; i++)
+   {
+      unsigned char value = 63 & seq[i];
+      if (invertedLogic)
+         value = ~value;
+
+      command.push_back(5);
+      command.push_back((unsigned char) i);
+      command.push_back(value);
+
+      // The firmware echoes the pattern as stored, i.e. masked to 6 bits
+      expected.push_back(5);
+      expected.push_back((unsigned char) i);
+      expected.push_back(63 & value);
+   }
+   command.push_back(6);
+   command.push_back((unsigned char) size);
+   expected.push_back(6);
+   expected.push_back((unsigned char) size);
+
+   int ret = port.Write(&command[0], (unsigned) command.size());
+   if (ret != DEVICE_OK)
+      return ret;
+
+   // A rejected command is answered with "n:" instead of its echo, so any
+   // error shows up either as a mismatch or as a short (timed out) reply
+   std::vector<unsigned char> answer(expected.size());
+   ret = port.ReadExactly(&answer[0], (unsigned) answer.size(), timeoutMs);
+   if (ret == DEVICE_SERIAL_TIMEOUT)
+      return ERR_COMMUNICATION;
+   if (ret != DEVICE_OK)
+      return ret;
+   if (answer != expected)
+      return ERR_COMMUNICATION;
+
+   return DEVICE_OK;
+}
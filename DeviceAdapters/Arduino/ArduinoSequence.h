@@ -0,0 +1,36 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ArduinoSequence.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Upload of digital output pattern sequences to the Arduino
+//                firmware, independent of the serial port implementation
+// LICENSE:       LGPL
+//
+
+#pragma once
+
+// Byte transport to the firmware. The hub implements this on top of its
+// serial port; the unit tests implement it on top of a pseudo-terminal.
+class ArduinoPort
+{
+public:
+   virtual ~ArduinoPort() {}
+
+   virtual int Write(const unsigned char* data, unsigned len) = 0;
+
+   // Read exactly len bytes. Returns DEVICE_SERIAL_TIMEOUT if they have not
+   // all arrived within timeoutMs.
+   virtual int ReadExactly(unsigned char* data, unsigned len, long timeoutMs) = 0;
+};
+
+// Loads seq[0..size) into the firmware's trigger pattern table and sets the
+// sequence length (firmware commands 5 and 6).
+//
+// All commands are written back-to-back and the acknowledgements are read
+// and checked as one batch, so that the upload costs a single round trip
+// instead of one per pattern. The whole batch (3 bytes per pattern plus 2)
+// must fit in the Arduino's 64-byte serial receive buffer, which holds for
+// the firmware's maximum of 12 patterns.
+int UploadSwitchSequence(ArduinoPort& port, const unsigned char* seq,
+      unsigned size, bool invertedLogic, long timeoutMs);
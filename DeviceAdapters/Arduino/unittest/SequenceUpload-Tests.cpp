@@ -0,0 +1,318 @@
+// DESCRIPTION:   Unit tests for the Arduino switch sequence upload, using a
+//                pseudo-terminal and a simulation of the AOTFcontroller
+//                firmware in place of the board
+//
+// LICENSE:       LGPL
+
+#include <gtest/gtest.h>
+
+#include "Arduino.h"
+#include "ArduinoSequence.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+// The adapter's end of the link: the master side of a pseudo-terminal
+class PtyPort : public ArduinoPort
+{
+   int fd_;
+
+public:
+   explicit PtyPort(int fd) : fd_(fd) {}
+
+   int Write(const unsigned char* data, unsigned len)
+   {
+      if (write(fd_, data, len) != static_cast<ssize_t>(len))
+         return ERR_WRITE_FAILED;
+      return DEVICE_OK;
+   }
+
+   int ReadExactly(unsigned char* data, unsigned len, long timeoutMs)
+   {
+      const boost::posix_time::ptime deadline =
+         boost::posix_time::microsec_clock::universal_time() +
+         boost::posix_time::milliseconds(timeoutMs);
+      unsigned bytesRead = 0;
+      while (bytesRead < len)
+      {
+         const long remainingMs = (deadline -
+               boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+         if (remainingMs <= 0)
+            return DEVICE_SERIAL_TIMEOUT;
+         pollfd pfd = { fd_, POLLIN, 0 };
+         if (poll(&pfd, 1, static_cast<int>(remainingMs)) <= 0)
+            continue;
+         const ssize_t n = read(fd_, data + bytesRead, len - bytesRead);
+         if (n < 0)
+            return ERR_COMMUNICATION;
+         bytesRead += static_cast<unsigned>(n);
+      }
+      return DEVICE_OK;
+   }
+};
+
+// Plays the firmware on the slave side of the pseudo-terminal. Handles
+// commands 5 and 6 as AOTFcontroller.ino does. Each batch of bytes that
+// arrives is held for latencyMs before being processed, which stands in for
+// the USB-serial converter's latency.
+class FirmwareSimulator
+{
+   int fd_;
+   long latencyMs_;
+   bool rejectPatterns_;
+   boost::mutex mutex_;
+   std::vector<unsigned char> patterns_;
+   int patternLength_;
+   int batches_;
+   bool stop_;
+   boost::thread thread_;
+
+public:
+   FirmwareSimulator(const char* slaveName, long latencyMs) :
+      fd_(open(slaveName, O_RDWR | O_NOCTTY)),
+      latencyMs_(latencyMs),
+      rejectPatterns_(false),
+      patterns_(12, 0),
+      patternLength_(0),
+      batches_(0),
+      stop_(false)
+   {
+      termios tio;
+      if (fd_ >= 0 && tcgetattr(fd_, &tio) == 0)
+      {
+         cfmakeraw(&tio);
+         tcsetattr(fd_, TCSANOW, &tio);
+      }
+   }
+
+   ~FirmwareSimulator()
+   {
+      {
+         boost::lock_guard<boost::mutex> g(mutex_);
+         stop_ = true;
+      }
+      thread_.join();
+      if (fd_ >= 0)
+         close(fd_);
+   }
+
+   bool IsOpen() const { return fd_ >= 0; }
+   void Start() { thread_ = boost::thread(&FirmwareSimulator::Run, this); }
+   void RejectPatterns() { rejectPatterns_ = true; }
+
+   std::vector<unsigned char> Patterns()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return patterns_;
+   }
+
+   int PatternLength()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return patternLength_;
+   }
+
+   int Batches()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return batches_;
+   }
+
+private:
+   bool Stopping()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return stop_;
+   }
+
+   void Run()
+   {
+      std::deque<unsigned char> input;
+      while (!Stopping())
+      {
+         pollfd pfd = { fd_, POLLIN, 0 };
+         if (poll(&pfd, 1, 10) <= 0)
+            continue;
+         unsigned char buf[256];
+         const ssize_t n = read(fd_, buf, sizeof(buf));
+         if (n <= 0)
+            continue;
+         input.insert(input.end(), buf, buf + n);
+
+         boost::this_thread::sleep(boost::posix_time::milliseconds(latencyMs_));
+         {
+            boost::lock_guard<boost::mutex> g(mutex_);
+            ++batches_;
+         }
+         Process(input);
+      }
+   }
+
+   void Process(std::deque<unsigned char>& input)
+   {
+      std::vector<unsigned char> reply;
+      while (!input.empty())
+      {
+         const unsigned char cmd = input[0];
+         const size_t needed = cmd == 5 ? 3 : cmd == 6 ? 2 : 1;
+         if (input.size() < needed)
+            break;
+
+         boost::lock_guard<boost::mutex> g(mutex_);
+         if (cmd == 5)
+         {
+            const unsigned char index = input[1];
+            if (index < patterns_.size() && !rejectPatterns_)
+            {
+               patterns_[index] = input[2] & 0x3F;
+               reply.push_back(5);
+               reply.push_back(index);
+               reply.push_back(patterns_[index]);
+            }
+            else
+            {
+               reply.push_back('n');
+               reply.push_back(':');
+            }
+         }
+         else if (cmd == 6 && input[1] <= 12)
+         {
+            patternLength_ = input[1];
+            reply.push_back(6);
+            reply.push_back(input[1]);
+         }
+         input.erase(input.begin(), input.begin() + needed);
+      }
+      if (!reply.empty())
+         ASSERT_EQ(static_cast<ssize_t>(reply.size()),
+               write(fd_, &reply[0], reply.size()));
+   }
+};
+
+class SequenceUploadTest : public ::testing::Test
+{
+protected:
+   int masterFd_;
+   std::string slaveName_;
+
+   virtual void SetUp()
+   {
+      masterFd_ = posix_openpt(O_RDWR | O_NOCTTY);
+      ASSERT_LE(0, masterFd_);
+      ASSERT_EQ(0, grantpt(masterFd_));
+      ASSERT_EQ(0, unlockpt(masterFd_));
+      slaveName_ = ptsname(masterFd_);
+   }
+
+   virtual void TearDown()
+   {
+      if (masterFd_ >= 0)
+         close(masterFd_);
+   }
+};
+
+const long latencyMs = 20;
+
+} // anonymous namespace
+
+
+TEST_F(SequenceUploadTest, StoresPatternsAndLength)
+{
+   FirmwareSimulator firmware(slaveName_.c_str(), latencyMs);
+   ASSERT_TRUE(firmware.IsOpen());
+   firmware.Start();
+   PtyPort port(masterFd_);
+
+   const unsigned char seq[] = { 1, 2, 4, 8, 16, 32, 63, 0, 13, 10, 17, 255 };
+   const unsigned size = sizeof(seq);
+   ASSERT_EQ(DEVICE_OK, UploadSwitchSequence(port, seq, size, false, 1000));
+
+   const std::vector<unsigned char> patterns = firmware.Patterns();
+   for (unsigned i = 0; i < size; ++i)
+      EXPECT_EQ(seq[i] & 63, patterns[i]) << "pattern " << i;
+   EXPECT_EQ(static_cast<int>(size), firmware.PatternLength());
+}
+
+TEST_F(SequenceUploadTest, InvertedLogic)
+{
+   FirmwareSimulator firmware(slaveName_.c_str(), latencyMs);
+   ASSERT_TRUE(firmware.IsOpen());
+   firmware.Start();
+   PtyPort port(masterFd_);
+
+   const unsigned char seq[] = { 0, 1, 62, 63 };
+   ASSERT_EQ(DEVICE_OK, UploadSwitchSequence(port, seq, 4, true, 1000));
+
+   const std::vector<unsigned char> patterns = firmware.Patterns();
+   EXPECT_EQ(63, patterns[0]);
+   EXPECT_EQ(62, patterns[1]);
+   EXPECT_EQ(1, patterns[2]);
+   EXPECT_EQ(0, patterns[3]);
+   EXPECT_EQ(4, firmware.PatternLength());
+}
+
+TEST_F(SequenceUploadTest, RejectedPatternIsAnError)
+{
+   FirmwareSimulator firmware(slaveName_.c_str(), latencyMs);
+   ASSERT_TRUE(firmware.IsOpen());
+   firmware.RejectPatterns();
+   firmware.Start();
+   PtyPort port(masterFd_);
+
+   const unsigned char seq[] = { 1, 2, 3 };
+   EXPECT_EQ(ERR_COMMUNICATION, UploadSwitchSequence(port, seq, 3, false, 500));
+}
+
+TEST_F(SequenceUploadTest, NoResponseIsAnError)
+{
+   // Opened (so that the line is in raw mode and does not echo) but silent
+   FirmwareSimulator firmware(slaveName_.c_str(), latencyMs);
+   ASSERT_TRUE(firmware.IsOpen());
+   PtyPort port(masterFd_);
+   const unsigned char seq[] = { 1 };
+   EXPECT_EQ(ERR_COMMUNICATION, UploadSwitchSequence(port, seq, 1, false, 100));
+}
+
+// Uploading pattern by pattern waited for each echo, costing one latency per
+// pattern plus one for the length; the batch should cost about one in total.
+TEST_F(SequenceUploadTest, UploadTime)
+{
+   FirmwareSimulator firmware(slaveName_.c_str(), latencyMs);
+   ASSERT_TRUE(firmware.IsOpen());
+   firmware.Start();
+   PtyPort port(masterFd_);
+
+   const unsigned char seq[12] = { 0 };
+   const boost::posix_time::ptime start =
+      boost::posix_time::microsec_clock::universal_time();
+   ASSERT_EQ(DEVICE_OK, UploadSwitchSequence(port, seq, 12, false, 1000));
+   const long elapsedMs = (boost::posix_time::microsec_clock::universal_time() -
+         start).total_milliseconds();
+
+   std::cout << "12 patterns at " << latencyMs << " ms latency: " <<
+      elapsedMs << " ms in " << firmware.Batches() << " batch(es); " <<
+      "one round trip per pattern would take at least " << 13 * latencyMs <<
+      " ms\n";
+   EXPECT_LT(elapsedMs, 13 * latencyMs / 2);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
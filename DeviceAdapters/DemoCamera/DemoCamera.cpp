@@ -53,6 +53,7 @@ const char* g_ShutterDeviceName = "DShutter";
 const char* g_DADeviceName = "D-DA";
 const char* g_DA2DeviceName = "D-DA2";
 const char* g_GalvoDeviceName = "DGalvo";
+const char* g_SLMDeviceName = "DSLM";
 const char* g_MagnifierDeviceName = "DOptovar";
 const char* g_HubDeviceName = "DHub";
 
@@ -89,6 +90,7 @@ MODULE_API void InitializeModuleData()
    RegisterDevice(g_DA2DeviceName, MM::SignalIODevice, "Demo DA-2");
    RegisterDevice(g_MagnifierDeviceName, MM::MagnifierDevice, "Demo Optovar");
    RegisterDevice(g_GalvoDeviceName, MM::GalvoDevice, "Demo Galvo");
+   RegisterDevice(g_SLMDeviceName, MM::SLMDevice, "Demo SLM");
    RegisterDevice("TransposeProcessor", MM::ImageProcessorDevice, "TransposeProcessor");
    RegisterDevice("ImageFlipX", MM::ImageProcessorDevice, "ImageFlipX");
    RegisterDevice("ImageFlipY", MM::ImageProcessorDevice, "ImageFlipY");
@@ -167,6 +169,10 @@ MODULE_API MM::Device* CreateDevice(const char* deviceName)
       // create Galvo 
       return new DemoGalvo();
    }
+   else if (strcmp(deviceName, g_SLMDeviceName) == 0)
+   {
+      return new DemoSLM();
+   }
 
    else if(strcmp(deviceName, "TransposeProcessor") == 0)
    {
@@ -244,15 +250,32 @@ CDemoCamera::CDemoCamera() :
    multiROIFillValue_(0),
    nComponents_(1),
    mode_(MODE_ARTIFICIAL_WAVES),
-   imgManpl_(0),
    pcf_(1.0),
    photonFlux_(50.0),
-   readNoise_(2.5)
+   readNoise_(2.5),
+   burstStartTrigger_(MM::g_TriggerType_Software),
+   burstEndTrigger_(MM::g_TriggerType_Internal),
+   frameStartTrigger_(MM::g_TriggerType_Internal),
+   exposureEndTrigger_(MM::g_TriggerType_Internal),
+   frameExposureMode_(MM::g_FrameExposureMode_Distinct),
+   preFrameDelayMs_(0.0),
+   postFrameDelayMs_(0.0),
+   burstLength_(1),
+   burstFramesTaken_(0),
+   burstArmed_(false),
+   burstStarted_(false),
+   nextFrameReadyTime_(0),
+   rollingShutterLineOffsetUs_(10.0),
+   rollingShutterActiveLines_(1)
 {
    memset(testProperty_,0,sizeof(testProperty_));
 
    // call the base class method to set-up default error codes/messages
    InitializeDefaultErrorMessages();
+   SetErrorText(ERR_BURST_NOT_ARMED, "Camera is not armed for a burst, or the burst has already started");
+   SetErrorText(ERR_BURST_NOT_STARTED, "Burst has not started");
+   SetErrorText(ERR_TRIGGER_NOT_SOFTWARE, "Trigger type is not \"software\"");
+   SetErrorText(ERR_TRIGGER_UNSUPPORTED, "The demo camera can only simulate internal and software triggers, and needs the number of images for an internal burst end");
    readoutStartTime_ = GetCurrentMMTime();
    thd_ = new MySequenceThread(this);
 
@@ -1055,11 +1078,23 @@ int CDemoCamera::StartSequenceAcquisition(double interval)
 */                                                                        
 int CDemoCamera::StopSequenceAcquisition()                                     
 {
+   // Also aborts a burst, armed or started
+   bool softwareFrames;
+   {
+      MMThreadGuard g(burstLock_);
+      softwareFrames = burstStarted_ &&
+         frameStartTrigger_ != MM::g_TriggerType_Internal;
+      burstArmed_ = false;
+      burstStarted_ = false;
+   }
+
    if (!thd_->IsStopped()) {
       thd_->Stop();                                                       
       thd_->wait();                                                       
    }                                                                      
-                                                                          
+   // Without the sequence thread, nothing else notifies the Core
+   if (softwareFrames)
+      return GetCoreCallback()->AcqFinished(this, 0);
    return DEVICE_OK;                                                      
 } 
 
@@ -1095,10 +1130,12 @@ int CDemoCamera::InsertImage()
    // Important:  metadata about the image are generated here:
    Metadata md;
    md.put("Camera", label);
-   md.put(MM::g_Keyword_Metadata_StartTime, CDeviceUtils::ConvertToString(sequenceStartTime_.getMsec()));
-   md.put(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::ConvertToString((timeStamp - sequenceStartTime_).getMsec()));
-   md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::ConvertToString( (long) roiX_)); 
-   md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::ConvertToString( (long) roiY_)); 
+   md.put(MM::g_Keyword_Metadata_StartTime, CDeviceUtils::FormatNumber(sequenceStartTime_.getMsec()));
+   md.put(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::FormatNumber((timeStamp - sequenceStartTime_).getMsec()));
+   md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::FormatNumber( (long) roiX_)); 
+   md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::FormatNumber( (long) roiY_)); 
+   md.put(MM::g_Keyword_Metadata_HardwareFrameNumber, CDeviceUtils::FormatNumber(imageCounter_));
+   md.put(MM::g_Keyword_Metadata_HardwareTimestamp_us, CDeviceUtils::FormatNumber((timeStamp - sequenceStartTime_).getUsec()));
 
    imageCounter_++;
 
@@ -1136,6 +1173,18 @@ int CDemoCamera::InsertImage()
 int CDemoCamera::RunSequenceOnThread()
 {
    int ret=DEVICE_ERR;
+   double preFrameDelayMs = 0.0;
+   double postFrameDelayMs = 0.0;
+   {
+      MMThreadGuard g(burstLock_);
+      if (burstStarted_)
+      {
+         preFrameDelayMs = preFrameDelayMs_;
+         postFrameDelayMs = postFrameDelayMs_;
+      }
+   }
+   SimulateDelay(preFrameDelayMs);
+
    MM::MMTime startTime = GetCurrentMMTime();
    
    // Trigger
@@ -1166,10 +1215,16 @@ int CDemoCamera::RunSequenceOnThread()
    {
       return ret;
    }
+   SimulateDelay(postFrameDelayMs);
    return ret;
 };
 
 bool CDemoCamera::IsCapturing() {
+   {
+      MMThreadGuard g(burstLock_);
+      if (burstArmed_)
+         return true;
+   }
    return !thd_->IsStopped();
 }
 
@@ -1180,6 +1235,11 @@ void CDemoCamera::OnThreadExiting() throw()
 {
    try
    {
+      {
+         MMThreadGuard g(burstLock_);
+         burstArmed_ = false;
+         burstStarted_ = false;
+      }
       LogMessage(g_Msg_SEQUENCE_ACQUISITION_THREAD_EXITING);
       GetCoreCallback()?GetCoreCallback()->AcqFinished(this,0):DEVICE_OK;
    }
@@ -1190,6 +1250,292 @@ void CDemoCamera::OnThreadExiting() throw()
 }
 
 
+namespace
+{
+   bool IsSimulatedTriggerType(const char* type)
+   {
+      return type != 0 && (strcmp(type, MM::g_TriggerType_Internal) == 0 ||
+            strcmp(type, MM::g_TriggerType_Software) == 0);
+   }
+}
+
+int CDemoCamera::SetPreFrameDelay(double delay_ms)
+{
+   if (delay_ms < 0.0)
+      return DEVICE_INVALID_INPUT_PARAM;
+   MMThreadGuard g(burstLock_);
+   preFrameDelayMs_ = delay_ms;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SetPostFrameDelay(double delay_ms)
+{
+   if (delay_ms < 0.0)
+      return DEVICE_INVALID_INPUT_PARAM;
+   MMThreadGuard g(burstLock_);
+   postFrameDelayMs_ = delay_ms;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SetBurstStartTriggerType(const char* type)
+{
+   if (IsCapturing())
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+   if (!IsSimulatedTriggerType(type))
+      return ERR_TRIGGER_UNSUPPORTED;
+   MMThreadGuard g(burstLock_);
+   burstStartTrigger_ = type;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SetBurstEndTriggerType(const char* type)
+{
+   if (IsCapturing())
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+   if (!IsSimulatedTriggerType(type))
+      return ERR_TRIGGER_UNSUPPORTED;
+   MMThreadGuard g(burstLock_);
+   burstEndTrigger_ = type;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SetFrameStartTriggerType(const char* type)
+{
+   if (IsCapturing())
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+   if (!IsSimulatedTriggerType(type))
+      return ERR_TRIGGER_UNSUPPORTED;
+   MMThreadGuard g(burstLock_);
+   frameStartTrigger_ = type;
+   return DEVICE_OK;
+}
+
+/*
+ * The exposure always ends after the exposure time.
+ */
+int CDemoCamera::SetExposureEndTriggerType(const char* type)
+{
+   if (IsCapturing())
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+   if (type == 0 || strcmp(type, MM::g_TriggerType_Internal) != 0)
+      return ERR_TRIGGER_UNSUPPORTED;
+   MMThreadGuard g(burstLock_);
+   exposureEndTrigger_ = type;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::GetBurstStartTriggerType(char* type)
+{
+   MMThreadGuard g(burstLock_);
+   CDeviceUtils::CopyLimitedString(type, burstStartTrigger_.c_str());
+   return DEVICE_OK;
+}
+
+int CDemoCamera::GetFrameStartTriggerType(char* type)
+{
+   MMThreadGuard g(burstLock_);
+   CDeviceUtils::CopyLimitedString(type, frameStartTrigger_.c_str());
+   return DEVICE_OK;
+}
+
+/*
+ * Only applies to external triggers, so it is only kept.
+ */
+int CDemoCamera::SetFrameExposureMode(const char* mode)
+{
+   if (mode == 0)
+      return DEVICE_INVALID_INPUT_PARAM;
+   MMThreadGuard g(burstLock_);
+   frameExposureMode_ = mode;
+   return DEVICE_OK;
+}
+
+/*
+ * Arms the camera for a burst, and starts it right away if the burst start
+ * trigger is internal. A burst of numImages frames ends after the last
+ * frame, or earlier on a software burst end trigger.
+ */
+int CDemoCamera::PrepareForBurst(int numImages)
+{
+   if (IsCapturing())
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+   if (numImages < 1 && numImages != -1)
+      return DEVICE_INVALID_INPUT_PARAM;
+
+   bool startNow;
+   {
+      MMThreadGuard g(burstLock_);
+      if (numImages == -1 && burstEndTrigger_ == MM::g_TriggerType_Internal)
+         return ERR_TRIGGER_UNSUPPORTED;
+      burstLength_ = numImages;
+      burstFramesTaken_ = 0;
+      burstArmed_ = true;
+      burstStarted_ = false;
+      startNow = burstStartTrigger_ == MM::g_TriggerType_Internal;
+   }
+
+   if (startNow)
+   {
+      int ret = StartBurst();
+      if (ret != DEVICE_OK)
+      {
+         MMThreadGuard g(burstLock_);
+         burstArmed_ = false;
+         return ret;
+      }
+   }
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SendBurstStartTrigger()
+{
+   {
+      MMThreadGuard g(burstLock_);
+      if (burstStartTrigger_ != MM::g_TriggerType_Software)
+         return ERR_TRIGGER_NOT_SOFTWARE;
+      if (!burstArmed_ || burstStarted_)
+         return ERR_BURST_NOT_ARMED;
+   }
+   return StartBurst();
+}
+
+/*
+ * Takes one frame, blocking for its exposure. Triggers sent during the
+ * post-frame delay of the previous frame wait for the delay to end.
+ */
+int CDemoCamera::SendFrameStartTrigger()
+{
+   double waitMs;
+   double postFrameDelayMs;
+   {
+      MMThreadGuard g(burstLock_);
+      if (frameStartTrigger_ != MM::g_TriggerType_Software)
+         return ERR_TRIGGER_NOT_SOFTWARE;
+      if (!burstStarted_)
+         return ERR_BURST_NOT_STARTED;
+      waitMs = (nextFrameReadyTime_ - GetCurrentMMTime()).getMsec();
+      waitMs = (std::max)(0.0, waitMs) + preFrameDelayMs_;
+      postFrameDelayMs = postFrameDelayMs_;
+   }
+   SimulateDelay(waitMs);
+
+   int ret = SnapImage();
+   if (ret == DEVICE_OK)
+      ret = InsertImage();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   bool complete;
+   {
+      MMThreadGuard g(burstLock_);
+      nextFrameReadyTime_ = GetCurrentMMTime() + MM::MMTime(postFrameDelayMs * 1000.0);
+      complete = burstLength_ > 0 && ++burstFramesTaken_ >= burstLength_;
+   }
+   if (complete)
+      return EndBurst();
+   return DEVICE_OK;
+}
+
+/*
+ * Ends the burst. Does nothing if it has already ended.
+ */
+int CDemoCamera::SendBurstEndTrigger()
+{
+   {
+      MMThreadGuard g(burstLock_);
+      if (burstEndTrigger_ != MM::g_TriggerType_Software)
+         return ERR_TRIGGER_NOT_SOFTWARE;
+   }
+   return EndBurst();
+}
+
+int CDemoCamera::GetRollingShutterLineOffset(double& offset_us)
+{
+   offset_us = rollingShutterLineOffsetUs_;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SetRollingShutterLineOffset(double offset_us)
+{
+   if (offset_us < 0.0)
+      return DEVICE_INVALID_INPUT_PARAM;
+   rollingShutterLineOffsetUs_ = offset_us;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::GetRollingShutterActiveLines(int& numLines)
+{
+   numLines = rollingShutterActiveLines_;
+   return DEVICE_OK;
+}
+
+int CDemoCamera::SetRollingShutterActiveLines(int numLines)
+{
+   if (numLines < 1 || numLines > static_cast<int>(GetImageHeight()))
+      return DEVICE_INVALID_INPUT_PARAM;
+   rollingShutterActiveLines_ = numLines;
+   return DEVICE_OK;
+}
+
+/*
+ * Starts an armed burst: internally triggered frames are taken by the
+ * sequence thread, software triggered ones by SendFrameStartTrigger().
+ */
+int CDemoCamera::StartBurst()
+{
+   int ret = GetCoreCallback()->PrepareForAcq(this);
+   if (ret != DEVICE_OK)
+      return ret;
+   sequenceStartTime_ = GetCurrentMMTime();
+   imageCounter_ = 0;
+   stopOnOverflow_ = false;
+
+   bool internalFrames;
+   long length;
+   {
+      MMThreadGuard g(burstLock_);
+      burstStarted_ = true;
+      burstFramesTaken_ = 0;
+      nextFrameReadyTime_ = sequenceStartTime_;
+      internalFrames = frameStartTrigger_ == MM::g_TriggerType_Internal;
+      length = burstLength_;
+   }
+   if (internalFrames)
+      thd_->Start(length > 0 ? length : LONG_MAX, 0.0);
+   return DEVICE_OK;
+}
+
+int CDemoCamera::EndBurst()
+{
+   bool started;
+   bool internalFrames;
+   {
+      MMThreadGuard g(burstLock_);
+      started = burstStarted_;
+      internalFrames = frameStartTrigger_ == MM::g_TriggerType_Internal;
+      burstArmed_ = false;
+      burstStarted_ = false;
+   }
+   if (!started)
+      return DEVICE_OK;
+   // The sequence thread notifies the Core as it exits
+   if (internalFrames)
+      return StopSequenceAcquisition();
+   return GetCoreCallback()->AcqFinished(this, 0);
+}
+
+void CDemoCamera::SimulateDelay(double delayMs)
+{
+   if (delayMs <= 0.0)
+      return;
+   MM::MMTime startTime = GetCurrentMMTime();
+   while ((GetCurrentMMTime() - startTime).getMsec() < delayMs)
+   {
+      CDeviceUtils::SleepMs(1);
+   }
+}
+
+
 MySequenceThread::MySequenceThread(CDemoCamera* pCam)
    :intervalMs_(default_intervalMS)
    ,numImages_(default_numImages)
@@ -2070,9 +2416,10 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
 	   double readNoiseDN = readNoise_ / pcf_;
       AddBackgroundAndNoise(img, offset, readNoiseDN);
       AddSignal (img, photonFlux_, exp, pcf_);
-      if (imgManpl_ != 0)
+      for (std::vector<ImgManipulator*>::iterator it = imgManipulators_.begin();
+            it != imgManipulators_.end(); ++it)
       {
-         imgManpl_->ChangePixels(img);
+         (*it)->ChangePixels(img);
       }
       return;
    }
@@ -2663,7 +3010,18 @@ double CDemoCamera::GaussDistributedValue(double mean, double std)
 
 int CDemoCamera::RegisterImgManipulatorCallBack(ImgManipulator* imgManpl)
 {
-   imgManpl_ = imgManpl;
+   MMThreadGuard g(imgPixelsLock_);
+   if (std::find(imgManipulators_.begin(), imgManipulators_.end(), imgManpl) ==
+         imgManipulators_.end())
+      imgManipulators_.push_back(imgManpl);
+   return DEVICE_OK;
+}
+
+int CDemoCamera::UnregisterImgManipulatorCallBack(ImgManipulator* imgManpl)
+{
+   MMThreadGuard g(imgPixelsLock_);
+   imgManipulators_.erase(std::remove(imgManipulators_.begin(),
+            imgManipulators_.end(), imgManpl), imgManipulators_.end());
    return DEVICE_OK;
 }
 
@@ -2766,6 +3124,14 @@ int CDemoFilterWheel::Initialize()
 }
 
 bool CDemoFilterWheel::Busy()
+{
+   DemoHub* pHub = static_cast<DemoHub*>(GetParentHub());
+   if (pHub)
+      pHub->StatusQuery();
+   return IsMoving();
+}
+
+bool CDemoFilterWheel::IsMoving()
 {
    MM::MMTime interval = GetCurrentMMTime() - changedTime_;
    MM::MMTime delay(GetDelayMs()*1000.0);
@@ -2920,6 +3286,14 @@ int CDemoStateDevice::Initialize()
 }
 
 bool CDemoStateDevice::Busy()
+{
+   DemoHub* pHub = static_cast<DemoHub*>(GetParentHub());
+   if (pHub)
+      pHub->StatusQuery();
+   return IsMoving();
+}
+
+bool CDemoStateDevice::IsMoving()
 {
    MM::MMTime interval = GetCurrentMMTime() - changedTime_;
    MM::MMTime delay(GetDelayMs()*1000.0);
@@ -3589,6 +3963,14 @@ int CDemoXYStage::Shutdown()
 }
 
 bool CDemoXYStage::Busy()
+{
+   DemoHub* pHub = static_cast<DemoHub*>(GetParentHub());
+   if (pHub)
+      pHub->StatusQuery();
+   return IsMoving();
+}
+
+bool CDemoXYStage::IsMoving()
 {
    if (timeOutTimer_ == 0)
       return false;
@@ -3706,6 +4088,14 @@ int DemoShutter::Initialize()
 
 
 bool DemoShutter::Busy()
+{
+   DemoHub* pHub = static_cast<DemoHub*>(GetParentHub());
+   if (pHub)
+      pHub->StatusQuery();
+   return IsMoving();
+}
+
+bool DemoShutter::IsMoving()
 {
    MM::MMTime interval = GetCurrentMMTime() - changedTime_;
 
@@ -4175,17 +4565,17 @@ void DemoGalvo::GetName(char* pName) const
 }
 int DemoGalvo::Initialize() 
 {
-   // generate Gaussian kernal
-   // Size is determined in the header file
-   int xSize = sizeof(gaussianMask_) / sizeof(gaussianMask_[0]);
-   int ySize = sizeof(gaussianMask_[0]) / 2;
-   for (int x = 0; x < xSize; x++)
+   // generate Gaussian kernal, stamped onto the image for each spot
+   const int spotSize = 10;
+   std::vector<unsigned short> kernel(spotSize * spotSize);
+   for (int y = 0; y < spotSize; y++)
    { 
-      for (int y =0; y < ySize; y++) 
+      for (int x = 0; x < spotSize; x++) 
       {
-         gaussianMask_[x][y] =(unsigned short) GaussValue(41, 0.5, 0.5, xSize / 2, ySize / 2, x, y);
+         kernel[y * spotSize + x] = (unsigned short) GaussValue(41, 0.5, 0.5, spotSize / 2, spotSize / 2, x, y);
       }
    }
+   spot_.Set(spotSize, kernel);
 
    DemoHub* pHub = static_cast<DemoHub*>(GetParentHub());
    if (!pHub)
@@ -4263,8 +4653,9 @@ int DemoGalvo::SetIlluminationState(bool on)
 
 int DemoGalvo::AddPolygonVertex(int polygonIndex, double x, double y) 
 {
-   std::vector<PointD> vertex = vertices_[polygonIndex];
+   MMThreadGuard g(roiMaskLock_);
    vertices_[polygonIndex].push_back(PointD(x, y));
+   roiMaskGeometry_.clear();
    //std::ostringstream os;
    //os << "Adding point to polygon " << polygonIndex << ", x: " << x  <<
    //   ", y: " << y;
@@ -4275,16 +4666,24 @@ int DemoGalvo::AddPolygonVertex(int polygonIndex, double x, double y)
 
 int DemoGalvo::DeletePolygons()
 {
+   MMThreadGuard g(roiMaskLock_);
    vertices_.clear();
+   roiMaskGeometry_.clear();
    return DEVICE_OK;
 }
 
 /**
  * This is to load the polygons into the device
- * Since we are virtual, there is nothing to do here
+ * Since we are virtual, we rasterize them for the camera's current
+ * settings, so that the work is not done while frames are generated
  */
 int DemoGalvo::LoadPolygons()
 {
+   if (demoCamera_ != 0)
+   {
+      MMThreadGuard g(roiMaskLock_);
+      UpdateROIMask(demoCamera_->GetImageWidth(), demoCamera_->GetImageHeight());
+   }
    return DEVICE_OK;
 }
 
@@ -4358,122 +4757,38 @@ int DemoGalvo::ChangePixels(ImgBuffer& img)
 
    if (runROIS_)
    {
-      // establish the bounding boxes around the ROIs in image coordinates
-      std::vector<std::vector<Point> > bBoxes = std::vector<std::vector<
-         Point> >();
-      for (unsigned int i = 0; i < vertices_.size(); i++) {
-         std::vector<Point> vertex;
-         for (std::vector<PointD>::iterator it = vertices_[i].begin();
-               it != vertices_[i].end(); ++it)
-         {
-            Point p = GalvoToCameraPoint(*it, img);
-            vertex.push_back(p);
-         }
-         std::vector<Point> bBox;
-         GetBoundingBox(vertex, bBox);
-         bBoxes.push_back(bBox);
-         //std::ostringstream os;
-         //os << "BBox: " << bBox[0].x << ", " << bBox[0].y << ", " <<
-         //  bBox[1].x << ", " << bBox[1].y;
-         //LogMessage(os.str().c_str());
-      }
+      MMThreadGuard g(roiMaskLock_);
+      UpdateROIMask(img.Width(), img.Height());
       if (img.Depth() == 1)
       {
          const unsigned char highValue = 240;
-         unsigned char* pBuf = (unsigned char*) const_cast<unsigned char*>(img.GetPixels());
-
-         // now iterate through the image pixels and set high 
-         // if they are within a bounding box
-         for (unsigned int x = 0; x < img.Width(); x++)
-         {
-            for (unsigned int y = 0; y < img.Height(); y++)
-            {
-               bool inROI = false;
-               for (unsigned int i = 0; i < bBoxes.size(); i++) 
-               {
-                  if (InBoundingBox(bBoxes[i], Point(x, y)))
-                     inROI = true;
-               }
-               if (inROI)
-               {
-                  long count = y * img.Width() + x;
-                  *(pBuf + count) = *(pBuf + count) + highValue;
-               }
-            }
-         }
-         img.SetPixels(pBuf);
+         roiMask_.AddTo(const_cast<unsigned char*>(img.GetPixels()), highValue);
       }
       else if (img.Depth() == 2)
       {
          const unsigned short highValue = 2048;
-         unsigned short* pBuf = (unsigned short*) const_cast<unsigned char*>(img.GetPixels());
-
-         // now iterate through the image pixels and set high 
-         // if they are within a bounding box
-         for (unsigned int x = 0; x < img.Width(); x++)
-         {
-            for (unsigned int y = 0; y < img.Height(); y++)
-            {
-               bool inROI = false;
-               for (unsigned int i = 0; i < bBoxes.size(); i++) 
-               {
-                  if (InBoundingBox(bBoxes[i], Point(x, y)))
-                     inROI = true;
-               }
-               if (inROI)
-               {
-                  long count = y * img.Width() + x;
-                  *(pBuf + count) = *(pBuf + count) + highValue;
-               }
-            }
-         }
-         img.SetPixels(pBuf);
+         roiMask_.AddTo((unsigned short*) const_cast<unsigned char*>(img.GetPixels()), highValue);
       }
       runROIS_ = false;
    } else
    {
-      Point cp = GalvoToCameraPoint(PointD(currentX_, currentY_), img);
+      Point cp = GalvoToCameraPoint(PointD(currentX_, currentY_), img.Width(), img.Height());
       int xPos = cp.x; int yPos = cp.y;
 
       std::ostringstream os;
       os << "XPos: " << xPos << ", YPos: " << yPos;
       LogMessage(os.str().c_str());
-      int xSpotSize = sizeof(gaussianMask_) / sizeof(gaussianMask_[0]);
-      int ySpotSize = sizeof(gaussianMask_[0]) / 2;
 
-      if (xPos > xSpotSize && xPos < (int) (img.Width() - xSpotSize - 1)  && 
-         yPos > ySpotSize && yPos < (int) (img.Height() - ySpotSize - 1) )
+      // The spot is clipped to the image
+      if (img.Depth() == 1)
       {
-         if (img.Depth() == 1)
-         {
-            unsigned char* pBuf = (unsigned char*) const_cast<unsigned char*>(img.GetPixels());
-            for (int x = 0; x < xSpotSize; x++) 
-            {
-               for (int y = 0; y < ySpotSize; y++) 
-               {
-                  int w = xPos + x;
-                  int h = yPos + y;
-                  long count = h * img.Width() + w;
-                  *(pBuf + count) = *(pBuf + count) + 5 * (unsigned char) gaussianMask_[x][y];
-               }
-            }
-            img.SetPixels(pBuf);
-         }
-         else if (img.Depth() == 2)
-         {
-            unsigned short* pBuf = (unsigned short*) const_cast<unsigned char*>(img.GetPixels());
-            for (int x = 0; x < xSpotSize; x++) 
-            {
-               for (int y = 0; y < ySpotSize; y++) 
-               {
-                  int w = xPos + x;
-                  int h = yPos + y;
-                  long count = h * img.Width() + w;
-                  *(pBuf + count) = *(pBuf + count) + 30 * (unsigned short) gaussianMask_[x][y];
-               }
-            }
-            img.SetPixels(pBuf);
-         }
+         unsigned char* pBuf = const_cast<unsigned char*>(img.GetPixels());
+         spot_.AddTo(pBuf, img.Width(), img.Height(), xPos, yPos, 5);
+      }
+      else if (img.Depth() == 2)
+      {
+         unsigned short* pBuf = (unsigned short*) const_cast<unsigned char*>(img.GetPixels());
+         spot_.AddTo(pBuf, img.Width(), img.Height(), xPos, yPos, 30);
       }
       if (pointAndFire_)
       {
@@ -4487,19 +4802,58 @@ int DemoGalvo::ChangePixels(ImgBuffer& img)
    return DEVICE_OK;
 }
 
+/**
+ * Rasterizes the polygons for the current camera geometry, unless the mask
+ * is already up to date. Must be called with roiMaskLock_ held.
+ */
+void DemoGalvo::UpdateROIMask(long imgWidth, long imgHeight)
+{
+   std::vector<long> geometry;
+   geometry.push_back(imgWidth);
+   geometry.push_back(imgHeight);
+   if (demoCamera_ != 0)
+   {
+      unsigned x, y, xSize, ySize;
+      demoCamera_->GetROI(x, y, xSize, ySize);
+      geometry.push_back(demoCamera_->GetCCDXSize());
+      geometry.push_back(demoCamera_->GetCCDYSize());
+      geometry.push_back(demoCamera_->GetBinning());
+      geometry.push_back(x);
+      geometry.push_back(y);
+   }
+   if (geometry == roiMaskGeometry_)
+      return;
+
+   std::vector< std::vector<PolygonMask::Vertex> > polygons;
+   for (std::map<int, std::vector<PointD> >::iterator it = vertices_.begin();
+         it != vertices_.end(); ++it)
+   {
+      std::vector<PolygonMask::Vertex> polygon;
+      for (std::vector<PointD>::iterator v = it->second.begin();
+            v != it->second.end(); ++v)
+      {
+         Point p = GalvoToCameraPoint(*v, imgWidth, imgHeight);
+         polygon.push_back(PolygonMask::Vertex(p.x, p.y));
+      }
+      polygons.push_back(polygon);
+   }
+   roiMask_.Rasterize(polygons, imgWidth, imgHeight);
+   roiMaskGeometry_ = geometry;
+}
+
 /**
  * Function that converts between the Galvo and Camera coordinate system
  * There is a bit of a conundrum, since we do not know what ROI and binning were
  * used when calibration took place. Let's assume 1x binning and full frame 
  * (and hope that is the same full frame as the camera is set to now).
- * Note: ImgBuffer is not really needed as an input
- * Returns point in coordinates suitable for the given ImgBuffer
+ * The image size is only used when there is no camera
+ * Returns point in coordinates suitable for an image of the given size
  * assuming that it has the ROI and binning as we get from the camera
  */
-Point DemoGalvo::GalvoToCameraPoint(PointD galvoPoint, ImgBuffer& img)
+Point DemoGalvo::GalvoToCameraPoint(PointD galvoPoint, long imgWidth, long imgHeight)
 {
-   long width = img.Width();
-   long height = img.Height();
+   long width = imgWidth;
+   long height = imgHeight;
    int binning = 1;
    unsigned x = 0, y = 0, xSize, ySize;
    if (demoCamera_ != 0) 
@@ -4536,67 +4890,332 @@ double DemoGalvo::GaussValue(double amplitude, double sigmaX, double sigmaY, int
 
 }
 /**
- * Returns the bounding box around the points defined in vertex
- * bBox is a vector with 2 points
+ * Not used; ROIs are filled with PolygonMask (GalvoRaster.h)
  */
-void DemoGalvo::GetBoundingBox(std::vector<Point>& vertex, std::vector<Point>& bBox)
+bool DemoGalvo::PointInTriangle(Point p, Point p0, Point p1, Point p2)
+{
+    long s = (long) p0.y * p2.x - p0.x * p2.y + (p2.y - p0.y) * p.x + (p0.x - p2.x) * p.y;
+    long t = (long) p0.x * p1.y - p0.y * p1.x + (p0.y - p1.y) * p.x + (p1.x - p0.x) * p.y;
+
+    if ((s < 0) != (t < 0))
+        return false;
+
+    long A = (long) -p1.y * p2.x + p0.y * (p2.x - p1.x) + p0.x * (p1.y - p2.y) + p1.x * p2.y;
+    if (A < 0.0)
+    {
+        s = -s;
+        t = -t;
+        A = -A;
+    }
+    return s > 0 && t > 0 && (s + t) < A;
+}
+
+///////////////////////////////////////////////////////////
+// DemoSLM
+DemoSLM::DemoSLM() :
+   initialized_(false),
+   width_(512),
+   height_(512),
+   maxSequenceLength_(1024),
+   intensity_(2048.0),
+   exposure_ms_(10.0)
 {
-   if (vertex.size() < 1)
+   InitializeDefaultErrorMessages();
+   SetErrorText(ERR_SLM_SEQUENCE_EMPTY, "The SLM sequence is empty");
+   SetErrorText(ERR_SLM_SEQUENCE_FULL, "The SLM sequence is longer than the maximum sequence length");
+
+   CPropertyAction* pAct = new CPropertyAction(this, &DemoSLM::OnWidth);
+   CreateIntegerProperty("Width", width_, false, pAct, true);
+   SetPropertyLimits("Width", 1, 8192);
+   pAct = new CPropertyAction(this, &DemoSLM::OnHeight);
+   CreateIntegerProperty("Height", height_, false, pAct, true);
+   SetPropertyLimits("Height", 1, 8192);
+   pAct = new CPropertyAction(this, &DemoSLM::OnMaxSequenceLength);
+   CreateIntegerProperty("MaxSequenceLength", maxSequenceLength_, false, pAct, true);
+   SetPropertyLimits("MaxSequenceLength", 1, 65536);
+}
+
+DemoSLM::~DemoSLM()
+{
+   Shutdown();
+}
+
+void DemoSLM::GetName(char* pName) const
+{
+   CDeviceUtils::CopyLimitedString(pName, g_SLMDeviceName);
+}
+
+int DemoSLM::Initialize()
+{
+   if (initialized_)
+      return DEVICE_OK;
+
+   int ret = CreateStringProperty(MM::g_Keyword_Name, g_SLMDeviceName, true);
+   if (ret != DEVICE_OK)
+      return ret;
+   ret = CreateStringProperty(MM::g_Keyword_Description, "Demo spatial light modulator", true);
+   if (ret != DEVICE_OK)
+      return ret;
+   CPropertyAction* pAct = new CPropertyAction(this, &DemoSLM::OnIntensity);
+   ret = CreateFloatProperty("Intensity", intensity_, false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+   SetPropertyLimits("Intensity", 0.0, 8192.0);
+
    {
-      return;
+      MMThreadGuard g(patternLock_);
+      patterns_.SetSize(width_, height_);
+      UpdateLookupTables();
+   }
+
+   // Render into the images of the camera on the same hub, as DemoGalvo does
+   DemoHub* pHub = static_cast<DemoHub*>(GetParentHub());
+   if (!pHub)
+   {
+      LogMessage(NoHubError);
+   }
+   else
+   {
+      char deviceName[MM::MaxStrLength];
+      unsigned int deviceIterator = 0;
+      for (;;)
+      {
+         GetLoadedDeviceOfType(MM::CameraDevice, deviceName, deviceIterator);
+         if (0 == strlen(deviceName))
+         {
+            LogMessage("SLM detected no camera devices");
+            break;
+         }
+         MM::Camera* camera = (MM::Camera*) GetDevice(deviceName);
+         if (GetCoreCallback()->GetParentHub(camera) == pHub)
+         {
+            static_cast<CDemoCamera*>(camera)->RegisterImgManipulatorCallBack(this);
+            cameraLabel_ = deviceName;
+            LogMessage("DemoSLM registered as callback");
+            break;
+         }
+         deviceIterator++;
+      }
    }
-   int minX = vertex[0].x;
-   int maxX = minX;
-   int minY = vertex[0].y;
-   int maxY = minY;
-   for (unsigned int i = 1; i < vertex.size(); i++)
+
+   initialized_ = true;
+   return DEVICE_OK;
+}
+
+int DemoSLM::Shutdown()
+{
+   if (!cameraLabel_.empty())
    {
-      if (vertex[i].x < minX)
-         minX = vertex[i].x;
-      if (vertex[i].x > maxX)
-         maxX = vertex[i].x;
-      if (vertex[i].y < minY)
-         minY = vertex[i].y;
-      if (vertex[i].y > maxY)
-         maxY = vertex[i].y;
+      // Look the camera up again; it is gone if it was unloaded first
+      CDemoCamera* camera =
+         dynamic_cast<CDemoCamera*>(GetDevice(cameraLabel_.c_str()));
+      if (camera != 0)
+         camera->UnregisterImgManipulatorCallBack(this);
+      cameraLabel_.clear();
    }
-   bBox.push_back(Point(minX, minY));
-   bBox.push_back(Point(maxX, maxY));
+   initialized_ = false;
+   return DEVICE_OK;
+}
+
+int DemoSLM::SetImage(unsigned char* pixels)
+{
+   MMThreadGuard g(patternLock_);
+   patterns_.SetImage(pixels);
+   return DEVICE_OK;
+}
+
+int DemoSLM::SetImage(unsigned int* /* pixels */)
+{
+   return DEVICE_UNSUPPORTED_COMMAND; // Monochrome only
+}
+
+int DemoSLM::DisplayImage()
+{
+   MMThreadGuard g(patternLock_);
+   patterns_.DisplayImage();
+   return DEVICE_OK;
+}
+
+int DemoSLM::SetPixelsTo(unsigned char intensity)
+{
+   MMThreadGuard g(patternLock_);
+   patterns_.SetPixelsTo(intensity);
+   patterns_.DisplayImage();
+   return DEVICE_OK;
+}
+
+int DemoSLM::SetPixelsTo(unsigned char red, unsigned char green, unsigned char blue)
+{
+   return SetPixelsTo(static_cast<unsigned char>((red + green + blue) / 3));
+}
+
+int DemoSLM::SetExposure(double interval_ms)
+{
+   exposure_ms_ = interval_ms;
+   return DEVICE_OK;
+}
+
+double DemoSLM::GetExposure()
+{
+   return exposure_ms_;
+}
+
+int DemoSLM::IsSLMSequenceable(bool& isSequenceable) const
+{
+   isSequenceable = true;
+   return DEVICE_OK;
+}
+
+int DemoSLM::GetSLMSequenceMaxLength(long& nrEvents) const
+{
+   nrEvents = maxSequenceLength_;
+   return DEVICE_OK;
+}
+
+int DemoSLM::StartSLMSequence()
+{
+   MMThreadGuard g(patternLock_);
+   if (!patterns_.StartSequence())
+      return ERR_SLM_SEQUENCE_EMPTY;
+   return DEVICE_OK;
+}
+
+int DemoSLM::StopSLMSequence()
+{
+   MMThreadGuard g(patternLock_);
+   patterns_.StopSequence();
+   return DEVICE_OK;
+}
+
+int DemoSLM::ClearSLMSequence()
+{
+   MMThreadGuard g(patternLock_);
+   patterns_.ClearSequence();
+   return DEVICE_OK;
+}
+
+int DemoSLM::AddToSLMSequence(const unsigned char* const pixels)
+{
+   MMThreadGuard g(patternLock_);
+   if (patterns_.SequenceLength() >= static_cast<std::size_t>(maxSequenceLength_))
+      return ERR_SLM_SEQUENCE_FULL;
+   patterns_.AddToSequence(pixels);
+   return DEVICE_OK;
+}
+
+int DemoSLM::AddToSLMSequence(const unsigned int* const /* pixels */)
+{
+   return DEVICE_UNSUPPORTED_COMMAND; // Monochrome only
+}
+
+int DemoSLM::SendSLMSequence()
+{
+   // The sequence is stored as it is added
+   return DEVICE_OK;
 }
 
 /**
- * Determines whether the given point is in the boundingBox
- * boundingBox should have two members, one with the minimum x, y position,
- * the second with the maximum x, y positions
+ * Callback function that will be called by DemoCamera everytime
+ * a new image is generated.
+ * Adds the displayed pattern, stretched over the image, and moves a running
+ * sequence on to its next pattern.
  */
-bool DemoGalvo::InBoundingBox(std::vector<Point> boundingBox, Point testPoint)
+int DemoSLM::ChangePixels(ImgBuffer& img)
 {
-   if (testPoint.x >= boundingBox[0].x && testPoint.x <= boundingBox[1].x &&
-         testPoint.y >= boundingBox[0].y && testPoint.y <= boundingBox[1].y)
-      return true;
-   return false;
+   MMThreadGuard g(patternLock_);
+   const int width = static_cast<int>(img.Width());
+   const int height = static_cast<int>(img.Height());
+   if (img.Depth() == 1)
+   {
+      patterns_.AddTo(const_cast<unsigned char*>(img.GetPixels()), width, height,
+            &lut8_[0]);
+   }
+   else if (img.Depth() == 2)
+   {
+      patterns_.AddTo((unsigned short*) const_cast<unsigned char*>(img.GetPixels()),
+            width, height, &lut16_[0]);
+   }
+   patterns_.NextSequenceImage();
+   return DEVICE_OK;
 }
 
 /**
- * Not used (yet), intent was to use this to determine whether 
- * a point is within the ROI, rather than drawing a bounding box
+ * Must be called with patternLock_ held.
  */
-bool DemoGalvo::PointInTriangle(Point p, Point p0, Point p1, Point p2)
+void DemoSLM::UpdateLookupTables()
 {
-    long s = (long) p0.y * p2.x - p0.x * p2.y + (p2.y - p0.y) * p.x + (p0.x - p2.x) * p.y;
-    long t = (long) p0.x * p1.y - p0.y * p1.x + (p0.y - p1.y) * p.x + (p1.x - p0.x) * p.y;
+   lut8_.resize(256);
+   lut16_.resize(256);
+   for (int v = 0; v < 256; ++v)
+   {
+      const double signal = intensity_ * v / 255.0;
+      lut16_[v] = static_cast<unsigned short>(signal + 0.5);
+      lut8_[v] = static_cast<unsigned char>((std::min)(255.0, signal / 16.0 + 0.5));
+   }
+}
 
-    if ((s < 0) != (t < 0))
-        return false;
+int DemoSLM::OnWidth(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(width_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      if (initialized_)
+      {
+         pProp->Set(width_);
+         return DEVICE_CAN_NOT_SET_PROPERTY;
+      }
+      pProp->Get(width_);
+   }
+   return DEVICE_OK;
+}
 
-    long A = (long) -p1.y * p2.x + p0.y * (p2.x - p1.x) + p0.x * (p1.y - p2.y) + p1.x * p2.y;
-    if (A < 0.0)
-    {
-        s = -s;
-        t = -t;
-        A = -A;
-    }
-    return s > 0 && t > 0 && (s + t) < A;
+int DemoSLM::OnHeight(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(height_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      if (initialized_)
+      {
+         pProp->Set(height_);
+         return DEVICE_CAN_NOT_SET_PROPERTY;
+      }
+      pProp->Get(height_);
+   }
+   return DEVICE_OK;
+}
+
+int DemoSLM::OnMaxSequenceLength(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(maxSequenceLength_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      pProp->Get(maxSequenceLength_);
+   }
+   return DEVICE_OK;
+}
+
+int DemoSLM::OnIntensity(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(intensity_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      pProp->Get(intensity_);
+      MMThreadGuard g(patternLock_);
+      UpdateLookupTables();
+   }
+   return DEVICE_OK;
 }
 
 ////////// BEGINNING OF POORLY ORGANIZED CODE //////////////
@@ -4914,11 +5533,72 @@ int MedianFilter::Process(unsigned char *pBuffer, unsigned int width, unsigned i
 
 int DemoHub::Initialize()
 {
+   // Simulated duration of each status query to the controller
+   CPropertyAction* pAct = new CPropertyAction(this, &DemoHub::OnStatusQueryDelay);
+   int nRet = CreateFloatProperty("StatusQueryDelay-ms", statusQueryDelayMs_, false, pAct);
+   if (nRet != DEVICE_OK)
+      return nRet;
+   SetPropertyLimits("StatusQueryDelay-ms", 0.0, 100.0);
+
+   // Number of status queries made so far
+   pAct = new CPropertyAction(this, &DemoHub::OnStatusQueries);
+   nRet = CreateIntegerProperty("StatusQueries", 0, true, pAct);
+   if (nRet != DEVICE_OK)
+      return nRet;
+
   	initialized_ = true;
  
 	return DEVICE_OK;
 }
 
+/**
+ * Answers the busy state of all peripherals with one status query, as a
+ * controller reporting all of its axes in one reply would.
+ */
+int DemoHub::SnapPeripheralBusyStates()
+{
+   StatusQuery();
+   return DEVICE_OK;
+}
+
+bool DemoHub::GetPeripheralBusy(MM::Device* peripheral, bool& busy)
+{
+   DemoHubPeripheral* pPeripheral = dynamic_cast<DemoHubPeripheral*>(peripheral);
+   if (!pPeripheral)
+      return false;
+   busy = pPeripheral->IsMoving();
+   return true;
+}
+
+void DemoHub::StatusQuery()
+{
+   ++statusQueries_;
+   if (statusQueryDelayMs_ > 0.0)
+      CDeviceUtils::SleepMs(static_cast<long>(statusQueryDelayMs_ + 0.5));
+}
+
+int DemoHub::OnStatusQueryDelay(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(statusQueryDelayMs_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      pProp->Get(statusQueryDelayMs_);
+   }
+   return DEVICE_OK;
+}
+
+int DemoHub::OnStatusQueries(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(statusQueries_);
+   }
+   return DEVICE_OK;
+}
+
 int DemoHub::DetectInstalledDevices()
 {  
    ClearInstalledDevices();
@@ -33,6 +33,8 @@
 #include "DeviceBase.h"
 #include "ImgBuffer.h"
 #include "DeviceThreads.h"
+#include "GalvoRaster.h"
+#include "SLMPattern.h"
 #include <string>
 #include <map>
 #include <algorithm>
@@ -48,8 +50,14 @@
 #define ERR_SEQUENCE_INACTIVE    105
 #define ERR_STAGE_MOVING         106
 #define HUB_NOT_AVAILABLE        107
+#define ERR_BURST_NOT_ARMED      108
+#define ERR_BURST_NOT_STARTED    109
+#define ERR_TRIGGER_NOT_SOFTWARE 110
+#define ERR_TRIGGER_UNSUPPORTED  111
+#define ERR_SLM_SEQUENCE_EMPTY   112
+#define ERR_SLM_SEQUENCE_FULL    113
 
-const char* NoHubError = "Parent Hub not defined.";
+const char* const NoHubError = "Parent Hub not defined.";
 
 // Defines which segments in a seven-segment display are lit up for each of
 // the numbers 0-9. Segments are:
@@ -75,6 +83,15 @@ class ImgManipulator
       virtual int ChangePixels(ImgBuffer& img) = 0;
 };
 
+// Peripheral whose busy state DemoHub reports in its busy snapshots
+class DemoHubPeripheral
+{
+   public:
+      virtual ~DemoHubPeripheral() {}
+      // Busy state, without the simulated status query to the hub
+      virtual bool IsMoving() = 0;
+};
+
 ////////////////////////
 // DemoHub
 //////////////////////
@@ -84,7 +101,9 @@ class DemoHub : public HubBase<DemoHub>
 public:
    DemoHub() :
       initialized_(false),
-      busy_(false)
+      busy_(false),
+      statusQueryDelayMs_(0.0),
+      statusQueries_(0)
    {}
    ~DemoHub() {}
 
@@ -97,6 +116,15 @@ public:
 
    // HUB api
    int DetectInstalledDevices();
+   int SnapPeripheralBusyStates();
+   bool GetPeripheralBusy(MM::Device* peripheral, bool& busy);
+
+   // Simulated round trip to the controller, made by peripherals to
+   // answer Busy()
+   void StatusQuery();
+
+   int OnStatusQueryDelay(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnStatusQueries(MM::PropertyBase* pProp, MM::ActionType eAct);
 
 private:
    void GetPeripheralInventory();
@@ -104,6 +132,8 @@ private:
    std::vector<std::string> peripherals_;
    bool initialized_;
    bool busy_;
+   double statusQueryDelayMs_;
+   long statusQueries_;
 };
 
 
@@ -170,6 +200,25 @@ public:
    int AddToExposureSequence(double exposureTime_ms);
    int SendExposureSequence() const;
 
+   bool SupportsBurstAPI() { return true; }
+   int SetPreFrameDelay(double delay_ms);
+   int SetPostFrameDelay(double delay_ms);
+   int SetBurstStartTriggerType(const char* type);
+   int SetBurstEndTriggerType(const char* type);
+   int SetFrameStartTriggerType(const char* type);
+   int SetExposureEndTriggerType(const char* type);
+   int GetBurstStartTriggerType(char* type);
+   int GetFrameStartTriggerType(char* type);
+   int SetFrameExposureMode(const char* mode);
+   int PrepareForBurst(int numImages);
+   int SendBurstStartTrigger();
+   int SendFrameStartTrigger();
+   int SendBurstEndTrigger();
+   int GetRollingShutterLineOffset(double& offset_us);
+   int SetRollingShutterLineOffset(double offset_us);
+   int GetRollingShutterActiveLines(int& numLines);
+   int SetRollingShutterActiveLines(int numLines);
+
    unsigned  GetNumberOfComponents() const { return nComponents_;};
 
    // action interface
@@ -212,6 +261,7 @@ public:
    double GaussDistributedValue(double mean, double std);
 
    int RegisterImgManipulatorCallBack(ImgManipulator* imgManpl);
+   int UnregisterImgManipulatorCallBack(ImgManipulator* imgManpl);
    long GetCCDXSize() { return cameraCCDXSize_; }
    long GetCCDYSize() { return cameraCCDYSize_; }
 
@@ -223,6 +273,9 @@ private:
    void GenerateSyntheticImage(ImgBuffer& img, double exp);
    bool GenerateColorTestPattern(ImgBuffer& img);
    int ResizeImageBuffer();
+   int StartBurst();
+   int EndBurst();
+   void SimulateDelay(double delayMs);
 
    static const double nominalPixelSizeUm_;
 
@@ -278,10 +331,28 @@ private:
    MySequenceThread * thd_;
    std::future<void> fut_;
    int mode_;
-   ImgManipulator* imgManpl_;
+   std::vector<ImgManipulator*> imgManipulators_; // Applied in order
    double pcf_;
    double photonFlux_;
    double readNoise_;
+
+   // Burst API simulation. Software and internal triggers are simulated;
+   // external (TTL) triggers are not supported.
+   MMThreadLock burstLock_; // Guards the burst state below
+   std::string burstStartTrigger_;
+   std::string burstEndTrigger_;
+   std::string frameStartTrigger_;
+   std::string exposureEndTrigger_;
+   std::string frameExposureMode_;
+   double preFrameDelayMs_;
+   double postFrameDelayMs_;
+   long burstLength_; // -1 to run until the burst end trigger
+   long burstFramesTaken_; // Software-triggered frames
+   bool burstArmed_; // From PrepareForBurst() until the burst ends
+   bool burstStarted_;
+   MM::MMTime nextFrameReadyTime_; // End of the last post-frame delay
+   double rollingShutterLineOffsetUs_;
+   int rollingShutterActiveLines_;
 };
 
 class MySequenceThread : public MMDeviceThreadBase
@@ -323,7 +394,7 @@ class MySequenceThread : public MMDeviceThreadBase
 // Simulation of the filter changer (state device)
 //////////////////////////////////////////////////////////////////////////////
 
-class CDemoFilterWheel : public CStateDeviceBase<CDemoFilterWheel>
+class CDemoFilterWheel : public CStateDeviceBase<CDemoFilterWheel>, public DemoHubPeripheral
 {
 public:
    CDemoFilterWheel();
@@ -336,6 +407,7 @@ public:
   
    void GetName(char* pszName) const;
    bool Busy();
+   bool IsMoving();
    unsigned long GetNumberOfPositions()const {return numPos_;}
 
    // action interface
@@ -420,7 +492,7 @@ private:
 // Simulation of a state device in which the number of states can be specified (state device)
 //////////////////////////////////////////////////////////////////////////////
 
-class CDemoStateDevice : public CStateDeviceBase<CDemoStateDevice>
+class CDemoStateDevice : public CStateDeviceBase<CDemoStateDevice>, public DemoHubPeripheral
 {
 public:
    CDemoStateDevice();
@@ -433,6 +505,7 @@ public:
   
    void GetName(char* pszName) const;
    bool Busy();
+   bool IsMoving();
    unsigned long GetNumberOfPositions()const {return numPos_;}
 
    // action interface
@@ -519,13 +592,14 @@ private:
 // Simulation of the single axis stage
 //////////////////////////////////////////////////////////////////////////////
 
-class CDemoXYStage : public CXYStageBase<CDemoXYStage>
+class CDemoXYStage : public CXYStageBase<CDemoXYStage>, public DemoHubPeripheral
 {
 public:
    CDemoXYStage();
    ~CDemoXYStage();
 
    bool Busy();
+   bool IsMoving();
    void GetName(char* pszName) const;
 
    int Initialize();
@@ -590,7 +664,7 @@ private:
 // DemoShutter class
 // Simulation of shutter device
 //////////////////////////////////////////////////////////////////////////////
-class DemoShutter : public CShutterBase<DemoShutter>
+class DemoShutter : public CShutterBase<DemoShutter>, public DemoHubPeripheral
 {
 public:
    DemoShutter() : state_(false), initialized_(false), changedTime_(0.0)
@@ -607,6 +681,7 @@ public:
 
    void GetName (char* pszName) const;
    bool Busy();
+   bool IsMoving();
 
    // Shutter API
    int SetOpen (bool open = true)
@@ -1160,14 +1235,18 @@ public:
 private:
 
    CDemoCamera* demoCamera_;
-   unsigned short gaussianMask_[10][10];
+   KernelStamp spot_;
 
    double GaussValue(double amplitude, double sigmaX, double sigmaY, int muX, int muY, int x, int y);
-   Point GalvoToCameraPoint(PointD GalvoPoint, ImgBuffer& img);
-   void GetBoundingBox(std::vector<Point>& vertex, std::vector<Point>& bBox);
-   bool InBoundingBox(std::vector<Point> boundingBox, Point testPoint);
+   Point GalvoToCameraPoint(PointD GalvoPoint, long imgWidth, long imgHeight);
+   void UpdateROIMask(long imgWidth, long imgHeight);
 
    std::map<int, std::vector<PointD> > vertices_;
+   // The polygons rasterized for the camera geometry (image size, CCD size,
+   // binning and ROI) recorded alongside; rebuilt when either changes
+   PolygonMask roiMask_;
+   std::vector<long> roiMaskGeometry_;
+   MMThreadLock roiMaskLock_;
    MM::MMTime pfExpirationTime_;
    bool initialized_;
    bool busy_;
@@ -1185,5 +1264,76 @@ private:
 };
 
 
+//////////////////////////////////////////////////////////////////////////////
+// DemoSLM class
+// Simulation of a spatial light modulator, whose displayed pattern is added
+// to the images of the DemoCamera on the same hub. A running sequence
+// advances by one pattern for each camera frame, as if the SLM were
+// triggered by the camera.
+//////////////////////////////////////////////////////////////////////////////
+
+class DemoSLM : public CSLMBase<DemoSLM>, ImgManipulator
+{
+public:
+   DemoSLM();
+   ~DemoSLM();
+
+   // MMDevice API
+   bool Busy() { return false; }
+   void GetName(char* pszName) const;
+
+   int Initialize();
+   int Shutdown();
+
+   // SLM API
+   int SetImage(unsigned char* pixels);
+   int SetImage(unsigned int* pixels);
+   int DisplayImage();
+   int SetPixelsTo(unsigned char intensity);
+   int SetPixelsTo(unsigned char red, unsigned char green, unsigned char blue);
+   int SetExposure(double interval_ms);
+   double GetExposure();
+   unsigned GetWidth() { return width_; }
+   unsigned GetHeight() { return height_; }
+   unsigned GetNumberOfComponents() { return 1; }
+   unsigned GetBytesPerPixel() { return 1; }
+
+   int IsSLMSequenceable(bool& isSequenceable) const;
+   int GetSLMSequenceMaxLength(long& nrEvents) const;
+   int StartSLMSequence();
+   int StopSLMSequence();
+   int ClearSLMSequence();
+   int AddToSLMSequence(const unsigned char* const pixels);
+   int AddToSLMSequence(const unsigned int* const pixels);
+   int SendSLMSequence();
+
+   int ChangePixels(ImgBuffer& img);
+
+   // action interface
+   int OnWidth(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnHeight(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnMaxSequenceLength(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnIntensity(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+   // Label, not pointer: the camera may be unloaded before the SLM
+   std::string cameraLabel_;
+   // Guards patterns_ and the lookup tables, which the camera reads while
+   // generating images
+   MMThreadLock patternLock_;
+   SLMPatterns patterns_;
+   // Camera signal added for each SLM intensity, by camera pixel depth
+   std::vector<unsigned char> lut8_;
+   std::vector<unsigned short> lut16_;
+   bool initialized_;
+   long width_;
+   long height_;
+   long maxSequenceLength_;
+   double intensity_; // Camera signal, in 16-bit counts, at SLM intensity 255
+   double exposure_ms_;
+
+   void UpdateLookupTables();
+};
+
 
 #endif //_DEMOCAMERA_H_
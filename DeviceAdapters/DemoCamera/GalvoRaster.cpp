@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          GalvoRaster.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Rasterization of the DemoGalvo's illumination into simulated
+//                camera images
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "GalvoRaster.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+
+// A non-horizontal polygon edge, covering rows yTop <= y < yBottom
+struct Edge
+{
+   int yTop;
+   int yBottom;
+   double xTop;  // x at yTop
+   double dxdy;
+
+   bool operator<(const Edge& other) const { return yTop < other.yTop; }
+};
+
+bool SpanLess(const PolygonMask::Span& a, const PolygonMask::Span& b)
+{
+   if (a.y != b.y)
+      return a.y < b.y;
+   return a.x0 < b.x0;
+}
+
+// Scanline fill of one polygon: walks the rows with an active edge table,
+// appending the clipped spans of each row to spans
+void FillPolygon(const std::vector<PolygonMask::Vertex>& polygon,
+      int width, int height, std::vector<PolygonMask::Span>& spans)
+{
+   std::vector<Edge> edges;
+   edges.reserve(polygon.size());
+   for (std::size_t i = 0; i < polygon.size(); ++i)
+   {
+      PolygonMask::Vertex a = polygon[i];
+      PolygonMask::Vertex b = polygon[(i + 1) % polygon.size()];
+      if (a.y == b.y)
+         continue;
+      if (a.y > b.y)
+         std::swap(a, b);
+      Edge e;
+      e.yTop = a.y;
+      e.yBottom = b.y;
+      e.xTop = a.x;
+      e.dxdy = static_cast<double>(b.x - a.x) / (b.y - a.y);
+      edges.push_back(e);
+   }
+   if (edges.empty())
+      return;
+   std::sort(edges.begin(), edges.end());
+
+   int yEnd = 0;
+   for (std::size_t i = 0; i < edges.size(); ++i)
+      yEnd = std::max(yEnd, edges[i].yBottom);
+   yEnd = std::min(yEnd, height);
+
+   std::vector<const Edge*> active;
+   std::vector<double> crossings;
+   std::size_t next = 0;
+   for (int y = std::max(edges[0].yTop, 0); y < yEnd; ++y)
+   {
+      while (next < edges.size() && edges[next].yTop <= y)
+         active.push_back(&edges[next++]);
+
+      crossings.clear();
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < active.size(); ++i)
+      {
+         const Edge* e = active[i];
+         if (e->yBottom <= y)
+            continue;
+         active[kept++] = e;
+         crossings.push_back(e->xTop + (y - e->yTop) * e->dxdy);
+      }
+      active.resize(kept);
+      std::sort(crossings.begin(), crossings.end());
+
+      for (std::size_t i = 0; i + 1 < crossings.size(); i += 2)
+      {
+         const int x0 = std::max(0, static_cast<int>(std::ceil(crossings[i])));
+         const int x1 = std::min(width,
+               static_cast<int>(std::ceil(crossings[i + 1])));
+         if (x0 < x1)
+            spans.push_back(PolygonMask::Span(y, x0, x1));
+      }
+   }
+}
+
+} // anonymous namespace
+
+
+void PolygonMask::Rasterize(const std::vector< std::vector<Vertex> >& polygons,
+      int width, int height)
+{
+   Clear();
+   width_ = std::max(width, 0);
+   height_ = std::max(height, 0);
+   if (width_ == 0 || height_ == 0)
+      return;
+
+   std::vector<Span> spans;
+   for (std::size_t i = 0; i < polygons.size(); ++i)
+   {
+      if (polygons[i].size() >= 3)
+         FillPolygon(polygons[i], width_, height_, spans);
+   }
+
+   // Merge the spans of overlapping polygons
+   std::sort(spans.begin(), spans.end(), SpanLess);
+   for (std::size_t i = 0; i < spans.size(); ++i)
+   {
+      if (!spans_.empty() && spans_.back().y == spans[i].y &&
+            spans[i].x0 <= spans_.back().x1)
+         spans_.back().x1 = std::max(spans_.back().x1, spans[i].x1);
+      else
+         spans_.push_back(spans[i]);
+   }
+}
+
+void PolygonMask::Clear()
+{
+   width_ = 0;
+   height_ = 0;
+   spans_.clear();
+}
+
+std::size_t PolygonMask::PixelCount() const
+{
+   std::size_t count = 0;
+   for (std::vector<Span>::const_iterator it = spans_.begin();
+         it != spans_.end(); ++it)
+      count += it->x1 - it->x0;
+   return count;
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          GalvoRaster.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Rasterization of the DemoGalvo's illumination into simulated
+//                camera images
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * The pixels of an image covered by a set of polygons, stored as horizontal
+ * runs ("spans") so that it can be applied to each frame without testing
+ * individual pixels.
+ *
+ * Vertices are in pixel coordinates. A pixel is covered when its corner
+ * (x, y) lies inside a polygon according to the even-odd rule, with the
+ * usual half-open convention: an axis-aligned rectangle from (x0, y0) to
+ * (x1, y1) covers x0 <= x < x1, y0 <= y < y1. Overlapping polygons cover
+ * a pixel only once.
+ */
+class PolygonMask
+{
+public:
+   struct Vertex
+   {
+      Vertex(int lx, int ly) : x(lx), y(ly) {}
+      int x;
+      int y;
+   };
+
+   // Pixels x0 <= x < x1 of row y
+   struct Span
+   {
+      Span(int ly, int lx0, int lx1) : y(ly), x0(lx0), x1(lx1) {}
+      int y;
+      int x0;
+      int x1;
+   };
+
+   PolygonMask() : width_(0), height_(0) {}
+
+   /**
+    * Replaces the mask with the union of the polygons, clipped to an image
+    * of width x height pixels. Polygons with fewer than 3 vertices are
+    * ignored.
+    */
+   void Rasterize(const std::vector< std::vector<Vertex> >& polygons,
+         int width, int height);
+   void Clear();
+
+   int Width() const { return width_; }
+   int Height() const { return height_; }
+   const std::vector<Span>& Spans() const { return spans_; }
+   std::size_t PixelCount() const;
+
+   /**
+    * Adds value to each covered pixel of an image of the size given to
+    * Rasterize(). Additions wrap around, as they do for the rest of the
+    * simulated signal.
+    */
+   template <typename T>
+   void AddTo(T* pixels, T value) const
+   {
+      for (std::vector<Span>::const_iterator it = spans_.begin();
+            it != spans_.end(); ++it)
+      {
+         // Kept as a plain loop over contiguous pixels so that the compiler
+         // vectorizes it
+         T* p = pixels + static_cast<std::size_t>(it->y) * width_;
+         for (int x = it->x0; x < it->x1; ++x)
+            p[x] = static_cast<T>(p[x] + value);
+      }
+   }
+
+private:
+   int width_;
+   int height_;
+   std::vector<Span> spans_; // Sorted by row, then x; non-overlapping
+};
+
+/**
+ * A precomputed square kernel (e.g. a Gaussian spot) that can be added to
+ * an image at any position, clipped to the image.
+ */
+class KernelStamp
+{
+public:
+   KernelStamp() : size_(0) {}
+
+   // values holds size x size entries, row by row
+   void Set(int size, const std::vector<unsigned short>& values)
+   {
+      size_ = size;
+      values_ = values;
+      values_.resize(static_cast<std::size_t>(size) * size);
+   }
+
+   int Size() const { return size_; }
+
+   // Adds scale times the kernel to an image of width x height pixels,
+   // with the kernel's top left corner at (left, top)
+   template <typename T>
+   void AddTo(T* pixels, int width, int height, int left, int top,
+         unsigned scale) const
+   {
+      const int x0 = left < 0 ? -left : 0;
+      const int y0 = top < 0 ? -top : 0;
+      const int x1 = width - left < size_ ? width - left : size_;
+      const int y1 = height - top < size_ ? height - top : size_;
+      for (int y = y0; y < y1; ++y)
+      {
+         T* row = pixels + static_cast<std::size_t>(top + y) * width + left;
+         const unsigned short* k = &values_[static_cast<std::size_t>(y) * size_];
+         for (int x = x0; x < x1; ++x)
+            row[x] = static_cast<T>(row[x] + scale * k[x]);
+      }
+   }
+
+private:
+   int size_;
+   std::vector<unsigned short> values_;
+};
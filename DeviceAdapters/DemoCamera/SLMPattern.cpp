@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SLMPattern.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Pattern storage of the DemoSLM and rendering of the displayed
+//                pattern into simulated camera images
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SLMPattern.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+SLMPatterns::SLMPatterns() :
+   width_(0),
+   height_(0),
+   sequenceLength_(0),
+   sequenceIndex_(0),
+   sequenceRunning_(false)
+{
+}
+
+void SLMPatterns::SetSize(unsigned width, unsigned height)
+{
+   width_ = width;
+   height_ = height;
+   displayed_.assign(ImageBytes(), 0);
+   uploaded_.assign(ImageBytes(), 0);
+   ClearSequence();
+   columnMap_.clear();
+   rowMap_.clear();
+}
+
+void SLMPatterns::SetImage(const unsigned char* pixels)
+{
+   if (!uploaded_.empty())
+      std::memcpy(&uploaded_[0], pixels, uploaded_.size());
+}
+
+void SLMPatterns::SetPixelsTo(unsigned char intensity)
+{
+   std::fill(uploaded_.begin(), uploaded_.end(), intensity);
+}
+
+void SLMPatterns::DisplayImage()
+{
+   // The uploaded image stays uploaded, so that displaying it again shows
+   // the same image
+   displayed_ = uploaded_;
+}
+
+void SLMPatterns::ClearSequence()
+{
+   StopSequence();
+   sequence_.clear();
+   sequenceLength_ = 0;
+   sequenceIndex_ = 0;
+}
+
+void SLMPatterns::AddToSequence(const unsigned char* frames,
+      std::size_t frameCount)
+{
+   if (frameCount == 0 || ImageBytes() == 0)
+      return;
+   sequence_.insert(sequence_.end(), frames, frames + frameCount * ImageBytes());
+   sequenceLength_ += frameCount;
+}
+
+bool SLMPatterns::StartSequence()
+{
+   if (sequenceLength_ == 0)
+      return false;
+   sequenceIndex_ = 0;
+   sequenceRunning_ = true;
+   return true;
+}
+
+void SLMPatterns::StopSequence()
+{
+   if (!sequenceRunning_)
+      return;
+   std::memcpy(&displayed_[0], DisplayedPixels(), displayed_.size());
+   sequenceRunning_ = false;
+}
+
+void SLMPatterns::NextSequenceImage()
+{
+   if (sequenceRunning_ && ++sequenceIndex_ == sequenceLength_)
+      sequenceIndex_ = 0;
+}
+
+const unsigned char* SLMPatterns::DisplayedPixels() const
+{
+   if (sequenceRunning_)
+      return &sequence_[sequenceIndex_ * ImageBytes()];
+   return displayed_.empty() ? 0 : &displayed_[0];
+}
+
+void SLMPatterns::UpdateMaps(int width, int height)
+{
+   if (columnMap_.size() == static_cast<std::size_t>(width) &&
+         rowMap_.size() == static_cast<std::size_t>(height))
+      return;
+   columnMap_.resize(width);
+   for (int x = 0; x < width; ++x)
+      columnMap_[x] = static_cast<unsigned>(
+            static_cast<unsigned long long>(x) * width_ / width);
+   rowMap_.resize(height);
+   for (int y = 0; y < height; ++y)
+      rowMap_[y] = static_cast<unsigned>(
+            static_cast<unsigned long long>(y) * height_ / height);
+}
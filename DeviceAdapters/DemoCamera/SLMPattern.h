@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SLMPattern.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Pattern storage of the DemoSLM and rendering of the displayed
+//                pattern into simulated camera images
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * The 8-bit images of a simulated SLM: the displayed image, the image
+ * uploaded for display next, and an uploaded sequence.
+ *
+ * Displaying an uploaded image copies it, leaving it uploaded, while a
+ * running sequence displays its images in place. The sequence is held in
+ * one contiguous buffer, so that a multi-frame upload is a single copy.
+ *
+ * The displayed image is stretched over the whole camera image. The
+ * camera pixel to SLM pixel mapping is cached for the last camera image
+ * size.
+ */
+class SLMPatterns
+{
+public:
+   SLMPatterns();
+
+   // Resets to a blank (all zero) display and an empty sequence
+   void SetSize(unsigned width, unsigned height);
+   unsigned Width() const { return width_; }
+   unsigned Height() const { return height_; }
+   std::size_t ImageBytes() const { return static_cast<std::size_t>(width_) * height_; }
+
+   // Uploads the image shown by the next call to DisplayImage()
+   void SetImage(const unsigned char* pixels);
+   void SetPixelsTo(unsigned char intensity);
+   void DisplayImage();
+
+   void ClearSequence();
+   // Appends frameCount images, stored one after the other in frames
+   void AddToSequence(const unsigned char* frames, std::size_t frameCount = 1);
+   std::size_t SequenceLength() const { return sequenceLength_; }
+
+   // Displays the first image of the sequence; false if it is empty
+   bool StartSequence();
+   // The sequence image being displayed stays on display
+   void StopSequence();
+   bool IsSequenceRunning() const { return sequenceRunning_; }
+   // Displays the next image of a running sequence, wrapping around
+   void NextSequenceImage();
+   std::size_t SequenceIndex() const { return sequenceIndex_; }
+
+   const unsigned char* DisplayedPixels() const;
+
+   /**
+    * Adds lut[v] to each pixel of a camera image of width x height pixels,
+    * where v is the displayed SLM pixel at the corresponding position.
+    * lut must have 256 entries. Additions wrap around, as they do for the
+    * rest of the simulated signal.
+    */
+   template <typename T>
+   void AddTo(T* pixels, int width, int height, const T* lut)
+   {
+      if (width <= 0 || height <= 0 || ImageBytes() == 0)
+         return;
+      UpdateMaps(width, height);
+      const unsigned char* displayed = DisplayedPixels();
+      const bool sameWidth = static_cast<unsigned>(width) == width_;
+      for (int y = 0; y < height; ++y)
+      {
+         const unsigned char* src = displayed +
+            static_cast<std::size_t>(rowMap_[y]) * width_;
+         T* dst = pixels + static_cast<std::size_t>(y) * width;
+         if (sameWidth)
+         {
+            for (int x = 0; x < width; ++x)
+               dst[x] = static_cast<T>(dst[x] + lut[src[x]]);
+         }
+         else
+         {
+            for (int x = 0; x < width; ++x)
+               dst[x] = static_cast<T>(dst[x] + lut[src[columnMap_[x]]]);
+         }
+      }
+   }
+
+private:
+   void UpdateMaps(int width, int height);
+
+   unsigned width_;
+   unsigned height_;
+   std::vector<unsigned char> displayed_;
+   std::vector<unsigned char> uploaded_;
+   std::vector<unsigned char> sequence_; // sequenceLength_ images
+   std::size_t sequenceLength_;
+   std::size_t sequenceIndex_;
+   bool sequenceRunning_;
+
+   // SLM column and row of each camera column and row
+   std::vector<unsigned> columnMap_;
+   std::vector<unsigned> rowMap_;
+};
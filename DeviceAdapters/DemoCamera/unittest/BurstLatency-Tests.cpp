@@ -0,0 +1,85 @@
+// DESCRIPTION:   Tests of the Core's trigger latency measurement of
+//                DemoCamera bursts
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "MMCore.h"
+
+#include <string>
+#include <vector>
+
+// Where the DemoCamera adapter was built
+#ifndef DEMOCAMERA_ADAPTER_DIR
+#define DEMOCAMERA_ADAPTER_DIR "../.libs"
+#endif
+
+
+class BurstLatencyTests : public ::testing::Test
+{
+protected:
+   CMMCore core_;
+
+   virtual void SetUp()
+   {
+      core_.setDeviceAdapterSearchPaths(
+            std::vector<std::string>(1, DEMOCAMERA_ADAPTER_DIR));
+      core_.loadDevice("Camera", "DemoCamera", "DCam");
+      core_.initializeDevice("Camera");
+      core_.setCameraDevice("Camera");
+      core_.setExposure(1.0);
+   }
+
+   void WaitForAcquisitionEnd()
+   {
+      for (int i = 0; i < 500 && core_.isSequenceRunning("Camera"); ++i)
+         core_.sleep(10.0);
+      ASSERT_FALSE(core_.isSequenceRunning("Camera"));
+   }
+};
+
+// The camera's default triggers (software burst start, internal frames) are
+// used without being set through the Core
+TEST_F(BurstLatencyTests, MeasuresWithCameraDefaultTriggers)
+{
+   core_.prepareForBurst("Camera", 3);
+   core_.sendBurstStartTrigger("Camera");
+   WaitForAcquisitionEnd();
+   EXPECT_EQ(1u, core_.getTriggerLatencies("Camera").size());
+}
+
+TEST_F(BurstLatencyTests, StopAbortsBurstAndLaterFramesAreNotMeasured)
+{
+   core_.setFrameStartTriggerType("Camera", MM::g_TriggerType_Software);
+   core_.prepareForBurst("Camera", 5);
+   core_.sendBurstStartTrigger("Camera");
+   core_.sendFrameStartTrigger("Camera");
+   core_.stopSequenceAcquisition("Camera");
+   EXPECT_FALSE(core_.isSequenceRunning("Camera"));
+   EXPECT_EQ(1u, core_.getTriggerLatencies("Camera").size());
+
+   core_.startSequenceAcquisition(2, 0.0, true);
+   WaitForAcquisitionEnd();
+   for (int i = 0; i < 2; ++i)
+   {
+      Metadata md;
+      core_.popNextImageMD(md);
+      EXPECT_FALSE(md.HasTag(MM::g_Keyword_Metadata_TriggerLatency_ms));
+   }
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
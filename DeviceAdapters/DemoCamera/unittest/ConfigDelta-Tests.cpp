@@ -0,0 +1,95 @@
+// DESCRIPTION:   Tests of the Core applying only the changed properties of
+//                DemoCamera config presets
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "MMCore.h"
+
+#include <string>
+#include <vector>
+
+// Where the DemoCamera adapter was built
+#ifndef DEMOCAMERA_ADAPTER_DIR
+#define DEMOCAMERA_ADAPTER_DIR "../.libs"
+#endif
+
+
+class ConfigDeltaTests : public ::testing::Test
+{
+protected:
+   CMMCore core_;
+
+   virtual void SetUp()
+   {
+      core_.setDeviceAdapterSearchPaths(
+            std::vector<std::string>(1, DEMOCAMERA_ADAPTER_DIR));
+      core_.loadDevice("Z", "DemoCamera", "DStage");
+      core_.loadDevice("Wheel", "DemoCamera", "DWheel");
+      core_.initializeAllDevices();
+
+      core_.defineConfig("Setup", "Low", "Z", "Position", "10.0000");
+      core_.defineConfig("Setup", "Low", "Wheel", "State", "0");
+      core_.defineConfig("Setup", "High", "Z", "Position", "20.0000");
+      core_.defineConfig("Setup", "High", "Wheel", "State", "0");
+      core_.setConfig("Setup", "Low");
+      core_.updateSystemStateCache();
+   }
+
+   // Moves the stage without going through setProperty(), which leaves the
+   // cache showing the Low preset
+   void MoveStageAway()
+   {
+      core_.setPosition("Z", 50.0);
+      ASSERT_DOUBLE_EQ(50.0, core_.getPosition("Z"));
+      ASSERT_EQ("Low", core_.getCurrentConfigFromCache("Setup"));
+   }
+};
+
+TEST_F(ConfigDeltaTests, CacheIsNotTrustedByDefault)
+{
+   EXPECT_FALSE(core_.isStateCacheTrusted());
+   MoveStageAway();
+   core_.setConfig("Setup", "Low");
+   EXPECT_DOUBLE_EQ(10.0, core_.getPosition("Z"));
+}
+
+TEST_F(ConfigDeltaTests, TrustedCacheAppliesOnlyChangedProperties)
+{
+   core_.setStateCacheTrusted(true);
+   MoveStageAway();
+
+   // Nothing differs from the cached preset, so nothing is set
+   core_.setConfig("Setup", "Low");
+   EXPECT_DOUBLE_EQ(50.0, core_.getPosition("Z"));
+
+   core_.setConfig("Setup", "High");
+   EXPECT_DOUBLE_EQ(20.0, core_.getPosition("Z"));
+   EXPECT_EQ("High", core_.getCurrentConfigFromCache("Setup"));
+}
+
+TEST_F(ConfigDeltaTests, UntrustedCacheAppliesWholePreset)
+{
+   core_.setStateCacheTrusted(true);
+   MoveStageAway();
+
+   core_.setStateCacheTrusted(false);
+   core_.setConfig("Setup", "Low");
+   EXPECT_DOUBLE_EQ(10.0, core_.getPosition("Z"));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
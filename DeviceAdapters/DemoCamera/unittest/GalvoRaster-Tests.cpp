@@ -0,0 +1,288 @@
+// DESCRIPTION:   Unit tests and benchmark for the DemoGalvo polygon and
+//                spot rasterization
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "GalvoRaster.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+namespace
+{
+
+typedef PolygonMask::Vertex Vertex;
+typedef std::vector<Vertex> Polygon;
+
+Polygon Rectangle(int x0, int y0, int x1, int y1)
+{
+   Polygon p;
+   p.push_back(Vertex(x0, y0));
+   p.push_back(Vertex(x1, y0));
+   p.push_back(Vertex(x1, y1));
+   p.push_back(Vertex(x0, y1));
+   return p;
+}
+
+// Star-shaped (and so usually concave) polygon around (cx, cy)
+Polygon Star(int cx, int cy, int outer, int inner, int points, double phase)
+{
+   Polygon p;
+   const double pi = 3.14159265358979;
+   for (int i = 0; i < 2 * points; ++i)
+   {
+      const double r = (i % 2) ? inner : outer;
+      const double a = phase + i * pi / points;
+      p.push_back(Vertex(cx + static_cast<int>(r * std::cos(a)),
+            cy + static_cast<int>(r * std::sin(a))));
+   }
+   return p;
+}
+
+// Per-pixel even-odd test, using the same conventions as PolygonMask
+bool Inside(const Polygon& polygon, int px, int py)
+{
+   bool inside = false;
+   for (size_t i = 0; i < polygon.size(); ++i)
+   {
+      Vertex a = polygon[i];
+      Vertex b = polygon[(i + 1) % polygon.size()];
+      if (a.y == b.y)
+         continue;
+      if (a.y > b.y)
+         std::swap(a, b);
+      if (py < a.y || py >= b.y)
+         continue;
+      const double dxdy = static_cast<double>(b.x - a.x) / (b.y - a.y);
+      if (px >= a.x + (py - a.y) * dxdy)
+         inside = !inside;
+   }
+   return inside;
+}
+
+std::vector<unsigned char> BruteForce(const std::vector<Polygon>& polygons,
+      int width, int height)
+{
+   std::vector<unsigned char> mask(width * height, 0);
+   for (int y = 0; y < height; ++y)
+      for (int x = 0; x < width; ++x)
+         for (size_t i = 0; i < polygons.size(); ++i)
+            if (polygons[i].size() >= 3 && Inside(polygons[i], x, y))
+               mask[y * width + x] = 1;
+   return mask;
+}
+
+std::vector<unsigned char> Render(const PolygonMask& mask)
+{
+   std::vector<unsigned char> image(mask.Width() * mask.Height(), 0);
+   if (!image.empty())
+      mask.AddTo(&image[0], static_cast<unsigned char>(1));
+   return image;
+}
+
+// Dozens of ROIs of assorted shapes, scattered over the image
+std::vector<Polygon> ManyPolygons(int width, int height, int count)
+{
+   std::vector<Polygon> polygons;
+   unsigned seed = 12345;
+   for (int i = 0; i < count; ++i)
+   {
+      seed = seed * 1103515245 + 12345;
+      const int cx = static_cast<int>((seed >> 8) % width);
+      seed = seed * 1103515245 + 12345;
+      const int cy = static_cast<int>((seed >> 8) % height);
+      const int r = std::max(4, std::min(width, height) / 12);
+      if (i % 3 == 0)
+         polygons.push_back(Rectangle(cx - r, cy - r / 2, cx + r, cy + r / 2));
+      else
+         polygons.push_back(Star(cx, cy, r, r / 2, 3 + i % 5, 0.1 * i));
+   }
+   return polygons;
+}
+
+} // anonymous namespace
+
+
+TEST(PolygonMaskTests, RectangleIsHalfOpen)
+{
+   std::vector<Polygon> polygons(1, Rectangle(2, 3, 6, 5));
+   PolygonMask mask;
+   mask.Rasterize(polygons, 10, 10);
+   ASSERT_EQ(2u, mask.Spans().size());
+   EXPECT_EQ(3, mask.Spans()[0].y);
+   EXPECT_EQ(2, mask.Spans()[0].x0);
+   EXPECT_EQ(6, mask.Spans()[0].x1);
+   EXPECT_EQ(4, mask.Spans()[1].y);
+   EXPECT_EQ(8u, mask.PixelCount());
+}
+
+TEST(PolygonMaskTests, MatchesPerPixelTest)
+{
+   std::vector<Polygon> polygons;
+   polygons.push_back(Star(30, 30, 25, 10, 5, 0.3));
+   polygons.push_back(Star(70, 40, 30, 8, 7, 1.1));
+   Polygon triangle;
+   triangle.push_back(Vertex(5, 90));
+   triangle.push_back(Vertex(95, 70));
+   triangle.push_back(Vertex(40, 99));
+   polygons.push_back(triangle);
+   Polygon selfIntersecting; // Bow tie
+   selfIntersecting.push_back(Vertex(10, 50));
+   selfIntersecting.push_back(Vertex(40, 80));
+   selfIntersecting.push_back(Vertex(40, 50));
+   selfIntersecting.push_back(Vertex(10, 80));
+   polygons.push_back(selfIntersecting);
+
+   PolygonMask mask;
+   mask.Rasterize(polygons, 100, 100);
+   EXPECT_EQ(BruteForce(polygons, 100, 100), Render(mask));
+}
+
+TEST(PolygonMaskTests, ClipsToImage)
+{
+   std::vector<Polygon> polygons;
+   polygons.push_back(Rectangle(-5, -5, 3, 4));
+   polygons.push_back(Star(19, 8, 12, 6, 4, 0.0));
+   PolygonMask mask;
+   mask.Rasterize(polygons, 20, 10);
+   // The corner rectangle keeps only its part inside the image
+   EXPECT_EQ(3, mask.Spans()[0].x1);
+   EXPECT_EQ(BruteForce(polygons, 20, 10), Render(mask));
+   for (size_t i = 0; i < mask.Spans().size(); ++i)
+   {
+      const PolygonMask::Span& s = mask.Spans()[i];
+      EXPECT_LE(0, s.x0);
+      EXPECT_GE(20, s.x1);
+      EXPECT_LE(0, s.y);
+      EXPECT_GT(10, s.y);
+   }
+}
+
+TEST(PolygonMaskTests, OverlappingPolygonsAddOnce)
+{
+   std::vector<Polygon> polygons;
+   polygons.push_back(Rectangle(0, 0, 6, 2));
+   polygons.push_back(Rectangle(4, 0, 10, 2));
+   polygons.push_back(Rectangle(6, 0, 8, 2)); // Adjacent and contained
+   PolygonMask mask;
+   mask.Rasterize(polygons, 10, 2);
+   ASSERT_EQ(2u, mask.Spans().size());
+   EXPECT_EQ(0, mask.Spans()[0].x0);
+   EXPECT_EQ(10, mask.Spans()[0].x1);
+
+   std::vector<unsigned short> image(20, 100);
+   mask.AddTo(&image[0], static_cast<unsigned short>(2048));
+   for (size_t i = 0; i < image.size(); ++i)
+      EXPECT_EQ(2148, image[i]);
+}
+
+TEST(PolygonMaskTests, DegeneratePolygonsAreIgnored)
+{
+   std::vector<Polygon> polygons;
+   polygons.push_back(Polygon());
+   polygons.push_back(Rectangle(1, 1, 5, 1)); // Zero height
+   Polygon line;
+   line.push_back(Vertex(0, 0));
+   line.push_back(Vertex(5, 5));
+   polygons.push_back(line);
+   PolygonMask mask;
+   mask.Rasterize(polygons, 10, 10);
+   EXPECT_EQ(0u, mask.PixelCount());
+}
+
+TEST(KernelStampTests, ClipsToImage)
+{
+   std::vector<unsigned short> kernel(9);
+   for (int i = 0; i < 9; ++i)
+      kernel[i] = static_cast<unsigned short>(i + 1);
+   KernelStamp stamp;
+   stamp.Set(3, kernel);
+
+   std::vector<unsigned char> image(16, 0);
+   stamp.AddTo(&image[0], 4, 4, -1, 2, 2);
+   // Kernel columns 1..2 and rows 0..1 land on image columns 0..1, rows 2..3
+   EXPECT_EQ(4, image[2 * 4 + 0]);
+   EXPECT_EQ(6, image[2 * 4 + 1]);
+   EXPECT_EQ(10, image[3 * 4 + 0]);
+   EXPECT_EQ(12, image[3 * 4 + 1]);
+   unsigned total = 0;
+   for (size_t i = 0; i < image.size(); ++i)
+      total += image[i];
+   EXPECT_EQ(32u, total);
+
+   std::vector<unsigned short> far(16, 0);
+   stamp.AddTo(&far[0], 4, 4, 10, 10, 1);
+   stamp.AddTo(&far[0], 4, 4, -10, -10, 1);
+   for (size_t i = 0; i < far.size(); ++i)
+      EXPECT_EQ(0, far[i]);
+}
+
+// Rasterizing (once per LoadPolygons or change of camera settings) and
+// applying the mask (once per frame), compared with testing every pixel
+// against every polygon
+TEST(PolygonMaskTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const int polygonCount = 48;
+   const int sizes[] = { 512, 1024, 2048 };
+   for (int s = 0; s < 3; ++s)
+   {
+      const int size = sizes[s];
+      const std::vector<Polygon> polygons = ManyPolygons(size, size, polygonCount);
+
+      const int rasterizations = 20;
+      PolygonMask mask;
+      const ptime t0 = microsec_clock::universal_time();
+      for (int i = 0; i < rasterizations; ++i)
+         mask.Rasterize(polygons, size, size);
+      const ptime t1 = microsec_clock::universal_time();
+
+      std::vector<unsigned short> image(size * size, 0);
+      const int frames = 50;
+      for (int i = 0; i < frames; ++i)
+         mask.AddTo(&image[0], static_cast<unsigned short>(2048));
+      const ptime t2 = microsec_clock::universal_time();
+
+      const double rasterizeUs = static_cast<double>((t1 - t0).total_microseconds()) / rasterizations;
+      const double applyUs = static_cast<double>((t2 - t1).total_microseconds()) / frames;
+      std::cout << size << "x" << size << ", " << polygonCount << " polygons (" <<
+         100.0 * mask.PixelCount() / (size * size) << "% covered): rasterize " <<
+         rasterizeUs << " us (" <<
+         (rasterizeUs > 0.0 ? polygonCount * 1e6 / rasterizeUs : 0.0) <<
+         " polygons/s), apply " << applyUs << " us/frame";
+
+      if (size == sizes[0])
+      {
+         const ptime t3 = microsec_clock::universal_time();
+         const std::vector<unsigned char> reference = BruteForce(polygons, size, size);
+         const ptime t4 = microsec_clock::universal_time();
+         std::cout << ", per-pixel test " << (t4 - t3).total_microseconds() << " us/frame";
+         EXPECT_EQ(reference, Render(mask));
+      }
+      std::cout << "\n";
+      EXPECT_EQ(static_cast<unsigned short>(frames * 2048), image[mask.Spans()[0].y * size + mask.Spans()[0].x0]);
+   }
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
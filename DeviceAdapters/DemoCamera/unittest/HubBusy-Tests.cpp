@@ -0,0 +1,94 @@
+// DESCRIPTION:   Tests of the Core's busy polling through DemoHub, which
+//                counts the status queries that the polling costs
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "MMCore.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Where the DemoCamera adapter was built
+#ifndef DEMOCAMERA_ADAPTER_DIR
+#define DEMOCAMERA_ADAPTER_DIR "../.libs"
+#endif
+
+
+class HubBusyTests : public ::testing::Test
+{
+protected:
+   CMMCore core_;
+
+   virtual void SetUp()
+   {
+      core_.setDeviceAdapterSearchPaths(
+            std::vector<std::string>(1, DEMOCAMERA_ADAPTER_DIR));
+   }
+
+   void LoadHub(const char* label)
+   {
+      core_.loadDevice(label, "DemoCamera", "DHub");
+      core_.initializeDevice(label);
+   }
+
+   void LoadPeripheral(const char* label, const char* name, const char* hub)
+   {
+      core_.loadDevice(label, "DemoCamera", name);
+      core_.setParentLabel(label, hub);
+      core_.initializeDevice(label);
+   }
+
+   long StatusQueries(const char* hub)
+   {
+      return std::atol(core_.getProperty(hub, "StatusQueries").c_str());
+   }
+};
+
+TEST_F(HubBusyTests, SystemBusyQueriesEachHubOnce)
+{
+   LoadHub("Hub");
+   LoadPeripheral("Wheel", "DWheel", "Hub");
+   LoadPeripheral("State", "DStateDevice", "Hub");
+   LoadPeripheral("XY", "DXYStage", "Hub");
+   LoadPeripheral("Shutter", "DShutter", "Hub");
+
+   const long before = StatusQueries("Hub");
+   EXPECT_FALSE(core_.systemBusy());
+   EXPECT_EQ(before + 1, StatusQueries("Hub"));
+   EXPECT_FALSE(core_.deviceTypeBusy(MM::StateDevice));
+   EXPECT_EQ(before + 2, StatusQueries("Hub"));
+}
+
+TEST_F(HubBusyTests, SystemBusyStopsAtFirstBusyDevice)
+{
+   LoadHub("HubA");
+   LoadHub("HubB");
+   LoadPeripheral("WheelA", "DWheel", "HubA");
+   LoadPeripheral("WheelB", "DWheel", "HubB");
+
+   core_.setDeviceDelayMs("WheelA", 500.0);
+   core_.setProperty("WheelA", MM::g_Keyword_State, "1");
+   const long beforeA = StatusQueries("HubA");
+   const long beforeB = StatusQueries("HubB");
+   EXPECT_TRUE(core_.systemBusy());
+   EXPECT_EQ(beforeA + 1, StatusQueries("HubA"));
+   EXPECT_EQ(beforeB, StatusQueries("HubB"));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
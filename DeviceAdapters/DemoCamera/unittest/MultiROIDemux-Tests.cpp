@@ -0,0 +1,104 @@
+// DESCRIPTION:   Tests of the Core splitting DemoCamera multi-ROI frames into
+//                per-ROI images in the circular buffer
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "MMCore.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Where the DemoCamera adapter was built
+#ifndef DEMOCAMERA_ADAPTER_DIR
+#define DEMOCAMERA_ADAPTER_DIR "../.libs"
+#endif
+
+
+class MultiROIDemuxTests : public ::testing::Test
+{
+protected:
+   CMMCore core_;
+
+   virtual void SetUp()
+   {
+      core_.setDeviceAdapterSearchPaths(
+            std::vector<std::string>(1, DEMOCAMERA_ADAPTER_DIR));
+      core_.loadDevice("Camera", "DemoCamera", "DCam");
+      core_.initializeDevice("Camera");
+      core_.setCameraDevice("Camera");
+      core_.setProperty("Camera", "AllowMultiROI", "1");
+
+      // A 20x16 and a 30x8 region, which the buffer stores as 30x16 images
+      std::vector<unsigned> xs, ys, widths, heights;
+      xs.push_back(10); ys.push_back(10); widths.push_back(20); heights.push_back(16);
+      xs.push_back(50); ys.push_back(60); widths.push_back(30); heights.push_back(8);
+      core_.setMultiROI(xs, ys, widths, heights);
+      core_.setMultiROIDemuxEnabled(true);
+   }
+
+   void ExpectPerROISize()
+   {
+      EXPECT_EQ(30u, core_.getImageWidth());
+      EXPECT_EQ(16u, core_.getImageHeight());
+      EXPECT_EQ(2u, core_.getNumberOfCameraChannels());
+      EXPECT_EQ(30 * 16 * core_.getBytesPerPixel(), core_.getImageBufferSize());
+   }
+};
+
+TEST_F(MultiROIDemuxTests, GettersDescribeFramesPoppedAfterStop)
+{
+   core_.startSequenceAcquisition(2, 0.0, true);
+   while (core_.isSequenceRunning())
+      core_.sleep(10.0);
+   core_.stopSequenceAcquisition();
+
+   ExpectPerROISize();
+   // Each frame holds one image per ROI
+   ASSERT_EQ(2, core_.getRemainingImageCount());
+   for (unsigned roi = 0; roi < 2; ++roi)
+   {
+      Metadata md;
+      ASSERT_TRUE(core_.popNextImageMD(roi, 0, md) != 0);
+      EXPECT_EQ(30, std::atol(md.GetSingleTag("Width").GetValue().c_str()));
+      EXPECT_EQ(16, std::atol(md.GetSingleTag("Height").GetValue().c_str()));
+      EXPECT_EQ(roi ? 30 : 20,
+            std::atol(md.GetSingleTag("MultiROIWidth").GetValue().c_str()));
+      EXPECT_EQ(roi ? 8 : 16,
+            std::atol(md.GetSingleTag("MultiROIHeight").GetValue().c_str()));
+   }
+   ExpectPerROISize();
+}
+
+TEST_F(MultiROIDemuxTests, SnappedImageIsSplitLikeTheBuffer)
+{
+   core_.snapImage();
+   ExpectPerROISize();
+   EXPECT_TRUE(core_.getImage() != 0);
+   EXPECT_TRUE(core_.getImage(1) != 0);
+   EXPECT_THROW(core_.getImage(2), CMMError);
+}
+
+TEST_F(MultiROIDemuxTests, DisablingRestoresTheCameraSize)
+{
+   core_.setMultiROIDemuxEnabled(false);
+   EXPECT_EQ(1u, core_.getNumberOfCameraChannels());
+   EXPECT_NE(30u, core_.getImageWidth());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,231 @@
+// DESCRIPTION:   Unit tests and benchmark for the DemoSLM pattern storage and
+//                rendering
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "SLMPattern.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <iostream>
+#include <vector>
+
+
+namespace
+{
+
+std::vector<unsigned short> IdentityLut()
+{
+   std::vector<unsigned short> lut(256);
+   for (int v = 0; v < 256; ++v)
+      lut[v] = static_cast<unsigned short>(v);
+   return lut;
+}
+
+// width x height pattern whose pixels are value + x + y
+std::vector<unsigned char> Gradient(unsigned width, unsigned height,
+      unsigned char value)
+{
+   std::vector<unsigned char> pattern(width * height);
+   for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x)
+         pattern[y * width + x] = static_cast<unsigned char>(value + x + y);
+   return pattern;
+}
+
+} // anonymous namespace
+
+
+TEST(SLMPatternsTests, UploadedImageIsShownWhenDisplayed)
+{
+   SLMPatterns patterns;
+   patterns.SetSize(4, 3);
+   ASSERT_EQ(12u, patterns.ImageBytes());
+   EXPECT_EQ(0, patterns.DisplayedPixels()[5]);
+
+   const std::vector<unsigned char> first = Gradient(4, 3, 10);
+   patterns.SetImage(&first[0]);
+   EXPECT_EQ(0, patterns.DisplayedPixels()[5]);
+   patterns.DisplayImage();
+   EXPECT_EQ(first, std::vector<unsigned char>(patterns.DisplayedPixels(),
+            patterns.DisplayedPixels() + 12));
+
+   patterns.SetPixelsTo(7);
+   EXPECT_EQ(first[11], patterns.DisplayedPixels()[11]);
+   patterns.DisplayImage();
+   EXPECT_EQ(7, patterns.DisplayedPixels()[0]);
+   EXPECT_EQ(7, patterns.DisplayedPixels()[11]);
+}
+
+TEST(SLMPatternsTests, DisplayingTwiceKeepsTheUploadedImage)
+{
+   SLMPatterns patterns;
+   patterns.SetSize(4, 3);
+   const std::vector<unsigned char> first = Gradient(4, 3, 10);
+   patterns.SetImage(&first[0]);
+   patterns.DisplayImage();
+   patterns.DisplayImage();
+   EXPECT_EQ(first, std::vector<unsigned char>(patterns.DisplayedPixels(),
+            patterns.DisplayedPixels() + 12));
+
+   // Also after a new upload, the previous image does not come back
+   patterns.SetPixelsTo(7);
+   patterns.DisplayImage();
+   patterns.DisplayImage();
+   EXPECT_EQ(7, patterns.DisplayedPixels()[0]);
+   EXPECT_EQ(7, patterns.DisplayedPixels()[11]);
+}
+
+TEST(SLMPatternsTests, SequenceCyclesThroughImages)
+{
+   SLMPatterns patterns;
+   patterns.SetSize(2, 2);
+   EXPECT_FALSE(patterns.StartSequence());
+
+   // One contiguous upload of two images, then one more
+   const unsigned char frames[] = { 1, 1, 1, 1, 2, 2, 2, 2 };
+   const unsigned char third[] = { 3, 3, 3, 3 };
+   patterns.AddToSequence(frames, 2);
+   patterns.AddToSequence(third);
+   ASSERT_EQ(3u, patterns.SequenceLength());
+
+   ASSERT_TRUE(patterns.StartSequence());
+   EXPECT_TRUE(patterns.IsSequenceRunning());
+   const unsigned char expected[] = { 1, 2, 3, 1, 2 };
+   for (int i = 0; i < 5; ++i)
+   {
+      EXPECT_EQ(expected[i], patterns.DisplayedPixels()[3]) << "image " << i;
+      patterns.NextSequenceImage();
+   }
+
+   // The last sequence image stays on display
+   patterns.StopSequence();
+   EXPECT_FALSE(patterns.IsSequenceRunning());
+   EXPECT_EQ(3, patterns.DisplayedPixels()[0]);
+   patterns.NextSequenceImage();
+   EXPECT_EQ(3, patterns.DisplayedPixels()[0]);
+
+   patterns.ClearSequence();
+   EXPECT_EQ(0u, patterns.SequenceLength());
+   EXPECT_FALSE(patterns.StartSequence());
+}
+
+TEST(SLMPatternsTests, RendersStretchedOverImage)
+{
+   SLMPatterns patterns;
+   patterns.SetSize(2, 2);
+   const unsigned char pattern[] = { 10, 20, 30, 40 };
+   patterns.SetImage(pattern);
+   patterns.DisplayImage();
+
+   const std::vector<unsigned short> lut = IdentityLut();
+   std::vector<unsigned short> image(4 * 6, 100);
+   patterns.AddTo(&image[0], 4, 6, &lut[0]);
+   for (int y = 0; y < 6; ++y)
+   {
+      for (int x = 0; x < 4; ++x)
+      {
+         const unsigned short expected = static_cast<unsigned short>(
+               100 + pattern[(y / 3) * 2 + x / 2]);
+         EXPECT_EQ(expected, image[y * 4 + x]) << x << ", " << y;
+      }
+   }
+
+   // Same size as the SLM
+   std::vector<unsigned short> small(4, 1);
+   patterns.AddTo(&small[0], 2, 2, &lut[0]);
+   EXPECT_EQ(11, small[0]);
+   EXPECT_EQ(41, small[3]);
+}
+
+TEST(SLMPatternsTests, LookupTableScalesSignal)
+{
+   SLMPatterns patterns;
+   patterns.SetSize(3, 1);
+   patterns.SetPixelsTo(255);
+   patterns.DisplayImage();
+   std::vector<unsigned char> lut(256, 0);
+   lut[255] = 200;
+   std::vector<unsigned char> image(3, 100);
+   patterns.AddTo(&image[0], 3, 1, &lut[0]);
+   EXPECT_EQ(static_cast<unsigned char>(300), image[0]); // Wraps around
+}
+
+// Pattern-switch throughput: uploading and displaying single images,
+// loading a sequence in one call, and stepping through it while rendering
+// into camera images of the SLM's size and of a larger camera.
+TEST(SLMPatternsTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const unsigned width = 1024, height = 768;
+   const unsigned frames = 100;
+   std::vector<unsigned char> sequence;
+   for (unsigned i = 0; i < frames; ++i)
+   {
+      const std::vector<unsigned char> frame = Gradient(width, height,
+            static_cast<unsigned char>(i));
+      sequence.insert(sequence.end(), frame.begin(), frame.end());
+   }
+
+   SLMPatterns patterns;
+   patterns.SetSize(width, height);
+   const ptime t0 = microsec_clock::universal_time();
+   for (unsigned i = 0; i < frames; ++i)
+   {
+      patterns.SetImage(&sequence[i * patterns.ImageBytes()]);
+      patterns.DisplayImage();
+   }
+   const ptime t1 = microsec_clock::universal_time();
+   patterns.AddToSequence(&sequence[0], frames);
+   const ptime t2 = microsec_clock::universal_time();
+   ASSERT_TRUE(patterns.StartSequence());
+   for (unsigned i = 0; i < 100 * frames; ++i)
+      patterns.NextSequenceImage();
+   const ptime t3 = microsec_clock::universal_time();
+
+   const double uploadUs = static_cast<double>((t1 - t0).total_microseconds()) / frames;
+   const double loadUs = static_cast<double>((t2 - t1).total_microseconds());
+   const double switchUs = static_cast<double>((t3 - t2).total_microseconds()) / (100 * frames);
+   std::cout << width << "x" << height << " SLM: upload and display " <<
+      uploadUs << " us (" << (uploadUs > 0.0 ? 1e6 / uploadUs : 0.0) <<
+      " patterns/s), load " << frames << "-image sequence " << loadUs <<
+      " us, sequence switch " << switchUs << " us\n";
+
+   const std::vector<unsigned short> lut = IdentityLut();
+   const unsigned cameraSizes[][2] = { { width, height }, { 2048, 2048 } };
+   for (int c = 0; c < 2; ++c)
+   {
+      const unsigned cw = cameraSizes[c][0], ch = cameraSizes[c][1];
+      std::vector<unsigned short> image(cw * ch, 0);
+      const ptime t4 = microsec_clock::universal_time();
+      for (unsigned i = 0; i < frames; ++i)
+      {
+         patterns.AddTo(&image[0], cw, ch, &lut[0]);
+         patterns.NextSequenceImage();
+      }
+      const ptime t5 = microsec_clock::universal_time();
+      const double renderUs = static_cast<double>((t5 - t4).total_microseconds()) / frames;
+      std::cout << cw << "x" << ch << " camera: render and switch " << renderUs <<
+         " us (" << (renderUs > 0.0 ? 1e6 / renderUs : 0.0) << " frames/s)\n";
+   }
+   patterns.StopSequence();
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -166,6 +166,7 @@ class PollingThread;
 class NotificationThread;
 class AcqThread;
 class StreamWriter;
+class MMThreadPool;
 template<class T> class PvParam;
 class PvUniversalParam;
 class PvEnumParam;
@@ -519,6 +520,11 @@ public: // Other published methods
     * Published to allow other classes access the camera.
     */
     short Handle();
+    /**
+    * Returns the pool for parallel processing of frames, sized by the Core's
+    * worker thread budget, or NULL if the camera is not initialized.
+    */
+    MMThreadPool* ThreadPool() const;
 
     // All the logging methods below prepend the message with a PVCAM Adapter
     // specific prefix. We use that to unify the logs and to clearly see which logs
@@ -774,6 +780,7 @@ private:
     AcqThread*      acqThd_;               // Non-CB live thread
 
     StreamWriter*   customDiskWriter_;     // Writer for custom disk streaming feature
+    MMThreadPool*   threadPool_;           // Workers for parallel frame copies
     bool            customDiskWriterActive_; // Cached value updated after writer->Start
 
     /// CAMERA PARAMETERS:
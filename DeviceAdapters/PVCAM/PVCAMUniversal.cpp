@@ -37,6 +37,7 @@
 #include "PVCAMAdapter.h"
 
 // MMDevice
+#include "DeviceThreadPool.h"
 #include "FixSnprintf.h"
 #include "ModuleInterface.h"
 
@@ -227,6 +228,7 @@ Universal::Universal(short cameraId, const char* deviceName)
     notificationThd_(NULL),
     acqThd_(NULL),
     customDiskWriter_(NULL),
+    threadPool_(NULL),
     customDiskWriterActive_(false),
     camParSize_(0),
     camSerSize_(0),
@@ -346,6 +348,7 @@ Universal::~Universal()
     delete notificationThd_;
     delete acqThd_;
     delete customDiskWriter_;
+    delete threadPool_;
 
 #ifdef PVCAM_METADATA_SUPPORTED
     if (metaFrameStruct_)
@@ -1390,13 +1393,20 @@ int Universal::Initialize()
     SetErrorText(ERR_TOO_MANY_ROIS,
         std::string("Device supports only " + ss.str() + " ROI(s).").c_str());
 
+    threadPool_ = new MMThreadPool(GetWorkerThreadBudget());
+
     // Make sure our configs are synchronized
     acqCfgCur_ = acqCfgNew_;
 
     // Force sending initial setup to camera to have up to date "post-setup" parameters
     nRet = applyAcqConfig(true);
     if (nRet != DEVICE_OK)
+    {
+        // Shutdown() does not clean up after a failed initialization
+        delete threadPool_;
+        threadPool_ = NULL;
         return LogAdapterError(nRet, __LINE__, "Failed to apply initial settings to camera");
+    }
 
     initialized_ = true;
     START_METHOD("<<< Universal::Initialize");
@@ -1434,6 +1444,8 @@ int Universal::Shutdown()
             pFrameInfo_ = NULL;
         }
 #endif
+        delete threadPool_;
+        threadPool_ = NULL;
         initialized_ = false;
     }
     return DEVICE_OK;
@@ -3475,6 +3487,11 @@ short Universal::Handle()
     return hPVCAM_;
 }
 
+MMThreadPool* Universal::ThreadPool() const
+{
+    return threadPool_;
+}
+
 int Universal::LogPvcamError(int lineNr, const std::string& message, int16 pvErrCode, bool debug) throw()
 {
     const int mmErrCode = ERR_PVCAM_OFFSET + pvErrCode;
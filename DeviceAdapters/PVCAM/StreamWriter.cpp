@@ -1,16 +1,14 @@
 #include "StreamWriter.h"
 
 // MMDevice
+#include "DeviceThreadPool.h"
 #include "FixSnprintf.h"
 
 // Local
 #include "PVCAMAdapter.h"
-#include "TaskSet_CopyMemory.h"
-#include "ThreadPool.h"
 
 // Boost
 #include <boost/filesystem.hpp>
-#include <boost/make_shared.hpp>
 #include <boost/thread/locks.hpp>
 
 // System
@@ -97,8 +95,6 @@ private:
 
 StreamWriter::StreamWriter(Universal* camera)
     : camera_(camera),
-    threadPool_(boost::make_shared<ThreadPool>()),
-    tasksMemCopy_(boost::make_shared<TaskSet_CopyMemory>(threadPool_)),
     pageBytes_(0),
     isEnabled_(false),
     dirRoot_(),
@@ -300,8 +296,11 @@ int StreamWriter::WriteFrame(const void* pFrame, size_t frameNr)
     if (!isFrameAligned)
     {
         // Standard memcpy is too slow for Kinetix, do parallel copy instead
-        //memcpy(alignedBuffer_, pFrame, frameBytes_);
-        tasksMemCopy_->MemCopy(alignedBuffer_, pFrame, frameBytes_);
+        MMThreadPool* threadPool = camera_->ThreadPool();
+        if (threadPool)
+            threadPool->MemCopy(alignedBuffer_, pFrame, frameBytes_);
+        else
+            memcpy(alignedBuffer_, pFrame, frameBytes_);
         writeBuffer = alignedBuffer_;
     }
 
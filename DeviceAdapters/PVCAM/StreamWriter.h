@@ -3,12 +3,9 @@
 
 #include <string>
 
-#include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
 class StackFile;
-class TaskSet_CopyMemory;
-class ThreadPool;
 class Universal;
 
 class StreamWriter
@@ -98,10 +95,6 @@ private:
 private:
     const Universal* camera_;
 
-    // TODO: Get some shared pool from outside
-    const boost::shared_ptr<ThreadPool> threadPool_;
-    const boost::shared_ptr<TaskSet_CopyMemory> tasksMemCopy_;
-
     size_t pageBytes_; // Set only once in constructor
 
     mutable boost::mutex mx_; // For serialization of public method calls
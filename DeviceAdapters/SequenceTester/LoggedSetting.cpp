@@ -37,7 +37,10 @@ LoggedSetting::LoggedSetting(SettingLogger* logger,
       InterDevice* device, const std::string& name) :
    logger_(logger),
    device_(device),
-   name_(name)
+   name_(name),
+   keyId_(logger->InternKey(device->GetDeviceName(), name)),
+   edgeTriggerKeyId_(logger->InternKey(device->GetDeviceName(),
+            "trig-in:" + name))
 {
 }
 
@@ -70,7 +73,7 @@ LoggedSetting::GetSequenceMaxLength() const
 void
 LoggedSetting::ReceiveEdgeTrigger()
 {
-   GetLogger()->FireOneShot(device_->GetDeviceName(), "trig-in:" + GetName());
+   GetLogger()->FireOneShot(edgeTriggerKeyId_);
    if (sequenceMaxLengthSetting_->Get() > 0)
       HandleEdgeTrigger();
 }
@@ -99,15 +102,14 @@ BoolSetting::BoolSetting(SettingLogger* logger,
    sequenceRunning_(false),
    nextTriggerIndex_(0)
 {
-   GetLogger()->SetBool(GetDevice()->GetDeviceName(), GetName(),
-         initialValue, false);
+   GetLogger()->SetBool(GetKeyId(), initialValue, false);
 }
 
 
 int
 BoolSetting::Set(bool newValue)
 {
-   GetLogger()->SetBool(GetDevice()->GetDeviceName(), GetName(), newValue);
+   GetLogger()->SetBool(GetKeyId(), newValue);
    FirePostSetSignal();
    return DEVICE_OK;
 }
@@ -124,7 +126,7 @@ BoolSetting::Get(bool& value) const
 bool
 BoolSetting::Get() const
 {
-   return GetLogger()->GetBool(GetDevice()->GetDeviceName(), GetName());
+   return GetLogger()->GetBool(GetKeyId());
 }
 
 
@@ -167,8 +169,7 @@ BoolSetting::HandleEdgeTrigger()
    if (nextTriggerIndex_ >= triggerSequence_.size())
       nextTriggerIndex_ = 0;
 
-   GetLogger()->SetBool(GetDevice()->GetDeviceName(), GetName(),
-         static_cast<bool>(newValue));
+   GetLogger()->SetBool(GetKeyId(), static_cast<bool>(newValue));
    FirePostSetSignal();
 }
 
@@ -304,15 +305,14 @@ IntegerSetting::IntegerSetting(SettingLogger* logger,
    sequenceRunning_(false),
    nextTriggerIndex_(0)
 {
-   GetLogger()->SetInteger(GetDevice()->GetDeviceName(), GetName(),
-         initialValue, false);
+   GetLogger()->SetInteger(GetKeyId(), initialValue, false);
 }
 
 
 int
 IntegerSetting::Set(long newValue)
 {
-   GetLogger()->SetInteger(GetDevice()->GetDeviceName(), GetName(), newValue);
+   GetLogger()->SetInteger(GetKeyId(), newValue);
    FirePostSetSignal();
    return DEVICE_OK;
 }
@@ -329,7 +329,7 @@ IntegerSetting::Get(long& value) const
 long
 IntegerSetting::Get() const
 {
-   return GetLogger()->GetInteger(GetDevice()->GetDeviceName(), GetName());
+   return GetLogger()->GetInteger(GetKeyId());
 }
 
 
@@ -372,7 +372,7 @@ IntegerSetting::HandleEdgeTrigger()
    if (nextTriggerIndex_ >= triggerSequence_.size())
       nextTriggerIndex_ = 0;
 
-   GetLogger()->SetInteger(GetDevice()->GetDeviceName(), GetName(), newValue);
+   GetLogger()->SetInteger(GetKeyId(), newValue);
    FirePostSetSignal();
 }
 
@@ -470,15 +470,14 @@ FloatSetting::FloatSetting(SettingLogger* logger,
    sequenceRunning_(false),
    nextTriggerIndex_(0)
 {
-   GetLogger()->SetFloat(GetDevice()->GetDeviceName(), GetName(),
-         initialValue, false);
+   GetLogger()->SetFloat(GetKeyId(), initialValue, false);
 }
 
 
 int
 FloatSetting::Set(double newValue)
 {
-   GetLogger()->SetFloat(GetDevice()->GetDeviceName(), GetName(), newValue);
+   GetLogger()->SetFloat(GetKeyId(), newValue);
    FirePostSetSignal();
    return DEVICE_OK;
 }
@@ -495,7 +494,7 @@ FloatSetting::Get(double& value) const
 double
 FloatSetting::Get() const
 {
-   return GetLogger()->GetFloat(GetDevice()->GetDeviceName(), GetName());
+   return GetLogger()->GetFloat(GetKeyId());
 }
 
 
@@ -538,7 +537,7 @@ FloatSetting::HandleEdgeTrigger()
    if (nextTriggerIndex_ >= triggerSequence_.size())
       nextTriggerIndex_ = 0;
 
-   GetLogger()->SetFloat(GetDevice()->GetDeviceName(), GetName(), newValue);
+   GetLogger()->SetFloat(GetKeyId(), newValue);
    FirePostSetSignal();
 }
 
@@ -630,15 +629,14 @@ StringSetting::StringSetting(SettingLogger* logger, InterDevice* device,
       const std::string& name, const std::string& initialValue) :
    LoggedSetting(logger, device, name)
 {
-   GetLogger()->SetString(GetDevice()->GetDeviceName(), GetName(),
-         initialValue, false);
+   GetLogger()->SetString(GetKeyId(), initialValue, false);
 }
 
 
 int
 StringSetting::Set(const std::string& newValue)
 {
-   GetLogger()->SetString(GetDevice()->GetDeviceName(), GetName(), newValue);
+   GetLogger()->SetString(GetKeyId(), newValue);
    FirePostSetSignal();
    return DEVICE_OK;
 }
@@ -655,7 +653,7 @@ StringSetting::Get(std::string& value) const
 std::string
 StringSetting::Get() const
 {
-   return GetLogger()->GetString(GetDevice()->GetDeviceName(), GetName());
+   return GetLogger()->GetString(GetKeyId());
 }
 
 
@@ -699,14 +697,14 @@ OneShotSetting::OneShotSetting(SettingLogger* logger,
       InterDevice* device, const std::string& name) :
    LoggedSetting(logger, device, name)
 {
-   GetLogger()->FireOneShot(GetDevice()->GetDeviceName(), GetName(), false);
+   GetLogger()->FireOneShot(GetKeyId(), false);
 }
 
 
 int
 OneShotSetting::Set()
 {
-   GetLogger()->FireOneShot(GetDevice()->GetDeviceName(), GetName());
+   GetLogger()->FireOneShot(GetKeyId());
    FirePostSetSignal();
    return DEVICE_OK;
 }
@@ -718,8 +716,7 @@ CountDownSetting::CountDownSetting(SettingLogger* logger,
    LoggedSetting(logger, device, name),
    defaultIncrement_(defaultIncrement)
 {
-   GetLogger()->SetInteger(GetDevice()->GetDeviceName(), GetName(),
-         initialCount, false);
+   GetLogger()->SetInteger(GetKeyId(), initialCount, false);
 }
 
 
@@ -727,9 +724,9 @@ int
 CountDownSetting::Set(long increment)
 {
    long oldCount =
-      GetLogger()->GetInteger(GetDevice()->GetDeviceName(), GetName());
+      GetLogger()->GetInteger(GetKeyId());
    long newCount = oldCount + increment;
-   GetLogger()->SetInteger(GetDevice()->GetDeviceName(), GetName(), newCount);
+   GetLogger()->SetInteger(GetKeyId(), newCount);
    FirePostSetSignal();
    return DEVICE_OK;
 }
@@ -746,11 +743,10 @@ CountDownSetting::Get(long& value)
 long CountDownSetting::Get()
 {
    long count =
-      GetLogger()->GetInteger(GetDevice()->GetDeviceName(), GetName());
+      GetLogger()->GetInteger(GetKeyId());
    if (count > 0)
    {
-      GetLogger()->SetInteger(GetDevice()->GetDeviceName(), GetName(),
-            count - 1);
+      GetLogger()->SetInteger(GetKeyId(), count - 1);
    }
    // Return the value _before_ the decrement. Otherwise a unit increment would
    // have no effect.
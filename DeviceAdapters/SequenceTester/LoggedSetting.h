@@ -24,6 +24,7 @@
 #pragma once
 
 #include "DeviceBase.h"
+#include "SettingLogger.h"
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/make_shared.hpp>
@@ -59,6 +60,8 @@ class LoggedSetting : public boost::enable_shared_from_this<LoggedSetting>
    SettingLogger* logger_;
    InterDevice* device_;
    const std::string name_;
+   const SettingKeyId keyId_;
+   const SettingKeyId edgeTriggerKeyId_;
 
    boost::shared_ptr<CountDownSetting> busySetting_;
 
@@ -77,6 +80,7 @@ protected:
    InterDevice* GetDevice() { return device_; }
    const InterDevice* GetDevice() const { return device_; }
    std::string GetName() const { return name_; }
+   SettingKeyId GetKeyId() const { return keyId_; }
 
    void FirePostSetSignal() { postSetSignal_(); }
 
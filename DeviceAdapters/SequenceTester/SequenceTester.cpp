@@ -145,6 +145,11 @@ DeleteDevice(MM::Device* pDevice)
 TesterHub::TesterHub(const std::string& name) :
    Super(name)
 {
+   // Events logged between images beyond this are dropped, oldest first
+   HubBase<Self>::CreateIntegerProperty("MaxHistoryEvents",
+         static_cast<long>(SettingLogger::DefaultMaxHistoryEvents),
+         false, 0, true);
+   SetPropertyLimits("MaxHistoryEvents", 1, 16 * 1024 * 1024);
 }
 
 
@@ -159,6 +164,10 @@ TesterHub::Initialize()
    // be the hub.
    InterDevice::SetHub(GetSharedPtr());
 
+   long maxHistoryEvents;
+   GetProperty("MaxHistoryEvents", maxHistoryEvents);
+   logger_.SetMaxHistoryEvents(maxHistoryEvents);
+
    return CommonHubPeripheralInitialize();
 }
 
@@ -241,26 +250,38 @@ TesterHub::FindPeerDevice(const std::string& name)
 
 TesterCamera::TesterCamera(const std::string& name) :
    Super(name),
-   produceHumanReadableImages_(true),
+   imageMode_(ImageModeHumanReadable),
    imageWidth_(384),
    imageHeight_(384),
    nextSerialNr_(0),
    nextSnapImageNr_(0),
    nextSequenceImageNr_(0),
    snapImage_(0),
-   stopSequence_(true)
+   stopSequence_(true),
+   burstArmed_(false),
+   softwareFrames_(false),
+   burstLength_(1),
+   burstFramesSent_(0)
 {
    // For pre-init properties only, we use the traditional method to set up.
    CCameraBase<Self>::CreateStringProperty("ImageMode", "HumanReadable",
          false, 0, true);
    AddAllowedValue("ImageMode", "HumanReadable");
    AddAllowedValue("ImageMode", "MachineReadable");
+   AddAllowedValue("ImageMode", "Binary");
    CCameraBase<Self>::CreateIntegerProperty("ImageWidth", imageWidth_,
          false, 0, true);
    SetPropertyLimits("ImageWidth", 32, 4096);
    CCameraBase<Self>::CreateIntegerProperty("ImageHeight", imageHeight_,
          false, 0, true);
    SetPropertyLimits("ImageHeight", 32, 4096);
+
+   SetErrorText(ERR_BURST_NOT_ARMED,
+         "Camera is not armed for a burst, or the burst has already started");
+   SetErrorText(ERR_BURST_NOT_STARTED,
+         "Burst has not started");
+   SetErrorText(ERR_TRIGGER_NOT_SOFTWARE,
+         "Trigger type is not \"software\"");
 }
 
 
@@ -283,7 +304,12 @@ TesterCamera::Initialize()
 
    char imageMode[MM::MaxStrLength];
    GetProperty("ImageMode", imageMode);
-   produceHumanReadableImages_ = (imageMode == std::string("HumanReadable"));
+   if (imageMode == std::string("MachineReadable"))
+      imageMode_ = ImageModeMachineReadable;
+   else if (imageMode == std::string("Binary"))
+      imageMode_ = ImageModeBinary;
+   else
+      imageMode_ = ImageModeHumanReadable;
    GetProperty("ImageWidth", imageWidth_);
    GetProperty("ImageHeight", imageHeight_);
 
@@ -299,6 +325,22 @@ TesterCamera::Initialize()
    CreateFloatProperty("Exposure", exposureSetting_);
    CreateIntegerProperty("Binning", binningSetting_);
 
+   // Not exposed as properties; set through the burst API
+   preFrameDelaySetting_ = FloatSetting::New(GetLogger(), this,
+         "PreFrameDelay", 0.0, false);
+   postFrameDelaySetting_ = FloatSetting::New(GetLogger(), this,
+         "PostFrameDelay", 0.0, false);
+   burstStartTriggerSetting_ = StringSetting::New(GetLogger(), this,
+         "BurstStartTrigger", MM::g_TriggerType_Software);
+   burstEndTriggerSetting_ = StringSetting::New(GetLogger(), this,
+         "BurstEndTrigger", MM::g_TriggerType_Internal);
+   frameStartTriggerSetting_ = StringSetting::New(GetLogger(), this,
+         "FrameStartTrigger", MM::g_TriggerType_Internal);
+   exposureEndTriggerSetting_ = StringSetting::New(GetLogger(), this,
+         "ExposureEndTrigger", MM::g_TriggerType_Internal);
+   frameExposureModeSetting_ = StringSetting::New(GetLogger(), this,
+         "FrameExposureMode", MM::g_FrameExposureMode_Distinct);
+
    RegisterEdgeTriggerSource("ExposureStartEdge", exposureStartEdgeTrigger_);
    RegisterEdgeTriggerSource("ExposureStopEdge", exposureStopEdgeTrigger_);
 
@@ -435,7 +477,13 @@ TesterCamera::StartSequenceAcquisitionImpl(bool finite, long count,
       stopSequence_ = false;
    }
 
-   GetCoreCallback()->PrepareForAcq(this);
+   int err = GetCoreCallback()->PrepareForAcq(this);
+   if (err != DEVICE_OK)
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      stopSequence_ = true;
+      return err;
+   }
 
    // Note: boost::packaged_task<void ()> in more recent versions of Boost.
    boost::packaged_task<void> captureTask(
@@ -458,9 +506,11 @@ TesterCamera::StopSequenceAcquisition()
 
    {
       boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      burstArmed_ = false;
       if (stopSequence_)
          return DEVICE_OK;
       stopSequence_ = true;
+      softwareFrames_ = false;
    }
 
    // In newer Boost versions: if (sequenceFuture_.valid())
@@ -489,7 +539,232 @@ TesterCamera::IsCapturing()
    // which is protected by its own mutex.
 
    boost::lock_guard<boost::mutex> lock(sequenceMutex_);
-   return !stopSequence_;
+   return burstArmed_ || !stopSequence_;
+}
+
+
+int
+TesterCamera::SetPreFrameDelay(double delayMs)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return preFrameDelaySetting_->Set(delayMs);
+}
+
+
+int
+TesterCamera::SetPostFrameDelay(double delayMs)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return postFrameDelaySetting_->Set(delayMs);
+}
+
+
+int
+TesterCamera::SetBurstStartTriggerType(const char* type)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return burstStartTriggerSetting_->Set(type);
+}
+
+
+int
+TesterCamera::SetBurstEndTriggerType(const char* type)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return burstEndTriggerSetting_->Set(type);
+}
+
+
+int
+TesterCamera::SetFrameStartTriggerType(const char* type)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return frameStartTriggerSetting_->Set(type);
+}
+
+
+int
+TesterCamera::SetExposureEndTriggerType(const char* type)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return exposureEndTriggerSetting_->Set(type);
+}
+
+
+int
+TesterCamera::GetBurstStartTriggerType(char* type)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   CDeviceUtils::CopyLimitedString(type,
+         burstStartTriggerSetting_->Get().c_str());
+   return DEVICE_OK;
+}
+
+
+int
+TesterCamera::GetFrameStartTriggerType(char* type)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   CDeviceUtils::CopyLimitedString(type,
+         frameStartTriggerSetting_->Get().c_str());
+   return DEVICE_OK;
+}
+
+
+int
+TesterCamera::SetFrameExposureMode(const char* mode)
+{
+   TesterHub::Guard g(GetHub()->LockGlobalMutex());
+   return frameExposureModeSetting_->Set(mode);
+}
+
+
+int
+TesterCamera::PrepareForBurst(int numImages)
+{
+   bool startNow;
+   {
+      TesterHub::Guard g(GetHub()->LockGlobalMutex());
+      startNow = burstStartTriggerSetting_->Get() == MM::g_TriggerType_Internal;
+   }
+
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      if (burstArmed_ || !stopSequence_)
+         return DEVICE_CAMERA_BUSY_ACQUIRING;
+      burstLength_ = numImages;
+      burstArmed_ = true;
+   }
+
+   if (startNow)
+   {
+      int err = StartBurst();
+      if (err != DEVICE_OK)
+      {
+         boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+         burstArmed_ = false;
+         return err;
+      }
+   }
+   return DEVICE_OK;
+}
+
+
+int
+TesterCamera::SendBurstStartTrigger()
+{
+   {
+      TesterHub::Guard g(GetHub()->LockGlobalMutex());
+      if (burstStartTriggerSetting_->Get() != MM::g_TriggerType_Software)
+         return ERR_TRIGGER_NOT_SOFTWARE;
+   }
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      if (!burstArmed_)
+         return ERR_BURST_NOT_ARMED;
+   }
+   return StartBurst();
+}
+
+
+int
+TesterCamera::SendFrameStartTrigger()
+{
+   long frame;
+   bool complete;
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      if (stopSequence_)
+         return ERR_BURST_NOT_STARTED;
+      if (!softwareFrames_)
+         return ERR_TRIGGER_NOT_SOFTWARE;
+      frame = burstFramesSent_++;
+      complete = burstLength_ > 0 && burstFramesSent_ >= burstLength_;
+   }
+
+   const unsigned char* bytes;
+   {
+      TesterHub::Guard g(GetHub()->LockGlobalMutex());
+      bytes = GenerateLogImage(true, nextSequenceImageNr_++, frame);
+   }
+
+   char label[MM::MaxStrLength];
+   GetLabel(label);
+   Metadata md;
+   md.put("Camera", label);
+   int err = GetCoreCallback()->InsertImage(this, bytes, GetImageWidth(),
+         GetImageHeight(), GetImageBytesPerPixel(), md.Serialize().c_str());
+   delete[] bytes;
+   if (err != DEVICE_OK)
+      return err;
+
+   if (complete)
+      return SendBurstEndTrigger();
+   return DEVICE_OK;
+}
+
+
+int
+TesterCamera::SendBurstEndTrigger()
+{
+   bool softwareBurst;
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      softwareBurst = !stopSequence_ && softwareFrames_;
+      if (softwareBurst)
+      {
+         stopSequence_ = true;
+         softwareFrames_ = false;
+      }
+   }
+   if (!softwareBurst)
+      return StopSequenceAcquisition(); // Disarms if not started
+   return GetCoreCallback()->AcqFinished(this, 0);
+}
+
+
+int
+TesterCamera::StartBurst()
+{
+   bool softwareFrames;
+   {
+      TesterHub::Guard g(GetHub()->LockGlobalMutex());
+      softwareFrames =
+         frameStartTriggerSetting_->Get() == MM::g_TriggerType_Software;
+   }
+
+   // The camera stays armed if the burst fails to start
+   long count;
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      if (!stopSequence_)
+         return DEVICE_CAMERA_BUSY_ACQUIRING;
+      count = burstLength_;
+      burstArmed_ = false;
+      if (softwareFrames)
+      {
+         stopSequence_ = false;
+         softwareFrames_ = true;
+         burstFramesSent_ = 0;
+      }
+   }
+
+   int err;
+   if (!softwareFrames)
+      err = StartSequenceAcquisitionImpl(count > 0, count, false);
+   else
+      err = GetCoreCallback()->PrepareForAcq(this);
+   if (err != DEVICE_OK)
+   {
+      boost::lock_guard<boost::mutex> lock(sequenceMutex_);
+      if (softwareFrames)
+      {
+         stopSequence_ = true;
+         softwareFrames_ = false;
+      }
+      burstArmed_ = true;
+   }
+   return err;
 }
 
 
@@ -503,17 +778,21 @@ TesterCamera::GenerateLogImage(bool isSequenceImage, size_t cumulativeNr,
    char* bytes = new char[bufSize];
 
    SettingLogger* logger = GetLogger();
-   if (produceHumanReadableImages_)
+   switch (imageMode_)
    {
-      logger->DrawTextToBuffer(bytes, GetImageWidth(), GetImageHeight(),
-            GetDeviceName(), isSequenceImage, nextSerialNr_++,
-            cumulativeNr, frameNr);
-   }
-   else
-   {
-      logger->DumpMsgPackToBuffer(bytes, bufSize, GetDeviceName(),
-            isSequenceImage, nextSerialNr_++, cumulativeNr, frameNr);
-
+      case ImageModeHumanReadable:
+         logger->DrawTextToBuffer(bytes, GetImageWidth(), GetImageHeight(),
+               GetDeviceName(), isSequenceImage, nextSerialNr_++,
+               cumulativeNr, frameNr);
+         break;
+      case ImageModeMachineReadable:
+         logger->DumpMsgPackToBuffer(bytes, bufSize, GetDeviceName(),
+               isSequenceImage, nextSerialNr_++, cumulativeNr, frameNr);
+         break;
+      case ImageModeBinary:
+         logger->DumpBinaryToBuffer(bytes, bufSize, GetDeviceName(),
+               isSequenceImage, nextSerialNr_++, cumulativeNr, frameNr);
+         break;
    }
    logger->Reset();
 
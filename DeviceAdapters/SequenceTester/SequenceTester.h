@@ -40,6 +40,12 @@
 #include <vector>
 
 
+// Error codes of the burst API
+#define ERR_BURST_NOT_ARMED      20001
+#define ERR_BURST_NOT_STARTED    20002
+#define ERR_TRIGGER_NOT_SOFTWARE 20003
+
+
 // Common base class for all devices. Goes in between TDeviceBase and
 // UConcreteDevice in the inheritance graph.
 template <template <class> class TDeviceBase, class UConcreteDevice>
@@ -164,6 +170,22 @@ public:
    virtual int IsExposureSequenceable(bool& f) const
    { f = false; return DEVICE_OK; }
 
+   // Burst settings are only logged; external triggers are not simulated.
+   virtual bool SupportsBurstAPI() { return true; }
+   virtual int SetPreFrameDelay(double delayMs);
+   virtual int SetPostFrameDelay(double delayMs);
+   virtual int SetBurstStartTriggerType(const char* type);
+   virtual int SetBurstEndTriggerType(const char* type);
+   virtual int SetFrameStartTriggerType(const char* type);
+   virtual int SetExposureEndTriggerType(const char* type);
+   virtual int GetBurstStartTriggerType(char* type);
+   virtual int GetFrameStartTriggerType(char* type);
+   virtual int SetFrameExposureMode(const char* mode);
+   virtual int PrepareForBurst(int numImages);
+   virtual int SendBurstStartTrigger();
+   virtual int SendFrameStartTrigger();
+   virtual int SendBurstEndTrigger();
+
 private:
    // Must be called with hub global mutex held.
    // Returned pointer should be delete[]d by caller.
@@ -175,8 +197,16 @@ private:
 
    void SendSequence(bool finite, long count, bool stopOnOverflow);
 
+   int StartBurst();
+
 private:
-   bool produceHumanReadableImages_;
+   enum ImageMode
+   {
+      ImageModeHumanReadable,
+      ImageModeMachineReadable, // msgpack
+      ImageModeBinary // Compact; see SettingLogger::DumpBinaryToBuffer()
+   };
+   ImageMode imageMode_;
    long imageWidth_;
    long imageHeight_;
 
@@ -191,6 +221,10 @@ private:
    boost::mutex sequenceMutex_;
 
    bool stopSequence_; // Guarded by sequenceMutex_
+   bool burstArmed_; // Guarded by sequenceMutex_; until the burst starts
+   bool softwareFrames_; // Guarded by sequenceMutex_; burst frames by trigger
+   long burstLength_; // Guarded by sequenceMutex_; -1 for unlimited
+   long burstFramesSent_; // Guarded by sequenceMutex_
 
    // Note: boost::future in more recent versions
    boost::unique_future<void> sequenceFuture_;
@@ -198,6 +232,13 @@ private:
 
    FloatSetting::Ptr exposureSetting_;
    IntegerSetting::Ptr binningSetting_;
+   FloatSetting::Ptr preFrameDelaySetting_;
+   FloatSetting::Ptr postFrameDelaySetting_;
+   StringSetting::Ptr burstStartTriggerSetting_;
+   StringSetting::Ptr burstEndTriggerSetting_;
+   StringSetting::Ptr frameStartTriggerSetting_;
+   StringSetting::Ptr exposureEndTriggerSetting_;
+   StringSetting::Ptr frameExposureModeSetting_;
 
    EdgeTriggerSignal exposureStartEdgeTrigger_;
    EdgeTriggerSignal exposureStopEdgeTrigger_;
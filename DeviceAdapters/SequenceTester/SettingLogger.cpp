@@ -26,8 +26,7 @@
 #include <msgpack.hpp>
 
 #include <boost/lexical_cast.hpp>
-#include <boost/make_shared.hpp>
-#include <boost/shared_ptr.hpp>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -37,66 +36,6 @@
 // possibly other) decoder in sync, so be careful! Field order is crucial.
 
 
-void
-BoolSettingValue::Write(msgpack::sbuffer& sbuf) const
-{
-   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
-   pk.pack_array(2);
-   // type
-   pk.pack(std::string("bool"));
-   // value
-   pk.pack(value_);
-}
-
-
-void
-IntegerSettingValue::Write(msgpack::sbuffer& sbuf) const
-{
-   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
-   pk.pack_array(2);
-   // type
-   pk.pack(std::string("int"));
-   // value
-   pk.pack(value_);
-}
-
-
-void
-FloatSettingValue::Write(msgpack::sbuffer& sbuf) const
-{
-   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
-   pk.pack_array(2);
-   // type
-   pk.pack(std::string("float"));
-   // value
-   pk.pack(value_);
-}
-
-
-void
-StringSettingValue::Write(msgpack::sbuffer& sbuf) const
-{
-   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
-   pk.pack_array(2);
-   // type
-   pk.pack(std::string("string"));
-   // value
-   pk.pack(value_);
-}
-
-
-void
-OneShotSettingValue::Write(msgpack::sbuffer& sbuf) const
-{
-   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
-   pk.pack_array(2);
-   // type
-   pk.pack(std::string("one_shot"));
-   // value
-   pk.pack_nil();
-}
-
-
 void
 SettingKey::Write(msgpack::sbuffer& sbuf) const
 {
@@ -109,29 +48,6 @@ SettingKey::Write(msgpack::sbuffer& sbuf) const
 }
 
 
-void
-SettingEvent::Write(msgpack::sbuffer& sbuf) const
-{
-   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
-   pk.pack_array(3);
-   // key
-   key_.Write(sbuf);
-   // value
-   value_->Write(sbuf);
-   // count
-   pk.pack(count_);
-}
-
-
-void
-SettingEvent::Draw(TextImageCursor& cursor) const
-{
-   DrawStringOnImage(cursor,
-         "[" + boost::lexical_cast<std::string>(count_) + "]" +
-         key_.GetStringRep() + "=" + value_->GetString());
-}
-
-
 void
 CameraInfo::Write(msgpack::sbuffer& sbuf) const
 {
@@ -173,144 +89,345 @@ CameraInfo::Draw(TextImageCursor& cursor) const
 }
 
 
-void
-SettingLogger::SetBool(const std::string& device, const std::string& key,
-      bool value, bool logEvent)
+namespace
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   boost::shared_ptr<SettingValue> valueRecord =
-      boost::make_shared<BoolSettingValue>(value);
-   settingValues_[keyRecord] = valueRecord;
 
-   if (logEvent)
+// Appends little-endian fields to a fixed-size buffer; see
+// SettingLogger::DumpBinaryToBuffer() for the format.
+class BinaryWriter
+{
+   char* dest_;
+   size_t size_;
+   size_t pos_;
+   bool overflow_;
+
+public:
+   BinaryWriter(char* dest, size_t size) :
+      dest_(dest), size_(size), pos_(0), overflow_(false)
+   {}
+
+   bool Overflowed() const { return overflow_; }
+   size_t GetPosition() const { return pos_; }
+
+   void WriteBytes(const void* bytes, size_t count)
    {
-      SettingEvent event =
-         SettingEvent(keyRecord, valueRecord, GetNextCount());
-      settingEvents_.push_back(event);
+      if (overflow_ || count > size_ - pos_)
+      {
+         overflow_ = true;
+         return;
+      }
+      memcpy(dest_ + pos_, bytes, count);
+      pos_ += count;
    }
+
+   void WriteUInt(uint64_t value, size_t bytes)
+   {
+      unsigned char le[8];
+      for (size_t i = 0; i < bytes; ++i)
+         le[i] = static_cast<unsigned char>(value >> (8 * i));
+      WriteBytes(le, bytes);
+   }
+
+   void WriteU8(uint8_t value) { WriteUInt(value, 1); }
+   void WriteU32(uint32_t value) { WriteUInt(value, 4); }
+   void WriteU64(uint64_t value) { WriteUInt(value, 8); }
+   void WriteI64(int64_t value) { WriteUInt(static_cast<uint64_t>(value), 8); }
+
+   void WriteF64(double value)
+   {
+      uint64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      WriteU64(bits);
+   }
+
+   void WriteString(const std::string& value)
+   {
+      WriteU32(static_cast<uint32_t>(value.size()));
+      WriteBytes(value.data(), value.size());
+   }
+
+   void WriteValue(const SettingValue& value)
+   {
+      WriteU8(static_cast<uint8_t>(value.type));
+      switch (value.type)
+      {
+         case SettingValue::TypeBool:
+            WriteU8(value.boolValue ? 1 : 0);
+            break;
+         case SettingValue::TypeInteger:
+            WriteI64(value.integerValue);
+            break;
+         case SettingValue::TypeFloat:
+            WriteF64(value.floatValue);
+            break;
+         case SettingValue::TypeString:
+            WriteU32(value.stringId);
+            break;
+         default:
+            break;
+      }
+   }
+};
+
+} // anonymous namespace
+
+
+void
+SettingLogger::SetMaxHistoryEvents(size_t maxEvents)
+{
+   if (maxEvents == 0)
+      maxEvents = 1;
+
+   // Keep the newest events
+   std::vector<SettingEvent> history;
+   const size_t size = GetHistorySize();
+   const size_t first = size > maxEvents ? size - maxEvents : 0;
+   history.reserve(size - first);
+   for (size_t i = first; i < size; ++i)
+      history.push_back(GetHistoryEvent(i));
+   history_.swap(history);
+   historyStart_ = 0;
+   droppedEvents_ += first;
+   maxHistoryEvents_ = maxEvents;
 }
 
 
-bool
-SettingLogger::GetBool(const std::string& device,
-      const std::string& key) const
+SettingKeyId
+SettingLogger::InternKey(const std::string& device, const std::string& key)
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   SettingConstIterator found = settingValues_.find(keyRecord);
-   if (found == settingValues_.end())
-      return false;
-   return found->second->GetBool();
+   SettingKey keyRecord(device, key);
+   std::map<SettingKey, SettingKeyId>::const_iterator found =
+      keyIds_.find(keyRecord);
+   if (found != keyIds_.end())
+      return found->second;
+
+   const SettingKeyId id = static_cast<SettingKeyId>(keys_.size());
+   keys_.push_back(keyRecord);
+   keyIds_.insert(std::make_pair(keyRecord, id));
+   settingValues_.resize(keys_.size());
+   startingValues_.resize(keys_.size());
+   return id;
+}
+
+
+uint32_t
+SettingLogger::InternString(const std::string& value)
+{
+   std::map<std::string, uint32_t>::const_iterator found =
+      stringIds_.find(value);
+   if (found != stringIds_.end())
+      return found->second;
+
+   const uint32_t id = static_cast<uint32_t>(strings_.size());
+   strings_.push_back(value);
+   stringIds_.insert(std::make_pair(value, id));
+   return id;
+}
+
+
+const SettingValue*
+SettingLogger::FindValue(SettingKeyId key) const
+{
+   if (key >= settingValues_.size() ||
+         settingValues_[key].type == SettingValue::TypeNone)
+      return 0;
+   return &settingValues_[key];
 }
 
 
 void
-SettingLogger::SetInteger(const std::string& device, const std::string& key,
-      long value, bool logEvent)
+SettingLogger::Set(SettingKeyId key, const SettingValue& value, bool logEvent)
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   boost::shared_ptr<SettingValue> valueRecord =
-      boost::make_shared<IntegerSettingValue>(value);
-   settingValues_[keyRecord] = valueRecord;
+   settingValues_[key] = value;
 
    if (logEvent)
    {
-      SettingEvent event =
-         SettingEvent(keyRecord, valueRecord, GetNextCount());
-      settingEvents_.push_back(event);
+      SettingEvent event;
+      event.key = key;
+      event.value = value;
+      event.count = GetNextCount();
+      if (history_.size() < maxHistoryEvents_)
+      {
+         history_.push_back(event);
+      }
+      else
+      {
+         history_[historyStart_] = event;
+         historyStart_ = (historyStart_ + 1) % history_.size();
+         ++droppedEvents_;
+      }
    }
 }
 
 
+void
+SettingLogger::SetBool(SettingKeyId key, bool value, bool logEvent)
+{
+   SettingValue valueRecord;
+   valueRecord.type = SettingValue::TypeBool;
+   valueRecord.boolValue = value;
+   Set(key, valueRecord, logEvent);
+}
+
+
+bool
+SettingLogger::GetBool(SettingKeyId key) const
+{
+   const SettingValue* value = FindValue(key);
+   return value && value->type == SettingValue::TypeBool && value->boolValue;
+}
+
+
+void
+SettingLogger::SetInteger(SettingKeyId key, long value, bool logEvent)
+{
+   SettingValue valueRecord;
+   valueRecord.type = SettingValue::TypeInteger;
+   valueRecord.integerValue = value;
+   Set(key, valueRecord, logEvent);
+}
+
+
 long
-SettingLogger::GetInteger(const std::string& device,
-      const std::string& key) const
+SettingLogger::GetInteger(SettingKeyId key) const
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   SettingConstIterator found = settingValues_.find(keyRecord);
-   if (found == settingValues_.end())
+   const SettingValue* value = FindValue(key);
+   if (!value || value->type != SettingValue::TypeInteger)
       return 0;
-   return found->second->GetInteger();
+   return value->integerValue;
 }
 
 
 void
-SettingLogger::SetFloat(const std::string& device, const std::string& key,
-      double value, bool logEvent)
+SettingLogger::SetFloat(SettingKeyId key, double value, bool logEvent)
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   boost::shared_ptr<SettingValue> valueRecord =
-      boost::make_shared<FloatSettingValue>(value);
-   settingValues_[keyRecord] = valueRecord;
-
-   if (logEvent)
-   {
-      SettingEvent event =
-         SettingEvent(keyRecord, valueRecord, GetNextCount());
-      settingEvents_.push_back(event);
-   }
+   SettingValue valueRecord;
+   valueRecord.type = SettingValue::TypeFloat;
+   valueRecord.floatValue = value;
+   Set(key, valueRecord, logEvent);
 }
 
 
 double
-SettingLogger::GetFloat(const std::string& device,
-      const std::string& key) const
+SettingLogger::GetFloat(SettingKeyId key) const
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   SettingConstIterator found = settingValues_.find(keyRecord);
-   if (found == settingValues_.end())
+   const SettingValue* value = FindValue(key);
+   if (!value || value->type != SettingValue::TypeFloat)
       return 0.0;
-   return found->second->GetFloat();
+   return value->floatValue;
 }
 
 
 void
-SettingLogger::SetString(const std::string& device, const std::string& key,
-      const std::string& value, bool logEvent)
+SettingLogger::SetString(SettingKeyId key, const std::string& value,
+      bool logEvent)
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   boost::shared_ptr<SettingValue> valueRecord =
-      boost::make_shared<StringSettingValue>(value);
-   settingValues_[keyRecord] = valueRecord;
-
-   if (logEvent)
-   {
-      SettingEvent event =
-         SettingEvent(keyRecord, valueRecord, GetNextCount());
-      settingEvents_.push_back(event);
-   }
+   SettingValue valueRecord;
+   valueRecord.type = SettingValue::TypeString;
+   valueRecord.stringId = InternString(value);
+   Set(key, valueRecord, logEvent);
 }
 
 
 std::string
-SettingLogger::GetString(const std::string& device,
-      const std::string& key) const
+SettingLogger::GetString(SettingKeyId key) const
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   SettingConstIterator found = settingValues_.find(keyRecord);
-   if (found == settingValues_.end())
+   const SettingValue* value = FindValue(key);
+   if (!value)
       return std::string();
-   return found->second->GetString();
+   return ValueToString(*value);
 }
 
 
 void
-SettingLogger::FireOneShot(const std::string& device, const std::string& key,
-      bool logEvent)
+SettingLogger::FireOneShot(SettingKeyId key, bool logEvent)
 {
-   SettingKey keyRecord = SettingKey(device, key);
-   boost::shared_ptr<SettingValue> valueRecord =
-      boost::make_shared<OneShotSettingValue>();
-   settingValues_[keyRecord] = valueRecord;
+   SettingValue valueRecord;
+   valueRecord.type = SettingValue::TypeOneShot;
+   Set(key, valueRecord, logEvent);
+}
 
-   if (logEvent)
+
+std::string
+SettingLogger::ValueToString(const SettingValue& value) const
+{
+   switch (value.type)
+   {
+      case SettingValue::TypeBool:
+         return value.boolValue ? "true" : "false";
+      case SettingValue::TypeInteger:
+         return boost::lexical_cast<std::string>(value.integerValue);
+      case SettingValue::TypeFloat:
+         return boost::lexical_cast<std::string>(value.floatValue);
+      case SettingValue::TypeString:
+         return strings_[value.stringId];
+      case SettingValue::TypeOneShot:
+         return "(one-shot)";
+      default:
+         return std::string();
+   }
+}
+
+
+void
+SettingLogger::WriteValue(msgpack::sbuffer& sbuf,
+      const SettingValue& value) const
+{
+   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+   pk.pack_array(2);
+   switch (value.type)
    {
-      SettingEvent event =
-         SettingEvent(keyRecord, valueRecord, GetNextCount());
-      settingEvents_.push_back(event);
+      case SettingValue::TypeBool:
+         // type
+         pk.pack(std::string("bool"));
+         // value
+         pk.pack(value.boolValue);
+         break;
+      case SettingValue::TypeInteger:
+         pk.pack(std::string("int"));
+         pk.pack(value.integerValue);
+         break;
+      case SettingValue::TypeFloat:
+         pk.pack(std::string("float"));
+         pk.pack(value.floatValue);
+         break;
+      case SettingValue::TypeString:
+         pk.pack(std::string("string"));
+         pk.pack(strings_[value.stringId]);
+         break;
+      default:
+         pk.pack(std::string("one_shot"));
+         pk.pack_nil();
+         break;
    }
 }
 
 
+void
+SettingLogger::WriteEvent(msgpack::sbuffer& sbuf,
+      const SettingEvent& event) const
+{
+   msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+   pk.pack_array(3);
+   // key
+   keys_[event.key].Write(sbuf);
+   // value
+   WriteValue(sbuf, event.value);
+   // count
+   pk.pack(static_cast<size_t>(event.count));
+}
+
+
+void
+SettingLogger::DrawEvent(TextImageCursor& cursor,
+      const SettingEvent& event) const
+{
+   DrawStringOnImage(cursor,
+         "[" + boost::lexical_cast<std::string>(event.count) + "]" +
+         keys_[event.key].GetStringRep() + "=" + ValueToString(event.value));
+}
+
+
 bool
 SettingLogger::DumpMsgPackToBuffer(char* dest, size_t destSize,
       const std::string& camera, bool isSequenceImage,
@@ -352,6 +469,98 @@ SettingLogger::DumpMsgPackToBuffer(char* dest, size_t destSize,
 }
 
 
+// The binary format is written straight into the image, without the
+// per-item allocation of msgpack, for use at high frame and trigger rates.
+// All integers are little-endian; strings are a u32 length followed by the
+// bytes (no terminator). In order:
+//
+//   magic            8 bytes "MMSTBIN1"
+//   packetNumber     u64
+//   camera           string name, u64 serialImageNr, u8 isSequence,
+//                    u64 cumulativeImageNr, u64 frameNr
+//   startCounter     u64
+//   currentCounter   u64
+//   droppedEvents    u64 (history events lost to the ring limit)
+//   keys             u32 count, then (string device, string key) each;
+//                    a key id is the index in this table
+//   strings          u32 count, then string each; a string id is the index
+//   startState       u32 count, then (u32 key id, value) each
+//   currentState     u32 count, then (u32 key id, value) each
+//   history          u32 count, then (u32 key id, value, u64 counter) each
+//
+// A value is a u8 type (1 bool, 2 int, 3 float, 4 string, 5 one-shot)
+// followed by u8, i64, f64, u32 string id, or nothing, respectively. The
+// rest of the image is zero. If the dump does not fit, the whole image is
+// zero.
+bool
+SettingLogger::DumpBinaryToBuffer(char* dest, size_t destSize,
+      const std::string& camera, bool isSequenceImage,
+      size_t serialImageNr, size_t cumulativeImageNr, size_t frameNr)
+{
+   BinaryWriter writer(dest, destSize);
+
+   writer.WriteBytes("MMSTBIN1", 8);
+   writer.WriteU64(GetNextGlobalImageNr());
+   writer.WriteString(camera);
+   writer.WriteU64(serialImageNr);
+   writer.WriteU8(isSequenceImage ? 1 : 0);
+   writer.WriteU64(cumulativeImageNr);
+   writer.WriteU64(frameNr);
+   writer.WriteU64(counterAtLastReset_);
+   writer.WriteU64(counter_);
+   writer.WriteU64(droppedEvents_);
+
+   writer.WriteU32(static_cast<uint32_t>(keys_.size()));
+   for (std::vector<SettingKey>::const_iterator it = keys_.begin(),
+         end = keys_.end(); it != end; ++it)
+   {
+      writer.WriteString(it->GetDevice());
+      writer.WriteString(it->GetKey());
+   }
+
+   writer.WriteU32(static_cast<uint32_t>(strings_.size()));
+   for (std::vector<std::string>::const_iterator it = strings_.begin(),
+         end = strings_.end(); it != end; ++it)
+      writer.WriteString(*it);
+
+   const SettingValues* states[] = { &startingValues_, &settingValues_ };
+   for (int s = 0; s < 2; ++s)
+   {
+      const SettingValues& values = *states[s];
+      uint32_t count = 0;
+      for (size_t i = 0; i < values.size(); ++i)
+         if (values[i].type != SettingValue::TypeNone)
+            ++count;
+      writer.WriteU32(count);
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+         if (values[i].type == SettingValue::TypeNone)
+            continue;
+         writer.WriteU32(static_cast<uint32_t>(i));
+         writer.WriteValue(values[i]);
+      }
+   }
+
+   const size_t historySize = GetHistorySize();
+   writer.WriteU32(static_cast<uint32_t>(historySize));
+   for (size_t i = 0; i < historySize; ++i)
+   {
+      const SettingEvent& event = GetHistoryEvent(i);
+      writer.WriteU32(event.key);
+      writer.WriteValue(event.value);
+      writer.WriteU64(event.count);
+   }
+
+   if (writer.Overflowed())
+   {
+      memset(dest, 0, destSize);
+      return false;
+   }
+   memset(dest + writer.GetPosition(), 0, destSize - writer.GetPosition());
+   return true;
+}
+
+
 void
 SettingLogger::DrawTextToBuffer(char* dest, size_t destWidth,
       size_t destHeight, const std::string& camera, bool isSequenceImage,
@@ -385,40 +594,53 @@ SettingLogger::DrawTextToBuffer(char* dest, size_t destWidth,
 
 void
 SettingLogger::WriteSettingMap(msgpack::sbuffer& sbuf,
-      const SettingMap& values) const
+      const SettingValues& values) const
 {
    msgpack::packer<msgpack::sbuffer> pk(&sbuf);
 
-   pk.pack_array(values.size());
-   for (SettingConstIterator it = values.begin(), end = values.end();
-         it != end; ++it)
+   size_t count = 0;
+   for (size_t i = 0; i < values.size(); ++i)
+      if (values[i].type != SettingValue::TypeNone)
+         ++count;
+
+   // In key order
+   pk.pack_array(count);
+   for (std::map<SettingKey, SettingKeyId>::const_iterator
+         it = keyIds_.begin(), end = keyIds_.end(); it != end; ++it)
    {
+      if (it->second >= values.size() ||
+            values[it->second].type == SettingValue::TypeNone)
+         continue;
       pk.pack_array(2);
       // key
       it->first.Write(sbuf);
       // value
-      it->second->Write(sbuf);
+      WriteValue(sbuf, values[it->second]);
    }
 }
 
 
 void
 SettingLogger::DrawSettingMap(TextImageCursor& cursor,
-      const SettingMap& values) const
+      const SettingValues& values) const
 {
    bool first = true;
-   for (SettingConstIterator it = values.begin(), end = values.end();
-         it != end; ++it)
+   for (std::map<SettingKey, SettingKeyId>::const_iterator
+         it = keyIds_.begin(), end = keyIds_.end(); it != end; ++it)
    {
-      if (boost::dynamic_pointer_cast<OneShotSettingValue>(it->second))
-         continue; // Skip one-shot settings
+      if (it->second >= values.size())
+         continue;
+      const SettingValue& value = values[it->second];
+      if (value.type == SettingValue::TypeNone ||
+            value.type == SettingValue::TypeOneShot)
+         continue; // Skip unset and one-shot settings
 
       if (first)
          first = false;
       else
          cursor.Space();
       DrawStringOnImage(cursor, it->first.GetStringRep() + '=' +
-            it->second->GetString());
+            ValueToString(value));
    }
 }
 
@@ -428,24 +650,21 @@ SettingLogger::WriteHistory(msgpack::sbuffer& sbuf) const
 {
    msgpack::packer<msgpack::sbuffer> pk(&sbuf);
 
-   pk.pack_array(settingEvents_.size());
-   for (std::vector<SettingEvent>::const_iterator it = settingEvents_.begin(),
-         end = settingEvents_.end(); it != end; ++it)
-   {
-      it->Write(sbuf);
-   }
+   const size_t size = GetHistorySize();
+   pk.pack_array(size);
+   for (size_t i = 0; i < size; ++i)
+      WriteEvent(sbuf, GetHistoryEvent(i));
 }
 
 
 void
 SettingLogger::DrawHistory(TextImageCursor& cursor) const
 {
-   for (std::vector<SettingEvent>::const_iterator
-         begin = settingEvents_.begin(), it = begin,
-         end = settingEvents_.end(); it != end; ++it)
+   const size_t size = GetHistorySize();
+   for (size_t i = 0; i < size; ++i)
    {
-      if (it != begin)
+      if (i > 0)
          cursor.Space();
-      it->Draw(cursor);
+      DrawEvent(cursor, GetHistoryEvent(i));
    }
 }
@@ -27,10 +27,8 @@
 
 #include <msgpack.hpp>
 
-#include <boost/lexical_cast.hpp>
-#include <boost/shared_ptr.hpp>
-
 #include <map>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -45,67 +43,34 @@ public:
 };
 
 
-class SettingValue : public Serializable
-{
-public:
-   virtual bool GetBool() const { return false; }
-   virtual long GetInteger() const { return 0; }
-   virtual double GetFloat() const { return 0.0; }
-   virtual std::string GetString() const { return std::string(); }
-};
-
-
-class BoolSettingValue : public SettingValue
-{
-   const bool value_;
-public:
-   BoolSettingValue(bool value) : value_(value) {}
-   virtual void Write(msgpack::sbuffer& sbuf) const;
-   virtual bool GetBool() const { return value_; }
-   virtual std::string GetString() const { return value_ ? "true" : "false"; }
-};
-
-
-class IntegerSettingValue : public SettingValue
-{
-   const long value_;
-public:
-   IntegerSettingValue(long value) : value_(value) {}
-   virtual void Write(msgpack::sbuffer& sbuf) const;
-   virtual long GetInteger() const { return value_; }
-   virtual std::string GetString() const
-   { return boost::lexical_cast<std::string>(value_); }
-};
-
-
-class FloatSettingValue : public SettingValue
-{
-   const double value_;
-public:
-   FloatSettingValue(double value) : value_(value) {}
-   virtual void Write(msgpack::sbuffer& sbuf) const;
-   virtual double GetFloat() const { return value_; }
-   virtual std::string GetString() const
-   { return boost::lexical_cast<std::string>(value_); }
-};
+// Index of a (device, key) pair interned by SettingLogger
+typedef uint32_t SettingKeyId;
 
 
-class StringSettingValue : public SettingValue
+// A setting value or event, small enough to be logged without allocation.
+// String values are interned by SettingLogger and referred to by index.
+struct SettingValue
 {
-   const std::string value_;
-public:
-   StringSettingValue(const std::string& value) : value_(value) {}
-   virtual void Write(msgpack::sbuffer& sbuf) const;
-   virtual std::string GetString() const { return value_; }
-};
-
+   enum Type
+   {
+      TypeNone, // Never set
+      TypeBool,
+      TypeInteger,
+      TypeFloat,
+      TypeString,
+      TypeOneShot
+   };
+
+   Type type;
+   union
+   {
+      bool boolValue;
+      long integerValue;
+      double floatValue;
+      uint32_t stringId;
+   };
 
-class OneShotSettingValue : public SettingValue
-{
-public:
-   OneShotSettingValue() {}
-   virtual void Write(msgpack::sbuffer& sbuf) const;
-   virtual std::string GetString() const { return "(one-shot)"; }
+   SettingValue() : type(TypeNone), floatValue(0.0) {}
 };
 
 
@@ -125,22 +90,17 @@ public:
          (this->device_ == rhs.device_ && this->key_ < rhs.key_);
    }
 
+   const std::string& GetDevice() const { return device_; }
+   const std::string& GetKey() const { return key_; }
    std::string GetStringRep() const { return device_ + ',' + key_; }
 };
 
 
-class SettingEvent : public Serializable
+struct SettingEvent
 {
-   SettingKey key_;
-   boost::shared_ptr<SettingValue> value_;
-   size_t count_;
-public:
-   SettingEvent(SettingKey key, boost::shared_ptr<SettingValue> value,
-         uint64_t counterValue) :
-      key_(key), value_(value), count_(counterValue)
-   {}
-   virtual void Write(msgpack::sbuffer& sbuf) const;
-   virtual void Draw(TextImageCursor& cursor) const;
+   SettingKeyId key;
+   SettingValue value;
+   uint64_t count;
 };
 
 
@@ -165,37 +125,60 @@ public:
 };
 
 
+// Records setting values and the history of changes since the last image.
+//
+// Keys and string values are interned, so that recording an event costs no
+// more than appending a fixed-size record to the history. The history is a
+// ring: once it holds the maximum number of events, the oldest ones are
+// dropped (and counted), so that triggering at high rates without acquiring
+// images cannot exhaust memory.
 class SettingLogger
 {
 public:
+   static const size_t DefaultMaxHistoryEvents = 65536;
+
    SettingLogger() :
       counter_(0),
       counterAtLastReset_(0),
-      nextGlobalImageNr_(0)
+      nextGlobalImageNr_(0),
+      maxHistoryEvents_(DefaultMaxHistoryEvents),
+      historyStart_(0),
+      droppedEvents_(0)
    {}
 
+   void SetMaxHistoryEvents(size_t maxEvents);
+   size_t GetMaxHistoryEvents() const { return maxHistoryEvents_; }
+
+   // Returns the id of the key, adding it if new
+   SettingKeyId InternKey(const std::string& device, const std::string& key);
+
    // Recording and querying
 
    // These methods should be called by setting objects only, not directly
-   void SetBool(const std::string& device, const std::string& key,
-         bool value, bool logEvent = true);
-   bool GetBool(const std::string& device, const std::string& key) const;
-   void SetInteger(const std::string& device, const std::string& key,
-         long value, bool logEvent = true);
-   long GetInteger(const std::string& device, const std::string& key) const;
-   void SetFloat(const std::string& device, const std::string& key,
-         double value, bool logEvent = true);
-   double GetFloat(const std::string& device, const std::string& key) const;
-   void SetString(const std::string& device, const std::string& key,
-         const std::string& value, bool logEvent = true);
-   std::string GetString(const std::string& device, const std::string& key) const;
-   void FireOneShot(const std::string& device, const std::string& key,
+   void SetBool(SettingKeyId key, bool value, bool logEvent = true);
+   bool GetBool(SettingKeyId key) const;
+   void SetInteger(SettingKeyId key, long value, bool logEvent = true);
+   long GetInteger(SettingKeyId key) const;
+   void SetFloat(SettingKeyId key, double value, bool logEvent = true);
+   double GetFloat(SettingKeyId key) const;
+   void SetString(SettingKeyId key, const std::string& value,
          bool logEvent = true);
+   std::string GetString(SettingKeyId key) const;
+   void FireOneShot(SettingKeyId key, bool logEvent = true);
+
+   // History since the last reset, oldest first
+   size_t GetHistorySize() const { return history_.size(); }
+   const SettingEvent& GetHistoryEvent(size_t index) const
+   { return history_[(historyStart_ + index) % history_.size()]; }
+   uint64_t GetDroppedEventCount() const { return droppedEvents_; }
 
    // Log retrieval
    bool DumpMsgPackToBuffer(char* dest, size_t destSize,
          const std::string& camera, bool isSequenceImage,
          size_t serialImageNr, size_t cumulativeImageNr, size_t frameNr);
+   bool DumpBinaryToBuffer(char* dest, size_t destSize,
+         const std::string& camera, bool isSequenceImage,
+         size_t serialImageNr, size_t cumulativeImageNr, size_t frameNr);
    void DrawTextToBuffer(char* dest, size_t destWidth, size_t destHeight,
          const std::string& camera, bool isSequenceImage,
          size_t serialImageNr, size_t cumulativeImageNr, size_t frameNr);
@@ -205,7 +188,9 @@ public:
    {
       counterAtLastReset_ = counter_;
       startingValues_ = settingValues_;
-      settingEvents_.clear();
+      history_.clear(); // Keeps the capacity
+      historyStart_ = 0;
+      droppedEvents_ = 0;
    }
 
 private:
@@ -213,18 +198,33 @@ private:
    uint64_t counterAtLastReset_;
    uint64_t nextGlobalImageNr_;
 
-   typedef std::map< SettingKey, boost::shared_ptr<SettingValue> > SettingMap;
-   typedef SettingMap::const_iterator SettingConstIterator;
-   SettingMap settingValues_;
-   SettingMap startingValues_;
-   std::vector<SettingEvent> settingEvents_;
+   std::vector<SettingKey> keys_; // Indexed by SettingKeyId
+   std::map<SettingKey, SettingKeyId> keyIds_; // Also gives the sort order
+   std::vector<std::string> strings_;
+   std::map<std::string, uint32_t> stringIds_;
+
+   typedef std::vector<SettingValue> SettingValues; // Indexed by SettingKeyId
+   SettingValues settingValues_;
+   SettingValues startingValues_;
+
+   size_t maxHistoryEvents_;
+   std::vector<SettingEvent> history_;
+   size_t historyStart_; // Index of the oldest event, once full
+   uint64_t droppedEvents_;
 
    // Helper functions to be called with mutex_ held
    uint64_t GetNextCount() { return counter_++; }
    uint64_t GetNextGlobalImageNr() { return nextGlobalImageNr_++; }
-   void WriteSettingMap(msgpack::sbuffer& sbuf, const SettingMap& values) const;
+   const SettingValue* FindValue(SettingKeyId key) const;
+   void Set(SettingKeyId key, const SettingValue& value, bool logEvent);
+   uint32_t InternString(const std::string& value);
+   std::string ValueToString(const SettingValue& value) const;
+   void WriteValue(msgpack::sbuffer& sbuf, const SettingValue& value) const;
+   void WriteEvent(msgpack::sbuffer& sbuf, const SettingEvent& event) const;
+   void DrawEvent(TextImageCursor& cursor, const SettingEvent& event) const;
+   void WriteSettingMap(msgpack::sbuffer& sbuf, const SettingValues& values) const;
    void DrawSettingMap(TextImageCursor& cursor,
-         const SettingMap& values) const;
+         const SettingValues& values) const;
    void WriteHistory(msgpack::sbuffer& sbuf) const;
    void DrawHistory(TextImageCursor& cursor) const;
 };
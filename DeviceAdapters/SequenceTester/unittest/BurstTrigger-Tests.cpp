@@ -0,0 +1,268 @@
+// Mock device adapter for testing of device sequencing
+//
+// Copyright (C) 2014 University of California, San Francisco.
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gtest/gtest.h>
+
+#include "SequenceTester.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
+
+namespace
+{
+
+// Stands in for the Core: counts the frames and acquisition notifications
+// that the camera sends, and fails PrepareForAcq() on request
+class BurstCore : public MM::Core
+{
+   MM::Hub* hub_;
+   boost::mutex mutex_;
+   boost::condition_variable changed_;
+   int frames_;
+   int acqFinished_;
+   int prepareResult_;
+
+public:
+   explicit BurstCore(MM::Hub* hub = 0) :
+      hub_(hub), frames_(0), acqFinished_(0), prepareResult_(DEVICE_OK) {}
+
+   void FailPrepareForAcq(int code) { prepareResult_ = code; }
+   int Frames() { boost::lock_guard<boost::mutex> g(mutex_); return frames_; }
+   int AcqFinishedCount() { boost::lock_guard<boost::mutex> g(mutex_); return acqFinished_; }
+
+   // Wait up to 5 s for the counts to reach count
+   bool WaitForFrames(int count) { return WaitFor(frames_, count); }
+   bool WaitForAcqFinished(int count) { return WaitFor(acqFinished_, count); }
+
+   int PrepareForAcq(const MM::Device*) { return prepareResult_; }
+   int AcqFinished(const MM::Device*, int)
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      ++acqFinished_;
+      changed_.notify_all();
+      return DEVICE_OK;
+   }
+   int InsertImage(const MM::Device*, const unsigned char*, unsigned, unsigned,
+         unsigned, unsigned, const char*, const bool)
+   { return CountFrame(); }
+   int InsertImage(const MM::Device*, const unsigned char*, unsigned, unsigned,
+         unsigned, const Metadata*, const bool)
+   { return CountFrame(); }
+   int InsertImage(const MM::Device*, const unsigned char*, unsigned, unsigned,
+         unsigned, const char*, const bool)
+   { return CountFrame(); }
+   int InsertImage(const MM::Device*, const ImgBuffer&) { return CountFrame(); }
+   int InsertMultiChannel(const MM::Device*, const unsigned char*, unsigned,
+         unsigned, unsigned, unsigned, Metadata*)
+   { return CountFrame(); }
+   MM::Hub* GetParentHub(const MM::Device*) const { return hub_; }
+   MM::MMTime GetCurrentMMTime()
+   {
+      const boost::posix_time::time_duration t =
+         boost::posix_time::microsec_clock::universal_time().time_of_day();
+      return MM::MMTime(static_cast<double>(t.total_microseconds()));
+   }
+
+   // Not used by the burst
+   int LogMessage(const MM::Device*, const char*, bool) const { return DEVICE_OK; }
+   MM::Device* GetDevice(const MM::Device*, const char*) { return 0; }
+   int GetDeviceProperty(const char*, const char*, char*) { return DEVICE_ERR; }
+   int SetDeviceProperty(const char*, const char*, const char*) { return DEVICE_ERR; }
+   void GetLoadedDeviceOfType(const MM::Device*, MM::DeviceType, char* name, const unsigned int) { name[0] = 0; }
+   int SetSerialProperties(const char*, const char*, const char*, const char*, const char*, const char*, const char*) { return DEVICE_ERR; }
+   int SetSerialCommand(const MM::Device*, const char*, const char*, const char*) { return DEVICE_ERR; }
+   int GetSerialAnswer(const MM::Device*, const char*, unsigned long, char*, const char*) { return DEVICE_ERR; }
+   int WriteToSerial(const MM::Device*, const char*, const unsigned char*, unsigned long) { return DEVICE_ERR; }
+   int ReadFromSerial(const MM::Device*, const char*, unsigned char*, unsigned long, unsigned long&) { return DEVICE_ERR; }
+   int PurgeSerial(const MM::Device*, const char*) { return DEVICE_ERR; }
+   MM::PortType GetSerialPortType(const char*) const { return MM::InvalidPort; }
+   int WaitForSerialData(const MM::Device*, const char*, unsigned long, bool&) { return DEVICE_ERR; }
+   int ReadExactlyFromSerial(const MM::Device*, const char*, unsigned char*, unsigned long, unsigned long, unsigned long&) { return DEVICE_ERR; }
+   int SubscribeToSerialData(const MM::Device*, const char*, MM::SerialDataCallback*) { return DEVICE_ERR; }
+   int UnsubscribeFromSerialData(const MM::Device*, const char*, MM::SerialDataCallback*) { return DEVICE_ERR; }
+   int OnPropertiesChanged(const MM::Device*) { return DEVICE_OK; }
+   int OnPropertyChanged(const MM::Device*, const char*, const char*) { return DEVICE_OK; }
+   int OnStagePositionChanged(const MM::Device*, double) { return DEVICE_OK; }
+   int OnXYStagePositionChanged(const MM::Device*, double, double) { return DEVICE_OK; }
+   int OnExposureChanged(const MM::Device*, double) { return DEVICE_OK; }
+   int OnSLMExposureChanged(const MM::Device*, double) { return DEVICE_OK; }
+   int OnMagnifierChanged(const MM::Device*) { return DEVICE_OK; }
+   unsigned long GetClockTicksUs(const MM::Device*) { return 0; }
+   unsigned GetWorkerThreadBudget(const MM::Device*) { return 1; }
+   void ClearImageBuffer(const MM::Device*) {}
+   bool InitializeImageBuffer(unsigned, unsigned, unsigned int, unsigned int, unsigned int) { return true; }
+   const char* GetImage() { return 0; }
+   int GetImageDimensions(int&, int&, int&) { return DEVICE_ERR; }
+   int GetFocusPosition(double&) { return DEVICE_ERR; }
+   int SetFocusPosition(double) { return DEVICE_ERR; }
+   int MoveFocus(double) { return DEVICE_ERR; }
+   int SetXYPosition(double, double) { return DEVICE_ERR; }
+   int GetXYPosition(double&, double&) { return DEVICE_ERR; }
+   int MoveXYStage(double, double) { return DEVICE_ERR; }
+   int SetExposure(double) { return DEVICE_ERR; }
+   int GetExposure(double&) { return DEVICE_ERR; }
+   int SetConfig(const char*, const char*) { return DEVICE_ERR; }
+   int GetCurrentConfig(const char*, int, char*) { return DEVICE_ERR; }
+   int GetChannelConfig(char*, const unsigned int) { return DEVICE_ERR; }
+   MM::ImageProcessor* GetImageProcessor(const MM::Device*) { return 0; }
+   MM::AutoFocus* GetAutoFocus(const MM::Device*) { return 0; }
+   MM::State* GetStateDevice(const MM::Device*, const char*) { return 0; }
+   MM::SignalIO* GetSignalIODevice(const MM::Device*, const char*) { return 0; }
+   void NextPostedError(int&, char*, int, int&) {}
+   void PostError(const int, const char*) {}
+   void ClearPostedErrors() {}
+
+private:
+   bool WaitFor(const int& counter, int count)
+   {
+      boost::unique_lock<boost::mutex> g(mutex_);
+      const boost::system_time deadline =
+         boost::get_system_time() + boost::posix_time::seconds(5);
+      while (counter < count)
+         if (!changed_.timed_wait(g, deadline))
+            return counter >= count;
+      return true;
+   }
+
+   int CountFrame()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      ++frames_;
+      changed_.notify_all();
+      return DEVICE_OK;
+   }
+};
+
+// A hub and camera initialized against a BurstCore
+class TesterBurstTests : public ::testing::Test
+{
+protected:
+   boost::shared_ptr<TesterHub> hub_;
+   boost::shared_ptr<TesterCamera> camera_;
+   boost::shared_ptr<BurstCore> core_;
+
+   void SetUp()
+   {
+      hub_ = boost::make_shared<TesterHub>("THub");
+      camera_ = boost::make_shared<TesterCamera>("TCamera");
+      core_ = boost::make_shared<BurstCore>(hub_.get());
+      hub_->SetCallback(core_.get());
+      camera_->SetCallback(core_.get());
+      ASSERT_EQ(DEVICE_OK, hub_->Initialize());
+      ASSERT_EQ(DEVICE_OK, camera_->Initialize());
+      camera_->SetExposure(1.0);
+   }
+
+   void TearDown()
+   {
+      camera_->Shutdown();
+      hub_->Shutdown();
+   }
+
+   void SetTriggers(const char* burstStart, const char* frameStart,
+         const char* burstEnd)
+   {
+      ASSERT_EQ(DEVICE_OK, camera_->SetBurstStartTriggerType(burstStart));
+      ASSERT_EQ(DEVICE_OK, camera_->SetFrameStartTriggerType(frameStart));
+      ASSERT_EQ(DEVICE_OK, camera_->SetBurstEndTriggerType(burstEnd));
+   }
+};
+
+} // anonymous namespace
+
+
+TEST_F(TesterBurstTests, SoftwareTriggeredFrames)
+{
+   SetTriggers(MM::g_TriggerType_Software, MM::g_TriggerType_Software,
+         MM::g_TriggerType_Internal);
+
+   EXPECT_EQ(ERR_BURST_NOT_ARMED, camera_->SendBurstStartTrigger());
+   ASSERT_EQ(DEVICE_OK, camera_->PrepareForBurst(3));
+   EXPECT_TRUE(camera_->IsCapturing());
+   EXPECT_EQ(DEVICE_CAMERA_BUSY_ACQUIRING, camera_->PrepareForBurst(3));
+   EXPECT_EQ(ERR_BURST_NOT_STARTED, camera_->SendFrameStartTrigger());
+
+   ASSERT_EQ(DEVICE_OK, camera_->SendBurstStartTrigger());
+   EXPECT_EQ(ERR_BURST_NOT_ARMED, camera_->SendBurstStartTrigger());
+   for (int i = 0; i < 3; ++i)
+      ASSERT_EQ(DEVICE_OK, camera_->SendFrameStartTrigger());
+   EXPECT_EQ(3, core_->Frames());
+
+   // The burst ends with its last frame
+   EXPECT_EQ(1, core_->AcqFinishedCount());
+   EXPECT_FALSE(camera_->IsCapturing());
+   EXPECT_EQ(ERR_BURST_NOT_STARTED, camera_->SendFrameStartTrigger());
+}
+
+TEST_F(TesterBurstTests, InternalFramesUntilStopped)
+{
+   SetTriggers(MM::g_TriggerType_Internal, MM::g_TriggerType_Internal,
+         MM::g_TriggerType_Software);
+
+   // An internal burst start trigger starts the burst on arming
+   ASSERT_EQ(DEVICE_OK, camera_->PrepareForBurst(-1));
+   EXPECT_TRUE(camera_->IsCapturing());
+   EXPECT_EQ(ERR_TRIGGER_NOT_SOFTWARE, camera_->SendBurstStartTrigger());
+   EXPECT_EQ(ERR_TRIGGER_NOT_SOFTWARE, camera_->SendFrameStartTrigger());
+   EXPECT_TRUE(core_->WaitForFrames(3));
+
+   ASSERT_EQ(DEVICE_OK, camera_->SendBurstEndTrigger());
+   EXPECT_EQ(1, core_->AcqFinishedCount());
+   EXPECT_FALSE(camera_->IsCapturing());
+}
+
+TEST_F(TesterBurstTests, FailedStartLeavesCameraArmed)
+{
+   SetTriggers(MM::g_TriggerType_Software, MM::g_TriggerType_Software,
+         MM::g_TriggerType_Software);
+
+   ASSERT_EQ(DEVICE_OK, camera_->PrepareForBurst(2));
+   core_->FailPrepareForAcq(DEVICE_ERR);
+   EXPECT_EQ(DEVICE_ERR, camera_->SendBurstStartTrigger());
+   EXPECT_TRUE(camera_->IsCapturing());
+   EXPECT_EQ(ERR_BURST_NOT_STARTED, camera_->SendFrameStartTrigger());
+
+   core_->FailPrepareForAcq(DEVICE_OK);
+   ASSERT_EQ(DEVICE_OK, camera_->SendBurstStartTrigger());
+   ASSERT_EQ(DEVICE_OK, camera_->SendFrameStartTrigger());
+   ASSERT_EQ(DEVICE_OK, camera_->SendBurstEndTrigger());
+   EXPECT_EQ(1, core_->Frames());
+   EXPECT_EQ(1, core_->AcqFinishedCount());
+   EXPECT_FALSE(camera_->IsCapturing());
+}
+
+TEST_F(TesterBurstTests, StoppingDisarms)
+{
+   SetTriggers(MM::g_TriggerType_Software, MM::g_TriggerType_Software,
+         MM::g_TriggerType_Internal);
+
+   ASSERT_EQ(DEVICE_OK, camera_->PrepareForBurst(2));
+   ASSERT_EQ(DEVICE_OK, camera_->StopSequenceAcquisition());
+   EXPECT_FALSE(camera_->IsCapturing());
+   EXPECT_EQ(ERR_BURST_NOT_ARMED, camera_->SendBurstStartTrigger());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,270 @@
+// Mock device adapter for testing of device sequencing
+//
+// Copyright (C) 2014 University of California, San Francisco.
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gtest/gtest.h>
+
+#include "SettingLogger.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+// Reads the little-endian fields written by DumpBinaryToBuffer()
+class BinaryReader
+{
+   const unsigned char* p_;
+
+public:
+   explicit BinaryReader(const char* data) :
+      p_(reinterpret_cast<const unsigned char*>(data))
+   {}
+
+   uint64_t ReadUInt(size_t bytes)
+   {
+      uint64_t value = 0;
+      for (size_t i = 0; i < bytes; ++i)
+         value |= static_cast<uint64_t>(*p_++) << (8 * i);
+      return value;
+   }
+
+   uint8_t ReadU8() { return static_cast<uint8_t>(ReadUInt(1)); }
+   uint32_t ReadU32() { return static_cast<uint32_t>(ReadUInt(4)); }
+   uint64_t ReadU64() { return ReadUInt(8); }
+
+   double ReadF64()
+   {
+      const uint64_t bits = ReadU64();
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+   }
+
+   std::string ReadString()
+   {
+      const uint32_t size = ReadU32();
+      std::string value(reinterpret_cast<const char*>(p_), size);
+      p_ += size;
+      return value;
+   }
+};
+
+} // anonymous namespace
+
+
+TEST(SettingLoggerTests, KeysAreInterned)
+{
+   SettingLogger logger;
+   const SettingKeyId a = logger.InternKey("Dev", "A");
+   const SettingKeyId b = logger.InternKey("Dev", "B");
+   EXPECT_NE(a, b);
+   EXPECT_EQ(a, logger.InternKey("Dev", "A"));
+   EXPECT_NE(a, logger.InternKey("Other", "A"));
+}
+
+TEST(SettingLoggerTests, ValuesAndHistory)
+{
+   SettingLogger logger;
+   const SettingKeyId exposure = logger.InternKey("Cam", "Exposure");
+   const SettingKeyId open = logger.InternKey("Shutter", "State");
+   const SettingKeyId mode = logger.InternKey("Cam", "Mode");
+
+   logger.SetFloat(exposure, 10.0, false);
+   logger.SetBool(open, true);
+   logger.SetString(mode, "fast");
+   logger.SetString(mode, "slow");
+   EXPECT_DOUBLE_EQ(10.0, logger.GetFloat(exposure));
+   EXPECT_TRUE(logger.GetBool(open));
+   EXPECT_EQ("slow", logger.GetString(mode));
+   EXPECT_EQ(0, logger.GetInteger(exposure)); // Wrong type
+
+   ASSERT_EQ(3u, logger.GetHistorySize());
+   EXPECT_EQ(open, logger.GetHistoryEvent(0).key);
+   EXPECT_EQ(0u, logger.GetHistoryEvent(0).count);
+   EXPECT_EQ(mode, logger.GetHistoryEvent(2).key);
+   EXPECT_EQ(2u, logger.GetHistoryEvent(2).count);
+
+   logger.Reset();
+   EXPECT_EQ(0u, logger.GetHistorySize());
+   EXPECT_EQ("slow", logger.GetString(mode));
+}
+
+TEST(SettingLoggerTests, HistoryRingDropsOldest)
+{
+   SettingLogger logger;
+   logger.SetMaxHistoryEvents(4);
+   const SettingKeyId key = logger.InternKey("Stage", "Z");
+   for (long i = 0; i < 10; ++i)
+      logger.SetInteger(key, i);
+
+   ASSERT_EQ(4u, logger.GetHistorySize());
+   EXPECT_EQ(6u, logger.GetDroppedEventCount());
+   for (size_t i = 0; i < 4; ++i)
+   {
+      EXPECT_EQ(6 + i, logger.GetHistoryEvent(i).count);
+      EXPECT_EQ(static_cast<long>(6 + i),
+            logger.GetHistoryEvent(i).value.integerValue);
+   }
+
+   // Shrinking keeps the newest events
+   logger.SetMaxHistoryEvents(2);
+   ASSERT_EQ(2u, logger.GetHistorySize());
+   EXPECT_EQ(8u, logger.GetHistoryEvent(0).count);
+   EXPECT_EQ(8u, logger.GetDroppedEventCount());
+
+   logger.Reset();
+   EXPECT_EQ(0u, logger.GetDroppedEventCount());
+   logger.SetInteger(key, 42);
+   ASSERT_EQ(1u, logger.GetHistorySize());
+   EXPECT_EQ(10u, logger.GetHistoryEvent(0).count);
+}
+
+TEST(SettingLoggerTests, BinaryDump)
+{
+   SettingLogger logger;
+   const SettingKeyId exposure = logger.InternKey("Cam", "Exposure");
+   const SettingKeyId mode = logger.InternKey("Cam", "Mode");
+   logger.SetFloat(exposure, 10.0, false);
+   logger.Reset();
+   logger.SetString(mode, "fast");
+   logger.FireOneShot(logger.InternKey("Stage", "Home"));
+
+   std::vector<char> image(4096, 'x');
+   ASSERT_TRUE(logger.DumpBinaryToBuffer(&image[0], image.size(),
+            "Cam", true, 7, 5, 3));
+
+   BinaryReader reader(&image[0]);
+   EXPECT_EQ(0, memcmp("MMSTBIN1", &image[0], 8));
+   reader.ReadUInt(8);
+   EXPECT_EQ(0u, reader.ReadU64()); // packetNumber
+   EXPECT_EQ("Cam", reader.ReadString());
+   EXPECT_EQ(7u, reader.ReadU64());
+   EXPECT_EQ(1u, reader.ReadU8());
+   EXPECT_EQ(5u, reader.ReadU64());
+   EXPECT_EQ(3u, reader.ReadU64());
+   EXPECT_EQ(0u, reader.ReadU64()); // startCounter
+   EXPECT_EQ(2u, reader.ReadU64()); // currentCounter
+   EXPECT_EQ(0u, reader.ReadU64()); // droppedEvents
+
+   ASSERT_EQ(3u, reader.ReadU32());
+   EXPECT_EQ("Cam", reader.ReadString());
+   EXPECT_EQ("Exposure", reader.ReadString());
+   EXPECT_EQ("Cam", reader.ReadString());
+   EXPECT_EQ("Mode", reader.ReadString());
+   EXPECT_EQ("Stage", reader.ReadString());
+   EXPECT_EQ("Home", reader.ReadString());
+
+   ASSERT_EQ(1u, reader.ReadU32());
+   EXPECT_EQ("fast", reader.ReadString());
+
+   ASSERT_EQ(1u, reader.ReadU32()); // startState
+   EXPECT_EQ(exposure, reader.ReadU32());
+   EXPECT_EQ(SettingValue::TypeFloat, reader.ReadU8());
+   EXPECT_DOUBLE_EQ(10.0, reader.ReadF64());
+
+   ASSERT_EQ(3u, reader.ReadU32()); // currentState
+   EXPECT_EQ(exposure, reader.ReadU32());
+   EXPECT_EQ(SettingValue::TypeFloat, reader.ReadU8());
+   reader.ReadF64();
+   EXPECT_EQ(mode, reader.ReadU32());
+   EXPECT_EQ(SettingValue::TypeString, reader.ReadU8());
+   EXPECT_EQ(0u, reader.ReadU32());
+   reader.ReadU32();
+   EXPECT_EQ(SettingValue::TypeOneShot, reader.ReadU8());
+
+   ASSERT_EQ(2u, reader.ReadU32()); // history
+   EXPECT_EQ(mode, reader.ReadU32());
+   EXPECT_EQ(SettingValue::TypeString, reader.ReadU8());
+   EXPECT_EQ(0u, reader.ReadU32());
+   EXPECT_EQ(0u, reader.ReadU64());
+   reader.ReadU32();
+   EXPECT_EQ(SettingValue::TypeOneShot, reader.ReadU8());
+   EXPECT_EQ(1u, reader.ReadU64());
+   EXPECT_EQ(0, image.back()); // Zero padded
+
+   // Too small: all zero
+   std::vector<char> small(32, 'x');
+   EXPECT_FALSE(logger.DumpBinaryToBuffer(&small[0], small.size(),
+            "Cam", true, 8, 6, 4));
+   EXPECT_EQ(std::vector<char>(32, 0), small);
+}
+
+// Rate at which setting changes can be logged, and cost of dumping the
+// history of 1000 triggers into an image, as when a sequenced stage is
+// triggered at kHz rates during a 1 fps acquisition.
+TEST(SettingLoggerTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   SettingLogger logger;
+   std::vector<SettingKeyId> keys;
+   for (int i = 0; i < 20; ++i)
+      keys.push_back(logger.InternKey("Device" +
+               std::string(1, static_cast<char>('A' + i)), "Position"));
+
+   const int events = 1000000;
+   const ptime t0 = microsec_clock::universal_time();
+   for (int i = 0; i < events; ++i)
+   {
+      logger.SetFloat(keys[i % keys.size()], i * 0.1);
+      if (i % 1000 == 999)
+         logger.Reset();
+   }
+   const ptime t1 = microsec_clock::universal_time();
+
+   std::vector<char> image(512 * 512);
+   const int dumps = 200;
+   double binaryUs = 0.0;
+   double textUs = 0.0;
+   for (int d = 0; d < dumps; ++d)
+   {
+      for (int i = 0; i < 1000; ++i)
+         logger.SetFloat(keys[i % keys.size()], i * 0.1);
+      const ptime t2 = microsec_clock::universal_time();
+      ASSERT_TRUE(logger.DumpBinaryToBuffer(&image[0], image.size(),
+               "Cam", true, d, d, d));
+      const ptime t3 = microsec_clock::universal_time();
+      if (d % 20 == 0)
+         logger.DrawTextToBuffer(&image[0], 512, 512, "Cam", true, d, d, d);
+      const ptime t4 = microsec_clock::universal_time();
+      binaryUs += static_cast<double>((t3 - t2).total_microseconds());
+      textUs += static_cast<double>((t4 - t3).total_microseconds());
+      logger.Reset();
+   }
+
+   const double eventUs = static_cast<double>((t1 - t0).total_microseconds());
+   std::cout << "Logging: " <<
+      (eventUs > 0.0 ? events * 1e6 / eventUs : 0.0) << " events/s\n" <<
+      "Binary dump of 1000 events: " << binaryUs / dumps << " us\n" <<
+      "Text rendering of 1000 events: " << textUs / (dumps / 20) << " us\n";
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -29,7 +29,12 @@
 #include <boost/asio/serial_port.hpp>
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
+#include <algorithm>
 #include <deque>
 #include <exception>
 #include <string>
@@ -62,6 +67,7 @@ public:
       serialPortImplementation_(ioService, nativeHandle),
       pSerialPortAdapter_(pPort),
       device_(deviceName),
+      notifying_(false),
       shutDownInProgress_(false)
    {
       Construct(deviceName, baud, flow, parity, stopBits, dataBits);
@@ -81,6 +87,7 @@ public:
       serialPortImplementation_(ioService, deviceName),
       pSerialPortAdapter_(pPort),
       device_(deviceName),
+      notifying_(false),
       shutDownInProgress_(false)
    {
       Construct(deviceName, baud, flow, parity, stopBits, dataBits);
@@ -304,7 +311,7 @@ public:
    {
       // clear read buffer;
       {
-         MMThreadGuard g(readBufferLock_);
+         boost::lock_guard<boost::mutex> g(readBufferMutex_);
          data_read_.clear();
       }
 
@@ -320,7 +327,7 @@ public:
    bool ReadOneCharacter(char& msg)
    {
       bool retval = false;
-      MMThreadGuard g(readBufferLock_);
+      boost::lock_guard<boost::mutex> g(readBufferMutex_);
       if (0 < data_read_.size())
       {
          retval = true;
@@ -330,6 +337,51 @@ public:
       return retval;
    }
 
+   // Wait until there is data to read or the timeout expires. Returns whether
+   // data is available.
+   bool WaitForData(unsigned long timeoutMs)
+   {
+      const boost::system_time deadline = boost::get_system_time() +
+         boost::posix_time::milliseconds(timeoutMs);
+      boost::unique_lock<boost::mutex> g(readBufferMutex_);
+      while (data_read_.empty() && active_)
+      {
+         if (!dataArrived_.timed_wait(g, deadline))
+            break;
+      }
+      return !data_read_.empty();
+   }
+
+   // Whether the port is still operating; once it stops, no more data will
+   // arrive and WaitForData() returns without waiting
+   bool IsActive()
+   {
+      boost::lock_guard<boost::mutex> g(readBufferMutex_);
+      return active_;
+   }
+
+   void AddDataCallback(MM::SerialDataCallback* callback)
+   {
+      boost::lock_guard<boost::mutex> g(callbacksMutex_);
+      if (std::find(dataCallbacks_.begin(), dataCallbacks_.end(), callback) ==
+            dataCallbacks_.end())
+         dataCallbacks_.push_back(callback);
+   }
+
+   // Waits for a notification in progress to finish, so that the callback is
+   // not running when this returns - unless called from a callback, which
+   // may remove itself
+   void RemoveDataCallback(MM::SerialDataCallback* callback)
+   {
+      boost::unique_lock<boost::mutex> g(callbacksMutex_);
+      dataCallbacks_.erase(std::remove(dataCallbacks_.begin(),
+               dataCallbacks_.end(), callback), dataCallbacks_.end());
+      if (notifyingThread_ == boost::this_thread::get_id())
+         return;
+      while (notifying_)
+         notificationDone_.wait(g);
+   }
+
    void ShutDownInProgress(const bool v){ shutDownInProgress_ = v;};
 
 
@@ -363,12 +415,14 @@ private:
       if (!error)
       { // read completed, so process the data
          {
-            MMThreadGuard g(readBufferLock_);
+            boost::lock_guard<boost::mutex> g(readBufferMutex_);
             for(unsigned int ib = 0; ib < bytes_transferred; ++ib)
             {
                data_read_.push_back(read_msg_[ib]);
             }
          }
+         if (bytes_transferred > 0)
+            NotifyDataArrived();
          CDeviceUtils::SleepMs(1);
          ReadStart(); // start waiting for another asynchronous read again
       }
@@ -384,6 +438,41 @@ private:
    }
 
 
+   void NotifyDataArrived()
+   {
+      dataArrived_.notify_all();
+
+      // The callbacks are called without holding the lock, so that they can
+      // write to the port or remove themselves
+      std::vector<MM::SerialDataCallback*> callbacks;
+      {
+         boost::lock_guard<boost::mutex> g(callbacksMutex_);
+         if (dataCallbacks_.empty())
+            return;
+         callbacks = dataCallbacks_;
+         notifying_ = true;
+         notifyingThread_ = boost::this_thread::get_id();
+      }
+      for (std::vector<MM::SerialDataCallback*>::iterator it = callbacks.begin();
+            it != callbacks.end(); ++it)
+      {
+         {
+            // Skip callbacks removed by an earlier one
+            boost::lock_guard<boost::mutex> g(callbacksMutex_);
+            if (std::find(dataCallbacks_.begin(), dataCallbacks_.end(), *it) ==
+                  dataCallbacks_.end())
+               continue;
+         }
+         (*it)->OnSerialDataArrived(device_.c_str());
+      }
+      {
+         boost::lock_guard<boost::mutex> g(callbacksMutex_);
+         notifying_ = false;
+         notifyingThread_ = boost::thread::id();
+      }
+      notificationDone_.notify_all();
+   }
+
    // for asynchronous write operations:
    void DoWriteMsg(const std::vector<char>& msg)
    { // callback to handle write call from outside this class
@@ -452,7 +541,12 @@ private:
          MMThreadGuard g(implementationLock_);
          serialPortImplementation_.close();
       }
-      active_ = false;
+      {
+         // Wake any waiters, which will see that no more data is coming
+         boost::lock_guard<boost::mutex> g(readBufferMutex_);
+         active_ = false;
+      }
+      dataArrived_.notify_all();
    }
 
 
@@ -466,7 +560,13 @@ private:
    SerialPort* pSerialPortAdapter_;
    std::string device_;
 
-   MMThreadLock readBufferLock_;
+   boost::mutex readBufferMutex_;
+   boost::condition_variable dataArrived_;
+   boost::mutex callbacksMutex_;
+   std::vector<MM::SerialDataCallback*> dataCallbacks_;
+   bool notifying_; // Callbacks are being called, on notifyingThread_
+   boost::thread::id notifyingThread_;
+   boost::condition_variable notificationDone_;
    MMThreadLock writeBufferLock_;
    MMThreadLock implementationLock_;
    bool shutDownInProgress_;
@@ -36,6 +36,8 @@
 
 #ifdef __linux__
 #include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
 #endif
 
 #include <boost/bind.hpp>
@@ -114,6 +116,45 @@ bool SerialPortLister::portAccessible(const char* portName)
 }
 
 
+/*
+ * On Linux, USB serial adapters are listed in /dev/serial/by-id under names
+ * made of their vendor, product and serial number. Other ports, and other
+ * platforms, have no identifier.
+ */
+std::string SerialPortLister::GetHardwareId(const std::string& portName)
+{
+#ifdef __linux__
+   char portPath[PATH_MAX];
+   if (!realpath(portName.c_str(), portPath))
+      return std::string();
+
+   const std::string byIdDir = "/dev/serial/by-id/";
+   DIR* pdir = opendir(byIdDir.c_str());
+   if (!pdir)
+      return std::string();
+   std::string hardwareId;
+   struct dirent* pent;
+   while ((pent = readdir(pdir)) != 0)
+   {
+      if (pent->d_name[0] == '.')
+         continue;
+      char linkPath[PATH_MAX];
+      const std::string entry = byIdDir + pent->d_name;
+      if (realpath(entry.c_str(), linkPath) && strcmp(linkPath, portPath) == 0)
+      {
+         hardwareId = pent->d_name;
+         break;
+      }
+   }
+   closedir(pdir);
+   return hardwareId;
+#else
+   (void)portName;
+   return std::string();
+#endif
+}
+
+
 #ifdef WIN32
 const int MaxBuf = 100000;
 typedef struct
@@ -388,6 +429,15 @@ SerialPort::SerialPort(const char* portName) :
    ret = CreateProperty(MM::g_Keyword_Description, "Serial port driver (boost:asio)", MM::String, true);
    assert(ret == DEVICE_OK);
 
+   // Lets the Core recognize the device behind the port, e.g. for caching
+   // device detection results
+   const std::string hardwareId = SerialPortLister::GetHardwareId(portName_);
+   if (!hardwareId.empty())
+   {
+      ret = CreateProperty(MM::g_Keyword_HardwareId, hardwareId.c_str(), MM::String, true);
+      assert(ret == DEVICE_OK);
+   }
+
    // baud
    CPropertyAction* pActBaud = new CPropertyAction (this, &SerialPort::OnBaud);
    ret = CreateProperty(MM::g_Keyword_BaudRate, g_Baud_9600, MM::String, false, pActBaud, true);
@@ -938,6 +988,37 @@ int SerialPort::Purge()
    return DEVICE_OK;
 }
 
+int SerialPort::WaitForData(unsigned long timeoutMs, bool& dataAvailable)
+{
+   if (!initialized_)
+      return ERR_PORT_NOTINITIALIZED;
+
+   dataAvailable = pPort_->WaitForData(timeoutMs);
+   // A port that has stopped does not wait; report it so that callers
+   // waiting in a loop fall back to sleeping instead of spinning
+   if (!dataAvailable && !pPort_->IsActive())
+      return ERR_RECEIVE_FAILED;
+   return DEVICE_OK;
+}
+
+int SerialPort::AddDataCallback(MM::SerialDataCallback* callback)
+{
+   if (!initialized_)
+      return ERR_PORT_NOTINITIALIZED;
+
+   pPort_->AddDataCallback(callback);
+   return DEVICE_OK;
+}
+
+int SerialPort::RemoveDataCallback(MM::SerialDataCallback* callback)
+{
+   if (!initialized_)
+      return ERR_PORT_NOTINITIALIZED;
+
+   pPort_->RemoveDataCallback(callback);
+   return DEVICE_OK;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Action interface
 //
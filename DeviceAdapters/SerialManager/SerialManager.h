@@ -90,6 +90,9 @@ public:
    int Read(unsigned char* buf, unsigned long bufLen, unsigned long& charsRead);
    MM::PortType GetPortType() const {return MM::SerialPort;}
    int Purge();
+   int WaitForData(unsigned long timeoutMs, bool& dataAvailable);
+   int AddDataCallback(MM::SerialDataCallback* callback);
+   int RemoveDataCallback(MM::SerialDataCallback* callback);
 
    std::string Name() const;
 
@@ -178,4 +181,7 @@ public:
    // returns list of serial ports that can be opened
    static void ListPorts(std::vector<std::string> &availablePorts);
    static bool portAccessible(const char*  portName);
+   // returns an identifier of the hardware behind the port that stays the
+   // same when it is plugged into a different USB socket, or an empty string
+   static std::string GetHardwareId(const std::string& portName);
 };
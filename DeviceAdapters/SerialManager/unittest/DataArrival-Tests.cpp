@@ -0,0 +1,234 @@
+// DESCRIPTION:   Unit tests for serial data arrival notification, using a
+//                pseudo-terminal in place of a serial device
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "SerialManager.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+
+namespace
+{
+
+// The master side of a pseudo-terminal plays the device
+class PseudoTerminal
+{
+   int fd_;
+   std::string slaveName_;
+
+public:
+   PseudoTerminal() : fd_(posix_openpt(O_RDWR | O_NOCTTY))
+   {
+      if (fd_ >= 0 && grantpt(fd_) == 0 && unlockpt(fd_) == 0)
+         slaveName_ = ptsname(fd_);
+   }
+
+   ~PseudoTerminal()
+   {
+      if (fd_ >= 0)
+         close(fd_);
+   }
+
+   const std::string& SlaveName() const { return slaveName_; }
+
+   // Hangs up, so that reads on the slave side fail
+   void Close()
+   {
+      if (fd_ >= 0)
+         close(fd_);
+      fd_ = -1;
+   }
+
+   void Send(const std::string& data)
+   {
+      ASSERT_EQ(static_cast<ssize_t>(data.size()),
+            write(fd_, data.data(), data.size()));
+   }
+};
+
+class CountingCallback : public MM::SerialDataCallback
+{
+   boost::mutex mutex_;
+   boost::condition_variable cond_;
+   int count_;
+   std::string portName_;
+
+public:
+   CountingCallback() : count_(0) {}
+
+   virtual void OnSerialDataArrived(const char* portName)
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      ++count_;
+      portName_ = portName;
+      cond_.notify_all();
+   }
+
+   bool WaitForCount(int count, long timeoutMs)
+   {
+      boost::unique_lock<boost::mutex> g(mutex_);
+      const boost::system_time deadline = boost::get_system_time() +
+         boost::posix_time::milliseconds(timeoutMs);
+      while (count_ < count)
+      {
+         if (!cond_.timed_wait(g, deadline))
+            break;
+      }
+      return count_ >= count;
+   }
+
+   int Count()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return count_;
+   }
+
+   std::string PortName()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return portName_;
+   }
+};
+
+std::string ReadAll(SerialPort& port)
+{
+   unsigned char buf[256];
+   unsigned long read = 0;
+   EXPECT_EQ(DEVICE_OK, port.Read(buf, sizeof(buf), read));
+   return std::string(reinterpret_cast<char*>(buf), read);
+}
+
+void SendAfter(PseudoTerminal* pty, long delayMs, std::string data)
+{
+   boost::this_thread::sleep(boost::posix_time::milliseconds(delayMs));
+   pty->Send(data);
+}
+
+class DataArrivalTest : public ::testing::Test
+{
+protected:
+   PseudoTerminal pty_;
+   SerialPort* port_;
+
+   virtual void SetUp()
+   {
+      ASSERT_FALSE(pty_.SlaveName().empty());
+      port_ = new SerialPort(pty_.SlaveName().c_str());
+      port_->SetProperty("Verbose", "0");
+      ASSERT_EQ(DEVICE_OK, port_->Initialize());
+   }
+
+   virtual void TearDown()
+   {
+      delete port_;
+   }
+};
+
+} // anonymous namespace
+
+
+TEST_F(DataArrivalTest, WaitTimesOutWithoutData)
+{
+   bool available = true;
+   const boost::posix_time::ptime start =
+      boost::posix_time::microsec_clock::universal_time();
+   ASSERT_EQ(DEVICE_OK, port_->WaitForData(100, available));
+   const long elapsedMs = (boost::posix_time::microsec_clock::universal_time() -
+         start).total_milliseconds();
+   EXPECT_FALSE(available);
+   EXPECT_GE(elapsedMs, 90);
+}
+
+TEST_F(DataArrivalTest, WaitWakesWhenDataArrives)
+{
+   boost::thread sender(SendAfter, &pty_, 50, std::string("status\r"));
+   bool available = false;
+   const boost::posix_time::ptime start =
+      boost::posix_time::microsec_clock::universal_time();
+   ASSERT_EQ(DEVICE_OK, port_->WaitForData(5000, available));
+   const long elapsedMs = (boost::posix_time::microsec_clock::universal_time() -
+         start).total_milliseconds();
+   sender.join();
+
+   EXPECT_TRUE(available);
+   EXPECT_LT(elapsedMs, 1000);
+
+   // Allow for the data arriving in more than one piece
+   std::string received = ReadAll(*port_);
+   while (received.size() < 7 &&
+         port_->WaitForData(1000, available) == DEVICE_OK && available)
+      received += ReadAll(*port_);
+   EXPECT_EQ("status\r", received);
+}
+
+TEST_F(DataArrivalTest, WaitReturnsImmediatelyForUnreadData)
+{
+   pty_.Send("x");
+   bool available = false;
+   ASSERT_EQ(DEVICE_OK, port_->WaitForData(5000, available));
+   ASSERT_TRUE(available);
+   ASSERT_EQ(DEVICE_OK, port_->WaitForData(0, available));
+   EXPECT_TRUE(available);
+   EXPECT_EQ("x", ReadAll(*port_));
+   ASSERT_EQ(DEVICE_OK, port_->WaitForData(0, available));
+   EXPECT_FALSE(available);
+}
+
+TEST_F(DataArrivalTest, WaitFailsOnceThePortStops)
+{
+   pty_.Close();
+   // The port stops when its pending read fails. From then on waiting must
+   // fail rather than return at once with no data, or callers would spin.
+   bool available = true;
+   int ret = DEVICE_OK;
+   for (int i = 0; i < 50 && ret == DEVICE_OK; ++i)
+      ret = port_->WaitForData(100, available);
+   EXPECT_NE(DEVICE_OK, ret);
+   EXPECT_FALSE(available);
+}
+
+TEST_F(DataArrivalTest, CallbackIsNotifiedUntilRemoved)
+{
+   CountingCallback callback;
+   ASSERT_EQ(DEVICE_OK, port_->AddDataCallback(&callback));
+   ASSERT_EQ(DEVICE_OK, port_->AddDataCallback(&callback)); // No duplicate
+
+   pty_.Send("a");
+   ASSERT_TRUE(callback.WaitForCount(1, 5000));
+   EXPECT_EQ(pty_.SlaveName(), callback.PortName());
+   EXPECT_EQ("a", ReadAll(*port_));
+   EXPECT_EQ(1, callback.Count());
+
+   ASSERT_EQ(DEVICE_OK, port_->RemoveDataCallback(&callback));
+   const int count = callback.Count();
+   pty_.Send("b");
+   bool available = false;
+   ASSERT_EQ(DEVICE_OK, port_->WaitForData(5000, available));
+   ASSERT_TRUE(available);
+   EXPECT_EQ(count, callback.Count());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
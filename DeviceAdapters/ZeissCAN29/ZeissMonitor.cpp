@@ -396,7 +396,11 @@ int ZeissMonitoringThread::svc() {
             } while (ret == 0);
          }
       } while ((charsRead != 0) && (!stop_)); 
-          CDeviceUtils::SleepMs(intervalUs_/1000);
+      // Sleep until more data arrives (waking periodically to check for
+      // stop); fall back to polling if the port cannot wait for data
+      bool dataAvailable;
+      if (core_.WaitForSerialData(&device_, hub_.port_.c_str(), 100, dataAvailable) != DEVICE_OK)
+         CDeviceUtils::SleepMs(intervalUs_/1000);
    }
    core_.LogMessage(&device_, "Monitoring Thread finished", true);
    return 0;
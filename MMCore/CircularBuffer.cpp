@@ -26,10 +26,15 @@
 #include "CircularBuffer.h"
 #include "CoreUtils.h"
 
+#include "FrameCodec.h"
+#include "SpillFile.h"
+#include "TaskSet_CompressFrame.h"
 #include "TaskSet_CopyMemory.h"
+#include "TaskSet_ImageStats.h"
 
 #include "../MMDevice/DeviceUtils.h"
 
+#include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 
 
@@ -41,30 +46,72 @@ const long adjustThreshold = LONG_MAX / 2;
 // division by zero can be added.
 const unsigned long maxCBSize = 10000000;
 
+// In compressed mode, the number of frame slots is chosen to allow for this
+// compression ratio. The actual capacity is limited by the arena size.
+const unsigned long maxCompressionRatio = 16;
+
+// Minimum number of decoded (or spilled) images kept valid for readers
+const size_t minDecodedImageCount = 4;
+
+// When a spill file is set, frames are moved to it once more than this
+// fraction of the in-memory slots hold unread frames, until no more than the
+// low-water fraction do
+const double spillHighWater = 0.5;
+const double spillLowWater = 0.25;
+
 CircularBuffer::CircularBuffer(unsigned int memorySizeMB) :
    width_(0), 
    height_(0), 
    pixDepth_(0), 
    imageCounter_(0), 
    insertIndex_(0), 
+   ramIndex_(0),
    saveIndex_(0), 
    memorySizeMB_(memorySizeMB), 
+   numChannels_(0),
    overflow_(false),
    threadPool_(boost::make_shared<ThreadPool>()),
-   tasksMemCopy_(boost::make_shared<TaskSet_CopyMemory>(threadPool_))
+   tasksMemCopy_(boost::make_shared<TaskSet_CopyMemory>(threadPool_)),
+   compressionEnabled_(false),
+   tasksCompress_(boost::make_shared<TaskSet_CompressFrame>(threadPool_)),
+   arenaHead_(0),
+   nextSerial_(0),
+   framesCompressed_(0),
+   rawBytesCompressed_(0),
+   compressedBytes_(0),
+   compressionTimeUs_(0.0),
+   tasksStats_(boost::make_shared<TaskSet_ImageStats>(threadPool_)),
+   statsBins_(0),
+   demuxOriginX_(0),
+   demuxOriginY_(0),
+   demuxActive_(false),
+   demuxSourceWidth_(0),
+   demuxSourceHeight_(0),
+   nextDecoded_(0),
+   fetchedWidth_(0),
+   fetchedHeight_(0),
+   fetchedDepth_(0),
+   fetchedPoolSize_(0),
+   framesSpilled_(0),
+   spillRequested_(false),
+   spillThreadStop_(false)
 {
    facet = new boost::posix_time::time_facet("%Y-%m-%d %H:%M:%s");
    tStream.imbue(std::locale(tStream.getloc(), facet));
 }
 
-CircularBuffer::~CircularBuffer() {}
+CircularBuffer::~CircularBuffer()
+{
+   StopSpillThread();
+}
 
 bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth)
 {
+   MMThreadGuard spillGuard(spillLock_);
    MMThreadGuard guard(g_bufferLock);
    imageNumbers_.clear();
-   boost::posix_time::ptime t = boost::posix_time::microsec_clock::local_time();
-   startTime_ = GetMMTimeNow(t);
+   frameAccounting_.Reset();
+   startTime_ = GetMMTimeNow();
 
    bool ret = true;
    try
@@ -72,8 +119,32 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       if (w == 0 || h==0 || pixDepth == 0 || channels == 0)
          return false; // does not make sense
 
+      // Multi-ROI frames are stored as one channel per ROI, if the ROIs fit
+      // in the frames to be inserted
+      demuxActive_ = false;
+      unsigned demuxWidth, demuxHeight, demuxCount;
+      if (channels == 1 && GetDemuxImageSize(demuxWidth, demuxHeight, demuxCount))
+      {
+         bool fits = true;
+         for (size_t i = 0; i < demuxRegions_.size(); ++i)
+         {
+            const ImageRegion& region = demuxRegions_[i];
+            if (region.x + region.width > w || region.y + region.height > h)
+               fits = false;
+         }
+         if (fits)
+         {
+            demuxActive_ = true;
+            demuxSourceWidth_ = w;
+            demuxSourceHeight_ = h;
+            channels = demuxCount;
+            w = demuxWidth;
+            h = demuxHeight;
+         }
+      }
+
       if (w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_)
-         if (frameArray_.size() > 0)
+         if (SlotCount() > 0)
             return true; // nothing to change
 
       width_ = w;
@@ -82,8 +153,16 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       numChannels_ = channels;
 
       insertIndex_ = 0;
+      ramIndex_ = 0;
       saveIndex_ = 0;
       overflow_ = false;
+      spillMetadata_.clear();
+      ResetRegionCursors();
+
+      framesCompressed_ = 0;
+      rawBytesCompressed_ = 0;
+      compressedBytes_ = 0;
+      compressionTimeUs_ = 0.0;
 
       // calculate the size of the entire buffer array once all images get allocated
       // the actual size at the time of the creation is going to be less, because
@@ -94,9 +173,30 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       if (cbSize == 0) 
       {
          frameArray_.resize(0);
+         compressedArray_.clear();
+         statsArray_.clear();
          return false; // memory footprint too small
       }
 
+      if (compressionEnabled_)
+      {
+         // Only the arena is allocated up front; the slots are cheap.
+         frameArray_.resize(0);
+         compressedArray_.clear();
+         arena_.clear();
+         arenaHead_ = 0;
+
+         cbSize = (unsigned long) std::min<unsigned long long>(
+               (unsigned long long) cbSize * maxCompressionRatio, maxCBSize);
+         arena_.resize((size_t) (memorySizeMB_ * bytesInMB));
+         compressedArray_.resize(cbSize,
+               std::vector<CompressedImage>(numChannels_));
+         AllocateStatistics();
+         return true;
+      }
+      compressedArray_.clear();
+      std::vector<unsigned char>().swap(arena_);
+
       // set a reasonable limit to circular buffer capacity 
       if (cbSize > maxCBSize)
          cbSize = maxCBSize; 
@@ -113,37 +213,405 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
          frameArray_[i].Resize(w, h, pixDepth);
          frameArray_[i].Preallocate(numChannels_);
       }
+
+      AllocateSpillSlots();
+      AllocateStatistics();
    }
 
    catch( ... /* std::bad_alloc& ex */)
    {
       frameArray_.resize(0);
+      spillMetadata_.clear();
+      statsArray_.clear();
+      compressedArray_.clear();
+      std::vector<unsigned char>().swap(arena_);
       ret = false;
    }
    return ret;
 }
 
+/**
+* Switches between storing raw and losslessly compressed frames.
+*
+* In compressed mode, frames are encoded on insertion (in parallel on the
+* buffer's thread pool) and decoded on retrieval, so that the memory footprint
+* holds proportionally more frames. The buffer contents are discarded; the
+* buffer must be initialized again before use.
+*/
+void CircularBuffer::SetCompressionEnabled(bool enable)
+{
+   MMThreadGuard insertGuard(g_insertLock);
+   MMThreadGuard spillGuard(spillLock_);
+   MMThreadGuard guard(g_bufferLock);
+
+   if (enable == compressionEnabled_)
+      return;
+
+   compressionEnabled_ = enable;
+   insertIndex_ = 0;
+   ramIndex_ = 0;
+   saveIndex_ = 0;
+   ResetRegionCursors();
+   overflow_ = false;
+   frameArray_.resize(0);
+   compressedArray_.clear();
+   statsArray_.clear();
+   std::vector<unsigned char>().swap(arena_);
+   arenaHead_ = 0;
+}
+
+/**
+* Returns the ratio of raw to compressed bytes for the frames inserted since
+* the buffer was initialized, or 1.0 if no frames have been compressed.
+*/
+double CircularBuffer::GetCompressionRatio() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   if (compressedBytes_ == 0)
+      return 1.0;
+   return (double) rawBytesCompressed_ / compressedBytes_;
+}
+
+/**
+* Returns the average wall time spent compressing a frame, in microseconds.
+*/
+double CircularBuffer::GetCompressionTimePerFrameUs() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   if (framesCompressed_ == 0)
+      return 0.0;
+   return compressionTimeUs_ / framesCompressed_;
+}
+
+/**
+* Sets a file to which unread frames are moved when the in-memory buffer fills
+* up, so that short bursts faster than the consumer are not dropped. The file
+* is created, mapped into memory and deleted when no longer used; this fails
+* if a file already exists at the path. An empty path or zero size removes
+* the spill file. The buffer contents are discarded.
+*
+* Spilling is not available in compressed mode.
+*/
+void CircularBuffer::SetSpillFile(const std::string& path, unsigned sizeMB) throw (CMMError)
+{
+   StopSpillThread();
+   {
+      MMThreadGuard insertGuard(g_insertLock);
+      MMThreadGuard spillGuard(spillLock_);
+      MMThreadGuard guard(g_bufferLock);
+
+      insertIndex_ = 0;
+      ramIndex_ = 0;
+      saveIndex_ = 0;
+      overflow_ = false;
+      ResetRegionCursors();
+      spillMetadata_.clear();
+      spillFile_.reset();
+
+      if (path.empty() || sizeMB == 0)
+         return;
+      if (compressionEnabled_)
+         throw CMMError("Circular buffer spill file cannot be used with compression");
+
+      spillFile_ = boost::make_shared<mm::SpillFile>(path,
+            (unsigned long long) sizeMB * bytesInMB);
+      AllocateSpillSlots();
+   }
+   StartSpillThread();
+}
+
+std::string CircularBuffer::GetSpillFilePath() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return spillFile_ ? spillFile_->GetPath() : std::string();
+}
+
+unsigned CircularBuffer::GetSpillFileSizeMB() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return spillFile_ ? (unsigned) (spillFile_->GetSize() / bytesInMB) : 0;
+}
+
+/**
+* Returns the number of frames moved to the spill file since the buffer was
+* initialized.
+*/
+unsigned long CircularBuffer::GetSpilledImageCount() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return (unsigned long) framesSpilled_;
+}
+
+// Called with g_bufferLock held
+long CircularBuffer::SlotCount() const
+{
+   if (compressionEnabled_)
+      return (long) compressedArray_.size();
+   return (long) frameArray_.size();
+}
+
+// Called with g_bufferLock held. Estimates how many frames fit in the given
+// number of arena bytes, based on the compression achieved so far.
+unsigned long CircularBuffer::EstimateFrameCount(size_t bytes) const
+{
+   unsigned long long frameBytes;
+   if (framesCompressed_ > 0)
+      frameBytes = compressedBytes_ * numChannels_ / framesCompressed_;
+   else
+      frameBytes = (unsigned long long) width_ * height_ * pixDepth_ * numChannels_;
+   if (frameBytes == 0)
+      return 0;
+   return (unsigned long) std::min<unsigned long long>(bytes / frameBytes,
+         compressedArray_.size());
+}
+
+/**
+* Enables or disables computing pixel statistics for each inserted image.
+*
+* The minimum, maximum, mean and standard deviation are added to the image
+* metadata (tags PixelMin, PixelMax, PixelMean and PixelStdDev); these and a
+* histogram with the given number of bins (at most 256 for 8-bit images) are
+* also kept with the frame while it is in memory. Only 8- and 16-bit
+* grayscale images are analyzed.
+*/
+void CircularBuffer::SetStatisticsEnabled(bool enable, unsigned histogramBins)
+{
+   MMThreadGuard insertGuard(g_insertLock);
+   MMThreadGuard guard(g_bufferLock);
+   statsBins_ = enable ? std::max(1u, histogramBins) : 0;
+   AllocateStatistics();
+}
+
+/**
+* Sets the regions into which multi-ROI frames are split, relative to the
+* frame (the bounding box of the ROIs), and the position of the frame on the
+* sensor. Pass no regions to store frames as they are. Takes effect when the
+* buffer is next initialized.
+*/
+void CircularBuffer::SetDemuxRegions(const std::vector<ImageRegion>& regions,
+      unsigned originX, unsigned originY)
+{
+   MMThreadGuard insertGuard(g_insertLock);
+   MMThreadGuard guard(g_bufferLock);
+   demuxRegions_ = regions;
+   demuxOriginX_ = originX;
+   demuxOriginY_ = originY;
+   // The buffer's layout no longer matches; Initialize() decides again
+   demuxActive_ = false;
+}
+
+std::vector<ImageRegion> CircularBuffer::GetDemuxRegions() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return demuxRegions_;
+}
+
+/**
+* Gets the size of the per-ROI images (that of the largest ROI) and their
+* number. Returns false if no regions are set.
+*/
+bool CircularBuffer::GetDemuxImageSize(unsigned& width, unsigned& height,
+      unsigned& count) const
+{
+   MMThreadGuard guard(g_bufferLock);
+   if (demuxRegions_.empty())
+      return false;
+   width = height = 0;
+   for (size_t i = 0; i < demuxRegions_.size(); ++i)
+   {
+      width = std::max(width, demuxRegions_[i].width);
+      height = std::max(height, demuxRegions_[i].height);
+   }
+   count = (unsigned) demuxRegions_.size();
+   return width > 0 && height > 0;
+}
+
+/**
+* Returns the statistics of the n-th image from the top (0 being the most
+* recent) for the given channel. Returns false if statistics are not
+* available for that image.
+*/
+bool CircularBuffer::GetNthFromTopImageStatistics(long n, unsigned channel,
+      ImageStatistics& stats) const
+{
+   MMThreadGuard guard(g_bufferLock);
+   if (statsArray_.empty() || n < 0 || n + 1 > insertIndex_ - saveIndex_)
+      return false;
+
+   long targetIndex = insertIndex_ - n - 1L;
+   if (targetIndex < ramIndex_)
+      return false; // Spilled; only the metadata tags are kept
+   targetIndex %= (long) statsArray_.size();
+   if (channel >= statsArray_[targetIndex].size() ||
+         statsArray_[targetIndex][channel].histogram.empty())
+      return false;
+   stats = statsArray_[targetIndex][channel];
+   return true;
+}
+
+// Called with g_bufferLock held, after the slots have been (re)allocated or
+// the statistics setting has changed
+void CircularBuffer::AllocateStatistics()
+{
+   statsArray_.clear();
+   if (statsBins_ > 0)
+      statsArray_.resize(SlotCount(), std::vector<ImageStatistics>(numChannels_));
+}
+
+// Called with g_insertLock held. Computes the statistics of one channel of
+// the image being inserted into statsScratch_ and adds them to its metadata.
+void CircularBuffer::ComputeStatistics(const unsigned char* pixels, Metadata& md)
+{
+   const unsigned bins = std::min(statsBins_, 1u << (8 * pixDepth_));
+   tasksStats_->Compute(pixels, (size_t) width_ * height_, pixDepth_, bins,
+         statsScratch_);
+   md.PutImageTag("PixelMin", statsScratch_.min);
+   md.PutImageTag("PixelMax", statsScratch_.max);
+   md.PutImageTag("PixelMean", statsScratch_.mean);
+   md.PutImageTag("PixelStdDev", statsScratch_.stdDev);
+}
+
+// Called with g_insertLock held. Moves statsScratch_ into the slot being
+// inserted, reusing the slot's previous histogram storage.
+void CircularBuffer::StoreStatistics(unsigned channel)
+{
+   MMThreadGuard guard(g_bufferLock);
+   if (statsArray_.empty() || channel >= numChannels_)
+      return;
+   ImageStatistics& stats = statsArray_[insertIndex_ % statsArray_.size()][channel];
+   stats.min = statsScratch_.min;
+   stats.max = statsScratch_.max;
+   stats.mean = statsScratch_.mean;
+   stats.stdDev = statsScratch_.stdDev;
+   stats.histogram.swap(statsScratch_.histogram);
+}
+
+// Called with g_bufferLock held
+unsigned long CircularBuffer::SpillSlotCount() const
+{
+   if (compressionEnabled_)
+      return 0;
+   return (unsigned long) spillMetadata_.size();
+}
+
+// Called with spillLock_ and g_bufferLock held, after the image dimensions
+// or the spill file have changed
+void CircularBuffer::AllocateSpillSlots()
+{
+   spillMetadata_.clear();
+   framesSpilled_ = 0;
+   if (!spillFile_ || compressionEnabled_)
+      return;
+
+   unsigned long long frameBytes =
+      (unsigned long long) width_ * height_ * pixDepth_ * numChannels_;
+   if (frameBytes == 0)
+      return;
+   unsigned long slots = (unsigned long) std::min<unsigned long long>(
+         spillFile_->GetSize() / frameBytes, maxCBSize);
+   spillMetadata_.resize(slots, std::vector<Metadata>(numChannels_));
+}
+
 void CircularBuffer::Clear() 
 {
+   MMThreadGuard spillGuard(spillLock_);
    MMThreadGuard guard(g_bufferLock); 
    insertIndex_=0; 
+   ramIndex_=0;
    saveIndex_=0; 
+   ResetRegionCursors();
    overflow_ = false;
-   boost::posix_time::ptime t = boost::posix_time::microsec_clock::local_time();
-   startTime_ = GetMMTimeNow(t);
+   arenaHead_ = 0;
+   startTime_ = GetMMTimeNow();
    imageNumbers_.clear();
 }
 
+// Counts a frame that was streamed to disk without being inserted, so that
+// its frame number is not mistaken for a gap
+void CircularBuffer::AccountForBypassedFrame(const Metadata* pMd)
+{
+   Metadata frameMd;
+   if (pMd)
+      frameMd = *pMd;
+   const std::string cameraName = frameMd.HasTag("Camera") ?
+      frameMd.GetSingleTag("Camera").GetValue() : std::string();
+   frameAccounting_.FrameReceived(cameraName, frameMd);
+}
+
+/**
+* Clears the buffer on behalf of a camera that does not stop when the buffer
+* overflows. The frames discarded unread are accounted as dropped by the
+* buffer.
+*/
+void CircularBuffer::ClearAfterOverflow()
+{
+   std::map<std::string, long> discarded;
+   {
+      MMThreadGuard spillGuard(spillLock_);
+      MMThreadGuard guard(g_bufferLock);
+      for (long index = saveIndex_; index < insertIndex_; ++index)
+         ++discarded[GetFrameCamera(index)];
+   }
+   Clear();
+   for (std::map<std::string, long>::const_iterator it = discarded.begin();
+         it != discarded.end(); ++it)
+      frameAccounting_.FramesDiscardedByBuffer(it->first, it->second);
+   frameAccounting_.BufferClearedAfterOverflow();
+}
+
+// Called with g_bufferLock held. Returns the label of the camera that sent
+// the unread frame with the given index.
+std::string CircularBuffer::GetFrameCamera(long index) const
+{
+   const Metadata* md = 0;
+   if (index < ramIndex_)
+   {
+      if (spillMetadata_.empty())
+         return std::string();
+      md = &spillMetadata_[index % spillMetadata_.size()][0];
+   }
+   else if (compressionEnabled_)
+      md = &compressedArray_[index % compressedArray_.size()][0].metadata;
+   else
+   {
+      const mm::ImgBuffer* img = frameArray_[index % frameArray_.size()].FindImage(0);
+      if (!img)
+         return std::string();
+      md = &img->GetMetadata();
+   }
+   if (!md->HasTag("Camera"))
+      return std::string();
+   return md->GetSingleTag("Camera").GetValue();
+}
+
 unsigned long CircularBuffer::GetSize() const
 {
    MMThreadGuard guard(g_bufferLock);
-   return (unsigned long)frameArray_.size();
+   if (compressionEnabled_)
+      return EstimateFrameCount(arena_.size());
+   return (unsigned long)frameArray_.size() + SpillSlotCount();
 }
 
 unsigned long CircularBuffer::GetFreeSize() const
 {
    MMThreadGuard guard(g_bufferLock);
-   long freeSize = (long)frameArray_.size() - (insertIndex_ - saveIndex_);
+   if (compressionEnabled_)
+   {
+      // Headroom at the current compression ratio
+      size_t used = 0;
+      if (insertIndex_ > saveIndex_)
+      {
+         size_t tail = compressedArray_[saveIndex_ % compressedArray_.size()][0].offset;
+         used = arenaHead_ >= tail ? arenaHead_ - tail :
+            arena_.size() - tail + arenaHead_;
+      }
+      unsigned long freeFrames = EstimateFrameCount(arena_.size() - used);
+      unsigned long freeSlots = (unsigned long)
+         (compressedArray_.size() - (insertIndex_ - saveIndex_));
+      return std::min(freeFrames, freeSlots);
+   }
+   long freeSize = (long)(frameArray_.size() + SpillSlotCount()) -
+      (insertIndex_ - saveIndex_);
    if (freeSize < 0)
       return 0;
    else
@@ -184,12 +652,63 @@ bool CircularBuffer::InsertImage(const unsigned char* pixArray, unsigned int wid
 * Inserts a multi-channel frame in the buffer.
 */
 bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned int numChannels, unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents, const Metadata* pMd) throw (CMMError)
+{
+   MMThreadGuard guard(g_insertLock);
+   if (numChannels == 1)
+   {
+      bool demux;
+      {
+         MMThreadGuard guard(g_bufferLock);
+         demux = demuxActive_ && width == demuxSourceWidth_ &&
+            height == demuxSourceHeight_ && byteDepth == pixDepth_;
+      }
+      if (demux)
+         return InsertDemuxed(pixArray, byteDepth, nComponents, pMd);
+   }
+   return InsertFrame(pixArray, numChannels, width, height, byteDepth,
+         nComponents, pMd, false);
+}
+
+// Called with g_insertLock held. Copies each ROI of a multi-ROI frame into a
+// channel of its own (padded with zeros to the size of the largest ROI) and
+// inserts the result.
+bool CircularBuffer::InsertDemuxed(const unsigned char* pixArray,
+      unsigned byteDepth, unsigned nComponents, const Metadata* pMd) throw (CMMError)
+{
+   unsigned width, height;
+   {
+      MMThreadGuard guard(g_bufferLock);
+      width = width_;
+      height = height_;
+   }
+   const size_t channelSize = (size_t) width * height * byteDepth;
+   demuxScratch_.resize(channelSize * demuxRegions_.size());
+
+   bool padded = false;
+   for (size_t i = 0; i < demuxRegions_.size(); ++i)
+      if (demuxRegions_[i].width != width || demuxRegions_[i].height != height)
+         padded = true;
+   if (padded)
+      memset(&demuxScratch_[0], 0, demuxScratch_.size());
+
+   for (size_t i = 0; i < demuxRegions_.size(); ++i)
+      CopyImageRegion(pixArray, demuxSourceWidth_, demuxSourceHeight_,
+            byteDepth, demuxRegions_[i], &demuxScratch_[i * channelSize], width);
+
+   return InsertFrame(&demuxScratch_[0], (unsigned) demuxRegions_.size(),
+         width, height, byteDepth, nComponents, pMd, true);
+}
+
+bool CircularBuffer::InsertFrame(const unsigned char* pixArray, unsigned numChannels,
+      unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents,
+      const Metadata* pMd, bool demuxed) throw (CMMError)
 {
     MMThreadGuard guard(g_insertLock);
  
-    mm::ImgBuffer* pImg;
+    mm::ImgBuffer* pImg = 0;
     unsigned long singleChannelSize = (unsigned long)width * height * byteDepth;
  
+    bool ramFull;
     {
        MMThreadGuard guard(g_bufferLock);
  
@@ -197,49 +716,93 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
        if (width != width_ || height != height_ || byteDepth != pixDepth_)
           throw CMMError("Incompatible image dimensions in the circular buffer", MMERR_CircularBufferIncompatibleImage);
  
-       bool overflowed = (insertIndex_ - saveIndex_) >= static_cast<long>(frameArray_.size());
+       ramFull = (insertIndex_ - ramIndex_) >= SlotCount();
+    }
+
+    // If the spill thread has not kept up, move a frame out of memory here
+    // rather than dropping this one (spillFile_ cannot change while
+    // g_insertLock is held)
+    if (ramFull && spillFile_)
+    {
+       MMThreadGuard spillGuard(spillLock_);
+       MigrateOldestFrame();
+    }
+
+    // Account for the frame before deciding whether there is room for it,
+    // so that frames dropped here are distinguished from those the camera
+    // never delivered
+    Metadata frameMd;
+    if (pMd)
+       frameMd = *pMd;
+    const std::string cameraName = frameMd.HasTag("Camera") ?
+       frameMd.GetSingleTag("Camera").GetValue() : std::string();
+    frameAccounting_.FrameReceived(cameraName, frameMd);
+
+    // Arena position to return to if a later channel does not fit
+    size_t arenaHeadAtStart;
+    {
+       MMThreadGuard guard(g_bufferLock);
+       bool overflowed = (insertIndex_ - ramIndex_) >= SlotCount();
        if (overflowed) {
           overflow_ = true;
+          frameAccounting_.FrameDroppedByBuffer(cameraName);
           return false;
        }
+       arenaHeadAtStart = arenaHead_;
     }
  
+    size_t frameOffset = 0;
     for (unsigned i=0; i<numChannels; i++)
     {
        Metadata md;
        {
           MMThreadGuard guard(g_bufferLock);
-          // we assume that all buffers are pre-allocated
-          pImg = frameArray_[insertIndex_ % frameArray_.size()].FindImage(i);
-          if (!pImg)
-             return false;
+          if (compressionEnabled_)
+          {
+             if (i >= numChannels_)
+                return false;
+          }
+          else
+          {
+             // we assume that all buffers are pre-allocated
+             pImg = frameArray_[insertIndex_ % frameArray_.size()].FindImage(i);
+             if (!pImg)
+                return false;
+          }
  
-          if (pMd)
+          // TODO: the same metadata is inserted for each channel ???
+          // Perhaps we need to add specific tags to each channel
+          md = frameMd;
+
+          if (demuxed && i < demuxRegions_.size())
           {
-             // TODO: the same metadata is inserted for each channel ???
-             // Perhaps we need to add specific tags to each channel
-             md = *pMd;
+             const ImageRegion& region = demuxRegions_[i];
+             md.PutImageTag(MM::g_Keyword_CameraChannelIndex, i);
+             md.PutImageTag(MM::g_Keyword_CameraChannelName,
+                   "ROI-" + ToString(i));
+             md.PutImageTag(MM::g_Keyword_Metadata_ROI_X, demuxOriginX_ + region.x);
+             md.PutImageTag(MM::g_Keyword_Metadata_ROI_Y, demuxOriginY_ + region.y);
+             md.PutImageTag("MultiROIWidth", region.width);
+             md.PutImageTag("MultiROIHeight", region.height);
           }
 
-         std::string cameraName = md.GetSingleTag("Camera").GetValue();
          if (imageNumbers_.end() == imageNumbers_.find(cameraName))
          {
             imageNumbers_[cameraName] = 0;
          }
 
          // insert image number. 
-         md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(imageNumbers_[cameraName]));
+         md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::FormatNumber(imageNumbers_[cameraName]));
          ++imageNumbers_[cameraName];
       }
 
-      boost::posix_time::ptime t = boost::posix_time::microsec_clock::local_time();
+      MM::MMTime timestamp = GetMMTimeNow();
       if (!md.HasTag(MM::g_Keyword_Elapsed_Time_ms))
       {
          // if time tag was not supplied by the camera insert current timestamp
-         MM::MMTime timestamp = GetMMTimeNow(t);
-         md.PutImageTag(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::ConvertToString((timestamp - startTime_).getMsec()));
+         md.PutImageTag(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::FormatNumber((timestamp - startTime_).getMsec()));
       }
-      tStream << t;
+      tStream << mm::CoreClock::ToPosixTime(timestamp);
       md.PutImageTag(MM::g_Keyword_Metadata_TimeInCore, tStream.str().c_str());
       tStream.str(std::string());
       tStream.clear();
@@ -262,7 +825,29 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
       else
          md.PutImageTag("PixelType","Unknown"); 
 
-      pImg->SetMetadata(md);
+      // Statistics are computed from the copy in the buffer if there is one,
+      // while it is still in cache
+      const bool computeStats = statsBins_ > 0 && nComponents == 1 &&
+         TaskSet_ImageStats::IsSupportedDepth(byteDepth);
+      if (computeStats && compressionEnabled_)
+         ComputeStatistics(pixArray + i * singleChannelSize, md);
+
+      if (compressionEnabled_)
+      {
+         if (!InsertCompressedChannel(pixArray + i * singleChannelSize, i, md, frameOffset))
+         {
+            MMThreadGuard guard(g_bufferLock);
+            // Release the space reserved for the channels already stored
+            arenaHead_ = arenaHeadAtStart;
+            overflow_ = true;
+            frameAccounting_.FrameDroppedByBuffer(cameraName);
+            return false;
+         }
+         if (computeStats)
+            StoreStatistics(i);
+         continue;
+      }
+
       //pImg->SetPixels(pixArray + i * singleChannelSize);
       // TODO: In MMCore the ImgBuffer::GetPixels() returns const pointer.
       //       It would be better to have something like ImgBuffer::GetPixelsRW() in MMDevice.
@@ -270,6 +855,12 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
       //       and utilize parallel copy also in single snap acquisitions.
       tasksMemCopy_->MemCopy((void*)pImg->GetPixels(),
             pixArray + i * singleChannelSize, singleChannelSize);
+      if (computeStats)
+      {
+         ComputeStatistics(pImg->GetPixels(), md);
+         StoreStatistics(i);
+      }
+      pImg->SetMetadata(md);
    }
 
    {
@@ -277,17 +868,193 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
 
       imageCounter_++;
       insertIndex_++;
-      if ((insertIndex_ - (long)frameArray_.size()) > adjustThreshold && (saveIndex_- (long)frameArray_.size()) > adjustThreshold)
+      if ((insertIndex_ - SlotCount()) > adjustThreshold && (saveIndex_- SlotCount()) > adjustThreshold)
       {
          // adjust buffer indices to avoid overflowing integer size
          insertIndex_ -= adjustThreshold;
+         ramIndex_ -= adjustThreshold;
          saveIndex_ -= adjustThreshold;
+         for (std::map<long, RegionCursor>::iterator it = regionCursors_.begin();
+               it != regionCursors_.end(); ++it)
+            it->second.nextIndex -= adjustThreshold;
       }
+
+      if (SpillSlotCount() > 0 &&
+            insertIndex_ - ramIndex_ > (long) (spillHighWater * SlotCount()))
+         RequestMigration();
    }
 
    return true;
 }
- 
+
+/**
+* Compresses one channel of the frame being inserted and stores it in the
+* arena. Called with g_insertLock held. Returns false if the arena cannot hold
+* the image without overwriting unread frames.
+*/
+bool CircularBuffer::InsertCompressedChannel(const unsigned char* pixels,
+      unsigned channel, const Metadata& md, size_t& frameOffset)
+{
+   // Dimensions cannot change while g_insertLock is held
+   boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+   const size_t bytes = tasksCompress_->Compress(pixels, width_, height_, pixDepth_);
+   const double elapsedUs = (double)
+      (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+
+   size_t offset;
+   {
+      MMThreadGuard guard(g_bufferLock);
+
+      // Start from the beginning of the arena whenever it holds no unread
+      // frames, to keep the largest possible contiguous space free
+      if (channel == 0 && insertIndex_ == saveIndex_)
+         arenaHead_ = 0;
+
+      size_t tail;
+      if (insertIndex_ > saveIndex_)
+         tail = compressedArray_[saveIndex_ % compressedArray_.size()][0].offset;
+      else if (channel > 0)
+         tail = frameOffset;
+      else
+         tail = arenaHead_;
+
+      if (!ReserveArena(bytes, tail, offset))
+         return false;
+      if (channel == 0)
+         frameOffset = offset;
+
+      CompressedImage& image = compressedArray_[insertIndex_ % compressedArray_.size()][channel];
+      image.offset = offset;
+      image.bytes = bytes;
+      image.serial = ++nextSerial_;
+      image.metadata = md;
+
+      ++framesCompressed_;
+      rawBytesCompressed_ += (unsigned long long) width_ * height_ * pixDepth_;
+      compressedBytes_ += bytes;
+      compressionTimeUs_ += elapsedUs;
+   }
+
+   // The reserved range is not visible to readers until the frame is
+   // committed, so it can be filled without holding the buffer lock
+   tasksCompress_->CopyCompressed(&arena_[offset]);
+   return true;
+}
+
+/**
+* Reserves a contiguous range of the arena. Called with g_bufferLock held;
+* tail is the start of the oldest byte that must be preserved. Returns false
+* if there is not enough room.
+*/
+bool CircularBuffer::ReserveArena(size_t bytes, size_t tail, size_t& offset)
+{
+   if (arenaHead_ >= tail)
+   {
+      // Used range is [tail, head); free space at the end, then at the start
+      if (arena_.size() - arenaHead_ >= bytes)
+      {
+         offset = arenaHead_;
+         arenaHead_ += bytes;
+         return true;
+      }
+      // Strict inequality keeps head != tail, which would mean "empty"
+      if (tail > bytes)
+      {
+         offset = 0;
+         arenaHead_ = bytes;
+         return true;
+      }
+      return false;
+   }
+
+   // Used range wraps around: [tail, end) and [0, head)
+   if (tail - arenaHead_ > bytes)
+   {
+      offset = arenaHead_;
+      arenaHead_ += bytes;
+      return true;
+   }
+   return false;
+}
+
+/**
+* Looks up an image of a compressed slot. Called with decodeLock_ and
+* g_bufferLock held. If the image has been decoded recently, cached is set to
+* the decoded buffer; otherwise the encoded image is copied for decoding by
+* DecodeFetchedImage() after g_bufferLock has been released.
+*/
+bool CircularBuffer::FetchCompressedImage(long slot, unsigned channel,
+      const mm::ImgBuffer*& cached) const
+{
+   cached = 0;
+   if (channel >= compressedArray_[slot].size())
+      return false;
+
+   const CompressedImage& image = compressedArray_[slot][channel];
+   for (size_t i = 0; i < decodedSerials_.size(); ++i)
+   {
+      if (decodedSerials_[i] == image.serial)
+      {
+         cached = decodedImages_[i].get();
+         return true;
+      }
+   }
+
+   fetchedData_.assign(arena_.begin() + image.offset,
+         arena_.begin() + image.offset + image.bytes);
+   fetchedImage_ = image;
+   fetchedWidth_ = width_;
+   fetchedHeight_ = height_;
+   fetchedDepth_ = pixDepth_;
+   fetchedPoolSize_ = std::max<size_t>(minDecodedImageCount, 2 * numChannels_);
+   return true;
+}
+
+/**
+* Decodes the image copied by FetchCompressedImage(). Called with decodeLock_
+* held.
+*/
+const mm::ImgBuffer* CircularBuffer::DecodeFetchedImage() const
+{
+   const size_t index = NextPooledImage(fetchedWidth_, fetchedHeight_,
+         fetchedDepth_, fetchedPoolSize_);
+   mm::ImgBuffer& img = *decodedImages_[index];
+
+   // See the comment on GetPixels() in InsertMultiChannel()
+   if (fetchedData_.empty() || !mm::FrameCodec::DecompressFrame(&fetchedData_[0],
+            fetchedData_.size(), fetchedWidth_, fetchedHeight_, fetchedDepth_,
+            const_cast<unsigned char*>(img.GetPixels())))
+      return 0;
+
+   img.SetMetadata(fetchedImage_.metadata);
+   decodedSerials_[index] = fetchedImage_.serial;
+   return &img;
+}
+
+/**
+* Takes the next buffer of the rotating pool used for decoded and spilled
+* images, growing the pool to poolSize and resizing the buffer as needed.
+* Called with decodeLock_ held. The returned buffer is marked as not holding
+* any cached image.
+*/
+size_t CircularBuffer::NextPooledImage(unsigned width, unsigned height,
+      unsigned depth, size_t poolSize) const
+{
+   while (decodedImages_.size() < poolSize)
+   {
+      decodedImages_.push_back(boost::make_shared<mm::ImgBuffer>(
+               width, height, depth));
+      decodedSerials_.push_back(0);
+   }
+
+   const size_t index = nextDecoded_++ % decodedImages_.size();
+   mm::ImgBuffer& img = *decodedImages_[index];
+   decodedSerials_[index] = 0;
+   if (img.Width() != width || img.Height() != height || img.Depth() != depth)
+      img.Resize(width, height, depth);
+   return index;
+}
+
 
 const unsigned char* CircularBuffer::GetTopImage() const
 {
@@ -302,6 +1069,72 @@ const mm::ImgBuffer* CircularBuffer::GetTopImageBuffer(unsigned channel) const
    return GetNthFromTopImageBuffer(0, channel);
 }
 
+/**
+* Returns the newest image of the channel like GetTopImageBuffer(), but
+* decodes compressed and spilled images into scratch instead of the pool
+* shared by the other retrieval functions, so that a background reader does
+* not invalidate images returned to the application. Images held uncompressed
+* in memory are returned in place.
+*/
+const mm::ImgBuffer* CircularBuffer::GetTopImageBuffer(unsigned channel,
+      mm::ImgBuffer& scratch) const
+{
+   MMThreadGuard spillGuard(spillLock_);
+   std::vector<unsigned char> encoded;
+   bool spilled;
+   unsigned long spillSlot = 0;
+   size_t imageBytes;
+   unsigned channels;
+   {
+      MMThreadGuard guard(g_bufferLock);
+
+      if (insertIndex_ - saveIndex_ < 1)
+         return 0;
+      const long index = insertIndex_ - 1;
+      spilled = index < ramIndex_;
+      if (!spilled && !compressionEnabled_)
+         return frameArray_[index % SlotCount()].FindImage(channel);
+      if (channel >= numChannels_)
+         return 0;
+
+      scratch.Resize(width_, height_, pixDepth_);
+      imageBytes = (size_t) width_ * height_ * pixDepth_;
+      channels = numChannels_;
+      if (!spilled)
+      {
+         const std::vector<CompressedImage>& images =
+            compressedArray_[index % SlotCount()];
+         if (channel >= images.size())
+            return 0;
+         const CompressedImage& image = images[channel];
+         encoded.assign(arena_.begin() + image.offset,
+               arena_.begin() + image.offset + image.bytes);
+         scratch.SetMetadata(image.metadata);
+      }
+      else
+      {
+         if (spillMetadata_.empty())
+            return 0;
+         spillSlot = (unsigned long) (index % spillMetadata_.size());
+         scratch.SetMetadata(spillMetadata_[spillSlot][channel]);
+      }
+   }
+
+   // See the comment on GetPixels() in InsertMultiChannel()
+   unsigned char* pixels = const_cast<unsigned char*>(scratch.GetPixels());
+   if (spilled)
+   {
+      memcpy(pixels, spillFile_->GetData() +
+            ((size_t) spillSlot * channels + channel) * imageBytes, imageBytes);
+      return &scratch;
+   }
+   if (encoded.empty() || !mm::FrameCodec::DecompressFrame(&encoded[0],
+            encoded.size(), scratch.Width(), scratch.Height(), scratch.Depth(),
+            pixels))
+      return 0;
+   return &scratch;
+}
+
 const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(unsigned long n) const
 {
    return GetNthFromTopImageBuffer(static_cast<long>(n), 0);
@@ -310,18 +1143,57 @@ const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(unsigned long n) c
 const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(long n,
       unsigned channel) const
 {
-   MMThreadGuard guard(g_bufferLock);
+   MMThreadGuard decodeGuard(decodeLock_);
+   MMThreadGuard spillGuard(spillLock_);
+   long index;
+   {
+      MMThreadGuard guard(g_bufferLock);
 
-   long availableImages = insertIndex_ - saveIndex_;
-   if (n + 1 > availableImages)
-      return 0;
+      long availableImages = insertIndex_ - saveIndex_;
+      if (n + 1 > availableImages)
+         return 0;
 
-   long targetIndex = insertIndex_ - n - 1L;
-   while (targetIndex < 0)
-      targetIndex += (long) frameArray_.size();
-   targetIndex %= frameArray_.size();
+      index = insertIndex_ - n - 1L;
+   }
+   return GetImageAtIndex(index, channel);
+}
+
+/**
+* Returns the image of the unread frame with the given index, or 0 if that
+* frame is not (or no longer) in the buffer. Called with decodeLock_ and
+* spillLock_ held.
+*/
+const mm::ImgBuffer* CircularBuffer::GetImageAtIndex(long index,
+      unsigned channel) const
+{
+   long targetIndex = index;
+   bool spilled;
+   {
+      MMThreadGuard guard(g_bufferLock);
+
+      if (index < saveIndex_ || index >= insertIndex_)
+         return 0;
 
-   return frameArray_[targetIndex].FindImage(channel);
+      spilled = targetIndex < ramIndex_;
+      if (!spilled)
+      {
+         while (targetIndex < 0)
+            targetIndex += SlotCount();
+         targetIndex %= SlotCount();
+
+         if (!compressionEnabled_)
+            return frameArray_[targetIndex].FindImage(channel);
+
+         const mm::ImgBuffer* cached;
+         if (!FetchCompressedImage(targetIndex, channel, cached))
+            return 0;
+         if (cached)
+            return cached;
+      }
+   }
+   if (spilled)
+      return ReadSpilledImage(targetIndex, channel);
+   return DecodeFetchedImage();
 }
 
 const unsigned char* CircularBuffer::GetNextImage()
@@ -334,13 +1206,363 @@ const unsigned char* CircularBuffer::GetNextImage()
 
 const mm::ImgBuffer* CircularBuffer::GetNextImageBuffer(unsigned channel)
 {
+   MMThreadGuard decodeGuard(decodeLock_);
+   MMThreadGuard spillGuard(spillLock_);
+   long index;
+   bool spilled;
+   {
+      MMThreadGuard guard(g_bufferLock);
+
+      long availableImages = insertIndex_ - saveIndex_;
+      if (availableImages < 1)
+         return 0;
+
+      // Spilled frames are older than the ones in memory
+      index = saveIndex_++;
+      spilled = index < ramIndex_;
+      if (!spilled)
+      {
+         ramIndex_ = saveIndex_;
+         long targetIndex = index % SlotCount();
+         if (!compressionEnabled_)
+            return frameArray_[targetIndex].FindImage(channel);
+
+         // The image is copied out before the lock is released, so it is safe
+         // for its arena space to be reused as soon as saveIndex_ has moved on
+         const mm::ImgBuffer* cached;
+         if (!FetchCompressedImage(targetIndex, channel, cached))
+            return 0;
+         if (cached)
+            return cached;
+      }
+   }
+   if (spilled)
+      return ReadSpilledImage(index, channel);
+   return DecodeFetchedImage();
+}
+
+/**
+* Copies a frame from the spill file into the pool of returned images. Called
+* with decodeLock_ and spillLock_ held; index is the (unread) frame's index.
+*/
+const mm::ImgBuffer* CircularBuffer::ReadSpilledImage(long index,
+      unsigned channel) const
+{
+   unsigned width, height, depth, channels;
+   unsigned long slot;
+   Metadata md;
+   {
+      MMThreadGuard guard(g_bufferLock);
+      if (spillMetadata_.empty() || channel >= numChannels_)
+         return 0;
+      slot = (unsigned long) (index % spillMetadata_.size());
+      width = width_;
+      height = height_;
+      depth = pixDepth_;
+      channels = numChannels_;
+      md = spillMetadata_[slot][channel];
+   }
+
+   const size_t poolIndex = NextPooledImage(width, height, depth,
+         std::max<size_t>(minDecodedImageCount, 2 * channels));
+   mm::ImgBuffer& img = *decodedImages_[poolIndex];
+   const size_t imageBytes = (size_t) width * height * depth;
+   const unsigned char* src = spillFile_->GetData() +
+      ((size_t) slot * channels + channel) * imageBytes;
+   // See the comment on GetPixels() in InsertMultiChannel()
+   memcpy(const_cast<unsigned char*>(img.GetPixels()), src, imageBytes);
+   img.SetMetadata(md);
+   return &img;
+}
+
+/**
+* Moves the oldest in-memory unread frame to the spill file. Called with
+* spillLock_ held. Returns false if there is nothing to move or the spill file
+* is full.
+*/
+bool CircularBuffer::MigrateOldestFrame()
+{
+   long index;
+   unsigned long slot;
+   const mm::FrameBuffer* frame;
+   unsigned channels;
+   size_t imageBytes;
+   {
+      MMThreadGuard guard(g_bufferLock);
+      const unsigned long spillSlots = SpillSlotCount();
+      if (spillSlots == 0 || ramIndex_ >= insertIndex_ ||
+            ramIndex_ - saveIndex_ >= (long) spillSlots)
+         return false;
+      index = ramIndex_;
+      slot = (unsigned long) (index % spillSlots);
+      frame = &frameArray_[index % frameArray_.size()];
+      channels = numChannels_;
+      imageBytes = (size_t) width_ * height_ * pixDepth_;
+   }
+
+   // The slot cannot be reused for insertion while ramIndex_ points to it,
+   // and nobody reads the spill file while we hold spillLock_. If the frame
+   // is read (and its slot reused) while being copied, the copy is discarded.
+   unsigned char* dst = spillFile_->GetData() + (size_t) slot * channels * imageBytes;
+   for (unsigned i = 0; i < channels; ++i)
+   {
+      const mm::ImgBuffer* img = frame->FindImage(i);
+      if (img)
+         memcpy(dst + i * imageBytes, img->GetPixels(), imageBytes);
+   }
+
    MMThreadGuard guard(g_bufferLock);
+   if (ramIndex_ != index)
+      return true;
+   for (unsigned i = 0; i < channels; ++i)
+   {
+      const mm::ImgBuffer* img = frame->FindImage(i);
+      spillMetadata_[slot][i] = img ? img->GetMetadata() : Metadata();
+   }
+   ++ramIndex_;
+   ++framesSpilled_;
+   return true;
+}
 
-   long availableImages = insertIndex_ - saveIndex_;
-   if (availableImages < 1)
-      return 0;
+// Called with g_bufferLock held
+void CircularBuffer::RequestMigration()
+{
+   boost::lock_guard<boost::mutex> lock(spillRequestMutex_);
+   if (spillRequested_)
+      return;
+   spillRequested_ = true;
+   spillRequestCv_.notify_one();
+}
+
+void CircularBuffer::StartSpillThread()
+{
+   {
+      boost::lock_guard<boost::mutex> lock(spillRequestMutex_);
+      spillRequested_ = false;
+      spillThreadStop_ = false;
+   }
+   spillThread_ = boost::make_shared<boost::thread>(
+         boost::bind(&CircularBuffer::SpillThreadFunc, this));
+}
+
+void CircularBuffer::StopSpillThread()
+{
+   if (!spillThread_)
+      return;
+   {
+      boost::lock_guard<boost::mutex> lock(spillRequestMutex_);
+      spillThreadStop_ = true;
+   }
+   spillRequestCv_.notify_one();
+   spillThread_->join();
+   spillThread_.reset();
+}
 
-   long targetIndex = saveIndex_ % frameArray_.size();
-   ++saveIndex_;
-   return frameArray_[targetIndex].FindImage(channel);
+void CircularBuffer::SpillThreadFunc()
+{
+   for (;;)
+   {
+      {
+         boost::unique_lock<boost::mutex> lock(spillRequestMutex_);
+         while (!spillRequested_ && !spillThreadStop_)
+            spillRequestCv_.wait(lock);
+         if (spillThreadStop_)
+            return;
+         spillRequested_ = false;
+      }
+
+      // Move frames one at a time, so that readers and the synchronous
+      // migration in InsertMultiChannel() are not held up for long
+      for (;;)
+      {
+         {
+            boost::lock_guard<boost::mutex> lock(spillRequestMutex_);
+            if (spillThreadStop_)
+               return;
+         }
+         MMThreadGuard spillGuard(spillLock_);
+         {
+            MMThreadGuard guard(g_bufferLock);
+            if (insertIndex_ - ramIndex_ <= (long) (spillLowWater * SlotCount()))
+               break;
+         }
+         if (!MigrateOldestFrame())
+            break;
+      }
+   }
+}
+
+namespace
+{
+
+template <typename T>
+void CopyRegionPixels(const T* src, unsigned srcWidth, const ImageRegion& region,
+      T* dst, unsigned dstWidth)
+{
+   const unsigned outWidth = region.OutputWidth();
+   const unsigned outHeight = region.OutputHeight();
+   const unsigned step = region.step;
+   if (!region.binning || step == 1)
+   {
+      for (unsigned oy = 0; oy < outHeight; ++oy)
+      {
+         const T* row = src + (size_t) (region.y + oy * step) * srcWidth + region.x;
+         T* out = dst + (size_t) oy * dstWidth;
+         if (step == 1)
+            memcpy(out, row, outWidth * sizeof(T));
+         else
+            for (unsigned ox = 0; ox < outWidth; ++ox)
+               out[ox] = row[(size_t) ox * step];
+      }
+      return;
+   }
+
+   const unsigned long area = (unsigned long) step * step;
+   for (unsigned oy = 0; oy < outHeight; ++oy)
+   {
+      T* out = dst + (size_t) oy * dstWidth;
+      for (unsigned ox = 0; ox < outWidth; ++ox)
+      {
+         unsigned long sum = 0;
+         for (unsigned r = 0; r < step; ++r)
+         {
+            const T* p = src + (size_t) (region.y + oy * step + r) * srcWidth +
+               region.x + ox * step;
+            for (unsigned i = 0; i < step; ++i)
+               sum += p[i];
+         }
+         out[ox] = (T) (sum / area);
+      }
+   }
+}
+
+void CopyRegion(const mm::ImgBuffer& img, const ImageRegion& region,
+      unsigned char* dst) throw (CMMError)
+{
+   CopyImageRegion(img.GetPixels(), img.Width(), img.Height(), img.Depth(),
+         region, dst, region.OutputWidth());
+}
+
+} // anonymous namespace
+
+/**
+* Copies a region of an image to dst, whose rows are dstWidth pixels apart.
+* Binning is only done for 8- and 16-bit images.
+*/
+void CopyImageRegion(const unsigned char* src, unsigned srcWidth,
+      unsigned srcHeight, unsigned depth, const ImageRegion& region,
+      unsigned char* dst, unsigned dstWidth) throw (CMMError)
+{
+   if (region.step == 0 || region.OutputWidth() == 0 || region.OutputHeight() == 0 ||
+         region.x + region.width > srcWidth ||
+         region.y + region.height > srcHeight)
+      throw CMMError("Image region is empty or outside the image");
+
+   if (depth == 1)
+      CopyRegionPixels(src, srcWidth, region, dst, dstWidth);
+   else if (depth == 2)
+      CopyRegionPixels(reinterpret_cast<const unsigned short*>(src), srcWidth,
+            region, reinterpret_cast<unsigned short*>(dst), dstWidth);
+   else
+   {
+      if (region.binning && region.step > 1)
+         throw CMMError("Binned regions are only supported for 8- and 16-bit images");
+      for (unsigned oy = 0; oy < region.OutputHeight(); ++oy)
+      {
+         const unsigned char* row = src +
+            ((size_t) (region.y + oy * region.step) * srcWidth + region.x) * depth;
+         unsigned char* out = dst + (size_t) oy * dstWidth * depth;
+         for (unsigned ox = 0; ox < region.OutputWidth(); ++ox)
+            memcpy(out + (size_t) ox * depth, row + (size_t) ox * region.step * depth, depth);
+      }
+   }
+}
+
+/**
+* Copies a region of the n-th image from the top (0 being the most recent)
+* into dst, which must hold region.OutputWidth() * region.OutputHeight()
+* pixels. Only the region is read from an uncompressed in-memory frame.
+* Returns false if there is no such image.
+*/
+bool CircularBuffer::CopyNthFromTopRegion(long n, unsigned channel,
+      const ImageRegion& region, unsigned char* dst, Metadata* md) const throw (CMMError)
+{
+   MMThreadGuard decodeGuard(decodeLock_);
+   const mm::ImgBuffer* img = GetNthFromTopImageBuffer(n, channel);
+   if (!img)
+      return false;
+   CopyRegion(*img, region, dst);
+   if (md)
+      *md = img->GetMetadata();
+   return true;
+}
+
+/**
+* Adds (or replaces) a cursor that reads the given region of each frame
+* inserted from now on.
+*/
+void CircularBuffer::AddRegionCursor(long id, unsigned channel,
+      const ImageRegion& region)
+{
+   MMThreadGuard guard(g_bufferLock);
+   RegionCursor& cursor = regionCursors_[id];
+   cursor.channel = channel;
+   cursor.region = region;
+   cursor.nextIndex = insertIndex_;
+}
+
+void CircularBuffer::RemoveRegionCursor(long id)
+{
+   MMThreadGuard guard(g_bufferLock);
+   regionCursors_.erase(id);
+}
+
+/**
+* Copies the region of the next frame for the given cursor into dst and
+* advances the cursor. Frames read by GetNextImageBuffer() before the cursor
+* got to them are skipped; their number is returned in skipped. Returns false
+* if there is no new frame (or no such cursor).
+*/
+bool CircularBuffer::ReadNextRegion(long id, unsigned char* dst, Metadata* md,
+      unsigned long& skipped) throw (CMMError)
+{
+   skipped = 0;
+   MMThreadGuard decodeGuard(decodeLock_);
+   MMThreadGuard spillGuard(spillLock_);
+   long index;
+   unsigned channel;
+   ImageRegion region;
+   {
+      MMThreadGuard guard(g_bufferLock);
+      std::map<long, RegionCursor>::iterator it = regionCursors_.find(id);
+      if (it == regionCursors_.end())
+         return false;
+      RegionCursor& cursor = it->second;
+      if (cursor.nextIndex < saveIndex_)
+      {
+         skipped = (unsigned long) (saveIndex_ - cursor.nextIndex);
+         cursor.nextIndex = saveIndex_;
+      }
+      if (cursor.nextIndex >= insertIndex_)
+         return false;
+      index = cursor.nextIndex++;
+      channel = cursor.channel;
+      region = cursor.region;
+   }
+
+   const mm::ImgBuffer* img = GetImageAtIndex(index, channel);
+   if (!img)
+      return false;
+   CopyRegion(*img, region, dst);
+   if (md)
+      *md = img->GetMetadata();
+   return true;
+}
+
+// Called with g_bufferLock held, when the frame indices are reset
+void CircularBuffer::ResetRegionCursors()
+{
+   for (std::map<long, RegionCursor>::iterator it = regionCursors_.begin();
+         it != regionCursors_.end(); ++it)
+      it->second.nextIndex = 0;
 }
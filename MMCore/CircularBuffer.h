@@ -26,14 +26,19 @@
 
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "FrameAccounting.h"
 #include "FrameBuffer.h"
+#include "TaskSet_ImageStats.h"
 
 #include "../MMDevice/DeviceThreads.h"
 #include "../MMDevice/MMDevice.h"
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
+#include <map>
+#include <string>
 #include <vector>
 
 #ifdef _MSC_VER
@@ -42,7 +47,30 @@
 
 
 class ThreadPool;
+class TaskSet_CompressFrame;
 class TaskSet_CopyMemory;
+namespace mm { class SpillFile; }
+
+// A rectangular region of an image, optionally reduced by an integer factor
+// (step) in each dimension by subsampling or by averaging (binning)
+struct ImageRegion
+{
+   unsigned x;
+   unsigned y;
+   unsigned width;
+   unsigned height;
+   unsigned step;
+   bool binning;
+
+   ImageRegion() : x(0), y(0), width(0), height(0), step(1), binning(false) {}
+
+   unsigned OutputWidth() const { return step ? width / step : 0; }
+   unsigned OutputHeight() const { return step ? height / step : 0; }
+};
+
+void CopyImageRegion(const unsigned char* src, unsigned srcWidth,
+      unsigned srcHeight, unsigned depth, const ImageRegion& region,
+      unsigned char* dst, unsigned dstWidth) throw (CMMError);
 
 class CircularBuffer
 {
@@ -68,28 +96,114 @@ public:
    const unsigned char* GetTopImage() const;
    const unsigned char* GetNextImage();
    const mm::ImgBuffer* GetTopImageBuffer(unsigned channel) const;
+   const mm::ImgBuffer* GetTopImageBuffer(unsigned channel,
+         mm::ImgBuffer& scratch) const;
    const mm::ImgBuffer* GetNthFromTopImageBuffer(unsigned long n) const;
    const mm::ImgBuffer* GetNthFromTopImageBuffer(long n, unsigned channel) const;
    const mm::ImgBuffer* GetNextImageBuffer(unsigned channel);
    void Clear(); 
+   void ClearAfterOverflow();
 
    bool Overflow() {MMThreadGuard guard(g_bufferLock); return overflow_;}
+   // Total number of frames inserted since construction
+   long GetImageCounter() const {MMThreadGuard guard(g_bufferLock); return imageCounter_;}
+   // Dropped and late frame totals per camera since the last Initialize()
+   FrameCounts GetFrameCounts(const std::string& camera) const {return frameAccounting_.GetCounts(camera);}
+   // Counts a frame that was streamed to disk without being inserted
+   void AccountForBypassedFrame(const Metadata* pMd);
+
+   void SetCompressionEnabled(bool enable);
+   bool IsCompressionEnabled() const {MMThreadGuard guard(g_bufferLock); return compressionEnabled_;}
+   double GetCompressionRatio() const;
+   double GetCompressionTimePerFrameUs() const;
+
+   bool CopyNthFromTopRegion(long n, unsigned channel, const ImageRegion& region,
+         unsigned char* dst, Metadata* md) const throw (CMMError);
+   void AddRegionCursor(long id, unsigned channel, const ImageRegion& region);
+   void RemoveRegionCursor(long id);
+   bool ReadNextRegion(long id, unsigned char* dst, Metadata* md,
+         unsigned long& skipped) throw (CMMError);
+
+   void SetDemuxRegions(const std::vector<ImageRegion>& regions,
+         unsigned originX, unsigned originY);
+   std::vector<ImageRegion> GetDemuxRegions() const;
+   bool GetDemuxImageSize(unsigned& width, unsigned& height,
+         unsigned& count) const;
+   bool IsDemuxActive() const {MMThreadGuard guard(g_bufferLock); return demuxActive_;}
+
+   void SetStatisticsEnabled(bool enable, unsigned histogramBins);
+   bool IsStatisticsEnabled() const {MMThreadGuard guard(g_bufferLock); return statsBins_ > 0;}
+   unsigned GetStatisticsHistogramBins() const {MMThreadGuard guard(g_bufferLock); return statsBins_;}
+   bool GetNthFromTopImageStatistics(long n, unsigned channel, ImageStatistics& stats) const;
+
+   void SetSpillFile(const std::string& path, unsigned sizeMB) throw (CMMError);
+   std::string GetSpillFilePath() const;
+   unsigned GetSpillFileSizeMB() const;
+   unsigned long GetSpilledImageCount() const;
 
    mutable MMThreadLock g_bufferLock;
    mutable MMThreadLock g_insertLock;
 
 private:
+   // In compressed mode each slot holds, per channel, the location of the
+   // encoded image in arena_ together with its metadata.
+   struct CompressedImage
+   {
+      size_t offset;
+      size_t bytes;
+      unsigned long long serial;
+      Metadata metadata;
+
+      CompressedImage() : offset(0), bytes(0), serial(0) {}
+   };
+
+   long SlotCount() const;
+   unsigned long EstimateFrameCount(size_t bytes) const;
+   bool InsertCompressedChannel(const unsigned char* pixels, unsigned channel,
+         const Metadata& md, size_t& frameOffset);
+   bool ReserveArena(size_t bytes, size_t tail, size_t& offset);
+   bool FetchCompressedImage(long slot, unsigned channel,
+         const mm::ImgBuffer*& cached) const;
+   const mm::ImgBuffer* DecodeFetchedImage() const;
+   bool InsertFrame(const unsigned char* pixArray, unsigned numChannels,
+         unsigned width, unsigned height, unsigned byteDepth,
+         unsigned nComponents, const Metadata* pMd, bool demuxed) throw (CMMError);
+   bool InsertDemuxed(const unsigned char* pixArray, unsigned byteDepth,
+         unsigned nComponents, const Metadata* pMd) throw (CMMError);
+   const mm::ImgBuffer* GetImageAtIndex(long index, unsigned channel) const;
+   void ResetRegionCursors();
+   size_t NextPooledImage(unsigned width, unsigned height, unsigned depth,
+         size_t poolSize) const;
+
+   unsigned long SpillSlotCount() const;
+   void AllocateSpillSlots();
+   void AllocateStatistics();
+   void ComputeStatistics(const unsigned char* pixels, Metadata& md);
+   void StoreStatistics(unsigned channel);
+   const mm::ImgBuffer* ReadSpilledImage(long index, unsigned channel) const;
+   bool MigrateOldestFrame();
+   void RequestMigration();
+   void StartSpillThread();
+   void StopSpillThread();
+   void SpillThreadFunc();
+   std::string GetFrameCamera(long index) const;
+
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
    long imageCounter_;
    MM::MMTime startTime_;
    std::map<std::string, long> imageNumbers_;
+   FrameAccounting frameAccounting_;
 
    // Invariants:
-   // 0 <= saveIndex_ <= insertIndex_
-   // insertIndex_ - saveIndex_ <= frameArray_.size()
+   // 0 <= saveIndex_ <= ramIndex_ <= insertIndex_
+   // insertIndex_ - ramIndex_ <= frameArray_.size()
+   // ramIndex_ - saveIndex_ <= SpillSlotCount()
+   // Unread frames [saveIndex_, ramIndex_) have been moved to the spill file;
+   // frames [ramIndex_, insertIndex_) are in memory.
    long insertIndex_;
+   long ramIndex_;
    long saveIndex_;
 
    unsigned long memorySizeMB_;
@@ -100,6 +214,83 @@ private:
    boost::shared_ptr<ThreadPool> threadPool_;
    boost::shared_ptr<TaskSet_CopyMemory> tasksMemCopy_;
 
+   // Compressed mode. The arena is a byte ring holding the encoded images of
+   // unread frames in insertion order.
+   bool compressionEnabled_;
+   boost::shared_ptr<TaskSet_CompressFrame> tasksCompress_;
+   std::vector<unsigned char> arena_;
+   size_t arenaHead_;
+   std::vector< std::vector<CompressedImage> > compressedArray_;
+   unsigned long long nextSerial_;
+   unsigned long long framesCompressed_; // Counts each channel separately
+   unsigned long long rawBytesCompressed_;
+   unsigned long long compressedBytes_;
+   double compressionTimeUs_;
+
+   // Per-frame statistics, computed on insertion when statsBins_ > 0. Tags
+   // with the scalar statistics are added to the image metadata; the full
+   // statistics are kept per slot and channel while the frame is in memory.
+   boost::shared_ptr<TaskSet_ImageStats> tasksStats_;
+   unsigned statsBins_;
+   std::vector< std::vector<ImageStatistics> > statsArray_;
+   ImageStatistics statsScratch_; // Used with g_insertLock held
+
+   // Multi-ROI demultiplexing. If regions are set, single-channel frames of
+   // demuxSourceWidth_ x demuxSourceHeight_ (the bounding box of the ROIs)
+   // are split on insertion into one channel per region, each of the
+   // largest region's size. Regions are relative to the bounding box, whose
+   // position on the sensor is demuxOriginX_, demuxOriginY_.
+   std::vector<ImageRegion> demuxRegions_;
+   unsigned demuxOriginX_;
+   unsigned demuxOriginY_;
+   bool demuxActive_; // Set by Initialize()
+   unsigned demuxSourceWidth_;
+   unsigned demuxSourceHeight_;
+   std::vector<unsigned char> demuxScratch_; // Used with g_insertLock held
+
+   // Region cursors read a region of each new frame, independently of (and
+   // without consuming) the frames read by GetNextImageBuffer()
+   struct RegionCursor
+   {
+      unsigned channel;
+      ImageRegion region;
+      long nextIndex;
+   };
+   std::map<long, RegionCursor> regionCursors_;
+
+   // Images are decoded on retrieval into a small rotating set of buffers,
+   // so that returned pointers stay valid until several more retrievals
+   // have been made. The most recently decoded images are reused when the
+   // same image is requested again (e.g. by repeated GetTopImage() calls).
+   mutable MMThreadLock decodeLock_;
+   mutable std::vector< boost::shared_ptr<mm::ImgBuffer> > decodedImages_;
+   mutable std::vector<unsigned long long> decodedSerials_;
+   mutable size_t nextDecoded_;
+   // Copy of the image being decoded, taken under g_bufferLock so that
+   // decoding does not hold up insertion
+   mutable std::vector<unsigned char> fetchedData_;
+   mutable CompressedImage fetchedImage_;
+   mutable unsigned fetchedWidth_;
+   mutable unsigned fetchedHeight_;
+   mutable unsigned fetchedDepth_;
+   mutable size_t fetchedPoolSize_;
+
+   // Spill tier (uncompressed mode only). When the in-memory frames exceed a
+   // high-water mark, a background thread moves the oldest unread frames to
+   // a memory-mapped file, from which they are read back in order.
+   // Lock order: decodeLock_, spillLock_, g_bufferLock. The spill thread
+   // holds spillLock_ while copying a frame, so readers never see a spill
+   // slot that is being written.
+   mutable MMThreadLock spillLock_;
+   boost::shared_ptr<mm::SpillFile> spillFile_;
+   std::vector< std::vector<Metadata> > spillMetadata_;
+   unsigned long long framesSpilled_;
+   boost::shared_ptr<boost::thread> spillThread_;
+   boost::mutex spillRequestMutex_;
+   boost::condition_variable spillRequestCv_;
+   bool spillRequested_;
+   bool spillThreadStop_;
+
    boost::posix_time::time_facet * facet;
    std::ostringstream tStream;
 };
@@ -27,7 +27,11 @@
 
 #include "Configuration.h"
 #include "Error.h"
+
+#include <boost/thread/mutex.hpp>
+
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -167,6 +171,7 @@ public:
    void Define(const char* groupName, const char* configName)
    {
       groups_[groupName].Define(configName);
+      DropTransitions(groupName);
    }
 
    /**
@@ -175,6 +180,7 @@ public:
    void Define(const char* groupName, const char* configName, const char* deviceLabel, const char* propName, const char* value)
    {
       groups_[groupName].Define(configName, deviceLabel, propName, value);
+      DropTransitions(groupName);
    }
 
    /**
@@ -232,6 +238,7 @@ public:
             return false; // group not found
          if (it->second.Rename(oldConfigName, newConfigName))
          {
+            DropTransitions(groupName);
             // NOTE: changed to not remove empty groups, N.A. 1.31.2006
             // check if the config group is empty, and if so remove it
             //if (it->second.IsEmpty())
@@ -259,6 +266,7 @@ public:
          return false; // group not found
       if (it->second.Delete(configName, deviceLabel, propName))
       {
+         DropTransitions(groupName);
          return true;
       }
       else
@@ -280,6 +288,7 @@ public:
          return false; // group not found
       if (it->second.Delete(configName))
       {
+         DropTransitions(groupName);
          // NOTE: changed to not remove empty groups, N.A. 1.31.2006
          // check if the config group is empty, and if so remove it
          //if (it->second.IsEmpty())
@@ -303,6 +312,7 @@ public:
       if (it != groups_.end())
       {
          groups_.erase(it->first);
+         DropTransitions(groupName);
          return true;
       }
       return false; //not found
@@ -324,6 +334,8 @@ public:
          {
             groups_[newGroupName] = it->second;
             groups_.erase(it->first);
+            DropTransitions(oldGroupName);
+            DropTransitions(newGroupName);
             return true;
          }
          return false; //not found
@@ -366,11 +378,97 @@ public:
    void Clear()
    {
       groups_.clear();
+      boost::mutex::scoped_lock lock(transitionsMutex_);
+      transitions_.clear();
    }
 
+   /**
+    * Gets the settings that must be applied to switch a group from preset
+    * fromConfig to preset toConfig: the settings of toConfig that are not in
+    * fromConfig or have a different value there. Returns false if the group
+    * or either preset does not exist.
+    *
+    * The transitions between all pairs of presets of a group are computed
+    * together, at the first call after the group was defined or changed.
+    * Calls may come from several threads at once (setConfig() does not
+    * otherwise modify the collection).
+    */
+   bool FindTransition(const char* groupName, const char* fromConfig,
+         const char* toConfig, Configuration& transition)
+   {
+      boost::mutex::scoped_lock lock(transitionsMutex_);
+      std::map<std::string, TransitionTable>::iterator table =
+         transitions_.find(groupName);
+      if (table == transitions_.end())
+      {
+         if (!PlanTransitions(groupName))
+            return false;
+         table = transitions_.find(groupName);
+      }
+      TransitionTable::const_iterator it =
+         table->second.find(std::make_pair(std::string(fromConfig), std::string(toConfig)));
+      if (it == table->second.end())
+         return false;
+      transition = it->second;
+      return true;
+   }
+
+   /**
+    * Computes the transitions of all groups that do not have them yet.
+    */
+   void PlanTransitions()
+   {
+      boost::mutex::scoped_lock lock(transitionsMutex_);
+      for (std::map<std::string, ConfigGroup>::const_iterator it = groups_.begin();
+            it != groups_.end(); ++it)
+      {
+         if (transitions_.find(it->first) == transitions_.end())
+            PlanTransitions(it->first.c_str());
+      }
+   }
 
 private:
+   // Transition settings keyed by (from, to) preset names
+   typedef std::map<std::pair<std::string, std::string>, Configuration> TransitionTable;
+
+   void DropTransitions(const std::string& groupName)
+   {
+      boost::mutex::scoped_lock lock(transitionsMutex_);
+      transitions_.erase(groupName);
+   }
+
+   // Requires transitionsMutex_
+   bool PlanTransitions(const char* groupName)
+   {
+      std::map<std::string, ConfigGroup>::iterator group = groups_.find(groupName);
+      if (group == groups_.end())
+         return false;
+
+      TransitionTable& table = transitions_[groupName];
+      table.clear();
+      std::vector<std::string> configs = group->second.GetAvailable();
+      for (size_t from = 0; from < configs.size(); ++from)
+      {
+         Configuration* pFrom = group->second.Find(configs[from].c_str());
+         for (size_t to = 0; to < configs.size(); ++to)
+         {
+            Configuration* pTo = group->second.Find(configs[to].c_str());
+            Configuration& transition = table[std::make_pair(configs[from], configs[to])];
+            for (size_t i = 0; i < pTo->size(); ++i)
+            {
+               PropertySetting setting = pTo->getSetting(i);
+               if (!pFrom->isSettingIncluded(setting))
+                  transition.addSetting(setting);
+            }
+         }
+      }
+      return true;
+   }
+
    std::map<std::string, ConfigGroup> groups_;
+   // Guards transitions_, which setConfig() fills in lazily
+   boost::mutex transitionsMutex_;
+   std::map<std::string, TransitionTable> transitions_;
 };
 
 /**
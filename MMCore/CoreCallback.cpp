@@ -31,6 +31,9 @@
 #include "CircularBuffer.h"
 #include "CoreCallback.h"
 #include "DeviceManager.h"
+#include "DiskStream.h"
+#include "TriggerLatency.h"
+#include "WorkerThreadBudget.h"
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <string>
@@ -56,6 +59,11 @@ int
 CoreCallback::LogMessage(const MM::Device* caller, const char* msg,
       bool debugOnly) const
 {
+   // Skip the device lookup when the entry would be discarded anyway
+   if (debugOnly &&
+         !core_->coreLogger_.IsLevelEnabled(mm::logging::LogLevelDebug))
+      return DEVICE_OK;
+
    boost::shared_ptr<DeviceInstance> device;
    try
    {
@@ -205,7 +213,8 @@ CoreCallback::Sleep(const MM::Device*, double intervalMs)
 
 /**
  * Get the metadata tags attached to device caller, and merge them with metadata
- * in pMd (if not null). Returns a metadata object.
+ * in pMd (if not null), adding the trigger latency of burst frames. Returns a
+ * metadata object.
  */
 Metadata
 CoreCallback::AddCameraMetadata(const MM::Device* caller, const Metadata* pMd)
@@ -222,6 +231,7 @@ CoreCallback::AddCameraMetadata(const MM::Device* caller, const Metadata* pMd)
 
    std::string label = camera->GetLabel();
    newMD.put("Camera", label);
+   core_->triggerLatency_->FrameReceived(label, GetMMTimeNow().getMsec(), newMD);
 
    std::string serializedMD;
    try
@@ -261,6 +271,15 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
             ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
          }
       }
+      int ret = StreamToDisk(caller, buf, width, height, byteDepth, 1);
+      if (ret != DEVICE_OK)
+         return ret;
+      if (!core_->diskStream_->KeepsImagesInBuffer())
+      {
+         core_->cbuf_->AccountForBypassedFrame(&md);
+         return DEVICE_OK;
+      }
+
       if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, &md))
          return DEVICE_OK;
       else
@@ -293,6 +312,15 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
             ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
          }
       }
+      int ret = StreamToDisk(caller, buf, width, height, byteDepth, nComponents);
+      if (ret != DEVICE_OK)
+         return ret;
+      if (!core_->diskStream_->KeepsImagesInBuffer())
+      {
+         core_->cbuf_->AccountForBypassedFrame(&md);
+         return DEVICE_OK;
+      }
+
       if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, nComponents, &md))
          return DEVICE_OK;
       else
@@ -304,6 +332,31 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
    }
 }
 
+/**
+ * Writes the image to the camera's raw files if streaming to disk is enabled.
+ * Frames not kept in the buffer must still be passed to the buffer's frame
+ * accounting (CircularBuffer::AccountForBypassedFrame()).
+ */
+int CoreCallback::StreamToDisk(const MM::Device* caller,
+      const unsigned char* buf, unsigned width, unsigned height,
+      unsigned byteDepth, unsigned nComponents)
+{
+   if (!core_->diskStream_->IsEnabled())
+      return DEVICE_OK;
+
+   char label[MM::MaxStrLength];
+   caller->GetLabel(label);
+   std::string errorText;
+   if (!core_->diskStream_->Write(label, buf, width, height, byteDepth,
+            nComponents, errorText))
+   {
+      LOG_ERROR(core_->coreLogger_) << "Streaming to disk failed for " <<
+         label << ": " << errorText;
+      return DEVICE_ERR;
+   }
+   return DEVICE_OK;
+}
+
 int CoreCallback::InsertImage(const MM::Device* caller, const ImgBuffer & imgBuf)
 {
    Metadata md = imgBuf.GetMetadata();
@@ -320,7 +373,7 @@ int CoreCallback::InsertImage(const MM::Device* caller, const ImgBuffer & imgBuf
 
 void CoreCallback::ClearImageBuffer(const MM::Device* /*caller*/)
 {
-   core_->cbuf_->Clear();
+   core_->cbuf_->ClearAfterOverflow();
 }
 
 bool CoreCallback::InitializeImageBuffer(unsigned channels, unsigned slices,
@@ -350,6 +403,23 @@ int CoreCallback::InsertMultiChannel(const MM::Device* caller,
       {
          ip->Process( const_cast<unsigned char*>(buf), width, height, byteDepth);
       }
+
+      // Each channel is streamed as a frame of its own
+      const std::size_t channelBytes =
+         static_cast<std::size_t>(width) * height * byteDepth;
+      for (unsigned i = 0; i < numChannels; ++i)
+      {
+         int ret = StreamToDisk(caller, buf + i * channelBytes, width, height,
+               byteDepth, 1);
+         if (ret != DEVICE_OK)
+            return ret;
+      }
+      if (!core_->diskStream_->KeepsImagesInBuffer())
+      {
+         core_->cbuf_->AccountForBypassedFrame(&md);
+         return DEVICE_OK;
+      }
+
       if (core_->cbuf_->InsertMultiChannel(buf, numChannels, width, height, byteDepth, &md))
          return DEVICE_OK;
       else
@@ -376,6 +446,13 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
       return DEVICE_ERR;
    }
 
+   std::string streamError;
+   if (!core_->diskStream_->Finish(camera->GetLabel(), streamError))
+   {
+      LOG_ERROR(core_->coreLogger_) << "Streaming to disk failed for " <<
+         camera->GetLabel() << ": " << streamError;
+   }
+
    boost::shared_ptr<DeviceInstance> currentCamera =
       core_->currentCameraDevice_.lock();
 
@@ -680,12 +757,11 @@ int CoreCallback::SetSerialProperties(const char* portName,
    return DEVICE_OK;
 }
 
-/**
- * Sends an array of bytes to the port.
- */
-int CoreCallback::WriteToSerial(const MM::Device* caller, const char* portName, const unsigned char* buf, unsigned long length)
+// Looks up a serial port for a device that uses it. Returns an error code
+// if there is no such port or the device is the port itself.
+int CoreCallback::GetSerialPort(const MM::Device* caller, const char* portName,
+      boost::shared_ptr<SerialInstance>& pSerial)
 {
-   boost::shared_ptr<SerialInstance> pSerial;
    try
    {
       pSerial = core_->deviceManager_->GetDeviceOfType<SerialInstance>(portName);
@@ -702,6 +778,18 @@ int CoreCallback::WriteToSerial(const MM::Device* caller, const char* portName,
    // don't allow self reference
    if (pSerial->GetRawPtr() == caller)
       return DEVICE_SELF_REFERENCE;
+   return DEVICE_OK;
+}
+
+/**
+ * Sends an array of bytes to the port.
+ */
+int CoreCallback::WriteToSerial(const MM::Device* caller, const char* portName, const unsigned char* buf, unsigned long length)
+{
+   boost::shared_ptr<SerialInstance> pSerial;
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
 
    return pSerial->Write(buf, length);
 }
@@ -712,22 +800,9 @@ int CoreCallback::WriteToSerial(const MM::Device* caller, const char* portName,
 int CoreCallback::ReadFromSerial(const MM::Device* caller, const char* portName, unsigned char* buf, unsigned long bufLength, unsigned long &bytesRead)
 {
    boost::shared_ptr<SerialInstance> pSerial;
-   try
-   {
-      pSerial = core_->deviceManager_->GetDeviceOfType<SerialInstance>(portName);
-   }
-   catch (CMMError& err)
-   {
-      return err.getCode();    
-   }
-   catch (...)
-   {
-      return DEVICE_SERIAL_COMMAND_FAILED;
-   }
-
-   // don't allow self reference
-   if (pSerial->GetRawPtr() == caller)
-      return DEVICE_SELF_REFERENCE;
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
 
    return pSerial->Read(buf, bufLength, bytesRead);
 }
@@ -738,24 +813,90 @@ int CoreCallback::ReadFromSerial(const MM::Device* caller, const char* portName,
 int CoreCallback::PurgeSerial(const MM::Device* caller, const char* portName)
 {
    boost::shared_ptr<SerialInstance> pSerial;
-   try
-   {
-      pSerial = core_->deviceManager_->GetDeviceOfType<SerialInstance>(portName);
-   }
-   catch (CMMError& err)
-   {
-      return err.getCode();    
-   }
-   catch (...)
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   return pSerial->Purge();
+}
+
+/**
+ * Waits until data can be read from the port, without polling.
+ */
+int CoreCallback::WaitForSerialData(const MM::Device* caller, const char* portName, unsigned long timeoutMs, bool& dataAvailable)
+{
+   boost::shared_ptr<SerialInstance> pSerial;
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   return pSerial->WaitForData(timeoutMs, dataAvailable);
+}
+
+/**
+ * Reads a fixed number of bytes from the port, sleeping until more data
+ * arrives rather than polling.
+ */
+int CoreCallback::ReadExactlyFromSerial(const MM::Device* caller, const char* portName, unsigned char* buf, unsigned long length, unsigned long timeoutMs, unsigned long& bytesRead)
+{
+   bytesRead = 0;
+
+   boost::shared_ptr<SerialInstance> pSerial;
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   // Monotonic, so that a step of the system clock does not shift the deadline
+   const MM::MMTime deadline = GetMMTimeNow() +
+      MM::MMTime(1000.0 * timeoutMs);
+   for (;;)
    {
-      return DEVICE_SERIAL_COMMAND_FAILED;
+      unsigned long read = 0;
+      ret = pSerial->Read(buf + bytesRead, length - bytesRead, read);
+      if (ret != DEVICE_OK)
+         return ret;
+      bytesRead += read;
+      if (bytesRead >= length)
+         return DEVICE_OK;
+
+      const long remainingMs =
+         static_cast<long>((deadline - GetMMTimeNow()).getMsec());
+      if (remainingMs <= 0)
+         return DEVICE_SERIAL_TIMEOUT;
+
+      bool dataAvailable;
+      ret = pSerial->WaitForData(remainingMs, dataAvailable);
+      if (ret == DEVICE_UNSUPPORTED_COMMAND)
+         CDeviceUtils::SleepMs(1); // Port cannot wait; poll every millisecond
+      else if (ret != DEVICE_OK)
+         return ret;
    }
+}
 
-   // don't allow self reference
-   if (pSerial->GetRawPtr() == caller)
-      return DEVICE_SELF_REFERENCE;
+/**
+ * Registers a callback to be invoked when data arrives on the port.
+ */
+int CoreCallback::SubscribeToSerialData(const MM::Device* caller, const char* portName, MM::SerialDataCallback* callback)
+{
+   boost::shared_ptr<SerialInstance> pSerial;
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
 
-   return pSerial->Purge();
+   return pSerial->AddDataCallback(callback);
+}
+
+/**
+ * Unregisters a callback added with SubscribeToSerialData().
+ */
+int CoreCallback::UnsubscribeFromSerialData(const MM::Device* caller, const char* portName, MM::SerialDataCallback* callback)
+{
+   boost::shared_ptr<SerialInstance> pSerial;
+   int ret = GetSerialPort(caller, portName, pSerial);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   return pSerial->RemoveDataCallback(callback);
 }
 
 /**
@@ -1079,3 +1220,8 @@ MM::MMTime CoreCallback::GetCurrentMMTime()
 {		
 	return GetMMTimeNow();
 }
+
+unsigned CoreCallback::GetWorkerThreadBudget(const MM::Device* caller)
+{
+   return core_->workerThreadBudget_->Lease(caller);
+}
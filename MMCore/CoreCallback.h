@@ -74,6 +74,10 @@ public:
    int WriteToSerial(const MM::Device* caller, const char* portName, const unsigned char* buf, unsigned long length);
    int ReadFromSerial(const MM::Device* caller, const char* portName, unsigned char* buf, unsigned long bufLength, unsigned long &bytesRead);
    int PurgeSerial(const MM::Device* caller, const char* portName);
+   int WaitForSerialData(const MM::Device* caller, const char* portName, unsigned long timeoutMs, bool& dataAvailable);
+   int ReadExactlyFromSerial(const MM::Device* caller, const char* portName, unsigned char* buf, unsigned long length, unsigned long timeoutMs, unsigned long& bytesRead);
+   int SubscribeToSerialData(const MM::Device* caller, const char* portName, MM::SerialDataCallback* callback);
+   int UnsubscribeFromSerialData(const MM::Device* caller, const char* portName, MM::SerialDataCallback* callback);
    int SetSerialCommand(const MM::Device*, const char* portName, const char* command, const char* term);
    int GetSerialAnswer(const MM::Device*, const char* portName, unsigned long ansLength, char* answerTxt, const char* term);
 
@@ -82,6 +86,8 @@ public:
 	// MMTime, in epoch beginning at 2000 01 01
    MM::MMTime GetCurrentMMTime();
 
+   unsigned GetWorkerThreadBudget(const MM::Device* caller);
+
    void Sleep(const MM::Device* caller, double intervalMs);
 
    // continuous acquisition support
@@ -143,6 +149,11 @@ private:
    MMThreadLock* pValueChangeLock_;
 
    Metadata AddCameraMetadata(const MM::Device* caller, const Metadata* pMd);
+   int GetSerialPort(const MM::Device* caller, const char* portName,
+         boost::shared_ptr<SerialInstance>& pSerial);
+   int StreamToDisk(const MM::Device* caller, const unsigned char* buf,
+         unsigned width, unsigned height, unsigned byteDepth,
+         unsigned nComponents);
 
    int OnConfigGroupChanged(const char* groupName, const char* newConfigName);
    int OnPixelSizeChanged(double newPixelSizeUm);
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          CoreClock.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Monotonic clock for image timestamps and device timing
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "CoreClock.h"
+
+#include <boost/date_time/gregorian/gregorian_types.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <chrono>
+
+namespace mm {
+
+namespace {
+
+long long SteadyNowUs()
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Microseconds to add to the steady clock to get the time since the epoch
+long long AnchorOffsetUs()
+{
+   // Initialized once, thread-safely, at first use
+   static const long long offset =
+      (boost::posix_time::microsec_clock::local_time() -
+       CoreClock::Epoch()).total_microseconds() - SteadyNowUs();
+   return offset;
+}
+
+} // anonymous namespace
+
+MM::MMTime CoreClock::Now()
+{
+   const long long offset = AnchorOffsetUs();
+   const long long us = SteadyNowUs() + offset;
+   return MM::MMTime(static_cast<long>(us / 1000000),
+         static_cast<long>(us % 1000000));
+}
+
+boost::posix_time::ptime CoreClock::ToPosixTime(const MM::MMTime& time)
+{
+   return Epoch() + boost::posix_time::seconds(time.sec_) +
+      boost::posix_time::microseconds(time.uSec_);
+}
+
+boost::posix_time::ptime CoreClock::Epoch()
+{
+   return boost::posix_time::ptime(boost::gregorian::date(2000, 1, 1));
+}
+
+} // namespace mm
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          CoreClock.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Monotonic clock for image timestamps and device timing
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/MMDevice.h"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace mm {
+
+/**
+ * The clock of MM::MMTime values handed out by the Core: microseconds since
+ * 2000-01-01 local time, as read from the wall clock once at first use and
+ * advanced from then on by a monotonic clock.
+ *
+ * Intervals between readings are therefore never negative and unaffected by
+ * adjustments of the system time (e.g. by NTP), at the cost of drifting
+ * from the wall clock by whatever adjustments occur while the process runs.
+ * Reading the clock does not involve time zone conversion.
+ */
+class CoreClock
+{
+public:
+   static MM::MMTime Now();
+
+   // Wall time of a value returned by Now()
+   static boost::posix_time::ptime ToPosixTime(const MM::MMTime& time);
+
+   // The time, 2000-01-01 local time, at which MM::MMTime values are zero
+   static boost::posix_time::ptime Epoch();
+};
+
+} // namespace mm
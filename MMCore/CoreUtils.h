@@ -26,6 +26,7 @@
 #pragma once
 
 #include "../MMDevice/MMDevice.h"
+#include "CoreClock.h"
 
 // suppress hideous boost warnings
 #ifdef WIN32
@@ -105,9 +106,9 @@ inline MM::MMTime GetMMTimeNow(boost::posix_time::ptime t0)
    return MM::MMTime( (double) diff.total_microseconds());
 }
 
-//NB we are starting the 'epoch' on 2000 01 01
+// Monotonic; see mm::CoreClock
 inline MM::MMTime GetMMTimeNow()
 {
-   return GetMMTimeNow(boost::posix_time::microsec_clock::local_time());
+   return mm::CoreClock::Now();
 }
 
@@ -0,0 +1,321 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DetectionCache.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Persisted results of device detection, and grouping of
+//                detections that can run in parallel.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DetectionCache.h"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace mm {
+
+namespace {
+
+const char* const fileHeader = "# Micro-Manager device detection cache, version 1";
+
+std::vector<std::string> SplitTabs(const std::string& line)
+{
+   std::vector<std::string> fields;
+   std::string::size_type start = 0;
+   for (;;)
+   {
+      const std::string::size_type tab = line.find('\t', start);
+      fields.push_back(line.substr(start, tab == std::string::npos ?
+               std::string::npos : tab - start));
+      if (tab == std::string::npos)
+         return fields;
+      start = tab + 1;
+   }
+}
+
+} // anonymous namespace
+
+DetectionCache::DetectionCache()
+{
+}
+
+bool DetectionCache::Open(const std::string& path, std::string& errorText)
+{
+   EntryMap entries;
+   std::ifstream file(path.c_str());
+   if (file.is_open())
+   {
+      // One line per entry: module, device, port, fingerprint, status, then
+      // name and value of each port setting, separated by tabs
+      std::string line;
+      while (std::getline(file, line))
+      {
+         if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+         if (line.empty() || line[0] == '#')
+            continue;
+         const std::vector<std::string> fields = SplitTabs(line);
+         if (fields.size() < 5 || fields.size() % 2 != 1)
+            continue;
+         DetectionCacheEntry entry;
+         entry.fingerprint = Unescape(fields[3]);
+         try
+         {
+            entry.status = static_cast<MM::DeviceDetectionStatus>(
+                  boost::lexical_cast<int>(fields[4]));
+         }
+         catch (const boost::bad_lexical_cast&)
+         {
+            continue;
+         }
+         for (size_t i = 5; i + 1 < fields.size(); i += 2)
+            entry.portSettings.push_back(std::make_pair(
+                     Unescape(fields[i]), Unescape(fields[i + 1])));
+         entries[Key(Unescape(fields[0]), Unescape(fields[1]),
+               Unescape(fields[2]))] = entry;
+      }
+      if (file.bad())
+      {
+         errorText = "Cannot read device detection cache '" + path + "'";
+         return false;
+      }
+   }
+
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   path_ = path;
+   entries_.swap(entries);
+   return true;
+}
+
+void DetectionCache::Close()
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   path_.clear();
+   entries_.clear();
+}
+
+bool DetectionCache::IsOpen() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   return !path_.empty();
+}
+
+bool DetectionCache::Lookup(const std::string& module,
+      const std::string& device, const std::string& port,
+      const std::string& fingerprint, DetectionCacheEntry& entry) const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   if (path_.empty())
+      return false;
+   EntryMap::const_iterator it = entries_.find(Key(module, device, port));
+   // Files written by earlier versions may hold other results
+   if (it == entries_.end() || it->second.fingerprint != fingerprint ||
+         it->second.status != MM::CanCommunicate)
+      return false;
+   entry = it->second;
+   return true;
+}
+
+bool DetectionCache::Store(const std::string& module,
+      const std::string& device, const std::string& port,
+      const DetectionCacheEntry& entry, std::string& errorText)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   if (path_.empty())
+      return true;
+   const std::string key = Key(module, device, port);
+   if (entry.status == MM::CanCommunicate)
+      entries_[key] = entry;
+   else if (entries_.erase(key) == 0)
+      return true;
+   return Save(errorText);
+}
+
+bool DetectionCache::Clear(std::string& errorText)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   entries_.clear();
+   if (path_.empty())
+      return true;
+   return Save(errorText);
+}
+
+std::string DetectionCache::Escape(const std::string& field)
+{
+   std::string escaped;
+   escaped.reserve(field.size());
+   for (std::string::const_iterator it = field.begin(); it != field.end(); ++it)
+   {
+      switch (*it)
+      {
+         case '\\': escaped += "\\\\"; break;
+         case '\t': escaped += "\\t"; break;
+         case '\n': escaped += "\\n"; break;
+         case '\r': escaped += "\\r"; break;
+         default: escaped += *it; break;
+      }
+   }
+   return escaped;
+}
+
+std::string DetectionCache::Unescape(const std::string& field)
+{
+   std::string unescaped;
+   unescaped.reserve(field.size());
+   for (std::string::size_type i = 0; i < field.size(); ++i)
+   {
+      if (field[i] != '\\' || i + 1 == field.size())
+      {
+         unescaped += field[i];
+         continue;
+      }
+      switch (field[++i])
+      {
+         case 't': unescaped += '\t'; break;
+         case 'n': unescaped += '\n'; break;
+         case 'r': unescaped += '\r'; break;
+         default: unescaped += field[i]; break;
+      }
+   }
+   return unescaped;
+}
+
+std::string DetectionCache::Key(const std::string& module,
+      const std::string& device, const std::string& port)
+{
+   return Escape(module) + '\t' + Escape(device) + '\t' + Escape(port);
+}
+
+bool DetectionCache::Save(std::string& errorText) const
+{
+   // Write to a temporary file and rename, so that a crash cannot leave a
+   // truncated cache behind
+   const std::string tempPath = path_ + ".tmp";
+   {
+      std::ofstream file(tempPath.c_str(), std::ios::trunc);
+      file << fileHeader << '\n';
+      for (EntryMap::const_iterator it = entries_.begin();
+            it != entries_.end(); ++it)
+      {
+         const DetectionCacheEntry& entry = it->second;
+         file << it->first << '\t' << Escape(entry.fingerprint) << '\t' <<
+            static_cast<int>(entry.status);
+         for (size_t i = 0; i < entry.portSettings.size(); ++i)
+            file << '\t' << Escape(entry.portSettings[i].first) <<
+               '\t' << Escape(entry.portSettings[i].second);
+         file << '\n';
+      }
+      file.close();
+      if (!file)
+      {
+         std::remove(tempPath.c_str());
+         errorText = "Cannot write device detection cache '" + path_ + "'";
+         return false;
+      }
+   }
+#ifdef _WIN32
+   std::remove(path_.c_str()); // rename() does not replace on Windows
+#endif
+   if (std::rename(tempPath.c_str(), path_.c_str()) != 0)
+   {
+      std::remove(tempPath.c_str());
+      errorText = "Cannot write device detection cache '" + path_ + "'";
+      return false;
+   }
+   return true;
+}
+
+std::vector< std::vector<size_t> > GroupIndependentDetections(
+      const std::vector< std::vector<std::string> >& resources)
+{
+   // Union-find over the detections, joined through shared resources
+   std::vector<size_t> parent(resources.size());
+   for (size_t i = 0; i < parent.size(); ++i)
+      parent[i] = i;
+   struct Find
+   {
+      static size_t Root(std::vector<size_t>& parent, size_t i)
+      {
+         while (parent[i] != i)
+         {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+         }
+         return i;
+      }
+   };
+
+   std::map<std::string, size_t> firstUser;
+   for (size_t i = 0; i < resources.size(); ++i)
+   {
+      for (size_t r = 0; r < resources[i].size(); ++r)
+      {
+         std::map<std::string, size_t>::iterator found =
+            firstUser.find(resources[i][r]);
+         if (found == firstUser.end())
+         {
+            firstUser.insert(std::make_pair(resources[i][r], i));
+            continue;
+         }
+         const size_t a = Find::Root(parent, found->second);
+         const size_t b = Find::Root(parent, i);
+         if (a != b)
+            parent[(std::max)(a, b)] = (std::min)(a, b);
+      }
+   }
+
+   std::vector< std::vector<size_t> > groups;
+   std::map<size_t, size_t> groupOfRoot;
+   for (size_t i = 0; i < resources.size(); ++i)
+   {
+      const size_t root = Find::Root(parent, i);
+      std::map<size_t, size_t>::iterator found = groupOfRoot.find(root);
+      if (found == groupOfRoot.end())
+      {
+         groupOfRoot.insert(std::make_pair(root, groups.size()));
+         groups.push_back(std::vector<size_t>(1, i));
+      }
+      else
+      {
+         groups[found->second].push_back(i);
+      }
+   }
+   return groups;
+}
+
+void RunDetectionGroups(const std::vector< std::vector<size_t> >& groups,
+      const boost::function<void (size_t)>& detect)
+{
+   struct Group
+   {
+      static void Run(const std::vector<size_t>* group,
+            const boost::function<void (size_t)>* detect)
+      {
+         for (size_t i = 0; i < group->size(); ++i)
+            (*detect)((*group)[i]);
+      }
+   };
+
+   boost::thread_group threads;
+   for (size_t g = 1; g < groups.size(); ++g)
+      threads.create_thread(boost::bind(&Group::Run, &groups[g], &detect));
+   if (!groups.empty())
+      Group::Run(&groups[0], &detect);
+   threads.join_all();
+}
+
+} // namespace mm
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DetectionCache.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Persisted results of device detection, and grouping of
+//                detections that can run in parallel.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+struct DetectionCacheEntry
+{
+   // Identifies the hardware behind the port (e.g. a USB serial adapter),
+   // not the device connected to it; the entry is only valid while the port
+   // reports the same fingerprint
+   std::string fingerprint;
+   MM::DeviceDetectionStatus status;
+   // Port properties set by the detection, to apply on a cache hit
+   std::vector< std::pair<std::string, std::string> > portSettings;
+
+   DetectionCacheEntry() : status(MM::Unimplemented) {}
+};
+
+/**
+ * Results of device detection, keyed by device adapter module, device name
+ * and port, so that a device need not be probed again (which can take
+ * seconds) until the hardware on its port changes.
+ *
+ * Only devices that were found (MM::CanCommunicate) are remembered. Other
+ * results may be due to a device that was switched off or unplugged, and
+ * storing one removes the device's entry, so that it is probed next time.
+ *
+ * Entries are kept in a text file, rewritten after each change.
+ */
+class DetectionCache
+{
+public:
+   DetectionCache();
+
+   /**
+    * Loads the entries from the file, which need not exist yet, and saves
+    * to it from then on. Returns false, setting errorText, if the file
+    * exists but cannot be read. Malformed lines are skipped.
+    */
+   bool Open(const std::string& path, std::string& errorText);
+   void Close(); // Keeps the file, but stops using it
+   bool IsOpen() const;
+
+   // Returns false if there is no entry for a device that was found, or if
+   // its fingerprint differs
+   bool Lookup(const std::string& module, const std::string& device,
+         const std::string& port, const std::string& fingerprint,
+         DetectionCacheEntry& entry) const;
+   bool Store(const std::string& module, const std::string& device,
+         const std::string& port, const DetectionCacheEntry& entry,
+         std::string& errorText);
+   bool Clear(std::string& errorText);
+
+   static std::string Escape(const std::string& field);
+   static std::string Unescape(const std::string& field);
+
+private:
+   typedef std::map<std::string, DetectionCacheEntry> EntryMap;
+
+   static std::string Key(const std::string& module,
+         const std::string& device, const std::string& port);
+   bool Save(std::string& errorText) const; // Called with mutex_ held
+
+   mutable boost::mutex mutex_; // Guards all of the below
+   std::string path_; // Empty when closed
+   EntryMap entries_;
+};
+
+/**
+ * Groups detections so that those sharing a resource (e.g. a port, or a
+ * device adapter module, whose calls are serialized) are in the same group,
+ * and groups are independent. resources[i] lists those used by detection i.
+ * Returns the indices of each group, in increasing order.
+ */
+std::vector< std::vector<size_t> > GroupIndependentDetections(
+      const std::vector< std::vector<std::string> >& resources);
+
+/**
+ * Calls detect(i) for the indices of all groups: the groups in parallel (the
+ * calling thread takes the first), and the indices of each group one after
+ * another, in order. Returns when all have finished; detect must not throw.
+ */
+void RunDetectionGroups(const std::vector< std::vector<size_t> >& groups,
+      const boost::function<void (size_t)>& detect);
+
+} // namespace mm
@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceCallProfile.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Opt-in latency histograms of the calls that the Core makes
+//                into each device
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DeviceCallProfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+
+namespace mm {
+
+namespace {
+
+// The lock waiting time measured last on this thread, until taken by a call
+// into the device whose profile it belongs to
+thread_local const DeviceCallProfile* pendingLockWaitProfile = 0;
+thread_local unsigned long long pendingLockWaitNs = 0;
+
+void Merge(LatencyHistogram::Snapshot& total,
+      const LatencyHistogram::Snapshot& part)
+{
+   total.count += part.count;
+   total.totalNs += part.totalNs;
+   total.maxNs = (std::max)(total.maxNs, part.maxNs);
+   total.buckets.resize(part.buckets.size());
+   for (std::size_t i = 0; i < part.buckets.size(); ++i)
+      total.buckets[i] += part.buckets[i];
+}
+
+void WriteHistogram(std::ostream& out, const std::string& device,
+      const std::string& method, const char* timing,
+      const LatencyHistogram::Snapshot& histogram)
+{
+   out << device << '\t' << method << '\t' << timing << '\t' <<
+      histogram.count << '\t' <<
+      histogram.MeanNs() / 1000.0 << '\t' <<
+      histogram.PercentileNs(0.5) / 1000.0 << '\t' <<
+      histogram.PercentileNs(0.99) / 1000.0 << '\t' <<
+      histogram.maxNs / 1000.0 << '\t';
+   bool first = true;
+   for (unsigned i = 0; i < histogram.buckets.size(); ++i)
+   {
+      if (histogram.buckets[i] == 0)
+         continue;
+      if (!first)
+         out << ' ';
+      out << LatencyHistogram::BucketLowerBound(i) << ':' << histogram.buckets[i];
+      first = false;
+   }
+   out << '\n';
+}
+
+} // anonymous namespace
+
+
+double LatencyHistogram::Snapshot::MeanNs() const
+{
+   return count > 0 ? static_cast<double>(totalNs) / count : 0.0;
+}
+
+double LatencyHistogram::Snapshot::PercentileNs(double fraction) const
+{
+   if (count == 0 || buckets.empty())
+      return 0.0;
+   const double target = fraction * count;
+   unsigned long long cumulative = 0;
+   for (unsigned i = 0; i < buckets.size(); ++i)
+   {
+      cumulative += buckets[i];
+      if (cumulative > 0 && cumulative >= target)
+      {
+         if (i + 1 >= buckets.size())
+            return static_cast<double>(maxNs);
+         // Middle of the bucket, but never above the longest duration
+         const double lower = static_cast<double>(BucketLowerBound(i));
+         const double upper = static_cast<double>(BucketLowerBound(i + 1));
+         return (std::min)(0.5 * (lower + upper), static_cast<double>(maxNs));
+      }
+   }
+   return static_cast<double>(maxNs);
+}
+
+void LatencyHistogram::Record(unsigned long long ns)
+{
+   count_.fetch_add(1, std::memory_order_relaxed);
+   totalNs_.fetch_add(ns, std::memory_order_relaxed);
+   unsigned long long max = maxNs_.load(std::memory_order_relaxed);
+   while (ns > max &&
+         !maxNs_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+      ;
+   buckets_[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset()
+{
+   count_.store(0, std::memory_order_relaxed);
+   totalNs_.store(0, std::memory_order_relaxed);
+   maxNs_.store(0, std::memory_order_relaxed);
+   for (unsigned i = 0; i < BucketCount; ++i)
+      buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+   // Not atomic as a whole; calls recorded meanwhile may be partly counted
+   Snapshot snapshot;
+   snapshot.count = count_.load(std::memory_order_relaxed);
+   snapshot.totalNs = totalNs_.load(std::memory_order_relaxed);
+   snapshot.maxNs = maxNs_.load(std::memory_order_relaxed);
+   snapshot.buckets.resize(BucketCount);
+   for (unsigned i = 0; i < BucketCount; ++i)
+      snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+   return snapshot;
+}
+
+unsigned LatencyHistogram::BucketIndex(unsigned long long ns)
+{
+   if (ns < 4)
+      return static_cast<unsigned>(ns);
+   unsigned exponent = 2;
+   while (exponent < 63 && (ns >> (exponent + 1)) != 0)
+      ++exponent;
+   const unsigned sub = static_cast<unsigned>(ns >> (exponent - 2)) & 3;
+   return (std::min)(4 * (exponent - 1) + sub, BucketCount - 1);
+}
+
+unsigned long long LatencyHistogram::BucketLowerBound(unsigned index)
+{
+   if (index < 4)
+      return index;
+   const unsigned exponent = index / 4 + 1;
+   const unsigned sub = index % 4;
+   return static_cast<unsigned long long>(4 + sub) << (exponent - 2);
+}
+
+
+DeviceCallProfile::DeviceCallProfile() :
+   enabled_(false)
+{
+   for (unsigned i = 0; i < MaxMethods; ++i)
+      methods_[i].store(0, std::memory_order_relaxed);
+}
+
+DeviceCallProfile::~DeviceCallProfile()
+{
+   if (pendingLockWaitProfile == this)
+      pendingLockWaitProfile = 0;
+   for (unsigned i = 0; i < MaxMethods; ++i)
+      delete methods_[i].load(std::memory_order_relaxed);
+}
+
+void DeviceCallProfile::Reset()
+{
+   for (unsigned i = 0; i < MaxMethods; ++i)
+   {
+      MethodEntry* entry = methods_[i].load(std::memory_order_acquire);
+      if (entry)
+      {
+         entry->adapter.Reset();
+         entry->lockWait.Reset();
+      }
+   }
+}
+
+void DeviceCallProfile::Record(const char* method,
+      unsigned long long adapterNs, bool hasLockWait,
+      unsigned long long lockWaitNs)
+{
+   MethodEntry* entry = FindOrAdd(method);
+   if (!entry)
+      return;
+   entry->adapter.Record(adapterNs);
+   if (hasLockWait)
+      entry->lockWait.Record(lockWaitNs);
+}
+
+std::vector<DeviceCallProfile::MethodSnapshot>
+DeviceCallProfile::GetSnapshot() const
+{
+   // Overloads have separate entries (their __func__ differ) but are
+   // reported together
+   std::map<std::string, MethodSnapshot> byName;
+   for (unsigned i = 0; i < MaxMethods; ++i)
+   {
+      const MethodEntry* entry = methods_[i].load(std::memory_order_acquire);
+      if (!entry)
+         continue;
+      const LatencyHistogram::Snapshot adapter = entry->adapter.GetSnapshot();
+      if (adapter.count == 0)
+         continue;
+      MethodSnapshot& snapshot = byName[entry->method];
+      snapshot.method = entry->method;
+      Merge(snapshot.adapter, adapter);
+      Merge(snapshot.lockWait, entry->lockWait.GetSnapshot());
+   }
+
+   std::vector<MethodSnapshot> result;
+   for (std::map<std::string, MethodSnapshot>::const_iterator it = byName.begin();
+         it != byName.end(); ++it)
+      result.push_back(it->second);
+   return result;
+}
+
+void DeviceCallProfile::WriteHeader(std::ostream& out)
+{
+   out << "Device\tMethod\tTiming\tCount\tMean_us\tMedian_us\t"
+      "P99_us\tMax_us\tHistogram_ns\n";
+}
+
+void DeviceCallProfile::Write(std::ostream& out, const std::string& device,
+      const std::vector<MethodSnapshot>& methods)
+{
+   for (std::vector<MethodSnapshot>::const_iterator it = methods.begin();
+         it != methods.end(); ++it)
+   {
+      WriteHistogram(out, device, it->method, "Adapter", it->adapter);
+      WriteHistogram(out, device, it->method, "LockWait", it->lockWait);
+   }
+}
+
+unsigned long long DeviceCallProfile::NowNs()
+{
+   return static_cast<unsigned long long>(
+         std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void DeviceCallProfile::SetPendingLockWait(unsigned long long ns)
+{
+   // A nested guard on the same device adds to the outer guard's wait
+   if (pendingLockWaitProfile == this)
+      pendingLockWaitNs += ns;
+   else
+      pendingLockWaitNs = ns;
+   pendingLockWaitProfile = this;
+}
+
+bool DeviceCallProfile::TakePendingLockWait(unsigned long long& ns)
+{
+   if (pendingLockWaitProfile != this)
+      return false;
+   ns = pendingLockWaitNs;
+   pendingLockWaitProfile = 0;
+   return true;
+}
+
+void DeviceCallProfile::WithdrawPendingLockWait()
+{
+   if (pendingLockWaitProfile == this)
+      pendingLockWaitProfile = 0;
+}
+
+DeviceCallProfile::MethodEntry* DeviceCallProfile::FindOrAdd(const char* method)
+{
+   const std::uintptr_t hash = reinterpret_cast<std::uintptr_t>(method) >> 3;
+   MethodEntry* added = 0;
+   for (unsigned probe = 0; probe < MaxMethods; ++probe)
+   {
+      std::atomic<MethodEntry*>& slot = methods_[(hash + probe) % MaxMethods];
+      MethodEntry* entry = slot.load(std::memory_order_acquire);
+      if (!entry)
+      {
+         if (!added)
+            added = new MethodEntry(method);
+         if (slot.compare_exchange_strong(entry, added,
+                  std::memory_order_acq_rel, std::memory_order_acquire))
+            return added;
+         // Another thread took the slot; entry is now its method
+      }
+      if (entry->method == method)
+      {
+         delete added;
+         return entry;
+      }
+   }
+   delete added;
+   return 0; // Too many methods; not recorded
+}
+
+} // namespace mm
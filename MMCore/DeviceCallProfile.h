@@ -0,0 +1,259 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceCallProfile.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Opt-in latency histograms of the calls that the Core makes
+//                into each device
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+/**
+ * Histogram of durations in nanoseconds, with four buckets per power of two,
+ * so that percentiles are within about 12% of the recorded durations.
+ * Recording is lock-free and may be done from any number of threads.
+ */
+class LatencyHistogram
+{
+public:
+   static const unsigned BucketCount = 160; // Up to about 18 minutes
+
+   struct Snapshot
+   {
+      Snapshot() : count(0), totalNs(0), maxNs(0) {}
+      unsigned long long count;
+      unsigned long long totalNs;
+      unsigned long long maxNs;
+      std::vector<unsigned long long> buckets;
+
+      double MeanNs() const;
+      // Approximate duration below which fraction of the durations lie
+      double PercentileNs(double fraction) const;
+   };
+
+   LatencyHistogram() { Reset(); }
+
+   void Record(unsigned long long ns);
+   void Reset();
+   Snapshot GetSnapshot() const;
+
+   static unsigned BucketIndex(unsigned long long ns);
+   // Durations in bucket index are >= its lower bound and < the next one's
+   static unsigned long long BucketLowerBound(unsigned index);
+
+private:
+   std::atomic<unsigned long long> count_;
+   std::atomic<unsigned long long> totalNs_;
+   std::atomic<unsigned long long> maxNs_;
+   std::atomic<unsigned long long> buckets_[BucketCount];
+};
+
+/**
+ * Per-method latency histograms of the calls made into one device: the time
+ * spent inside the device adapter and the time spent waiting for the device
+ * module's lock (DeviceModuleLockGuard) before the call.
+ *
+ * The waiting time is measured by the lock guard and attributed to the first
+ * call made into the device on the same thread while the guard is held.
+ * Calls made without a guard, or after the first, have no waiting time.
+ *
+ * Methods are identified by the address of their name, which must be a
+ * string with static storage (e.g. __func__); methods of the same name, such
+ * as overloads, are reported together.
+ * Histograms are allocated at a method's first call and kept until the
+ * profile is destroyed, so that recording never takes a lock.
+ */
+class DeviceCallProfile
+{
+public:
+   struct MethodSnapshot
+   {
+      std::string method;
+      LatencyHistogram::Snapshot adapter;
+      LatencyHistogram::Snapshot lockWait;
+   };
+
+   DeviceCallProfile();
+   ~DeviceCallProfile();
+
+   void SetEnabled(bool enable) { enabled_.store(enable, std::memory_order_relaxed); }
+   bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+   // Clears the histograms
+   void Reset();
+
+   void Record(const char* method, unsigned long long adapterNs,
+         bool hasLockWait, unsigned long long lockWaitNs);
+
+   // Methods that have been called since the last reset, by name
+   std::vector<MethodSnapshot> GetSnapshot() const;
+
+   /**
+    * Writes the histograms as tab-separated lines, two per method: the
+    * time spent in the adapter and the time spent waiting for the lock.
+    * Columns are device, method, timing ("Adapter" or "LockWait"), count,
+    * mean, median, 99th percentile and maximum in microseconds, and the
+    * histogram as space-separated "<lower bound in ns>:<count>" for each
+    * non-empty bucket.
+    */
+   static void WriteHeader(std::ostream& out);
+   static void Write(std::ostream& out, const std::string& device,
+         const std::vector<MethodSnapshot>& methods);
+
+   // Monotonic time for measuring durations
+   static unsigned long long NowNs();
+
+   // Lock waiting time, passed from DeviceModuleLockGuard to the next call
+   // on the same thread
+   void SetPendingLockWait(unsigned long long ns);
+   bool TakePendingLockWait(unsigned long long& ns);
+   void WithdrawPendingLockWait();
+
+private:
+   DeviceCallProfile(const DeviceCallProfile&);
+   DeviceCallProfile& operator=(const DeviceCallProfile&);
+
+   struct MethodEntry
+   {
+      explicit MethodEntry(const char* name) : method(name) {}
+      const char* method;
+      LatencyHistogram adapter;
+      LatencyHistogram lockWait;
+   };
+
+   MethodEntry* FindOrAdd(const char* method);
+
+   static const unsigned MaxMethods = 256;
+   std::atomic<bool> enabled_;
+   std::atomic<MethodEntry*> methods_[MaxMethods]; // Open addressing
+};
+
+/**
+ * Times one device call, from construction to destruction, if profiling is
+ * enabled when constructed.
+ */
+class DeviceCallTimer
+{
+public:
+   DeviceCallTimer(DeviceCallProfile& profile, const char* method) :
+      profile_(profile.IsEnabled() ? &profile : 0),
+      method_(method),
+      hasLockWait_(false),
+      lockWaitNs_(0),
+      startNs_(0)
+   {
+      if (profile_)
+      {
+         hasLockWait_ = profile_->TakePendingLockWait(lockWaitNs_);
+         startNs_ = DeviceCallProfile::NowNs();
+      }
+   }
+
+   DeviceCallTimer(DeviceCallTimer&& other) :
+      profile_(other.profile_),
+      method_(other.method_),
+      hasLockWait_(other.hasLockWait_),
+      lockWaitNs_(other.lockWaitNs_),
+      startNs_(other.startNs_)
+   {
+      other.profile_ = 0;
+   }
+
+   ~DeviceCallTimer()
+   {
+      if (profile_)
+         profile_->Record(method_, DeviceCallProfile::NowNs() - startNs_,
+               hasLockWait_, lockWaitNs_);
+   }
+
+private:
+   DeviceCallTimer(const DeviceCallTimer&);
+   DeviceCallTimer& operator=(const DeviceCallTimer&);
+
+   DeviceCallProfile* profile_;
+   const char* method_;
+   bool hasLockWait_;
+   unsigned long long lockWaitNs_;
+   unsigned long long startNs_;
+};
+
+/**
+ * Times the acquisition of a device module's lock, for attribution to the
+ * next call into the device. Construct before, and call LockAcquired()
+ * after, acquiring the lock.
+ */
+class LockWaitTimer
+{
+public:
+   explicit LockWaitTimer(DeviceCallProfile& profile) :
+      profile_(profile.IsEnabled() ? &profile : 0),
+      startNs_(profile_ ? DeviceCallProfile::NowNs() : 0)
+   {}
+
+   ~LockWaitTimer()
+   {
+      if (profile_)
+         profile_->WithdrawPendingLockWait();
+   }
+
+   void LockAcquired()
+   {
+      if (profile_)
+         profile_->SetPendingLockWait(DeviceCallProfile::NowNs() - startNs_);
+   }
+
+private:
+   LockWaitTimer(const LockWaitTimer&);
+   LockWaitTimer& operator=(const LockWaitTimer&);
+
+   DeviceCallProfile* profile_;
+   unsigned long long startNs_;
+};
+
+/**
+ * A raw device pointer that times the call made through it: the object lives
+ * until the end of the full expression, so that
+ * ProfiledCall<T>(...)->Method(args) times Method.
+ */
+template <typename TDevice>
+class ProfiledCall
+{
+public:
+   ProfiledCall(TDevice* device, DeviceCallProfile& profile,
+         const char* method) :
+      device_(device),
+      timer_(profile, method)
+   {}
+
+   ProfiledCall(ProfiledCall&& other) :
+      device_(other.device_),
+      timer_(std::move(other.timer_))
+   {}
+
+   TDevice* operator->() const { return device_; }
+
+private:
+   TDevice* device_;
+   DeviceCallTimer timer_;
+};
+
+} // namespace mm
@@ -293,8 +293,11 @@ DeviceManager::GetParentDevice(boost::shared_ptr<DeviceInstance> device) const
 
 
 DeviceModuleLockGuard::DeviceModuleLockGuard(boost::shared_ptr<DeviceInstance> device) :
+   wait_(device->GetCallProfile()),
    g_(device->GetAdapterModule()->GetLock())
-{}
+{
+   wait_.LockAcquired();
+}
 
 
 } // namespace mm
@@ -20,6 +20,7 @@
 #include "../MMDevice/MMDevice.h"
 #include "../MMDevice/DeviceThreads.h"
 #include "CoreUtils.h"
+#include "DeviceCallProfile.h"
 #include "Devices/DeviceInstance.h"
 #include "Error.h"
 #include "Logging/Logger.h"
@@ -134,9 +135,11 @@ public:
 };
 
 
-// Scoped acquisition of a device's module's lock
+// Scoped acquisition of a device's module's lock. The time spent waiting
+// for the lock is recorded in the device's call profile, if enabled.
 class DeviceModuleLockGuard
 {
+   LockWaitTimer wait_; // Must precede g_
    MMThreadGuard g_;
 public:
    explicit DeviceModuleLockGuard(boost::shared_ptr<DeviceInstance> device);
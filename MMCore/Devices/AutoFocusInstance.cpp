@@ -22,13 +22,13 @@
 #include "AutoFocusInstance.h"
 
 
-int AutoFocusInstance::SetContinuousFocusing(bool state) { return GetImpl()->SetContinuousFocusing(state); }
-int AutoFocusInstance::GetContinuousFocusing(bool& state) { return GetImpl()->GetContinuousFocusing(state); }
-bool AutoFocusInstance::IsContinuousFocusLocked() { return GetImpl()->IsContinuousFocusLocked(); }
-int AutoFocusInstance::FullFocus() { return GetImpl()->FullFocus(); }
-int AutoFocusInstance::IncrementalFocus() { return GetImpl()->IncrementalFocus(); }
-int AutoFocusInstance::GetLastFocusScore(double& score) { return GetImpl()->GetLastFocusScore(score); }
-int AutoFocusInstance::GetCurrentFocusScore(double& score) { return GetImpl()->GetCurrentFocusScore(score); }
-int AutoFocusInstance::AutoSetParameters() { return GetImpl()->AutoSetParameters(); }
-int AutoFocusInstance::GetOffset(double &offset) { return GetImpl()->GetOffset(offset); }
-int AutoFocusInstance::SetOffset(double offset) { return GetImpl()->SetOffset(offset); }
+int AutoFocusInstance::SetContinuousFocusing(bool state) { return ProfiledImpl(__func__)->SetContinuousFocusing(state); }
+int AutoFocusInstance::GetContinuousFocusing(bool& state) { return ProfiledImpl(__func__)->GetContinuousFocusing(state); }
+bool AutoFocusInstance::IsContinuousFocusLocked() { return ProfiledImpl(__func__)->IsContinuousFocusLocked(); }
+int AutoFocusInstance::FullFocus() { return ProfiledImpl(__func__)->FullFocus(); }
+int AutoFocusInstance::IncrementalFocus() { return ProfiledImpl(__func__)->IncrementalFocus(); }
+int AutoFocusInstance::GetLastFocusScore(double& score) { return ProfiledImpl(__func__)->GetLastFocusScore(score); }
+int AutoFocusInstance::GetCurrentFocusScore(double& score) { return ProfiledImpl(__func__)->GetCurrentFocusScore(score); }
+int AutoFocusInstance::AutoSetParameters() { return ProfiledImpl(__func__)->AutoSetParameters(); }
+int AutoFocusInstance::GetOffset(double &offset) { return ProfiledImpl(__func__)->GetOffset(offset); }
+int AutoFocusInstance::SetOffset(double offset) { return ProfiledImpl(__func__)->SetOffset(offset); }
@@ -22,51 +22,51 @@
 #include "CameraInstance.h"
 
 
-int CameraInstance::SnapImage() { return GetImpl()->SnapImage(); }
-const unsigned char* CameraInstance::GetImageBuffer() { return GetImpl()->GetImageBuffer(); }
-const unsigned char* CameraInstance::GetImageBuffer(unsigned channelNr) { return GetImpl()->GetImageBuffer(channelNr); }
-const unsigned int* CameraInstance::GetImageBufferAsRGB32() { return GetImpl()->GetImageBufferAsRGB32(); }
-unsigned CameraInstance::GetNumberOfComponents() const { return GetImpl()->GetNumberOfComponents(); }
+int CameraInstance::SnapImage() { return ProfiledImpl(__func__)->SnapImage(); }
+const unsigned char* CameraInstance::GetImageBuffer() { return ProfiledImpl(__func__)->GetImageBuffer(); }
+const unsigned char* CameraInstance::GetImageBuffer(unsigned channelNr) { return ProfiledImpl(__func__)->GetImageBuffer(channelNr); }
+const unsigned int* CameraInstance::GetImageBufferAsRGB32() { return ProfiledImpl(__func__)->GetImageBufferAsRGB32(); }
+unsigned CameraInstance::GetNumberOfComponents() const { return ProfiledImpl(__func__)->GetNumberOfComponents(); }
 
 std::string CameraInstance::GetComponentName(unsigned component)
 {
    DeviceStringBuffer nameBuf(this, "GetComponentName");
-   int err = GetImpl()->GetComponentName(component, nameBuf.GetBuffer());
+   int err = ProfiledImpl(__func__)->GetComponentName(component, nameBuf.GetBuffer());
    ThrowIfError(err, "Cannot get component name at index " +
          ToString(component));
    return nameBuf.Get();
 }
 
-int unsigned CameraInstance::GetNumberOfChannels() const { return GetImpl()->GetNumberOfChannels(); }
+int unsigned CameraInstance::GetNumberOfChannels() const { return ProfiledImpl(__func__)->GetNumberOfChannels(); }
 
 std::string CameraInstance::GetChannelName(unsigned channel)
 {
    DeviceStringBuffer nameBuf(this, "GetChannelName");
-   int err = GetImpl()->GetChannelName(channel, nameBuf.GetBuffer());
+   int err = ProfiledImpl(__func__)->GetChannelName(channel, nameBuf.GetBuffer());
    ThrowIfError(err, "Cannot get channel name at index " + ToString(channel));
    return nameBuf.Get();
 }
 
-long CameraInstance::GetImageBufferSize()const { return GetImpl()->GetImageBufferSize(); }
-unsigned CameraInstance::GetImageWidth() const { return GetImpl()->GetImageWidth(); }
-unsigned CameraInstance::GetImageHeight() const { return GetImpl()->GetImageHeight(); }
-unsigned CameraInstance::GetImageBytesPerPixel() const { return GetImpl()->GetImageBytesPerPixel(); }
-unsigned CameraInstance::GetBitDepth() const { return GetImpl()->GetBitDepth(); }
-double CameraInstance::GetPixelSizeUm() const { return GetImpl()->GetPixelSizeUm(); }
-int CameraInstance::GetBinning() const { return GetImpl()->GetBinning(); }
-int CameraInstance::SetBinning(int binSize) { return GetImpl()->SetBinning(binSize); }
-void CameraInstance::SetExposure(double exp_ms) { return GetImpl()->SetExposure(exp_ms); }
-double CameraInstance::GetExposure() const { return GetImpl()->GetExposure(); }
-int CameraInstance::SetROI(unsigned x, unsigned y, unsigned xSize, unsigned ySize) { return GetImpl()->SetROI(x, y, xSize, ySize); }
-int CameraInstance::GetROI(unsigned& x, unsigned& y, unsigned& xSize, unsigned& ySize) { return GetImpl()->GetROI(x, y, xSize, ySize); }
-int CameraInstance::ClearROI() { return GetImpl()->ClearROI(); }
+long CameraInstance::GetImageBufferSize()const { return ProfiledImpl(__func__)->GetImageBufferSize(); }
+unsigned CameraInstance::GetImageWidth() const { return ProfiledImpl(__func__)->GetImageWidth(); }
+unsigned CameraInstance::GetImageHeight() const { return ProfiledImpl(__func__)->GetImageHeight(); }
+unsigned CameraInstance::GetImageBytesPerPixel() const { return ProfiledImpl(__func__)->GetImageBytesPerPixel(); }
+unsigned CameraInstance::GetBitDepth() const { return ProfiledImpl(__func__)->GetBitDepth(); }
+double CameraInstance::GetPixelSizeUm() const { return ProfiledImpl(__func__)->GetPixelSizeUm(); }
+int CameraInstance::GetBinning() const { return ProfiledImpl(__func__)->GetBinning(); }
+int CameraInstance::SetBinning(int binSize) { return ProfiledImpl(__func__)->SetBinning(binSize); }
+void CameraInstance::SetExposure(double exp_ms) { return ProfiledImpl(__func__)->SetExposure(exp_ms); }
+double CameraInstance::GetExposure() const { return ProfiledImpl(__func__)->GetExposure(); }
+int CameraInstance::SetROI(unsigned x, unsigned y, unsigned xSize, unsigned ySize) { return ProfiledImpl(__func__)->SetROI(x, y, xSize, ySize); }
+int CameraInstance::GetROI(unsigned& x, unsigned& y, unsigned& xSize, unsigned& ySize) { return ProfiledImpl(__func__)->GetROI(x, y, xSize, ySize); }
+int CameraInstance::ClearROI() { return ProfiledImpl(__func__)->ClearROI(); }
 
 /**
  * Queries if the camera supports multiple simultaneous ROIs.
  */
 bool CameraInstance::SupportsMultiROI()
 {
-   return GetImpl()->SupportsMultiROI();
+   return ProfiledImpl(__func__)->SupportsMultiROI();
 }
 
 /**
@@ -76,7 +76,7 @@ bool CameraInstance::SupportsMultiROI()
  */
 bool CameraInstance::IsMultiROISet()
 {
-   return GetImpl()->IsMultiROISet();
+   return ProfiledImpl(__func__)->IsMultiROISet();
 }
 
 /**
@@ -85,7 +85,7 @@ bool CameraInstance::IsMultiROISet()
  */
 int CameraInstance::GetMultiROICount(unsigned int& count)
 {
-   return GetImpl()->GetMultiROICount(count);
+   return ProfiledImpl(__func__)->GetMultiROICount(count);
 }
 
 /**
@@ -101,7 +101,7 @@ int CameraInstance::SetMultiROI(const unsigned int* xs, const unsigned int* ys,
       const unsigned* widths, const unsigned int* heights,
       unsigned numROIs)
 {
-   return GetImpl()->SetMultiROI(xs, ys, widths, heights, numROIs);
+   return ProfiledImpl(__func__)->SetMultiROI(xs, ys, widths, heights, numROIs);
 }
 
 /**
@@ -117,14 +117,14 @@ int CameraInstance::SetMultiROI(const unsigned int* xs, const unsigned int* ys,
 int CameraInstance::GetMultiROI(unsigned* xs, unsigned* ys, unsigned* widths,
       unsigned* heights, unsigned* length)
 {
-   return GetImpl()->GetMultiROI(xs, ys, widths, heights, length);
+   return ProfiledImpl(__func__)->GetMultiROI(xs, ys, widths, heights, length);
 }
 
-int CameraInstance::StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow) { return GetImpl()->StartSequenceAcquisition(numImages, interval_ms, stopOnOverflow); }
-int CameraInstance::StartSequenceAcquisition(double interval_ms) { return GetImpl()->StartSequenceAcquisition(interval_ms); }
-int CameraInstance::StopSequenceAcquisition() { return GetImpl()->StopSequenceAcquisition(); }
-int CameraInstance::PrepareSequenceAcqusition() { return GetImpl()->PrepareSequenceAcqusition(); }
-bool CameraInstance::IsCapturing() { return GetImpl()->IsCapturing(); }
+int CameraInstance::StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow) { return ProfiledImpl(__func__)->StartSequenceAcquisition(numImages, interval_ms, stopOnOverflow); }
+int CameraInstance::StartSequenceAcquisition(double interval_ms) { return ProfiledImpl(__func__)->StartSequenceAcquisition(interval_ms); }
+int CameraInstance::StopSequenceAcquisition() { return ProfiledImpl(__func__)->StopSequenceAcquisition(); }
+int CameraInstance::PrepareSequenceAcqusition() { return ProfiledImpl(__func__)->PrepareSequenceAcqusition(); }
+bool CameraInstance::IsCapturing() { return ProfiledImpl(__func__)->IsCapturing(); }
 
 std::string CameraInstance::GetTags()
 {
@@ -133,16 +133,49 @@ std::string CameraInstance::GetTags()
    // (CCameraBase takes no precaution to limit string length; it is an
    // interface bug).
    DeviceStringBuffer serializedMetadataBuf(this, "GetTags");
-   GetImpl()->GetTags(serializedMetadataBuf.GetBuffer());
+   ProfiledImpl(__func__)->GetTags(serializedMetadataBuf.GetBuffer());
    return serializedMetadataBuf.Get();
 }
 
-void CameraInstance::AddTag(const char* key, const char* deviceLabel, const char* value) { return GetImpl()->AddTag(key, deviceLabel, value); }
-void CameraInstance::RemoveTag(const char* key) { return GetImpl()->RemoveTag(key); }
-int CameraInstance::IsExposureSequenceable(bool& isSequenceable) const { return GetImpl()->IsExposureSequenceable(isSequenceable); }
-int CameraInstance::GetExposureSequenceMaxLength(long& nrEvents) const { return GetImpl()->GetExposureSequenceMaxLength(nrEvents); }
-int CameraInstance::StartExposureSequence() { return GetImpl()->StartExposureSequence(); }
-int CameraInstance::StopExposureSequence() { return GetImpl()->StopExposureSequence(); }
-int CameraInstance::ClearExposureSequence() { return GetImpl()->ClearExposureSequence(); }
-int CameraInstance::AddToExposureSequence(double exposureTime_ms) { return GetImpl()->AddToExposureSequence(exposureTime_ms); }
-int CameraInstance::SendExposureSequence() const { return GetImpl()->SendExposureSequence(); }
+void CameraInstance::AddTag(const char* key, const char* deviceLabel, const char* value) { return ProfiledImpl(__func__)->AddTag(key, deviceLabel, value); }
+void CameraInstance::RemoveTag(const char* key) { return ProfiledImpl(__func__)->RemoveTag(key); }
+int CameraInstance::IsExposureSequenceable(bool& isSequenceable) const { return ProfiledImpl(__func__)->IsExposureSequenceable(isSequenceable); }
+int CameraInstance::GetExposureSequenceMaxLength(long& nrEvents) const { return ProfiledImpl(__func__)->GetExposureSequenceMaxLength(nrEvents); }
+int CameraInstance::StartExposureSequence() { return ProfiledImpl(__func__)->StartExposureSequence(); }
+int CameraInstance::StopExposureSequence() { return ProfiledImpl(__func__)->StopExposureSequence(); }
+int CameraInstance::ClearExposureSequence() { return ProfiledImpl(__func__)->ClearExposureSequence(); }
+int CameraInstance::AddToExposureSequence(double exposureTime_ms) { return ProfiledImpl(__func__)->AddToExposureSequence(exposureTime_ms); }
+int CameraInstance::SendExposureSequence() const { return ProfiledImpl(__func__)->SendExposureSequence(); }
+
+bool CameraInstance::SupportsBurstAPI() { return ProfiledImpl(__func__)->SupportsBurstAPI(); }
+int CameraInstance::SetPreFrameDelay(double delay_ms) { return ProfiledImpl(__func__)->SetPreFrameDelay(delay_ms); }
+int CameraInstance::SetPostFrameDelay(double delay_ms) { return ProfiledImpl(__func__)->SetPostFrameDelay(delay_ms); }
+int CameraInstance::SetBurstStartTriggerType(const char* type) { return ProfiledImpl(__func__)->SetBurstStartTriggerType(type); }
+int CameraInstance::SetBurstEndTriggerType(const char* type) { return ProfiledImpl(__func__)->SetBurstEndTriggerType(type); }
+int CameraInstance::SetFrameStartTriggerType(const char* type) { return ProfiledImpl(__func__)->SetFrameStartTriggerType(type); }
+int CameraInstance::SetExposureEndTriggerType(const char* type) { return ProfiledImpl(__func__)->SetExposureEndTriggerType(type); }
+int CameraInstance::SetFrameExposureMode(const char* mode) { return ProfiledImpl(__func__)->SetFrameExposureMode(mode); }
+int CameraInstance::PrepareForBurst(int numImages) { return ProfiledImpl(__func__)->PrepareForBurst(numImages); }
+int CameraInstance::SendBurstStartTrigger() { return ProfiledImpl(__func__)->SendBurstStartTrigger(); }
+int CameraInstance::SendFrameStartTrigger() { return ProfiledImpl(__func__)->SendFrameStartTrigger(); }
+int CameraInstance::SendBurstEndTrigger() { return ProfiledImpl(__func__)->SendBurstEndTrigger(); }
+int CameraInstance::GetRollingShutterLineOffset(double& offset_us) { return ProfiledImpl(__func__)->GetRollingShutterLineOffset(offset_us); }
+int CameraInstance::SetRollingShutterLineOffset(double offset_us) { return ProfiledImpl(__func__)->SetRollingShutterLineOffset(offset_us); }
+int CameraInstance::GetRollingShutterActiveLines(int& numLines) { return ProfiledImpl(__func__)->GetRollingShutterActiveLines(numLines); }
+int CameraInstance::SetRollingShutterActiveLines(int numLines) { return ProfiledImpl(__func__)->SetRollingShutterActiveLines(numLines); }
+
+int CameraInstance::GetBurstStartTriggerType(std::string& type)
+{
+   DeviceStringBuffer typeBuf(this, "GetBurstStartTriggerType");
+   int err = ProfiledImpl(__func__)->GetBurstStartTriggerType(typeBuf.GetBuffer());
+   type = typeBuf.Get();
+   return err;
+}
+
+int CameraInstance::GetFrameStartTriggerType(std::string& type)
+{
+   DeviceStringBuffer typeBuf(this, "GetFrameStartTriggerType");
+   int err = ProfiledImpl(__func__)->GetFrameStartTriggerType(typeBuf.GetBuffer());
+   type = typeBuf.Get();
+   return err;
+}
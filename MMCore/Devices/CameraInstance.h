@@ -82,4 +82,23 @@ public:
    int ClearExposureSequence();
    int AddToExposureSequence(double exposureTime_ms);
    int SendExposureSequence() const;
+
+   bool SupportsBurstAPI();
+   int SetPreFrameDelay(double delay_ms);
+   int SetPostFrameDelay(double delay_ms);
+   int SetBurstStartTriggerType(const char* type);
+   int SetBurstEndTriggerType(const char* type);
+   int SetFrameStartTriggerType(const char* type);
+   int SetExposureEndTriggerType(const char* type);
+   int GetBurstStartTriggerType(std::string& type);
+   int GetFrameStartTriggerType(std::string& type);
+   int SetFrameExposureMode(const char* mode);
+   int PrepareForBurst(int numImages);
+   int SendBurstStartTrigger();
+   int SendFrameStartTrigger();
+   int SendBurstEndTrigger();
+   int GetRollingShutterLineOffset(double& offset_us);
+   int SetRollingShutterLineOffset(double offset_us);
+   int GetRollingShutterActiveLines(int& numLines);
+   int SetRollingShutterActiveLines(int numLines);
 };
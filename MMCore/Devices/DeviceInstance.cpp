@@ -143,13 +143,13 @@ DeviceInstance::GetPropertyNames() const
 
 unsigned
 DeviceInstance::GetNumberOfProperties() const
-{ return pImpl_->GetNumberOfProperties(); }
+{ return ProfiledImpl(__func__)->GetNumberOfProperties(); }
 
 std::string
 DeviceInstance::GetProperty(const std::string& name) const
 {
    DeviceStringBuffer valueBuf(this, "GetProperty");
-   int err = pImpl_->GetProperty(name.c_str(), valueBuf.GetBuffer());
+   int err = ProfiledImpl(__func__)->GetProperty(name.c_str(), valueBuf.GetBuffer());
    ThrowIfError(err, "Cannot get value of property " +
          ToQuotedString(name));
    return valueBuf.Get();
@@ -162,7 +162,7 @@ DeviceInstance::SetProperty(const std::string& name,
    LOG_DEBUG(Logger()) << "Will set property \"" << name << "\" to \"" <<
       value << "\"";
 
-   int err = pImpl_->SetProperty(name.c_str(), value.c_str());
+   int err = ProfiledImpl(__func__)->SetProperty(name.c_str(), value.c_str());
 
    ThrowIfError(err, "Cannot set property " + ToQuotedString(name) +
          " to " + ToQuotedString(value));
@@ -173,13 +173,13 @@ DeviceInstance::SetProperty(const std::string& name,
 
 bool
 DeviceInstance::HasProperty(const std::string& name) const
-{ return pImpl_->HasProperty(name.c_str()); }
+{ return ProfiledImpl(__func__)->HasProperty(name.c_str()); }
 
 std::string
 DeviceInstance::GetPropertyName(size_t idx) const
 {
    DeviceStringBuffer nameBuf(this, "GetPropertyName");
-   bool ok = pImpl_->GetPropertyName(static_cast<unsigned>(idx), nameBuf.GetBuffer());
+   bool ok = ProfiledImpl(__func__)->GetPropertyName(static_cast<unsigned>(idx), nameBuf.GetBuffer());
    if (!ok)
       ThrowError("Cannot get property name at index " + ToString(idx));
    return nameBuf.Get();
@@ -189,7 +189,7 @@ bool
 DeviceInstance::GetPropertyReadOnly(const char* name) const
 {
    bool readOnly;
-   ThrowIfError(pImpl_->GetPropertyReadOnly(name, readOnly));
+   ThrowIfError(ProfiledImpl(__func__)->GetPropertyReadOnly(name, readOnly));
    return readOnly;
 }
 
@@ -197,7 +197,7 @@ bool
 DeviceInstance::GetPropertyInitStatus(const char* name) const
 {
    bool isPreInit;
-   ThrowIfError(pImpl_->GetPropertyInitStatus(name, isPreInit));
+   ThrowIfError(ProfiledImpl(__func__)->GetPropertyInitStatus(name, isPreInit));
    return isPreInit;
 }
 
@@ -205,7 +205,7 @@ bool
 DeviceInstance::HasPropertyLimits(const char* name) const
 {
    bool hasLimits;
-   ThrowIfError(pImpl_->HasPropertyLimits(name, hasLimits));
+   ThrowIfError(ProfiledImpl(__func__)->HasPropertyLimits(name, hasLimits));
    return hasLimits;
 }
 
@@ -213,7 +213,7 @@ double
 DeviceInstance::GetPropertyLowerLimit(const char* name) const
 {
    double lowLimit;
-   ThrowIfError(pImpl_->GetPropertyLowerLimit(name, lowLimit));
+   ThrowIfError(ProfiledImpl(__func__)->GetPropertyLowerLimit(name, lowLimit));
    return lowLimit;
 }
 
@@ -221,7 +221,7 @@ double
 DeviceInstance::GetPropertyUpperLimit(const char* name) const
 {
    double highLimit;
-   ThrowIfError(pImpl_->GetPropertyUpperLimit(name, highLimit));
+   ThrowIfError(ProfiledImpl(__func__)->GetPropertyUpperLimit(name, highLimit));
    return highLimit;
 }
 
@@ -229,19 +229,19 @@ MM::PropertyType
 DeviceInstance::GetPropertyType(const char* name) const
 {
    MM::PropertyType propType;
-   ThrowIfError(pImpl_->GetPropertyType(name, propType));
+   ThrowIfError(ProfiledImpl(__func__)->GetPropertyType(name, propType));
    return propType;
 }
 
 unsigned
 DeviceInstance::GetNumberOfPropertyValues(const char* propertyName) const
-{ return pImpl_->GetNumberOfPropertyValues(propertyName); }
+{ return ProfiledImpl(__func__)->GetNumberOfPropertyValues(propertyName); }
 
 std::string
 DeviceInstance::GetPropertyValueAt(const std::string& propertyName, unsigned index) const
 {
    DeviceStringBuffer valueBuf(this, "GetPropertyValueAt");
-   bool ok = pImpl_->GetPropertyValueAt(propertyName.c_str(), index,
+   bool ok = ProfiledImpl(__func__)->GetPropertyValueAt(propertyName.c_str(), index,
          valueBuf.GetBuffer());
    if (!ok)
    {
@@ -257,7 +257,7 @@ bool
 DeviceInstance::IsPropertySequenceable(const char* name) const
 {
    bool isSequenceable;
-   ThrowIfError(pImpl_->IsPropertySequenceable(name, isSequenceable));
+   ThrowIfError(ProfiledImpl(__func__)->IsPropertySequenceable(name, isSequenceable));
    return isSequenceable;
 }
 
@@ -265,45 +265,45 @@ long
 DeviceInstance::GetPropertySequenceMaxLength(const char* propertyName) const
 {
    long nrEvents;
-   ThrowIfError(pImpl_->GetPropertySequenceMaxLength(propertyName, nrEvents));
+   ThrowIfError(ProfiledImpl(__func__)->GetPropertySequenceMaxLength(propertyName, nrEvents));
    return nrEvents;
 }
 
 void
 DeviceInstance::StartPropertySequence(const char* propertyName)
 {
-   ThrowIfError(pImpl_->StartPropertySequence(propertyName));
+   ThrowIfError(ProfiledImpl(__func__)->StartPropertySequence(propertyName));
 }
 
 void
 DeviceInstance::StopPropertySequence(const char* propertyName)
 {
-   ThrowIfError(pImpl_->StopPropertySequence(propertyName));
+   ThrowIfError(ProfiledImpl(__func__)->StopPropertySequence(propertyName));
 }
 
 void
 DeviceInstance::ClearPropertySequence(const char* propertyName)
 {
-   ThrowIfError(pImpl_->ClearPropertySequence(propertyName));
+   ThrowIfError(ProfiledImpl(__func__)->ClearPropertySequence(propertyName));
 }
 
 void
 DeviceInstance::AddToPropertySequence(const char* propertyName, const char* value)
 {
-   ThrowIfError(pImpl_->AddToPropertySequence(propertyName, value));
+   ThrowIfError(ProfiledImpl(__func__)->AddToPropertySequence(propertyName, value));
 }
 
 void
 DeviceInstance::SendPropertySequence(const char* propertyName)
 {
-   ThrowIfError(pImpl_->SendPropertySequence(propertyName));
+   ThrowIfError(ProfiledImpl(__func__)->SendPropertySequence(propertyName));
 }
 
 std::string
 DeviceInstance::GetErrorText(int code) const
 {
    DeviceStringBuffer msgBuf(this, "GetErrorText");
-   bool ok = pImpl_->GetErrorText(code, msgBuf.GetBuffer());
+   bool ok = ProfiledImpl(__func__)->GetErrorText(code, msgBuf.GetBuffer());
    if (ok)
    {
       std::string msg = msgBuf.Get();
@@ -315,68 +315,68 @@ DeviceInstance::GetErrorText(int code) const
 
 bool
 DeviceInstance::Busy()
-{ return pImpl_->Busy(); }
+{ return ProfiledImpl(__func__)->Busy(); }
 
 double
 DeviceInstance::GetDelayMs() const
-{ return pImpl_->GetDelayMs(); }
+{ return ProfiledImpl(__func__)->GetDelayMs(); }
 
 void
 DeviceInstance::SetDelayMs(double delay)
-{ pImpl_->SetDelayMs(delay); }
+{ ProfiledImpl(__func__)->SetDelayMs(delay); }
 
 bool
 DeviceInstance::UsesDelay()
-{ return pImpl_->UsesDelay(); }
+{ return ProfiledImpl(__func__)->UsesDelay(); }
 
 void
 DeviceInstance::Initialize()
 {
-   ThrowIfError(pImpl_->Initialize());
+   ThrowIfError(ProfiledImpl(__func__)->Initialize());
 }
 
 void
 DeviceInstance::Shutdown()
 {
-   ThrowIfError(pImpl_->Shutdown());
+   ThrowIfError(ProfiledImpl(__func__)->Shutdown());
 }
 
 MM::DeviceType
 DeviceInstance::GetType() const
-{ return pImpl_->GetType(); }
+{ return ProfiledImpl(__func__)->GetType(); }
 
 std::string
 DeviceInstance::GetName() const
 {
    DeviceStringBuffer nameBuf(this, "GetName");
-   pImpl_->GetName(nameBuf.GetBuffer());
+   ProfiledImpl(__func__)->GetName(nameBuf.GetBuffer());
    return nameBuf.Get();
 }
 
 void
 DeviceInstance::SetCallback(MM::Core* callback) { 
-   pImpl_->SetCallback(callback); 
+   ProfiledImpl(__func__)->SetCallback(callback); 
 }
 
 
 bool
 DeviceInstance::SupportsDeviceDetection()
 {
-    return pImpl_->SupportsDeviceDetection();
+    return ProfiledImpl(__func__)->SupportsDeviceDetection();
 }
 
 MM::DeviceDetectionStatus
 DeviceInstance::DetectDevice()
-{ return pImpl_->DetectDevice(); }
+{ return ProfiledImpl(__func__)->DetectDevice(); }
 
 void
 DeviceInstance::SetParentID(const char* parentId)
-{ pImpl_->SetParentID(parentId); }
+{ ProfiledImpl(__func__)->SetParentID(parentId); }
 
 std::string
 DeviceInstance::GetParentID() const
 {
    DeviceStringBuffer nameBuf(this, "GetParentID");
-   pImpl_->GetParentID(nameBuf.GetBuffer());
+   ProfiledImpl(__func__)->GetParentID(nameBuf.GetBuffer());
    return nameBuf.Get();
 }
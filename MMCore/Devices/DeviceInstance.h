@@ -20,6 +20,7 @@
 #pragma once
 
 #include "../../MMDevice/MMDeviceConstants.h"
+#include "../DeviceCallProfile.h"
 #include "../Error.h"
 #include "../Logging/Logger.h"
 
@@ -71,6 +72,7 @@ private:
    DeleteDeviceFunction deleteFunction_;
    mm::logging::Logger deviceLogger_;
    mm::logging::Logger coreLogger_;
+   mutable mm::DeviceCallProfile callProfile_;
 
 public:
    boost::shared_ptr<LoadedDeviceAdapter> GetAdapterModule() const /* final */ { return adapter_; }
@@ -82,6 +84,9 @@ public:
    // need it for the few CoreCallback methods that return a device pointer.
    MM::Device* GetRawPtr() const /* final */ { return pImpl_; }
 
+   // Latencies of the calls made through the wrappers below (when enabled)
+   mm::DeviceCallProfile& GetCallProfile() const /* final */ { return callProfile_; }
+
    // Callback API
    int LogMessage(const char* msg, bool debugOnly);
 
@@ -104,6 +109,11 @@ protected:
    const mm::logging::Logger& Logger() const
    { return coreLogger_; }
 
+   // The raw device, for a call that is timed if profiling is enabled:
+   // ProfiledImpl(__func__)->Method(args)
+   mm::ProfiledCall<MM::Device> ProfiledImpl(const char* method) const
+   { return mm::ProfiledCall<MM::Device>(pImpl_, callProfile_, method); }
+
    CMMError MakeException() const;
    CMMError MakeExceptionForCode(int code) const;
    void ThrowError(const std::string& message) const;
@@ -60,4 +60,6 @@ protected:
 
 protected:
    RawDeviceClass* GetImpl() const /* final */ { return static_cast<RawDeviceClass*>(pImpl_); }
+   mm::ProfiledCall<RawDeviceClass> ProfiledImpl(const char* method) const
+   { return mm::ProfiledCall<RawDeviceClass>(GetImpl(), GetCallProfile(), method); }
 };
@@ -22,27 +22,27 @@
 #include "GalvoInstance.h"
 
 
-int GalvoInstance::PointAndFire(double x, double y, double time_us) { return GetImpl()->PointAndFire(x, y, time_us); }
-int GalvoInstance::SetSpotInterval(double pulseInterval_us) { return GetImpl()->SetSpotInterval(pulseInterval_us); }
-int GalvoInstance::SetPosition(double x, double y) { return GetImpl()->SetPosition(x, y); }
-int GalvoInstance::GetPosition(double& x, double& y) { return GetImpl()->GetPosition(x, y); }
-int GalvoInstance::SetIlluminationState(bool on) { return GetImpl()->SetIlluminationState(on); }
-double GalvoInstance::GetXRange() { return GetImpl()->GetXRange(); }
-double GalvoInstance::GetXMinimum() { return GetImpl()->GetXMinimum(); }
-double GalvoInstance::GetYRange() { return GetImpl()->GetYRange(); }
-double GalvoInstance::GetYMinimum() { return GetImpl()->GetYMinimum(); }
-int GalvoInstance::AddPolygonVertex(int polygonIndex, double x, double y) { return GetImpl()->AddPolygonVertex(polygonIndex, x, y); }
-int GalvoInstance::DeletePolygons() { return GetImpl()->DeletePolygons(); }
-int GalvoInstance::RunSequence() { return GetImpl()->RunSequence(); }
-int GalvoInstance::LoadPolygons() { return GetImpl()->LoadPolygons(); }
-int GalvoInstance::SetPolygonRepetitions(int repetitions) { return GetImpl()->SetPolygonRepetitions(repetitions); }
-int GalvoInstance::RunPolygons() { return GetImpl()->RunPolygons(); }
-int GalvoInstance::StopSequence() { return GetImpl()->StopSequence(); }
+int GalvoInstance::PointAndFire(double x, double y, double time_us) { return ProfiledImpl(__func__)->PointAndFire(x, y, time_us); }
+int GalvoInstance::SetSpotInterval(double pulseInterval_us) { return ProfiledImpl(__func__)->SetSpotInterval(pulseInterval_us); }
+int GalvoInstance::SetPosition(double x, double y) { return ProfiledImpl(__func__)->SetPosition(x, y); }
+int GalvoInstance::GetPosition(double& x, double& y) { return ProfiledImpl(__func__)->GetPosition(x, y); }
+int GalvoInstance::SetIlluminationState(bool on) { return ProfiledImpl(__func__)->SetIlluminationState(on); }
+double GalvoInstance::GetXRange() { return ProfiledImpl(__func__)->GetXRange(); }
+double GalvoInstance::GetXMinimum() { return ProfiledImpl(__func__)->GetXMinimum(); }
+double GalvoInstance::GetYRange() { return ProfiledImpl(__func__)->GetYRange(); }
+double GalvoInstance::GetYMinimum() { return ProfiledImpl(__func__)->GetYMinimum(); }
+int GalvoInstance::AddPolygonVertex(int polygonIndex, double x, double y) { return ProfiledImpl(__func__)->AddPolygonVertex(polygonIndex, x, y); }
+int GalvoInstance::DeletePolygons() { return ProfiledImpl(__func__)->DeletePolygons(); }
+int GalvoInstance::RunSequence() { return ProfiledImpl(__func__)->RunSequence(); }
+int GalvoInstance::LoadPolygons() { return ProfiledImpl(__func__)->LoadPolygons(); }
+int GalvoInstance::SetPolygonRepetitions(int repetitions) { return ProfiledImpl(__func__)->SetPolygonRepetitions(repetitions); }
+int GalvoInstance::RunPolygons() { return ProfiledImpl(__func__)->RunPolygons(); }
+int GalvoInstance::StopSequence() { return ProfiledImpl(__func__)->StopSequence(); }
 
 std::string GalvoInstance::GetChannel()
 {
    DeviceStringBuffer nameBuf(this, "GetChannel");
-   int err = GetImpl()->GetChannel(nameBuf.GetBuffer());
+   int err = ProfiledImpl(__func__)->GetChannel(nameBuf.GetBuffer());
    ThrowIfError(err, "Cannot get current channel name");
    return nameBuf.Get();
 }
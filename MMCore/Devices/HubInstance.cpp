@@ -97,20 +97,34 @@ void HubInstance::DetectInstalledDevices()
 
    if (!hasDetectedInstalledDevices_)
    {
-      detectInstalledDevicesStatus_ = GetImpl()->DetectInstalledDevices();
+      detectInstalledDevicesStatus_ = ProfiledImpl(__func__)->DetectInstalledDevices();
       hasDetectedInstalledDevices_ = true;
    }
    ThrowIfError(detectInstalledDevicesStatus_,
          "Failed to detect installed peripheral devices");
 }
 
-unsigned HubInstance::GetNumberOfInstalledDevices() { return GetImpl()->GetNumberOfInstalledDevices(); }
+unsigned HubInstance::GetNumberOfInstalledDevices() { return ProfiledImpl(__func__)->GetNumberOfInstalledDevices(); }
 
 MM::Device* HubInstance::GetInstalledDevice(int devIdx)
 {
-   MM::Device* peripheral = GetImpl()->GetInstalledDevice(devIdx);
+   MM::Device* peripheral = ProfiledImpl(__func__)->GetInstalledDevice(devIdx);
    if (!peripheral)
       throw CMMError("Hub " + ToQuotedString(GetLabel()) +
             " returned a null peripheral at index " + ToString(devIdx));
    return peripheral;
 }
+
+bool HubInstance::SnapPeripheralBusyStates()
+{
+   int err = ProfiledImpl(__func__)->SnapPeripheralBusyStates();
+   if (err == DEVICE_UNSUPPORTED_COMMAND)
+      return false;
+   ThrowIfError(err, "Failed to query the busy state of peripheral devices");
+   return true;
+}
+
+bool HubInstance::GetPeripheralBusy(boost::shared_ptr<DeviceInstance> peripheral, bool& busy)
+{
+   return ProfiledImpl(__func__)->GetPeripheralBusy(peripheral->GetRawPtr(), busy);
+}
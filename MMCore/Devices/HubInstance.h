@@ -47,6 +47,12 @@ public:
    // ultimately used. Perhaps should remove from Core API.
    std::string GetInstalledPeripheralDescription(const std::string& peripheralName);
 
+   // Busy state of the loaded peripherals, queried all at once. Returns false
+   // if the hub does not support it.
+   bool SnapPeripheralBusyStates();
+   // Returns false if the snapshot does not cover peripheral
+   bool GetPeripheralBusy(boost::shared_ptr<DeviceInstance> peripheral, bool& busy);
+
 private:
    std::vector<MM::Device*> GetInstalledPeripherals();
 
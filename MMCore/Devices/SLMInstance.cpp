@@ -22,26 +22,26 @@
 #include "SLMInstance.h"
 
 
-int SLMInstance::SetImage(unsigned char* pixels) { return GetImpl()->SetImage(pixels); }
-int SLMInstance::SetImage(unsigned int* pixels) { return GetImpl()->SetImage(pixels); }
-int SLMInstance::DisplayImage() { return GetImpl()->DisplayImage(); }
-int SLMInstance::SetPixelsTo(unsigned char intensity) { return GetImpl()->SetPixelsTo(intensity); }
-int SLMInstance::SetPixelsTo(unsigned char red, unsigned char green, unsigned char blue) { return GetImpl()->SetPixelsTo(red, green, blue); }
-int SLMInstance::SetExposure(double interval_ms) { return GetImpl()->SetExposure(interval_ms); }
-double SLMInstance::GetExposure() { return GetImpl()->GetExposure(); }
-unsigned SLMInstance::GetWidth() { return GetImpl()->GetWidth(); }
-unsigned SLMInstance::GetHeight() { return GetImpl()->GetHeight(); }
-unsigned SLMInstance::GetNumberOfComponents() { return GetImpl()->GetNumberOfComponents(); }
-unsigned SLMInstance::GetBytesPerPixel() { return GetImpl()->GetBytesPerPixel(); }
+int SLMInstance::SetImage(unsigned char* pixels) { return ProfiledImpl(__func__)->SetImage(pixels); }
+int SLMInstance::SetImage(unsigned int* pixels) { return ProfiledImpl(__func__)->SetImage(pixels); }
+int SLMInstance::DisplayImage() { return ProfiledImpl(__func__)->DisplayImage(); }
+int SLMInstance::SetPixelsTo(unsigned char intensity) { return ProfiledImpl(__func__)->SetPixelsTo(intensity); }
+int SLMInstance::SetPixelsTo(unsigned char red, unsigned char green, unsigned char blue) { return ProfiledImpl(__func__)->SetPixelsTo(red, green, blue); }
+int SLMInstance::SetExposure(double interval_ms) { return ProfiledImpl(__func__)->SetExposure(interval_ms); }
+double SLMInstance::GetExposure() { return ProfiledImpl(__func__)->GetExposure(); }
+unsigned SLMInstance::GetWidth() { return ProfiledImpl(__func__)->GetWidth(); }
+unsigned SLMInstance::GetHeight() { return ProfiledImpl(__func__)->GetHeight(); }
+unsigned SLMInstance::GetNumberOfComponents() { return ProfiledImpl(__func__)->GetNumberOfComponents(); }
+unsigned SLMInstance::GetBytesPerPixel() { return ProfiledImpl(__func__)->GetBytesPerPixel(); }
 int SLMInstance::IsSLMSequenceable(bool& isSequenceable)
-{ return GetImpl()->IsSLMSequenceable(isSequenceable); }
+{ return ProfiledImpl(__func__)->IsSLMSequenceable(isSequenceable); }
 int SLMInstance::GetSLMSequenceMaxLength(long& nrEvents)
-{ return GetImpl()->GetSLMSequenceMaxLength(nrEvents); }
-int SLMInstance::StartSLMSequence() { return GetImpl()->StartSLMSequence(); }
-int SLMInstance::StopSLMSequence() { return GetImpl()->StopSLMSequence(); }
-int SLMInstance::ClearSLMSequence() { return GetImpl()->ClearSLMSequence(); }
+{ return ProfiledImpl(__func__)->GetSLMSequenceMaxLength(nrEvents); }
+int SLMInstance::StartSLMSequence() { return ProfiledImpl(__func__)->StartSLMSequence(); }
+int SLMInstance::StopSLMSequence() { return ProfiledImpl(__func__)->StopSLMSequence(); }
+int SLMInstance::ClearSLMSequence() { return ProfiledImpl(__func__)->ClearSLMSequence(); }
 int SLMInstance::AddToSLMSequence(const unsigned char * pixels)
-{ return GetImpl()->AddToSLMSequence(pixels); }
+{ return ProfiledImpl(__func__)->AddToSLMSequence(pixels); }
 int SLMInstance::AddToSLMSequence(const unsigned int * pixels)
-{ return GetImpl()->AddToSLMSequence(pixels); }
-int SLMInstance::SendSLMSequence() { return GetImpl()->SendSLMSequence(); }
+{ return ProfiledImpl(__func__)->AddToSLMSequence(pixels); }
+int SLMInstance::SendSLMSequence() { return ProfiledImpl(__func__)->SendSLMSequence(); }
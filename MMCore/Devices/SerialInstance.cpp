@@ -22,9 +22,12 @@
 #include "SerialInstance.h"
 
 
-MM::PortType SerialInstance::GetPortType() const { return GetImpl()->GetPortType(); }
-int SerialInstance::SetCommand(const char* command, const char* term) { return GetImpl()->SetCommand(command, term); }
-int SerialInstance::GetAnswer(char* txt, unsigned maxChars, const char* term) { return GetImpl()->GetAnswer(txt, maxChars, term); }
-int SerialInstance::Write(const unsigned char* buf, unsigned long bufLen) { return GetImpl()->Write(buf, bufLen); }
-int SerialInstance::Read(unsigned char* buf, unsigned long bufLen, unsigned long& charsRead) { return GetImpl()->Read(buf, bufLen, charsRead); }
-int SerialInstance::Purge() { return GetImpl()->Purge(); }
+MM::PortType SerialInstance::GetPortType() const { return ProfiledImpl(__func__)->GetPortType(); }
+int SerialInstance::SetCommand(const char* command, const char* term) { return ProfiledImpl(__func__)->SetCommand(command, term); }
+int SerialInstance::GetAnswer(char* txt, unsigned maxChars, const char* term) { return ProfiledImpl(__func__)->GetAnswer(txt, maxChars, term); }
+int SerialInstance::Write(const unsigned char* buf, unsigned long bufLen) { return ProfiledImpl(__func__)->Write(buf, bufLen); }
+int SerialInstance::Read(unsigned char* buf, unsigned long bufLen, unsigned long& charsRead) { return ProfiledImpl(__func__)->Read(buf, bufLen, charsRead); }
+int SerialInstance::Purge() { return ProfiledImpl(__func__)->Purge(); }
+int SerialInstance::WaitForData(unsigned long timeoutMs, bool& dataAvailable) { return ProfiledImpl(__func__)->WaitForData(timeoutMs, dataAvailable); }
+int SerialInstance::AddDataCallback(MM::SerialDataCallback* callback) { return ProfiledImpl(__func__)->AddDataCallback(callback); }
+int SerialInstance::RemoveDataCallback(MM::SerialDataCallback* callback) { return ProfiledImpl(__func__)->RemoveDataCallback(callback); }
@@ -42,4 +42,7 @@ public:
    int Write(const unsigned char* buf, unsigned long bufLen);
    int Read(unsigned char* buf, unsigned long bufLen, unsigned long& charsRead);
    int Purge();
+   int WaitForData(unsigned long timeoutMs, bool& dataAvailable);
+   int AddDataCallback(MM::SerialDataCallback* callback);
+   int RemoveDataCallback(MM::SerialDataCallback* callback);
 };
@@ -22,6 +22,6 @@
 #include "ShutterInstance.h"
 
 
-int ShutterInstance::SetOpen(bool open) { return GetImpl()->SetOpen(open); }
-int ShutterInstance::GetOpen(bool& open) { return GetImpl()->GetOpen(open); }
-int ShutterInstance::Fire(double deltaT) { return GetImpl()->Fire(deltaT); }
+int ShutterInstance::SetOpen(bool open) { return ProfiledImpl(__func__)->SetOpen(open); }
+int ShutterInstance::GetOpen(bool& open) { return ProfiledImpl(__func__)->GetOpen(open); }
+int ShutterInstance::Fire(double deltaT) { return ProfiledImpl(__func__)->Fire(deltaT); }
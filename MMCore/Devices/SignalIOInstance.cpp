@@ -22,15 +22,15 @@
 #include "SignalIOInstance.h"
 
 
-int SignalIOInstance::SetGateOpen(bool open) { return GetImpl()->SetGateOpen(open); }
-int SignalIOInstance::GetGateOpen(bool& open) { return GetImpl()->GetGateOpen(open); }
-int SignalIOInstance::SetSignal(double volts) { return GetImpl()->SetSignal(volts); }
-int SignalIOInstance::GetSignal(double& volts) { return GetImpl()->GetSignal(volts); }
-int SignalIOInstance::GetLimits(double& minVolts, double& maxVolts) { return GetImpl()->GetLimits(minVolts, maxVolts); }
-int SignalIOInstance::IsDASequenceable(bool& isSequenceable) const { return GetImpl()->IsDASequenceable(isSequenceable); }
-int SignalIOInstance::GetDASequenceMaxLength(long& nrEvents) const { return GetImpl()->GetDASequenceMaxLength(nrEvents); }
-int SignalIOInstance::StartDASequence() { return GetImpl()->StartDASequence(); }
-int SignalIOInstance::StopDASequence() { return GetImpl()->StopDASequence(); }
-int SignalIOInstance::ClearDASequence() { return GetImpl()->ClearDASequence(); }
-int SignalIOInstance::AddToDASequence(double voltage) { return GetImpl()->AddToDASequence(voltage); }
-int SignalIOInstance::SendDASequence() { return GetImpl()->SendDASequence(); }
+int SignalIOInstance::SetGateOpen(bool open) { return ProfiledImpl(__func__)->SetGateOpen(open); }
+int SignalIOInstance::GetGateOpen(bool& open) { return ProfiledImpl(__func__)->GetGateOpen(open); }
+int SignalIOInstance::SetSignal(double volts) { return ProfiledImpl(__func__)->SetSignal(volts); }
+int SignalIOInstance::GetSignal(double& volts) { return ProfiledImpl(__func__)->GetSignal(volts); }
+int SignalIOInstance::GetLimits(double& minVolts, double& maxVolts) { return ProfiledImpl(__func__)->GetLimits(minVolts, maxVolts); }
+int SignalIOInstance::IsDASequenceable(bool& isSequenceable) const { return ProfiledImpl(__func__)->IsDASequenceable(isSequenceable); }
+int SignalIOInstance::GetDASequenceMaxLength(long& nrEvents) const { return ProfiledImpl(__func__)->GetDASequenceMaxLength(nrEvents); }
+int SignalIOInstance::StartDASequence() { return ProfiledImpl(__func__)->StartDASequence(); }
+int SignalIOInstance::StopDASequence() { return ProfiledImpl(__func__)->StopDASequence(); }
+int SignalIOInstance::ClearDASequence() { return ProfiledImpl(__func__)->ClearDASequence(); }
+int SignalIOInstance::AddToDASequence(double voltage) { return ProfiledImpl(__func__)->AddToDASequence(voltage); }
+int SignalIOInstance::SendDASequence() { return ProfiledImpl(__func__)->SendDASequence(); }
@@ -22,17 +22,17 @@
 #include "StageInstance.h"
 
 
-int StageInstance::SetPositionUm(double pos) { return GetImpl()->SetPositionUm(pos); }
-int StageInstance::SetRelativePositionUm(double d) { return GetImpl()->SetRelativePositionUm(d); }
-int StageInstance::Move(double velocity) { return GetImpl()->Move(velocity); }
-int StageInstance::Stop() { return GetImpl()->Stop(); }
-int StageInstance::Home() { return GetImpl()->Home(); }
-int StageInstance::SetAdapterOriginUm(double d) { return GetImpl()->SetAdapterOriginUm(d); }
-int StageInstance::GetPositionUm(double& pos) { return GetImpl()->GetPositionUm(pos); }
-int StageInstance::SetPositionSteps(long steps) { return GetImpl()->SetPositionSteps(steps); }
-int StageInstance::GetPositionSteps(long& steps) { return GetImpl()->GetPositionSteps(steps); }
-int StageInstance::SetOrigin() { return GetImpl()->SetOrigin(); }
-int StageInstance::GetLimits(double& lower, double& upper) { return GetImpl()->GetLimits(lower, upper); }
+int StageInstance::SetPositionUm(double pos) { return ProfiledImpl(__func__)->SetPositionUm(pos); }
+int StageInstance::SetRelativePositionUm(double d) { return ProfiledImpl(__func__)->SetRelativePositionUm(d); }
+int StageInstance::Move(double velocity) { return ProfiledImpl(__func__)->Move(velocity); }
+int StageInstance::Stop() { return ProfiledImpl(__func__)->Stop(); }
+int StageInstance::Home() { return ProfiledImpl(__func__)->Home(); }
+int StageInstance::SetAdapterOriginUm(double d) { return ProfiledImpl(__func__)->SetAdapterOriginUm(d); }
+int StageInstance::GetPositionUm(double& pos) { return ProfiledImpl(__func__)->GetPositionUm(pos); }
+int StageInstance::SetPositionSteps(long steps) { return ProfiledImpl(__func__)->SetPositionSteps(steps); }
+int StageInstance::GetPositionSteps(long& steps) { return ProfiledImpl(__func__)->GetPositionSteps(steps); }
+int StageInstance::SetOrigin() { return ProfiledImpl(__func__)->SetOrigin(); }
+int StageInstance::GetLimits(double& lower, double& upper) { return ProfiledImpl(__func__)->GetLimits(lower, upper); }
 
 MM::FocusDirection
 StageInstance::GetFocusDirection()
@@ -41,7 +41,7 @@ StageInstance::GetFocusDirection()
    if (!focusDirectionHasBeenSet_)
    {
       MM::FocusDirection direction;
-      int err = GetImpl()->GetFocusDirection(direction);
+      int err = ProfiledImpl(__func__)->GetFocusDirection(direction);
       ThrowIfError(err, "Cannot get focus direction");
 
       focusDirection_ = direction;
@@ -57,14 +57,14 @@ StageInstance::SetFocusDirection(MM::FocusDirection direction)
    focusDirectionHasBeenSet_ = true;
 }
 
-int StageInstance::IsStageSequenceable(bool& isSequenceable) const { return GetImpl()->IsStageSequenceable(isSequenceable); }
-int StageInstance::IsStageLinearSequenceable(bool& isSequenceable) const { return GetImpl()->IsStageLinearSequenceable(isSequenceable); }
-bool StageInstance::IsContinuousFocusDrive() const { return GetImpl()->IsContinuousFocusDrive(); }
-int StageInstance::GetStageSequenceMaxLength(long& nrEvents) const { return GetImpl()->GetStageSequenceMaxLength(nrEvents); }
-int StageInstance::StartStageSequence() { return GetImpl()->StartStageSequence(); }
-int StageInstance::StopStageSequence() { return GetImpl()->StopStageSequence(); }
-int StageInstance::ClearStageSequence() { return GetImpl()->ClearStageSequence(); }
-int StageInstance::AddToStageSequence(double position) { return GetImpl()->AddToStageSequence(position); }
-int StageInstance::SendStageSequence() { return GetImpl()->SendStageSequence(); }
+int StageInstance::IsStageSequenceable(bool& isSequenceable) const { return ProfiledImpl(__func__)->IsStageSequenceable(isSequenceable); }
+int StageInstance::IsStageLinearSequenceable(bool& isSequenceable) const { return ProfiledImpl(__func__)->IsStageLinearSequenceable(isSequenceable); }
+bool StageInstance::IsContinuousFocusDrive() const { return ProfiledImpl(__func__)->IsContinuousFocusDrive(); }
+int StageInstance::GetStageSequenceMaxLength(long& nrEvents) const { return ProfiledImpl(__func__)->GetStageSequenceMaxLength(nrEvents); }
+int StageInstance::StartStageSequence() { return ProfiledImpl(__func__)->StartStageSequence(); }
+int StageInstance::StopStageSequence() { return ProfiledImpl(__func__)->StopStageSequence(); }
+int StageInstance::ClearStageSequence() { return ProfiledImpl(__func__)->ClearStageSequence(); }
+int StageInstance::AddToStageSequence(double position) { return ProfiledImpl(__func__)->AddToStageSequence(position); }
+int StageInstance::SendStageSequence() { return ProfiledImpl(__func__)->SendStageSequence(); }
 int StageInstance::SetStageLinearSequence(double dZ_um, long nSlices)
-{ return GetImpl()->SetStageLinearSequence(dZ_um, nSlices); }
\ No newline at end of file
+{ return ProfiledImpl(__func__)->SetStageLinearSequence(dZ_um, nSlices); }
\ No newline at end of file
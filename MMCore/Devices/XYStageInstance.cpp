@@ -22,27 +22,27 @@
 #include "XYStageInstance.h"
 
 
-int XYStageInstance::SetPositionUm(double x, double y) { return GetImpl()->SetPositionUm(x, y); }
-int XYStageInstance::SetRelativePositionUm(double dx, double dy) { return GetImpl()->SetRelativePositionUm(dx, dy); }
-int XYStageInstance::SetAdapterOriginUm(double x, double y) { return GetImpl()->SetAdapterOriginUm(x, y); }
-int XYStageInstance::GetPositionUm(double& x, double& y) { return GetImpl()->GetPositionUm(x, y); }
-int XYStageInstance::GetLimitsUm(double& xMin, double& xMax, double& yMin, double& yMax) { return GetImpl()->GetLimitsUm(xMin, xMax, yMin, yMax); }
-int XYStageInstance::Move(double vx, double vy) { return GetImpl()->Move(vx, vy); }
-int XYStageInstance::SetPositionSteps(long x, long y) { return GetImpl()->SetPositionSteps(x, y); }
-int XYStageInstance::GetPositionSteps(long& x, long& y) { return GetImpl()->GetPositionSteps(x, y); }
-int XYStageInstance::SetRelativePositionSteps(long x, long y) { return GetImpl()->SetRelativePositionSteps(x, y); }
-int XYStageInstance::Home() { return GetImpl()->Home(); }
-int XYStageInstance::Stop() { return GetImpl()->Stop(); }
-int XYStageInstance::SetOrigin() { return GetImpl()->SetOrigin(); }
-int XYStageInstance::SetXOrigin() { return GetImpl()->SetXOrigin(); }
-int XYStageInstance::SetYOrigin() { return GetImpl()->SetYOrigin(); }
-int XYStageInstance::GetStepLimits(long& xMin, long& xMax, long& yMin, long& yMax) { return GetImpl()->GetStepLimits(xMin, xMax, yMin, yMax); }
-double XYStageInstance::GetStepSizeXUm() { return GetImpl()->GetStepSizeXUm(); }
-double XYStageInstance::GetStepSizeYUm() { return GetImpl()->GetStepSizeYUm(); }
-int XYStageInstance::IsXYStageSequenceable(bool& isSequenceable) const { return GetImpl()->IsXYStageSequenceable(isSequenceable); }
-int XYStageInstance::GetXYStageSequenceMaxLength(long& nrEvents) const { return GetImpl()->GetXYStageSequenceMaxLength(nrEvents); }
-int XYStageInstance::StartXYStageSequence() { return GetImpl()->StartXYStageSequence(); }
-int XYStageInstance::StopXYStageSequence() { return GetImpl()->StopXYStageSequence(); }
-int XYStageInstance::ClearXYStageSequence() { return GetImpl()->ClearXYStageSequence(); }
-int XYStageInstance::AddToXYStageSequence(double positionX, double positionY) { return GetImpl()->AddToXYStageSequence(positionX, positionY); }
-int XYStageInstance::SendXYStageSequence() { return GetImpl()->SendXYStageSequence(); }
+int XYStageInstance::SetPositionUm(double x, double y) { return ProfiledImpl(__func__)->SetPositionUm(x, y); }
+int XYStageInstance::SetRelativePositionUm(double dx, double dy) { return ProfiledImpl(__func__)->SetRelativePositionUm(dx, dy); }
+int XYStageInstance::SetAdapterOriginUm(double x, double y) { return ProfiledImpl(__func__)->SetAdapterOriginUm(x, y); }
+int XYStageInstance::GetPositionUm(double& x, double& y) { return ProfiledImpl(__func__)->GetPositionUm(x, y); }
+int XYStageInstance::GetLimitsUm(double& xMin, double& xMax, double& yMin, double& yMax) { return ProfiledImpl(__func__)->GetLimitsUm(xMin, xMax, yMin, yMax); }
+int XYStageInstance::Move(double vx, double vy) { return ProfiledImpl(__func__)->Move(vx, vy); }
+int XYStageInstance::SetPositionSteps(long x, long y) { return ProfiledImpl(__func__)->SetPositionSteps(x, y); }
+int XYStageInstance::GetPositionSteps(long& x, long& y) { return ProfiledImpl(__func__)->GetPositionSteps(x, y); }
+int XYStageInstance::SetRelativePositionSteps(long x, long y) { return ProfiledImpl(__func__)->SetRelativePositionSteps(x, y); }
+int XYStageInstance::Home() { return ProfiledImpl(__func__)->Home(); }
+int XYStageInstance::Stop() { return ProfiledImpl(__func__)->Stop(); }
+int XYStageInstance::SetOrigin() { return ProfiledImpl(__func__)->SetOrigin(); }
+int XYStageInstance::SetXOrigin() { return ProfiledImpl(__func__)->SetXOrigin(); }
+int XYStageInstance::SetYOrigin() { return ProfiledImpl(__func__)->SetYOrigin(); }
+int XYStageInstance::GetStepLimits(long& xMin, long& xMax, long& yMin, long& yMax) { return ProfiledImpl(__func__)->GetStepLimits(xMin, xMax, yMin, yMax); }
+double XYStageInstance::GetStepSizeXUm() { return ProfiledImpl(__func__)->GetStepSizeXUm(); }
+double XYStageInstance::GetStepSizeYUm() { return ProfiledImpl(__func__)->GetStepSizeYUm(); }
+int XYStageInstance::IsXYStageSequenceable(bool& isSequenceable) const { return ProfiledImpl(__func__)->IsXYStageSequenceable(isSequenceable); }
+int XYStageInstance::GetXYStageSequenceMaxLength(long& nrEvents) const { return ProfiledImpl(__func__)->GetXYStageSequenceMaxLength(nrEvents); }
+int XYStageInstance::StartXYStageSequence() { return ProfiledImpl(__func__)->StartXYStageSequence(); }
+int XYStageInstance::StopXYStageSequence() { return ProfiledImpl(__func__)->StopXYStageSequence(); }
+int XYStageInstance::ClearXYStageSequence() { return ProfiledImpl(__func__)->ClearXYStageSequence(); }
+int XYStageInstance::AddToXYStageSequence(double positionX, double positionY) { return ProfiledImpl(__func__)->AddToXYStageSequence(positionX, positionY); }
+int XYStageInstance::SendXYStageSequence() { return ProfiledImpl(__func__)->SendXYStageSequence(); }
@@ -0,0 +1,315 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DiskStream.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Streaming of sequence acquisition frames from any camera to
+//                raw files, next to or instead of the circular buffer.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DiskStream.h"
+
+#include <boost/make_shared.hpp>
+
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+namespace mm {
+
+DiskStream::DiskStream() :
+   enabled_(false),
+   sessionIdRepeats_(0),
+   finishedFrames_(0)
+{
+}
+
+DiskStream::~DiskStream()
+{
+   FinishAll();
+}
+
+void DiskStream::SetEnabled(bool enable)
+{
+   if (!enable)
+      FinishAll();
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   enabled_ = enable;
+}
+
+bool DiskStream::IsEnabled() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   return enabled_;
+}
+
+void DiskStream::SetSettings(const DiskStreamSettings& settings)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   settings_ = settings;
+}
+
+bool DiskStream::KeepsImagesInBuffer() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   return !enabled_ || settings_.keepInBuffer;
+}
+
+DiskStreamSettings DiskStream::GetSettings() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   return settings_;
+}
+
+bool DiskStream::Write(const std::string& camera, const unsigned char* pixels,
+      unsigned width, unsigned height, unsigned bytesPerPixel,
+      unsigned nComponents, std::string& errorText)
+{
+   for (;;)
+   {
+      CameraStreamPtr stream;
+      bool sizeMatches;
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         if (!enabled_)
+            return true;
+
+         std::map<std::string, CameraStreamPtr>::iterator it =
+            streams_.find(camera);
+         if (it != streams_.end())
+            stream = it->second;
+         else
+         {
+            stream = StartCamera(camera, width, height, bytesPerPixel,
+                  nComponents, errorText);
+            if (!stream)
+               return false;
+         }
+
+         sizeMatches = width == stream->width && height == stream->height &&
+            bytesPerPixel == stream->bytesPerPixel;
+         if (!sizeMatches)
+            DetachCamera(camera, stream);
+      }
+
+      if (!sizeMatches)
+      {
+         std::string ignored;
+         FinishCamera(stream, ignored);
+         errorText = "Image size of camera " + camera +
+            " changed while streaming to disk";
+         return false;
+      }
+
+      boost::shared_lock<boost::shared_mutex> useLock(stream->useMutex);
+      // A stream finished since the lookup is replaced by a new one, as if
+      // the frame had arrived after the finish
+      if (stream->finished)
+         continue;
+      if (stream->writer->WriteFrame(pixels))
+         return true;
+      useLock.unlock();
+
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         DetachCamera(camera, stream);
+      }
+      FinishCamera(stream, errorText);
+      if (errorText.empty())
+         errorText = stream->writer->GetErrorMessage();
+      return false;
+   }
+}
+
+bool DiskStream::Finish(const std::string& camera, std::string& errorText)
+{
+   CameraStreamPtr stream;
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      std::map<std::string, CameraStreamPtr>::iterator it =
+         streams_.find(camera);
+      if (it == streams_.end())
+         return true;
+      stream = it->second;
+      streams_.erase(it);
+   }
+   return FinishCamera(stream, errorText);
+}
+
+void DiskStream::FinishAll()
+{
+   std::map<std::string, CameraStreamPtr> streams;
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      streams.swap(streams_);
+   }
+   for (std::map<std::string, CameraStreamPtr>::iterator it = streams.begin();
+         it != streams.end(); ++it)
+   {
+      std::string ignored;
+      FinishCamera(it->second, ignored);
+   }
+}
+
+std::string DiskStream::GetSessionPath() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   return sessionPath_;
+}
+
+unsigned long long DiskStream::GetFramesWritten() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   unsigned long long frames = finishedFrames_;
+   for (std::map<std::string, CameraStreamPtr>::const_iterator it =
+         streams_.begin(); it != streams_.end(); ++it)
+      frames += it->second->writer->GetFramesWritten();
+   return frames;
+}
+
+DiskStream::CameraStreamPtr DiskStream::StartCamera(const std::string& camera,
+      unsigned width, unsigned height, unsigned bytesPerPixel,
+      unsigned nComponents, std::string& errorText)
+{
+   if (streams_.empty() && !StartSession(errorText))
+      return CameraStreamPtr();
+
+   CameraStreamPtr stream = boost::make_shared<CameraStream>();
+   stream->writer = boost::make_shared<MMStreamWriter>();
+   stream->width = width;
+   stream->height = height;
+   stream->bytesPerPixel = bytesPerPixel;
+   stream->sessionPath = sessionPath_;
+   const std::string prefix = FileNamePrefix(camera);
+   const std::size_t frameBytes =
+      static_cast<std::size_t>(width) * height * bytesPerPixel;
+   if (!stream->writer->Start(sessionPath_, prefix, frameBytes,
+            settings_.writerThreads, settings_.maxFileBytes))
+   {
+      errorText = stream->writer->GetErrorMessage();
+      return CameraStreamPtr();
+   }
+   streams_[camera] = stream;
+
+   // The frames are padded to whole pages, which ImageJ calls the gap
+   const std::string hintsFileName = sessionPath_ + prefix + "_import_imagej.txt";
+   std::ofstream hints(hintsFileName.c_str(), std::ios::trunc);
+   // Color pixels are stored as B, G, R and an unused byte, which ImageJ
+   // can only import as separate 8-bit values
+   const bool color = nComponents > 1;
+   const char* type = "8-bit";
+   if (!color && bytesPerPixel == 2)
+      type = "16-bit Unsigned";
+   else if (!color && bytesPerPixel == 4)
+      type = "32-bit Unsigned";
+   const unsigned importWidth = color ? width * bytesPerPixel : width;
+   hints << "To import the frames of " << camera << " in ImageJ, drag & drop a .raw file\n"
+      << "into the ImageJ window or select File -> Import -> Raw..., and set:\n"
+      << "- Image type: " << type << "\n"
+      << "- Width: " << importWidth << " pixels" <<
+         (color ? " (B, G, R, unused for each pixel)" : "") << "\n"
+      << "- Height: " << height << " pixels\n"
+      << "- Offset to first image: 0 bytes\n"
+      << "- Number of images: " << stream->writer->GetFramesPerFile() << "\n"
+      << "  (the maximum per file; ImageJ loads those available)\n"
+      << "- Gap between images: " <<
+         stream->writer->GetFrameBytesOnDisk() - frameBytes << " bytes\n"
+      << "- White is zero: unchecked\n"
+      << "- Little-endian byte order: checked\n";
+   return stream;
+}
+
+bool DiskStream::StartSession(std::string& errorText)
+{
+   const std::time_t now = std::time(0);
+   std::tm tm;
+#ifdef _WIN32
+   localtime_s(&tm, &now);
+#else
+   localtime_r(&now, &tm);
+#endif
+   char buffer[32];
+   std::strftime(buffer, sizeof(buffer), "%Y-%m-%d_%H-%M-%S", &tm);
+
+   // Sequences started within the same second get numbered sessions
+   std::string sessionId = buffer;
+   if (sessionId == lastSessionId_)
+   {
+      std::ostringstream oss;
+      oss << sessionId << "_" << ++sessionIdRepeats_ + 1;
+      sessionId = oss.str();
+   }
+   else
+   {
+      lastSessionId_ = sessionId;
+      sessionIdRepeats_ = 0;
+   }
+
+   std::string root = settings_.directory;
+   if (!root.empty() && root[root.size() - 1] != '/' &&
+         root[root.size() - 1] != '\\')
+      root += '/';
+   const std::string path = root + sessionId + '/';
+   if (settings_.directory.empty() || !MMStreamWriter::CreateDirectories(path))
+   {
+      errorText = "Cannot create directory '" + path + "' for streaming to disk";
+      return false;
+   }
+   sessionPath_ = path;
+   finishedFrames_ = 0;
+   return true;
+}
+
+void DiskStream::DetachCamera(const std::string& camera,
+      const CameraStreamPtr& stream)
+{
+   std::map<std::string, CameraStreamPtr>::iterator it = streams_.find(camera);
+   if (it != streams_.end() && it->second == stream)
+      streams_.erase(it);
+}
+
+bool DiskStream::FinishCamera(const CameraStreamPtr& stream,
+      std::string& errorText)
+{
+   // Waits for frames being queued by other threads
+   boost::unique_lock<boost::shared_mutex> useLock(stream->useMutex);
+   if (stream->finished)
+      return true;
+   stream->finished = true;
+   const bool ok = stream->writer->Stop();
+   if (!ok)
+      errorText = stream->writer->GetErrorMessage();
+   const unsigned long long frames = stream->writer->GetFramesWritten();
+   useLock.unlock();
+
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   if (stream->sessionPath == sessionPath_)
+      finishedFrames_ += frames;
+   return ok;
+}
+
+std::string DiskStream::FileNamePrefix(const std::string& camera)
+{
+   std::string prefix = camera;
+   for (std::string::iterator it = prefix.begin(); it != prefix.end(); ++it)
+   {
+      const char c = *it;
+      const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '-' || c == '_';
+      if (!safe)
+         *it = '_';
+   }
+   return prefix.empty() ? std::string("camera") : prefix;
+}
+
+} // namespace mm
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DiskStream.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Streaming of sequence acquisition frames from any camera to
+//                raw files, next to or instead of the circular buffer.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/DeviceStreamWriter.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+struct DiskStreamSettings
+{
+   std::string directory; // Sessions are created in subdirectories
+   unsigned writerThreads;
+   unsigned long long maxFileBytes; // Before starting a new file
+   bool keepInBuffer; // Also insert frames into the circular buffer
+
+   DiskStreamSettings() :
+      writerThreads(2),
+      maxFileBytes(3ULL * 1024 * 1024 * 1024),
+      keepInBuffer(true)
+   {}
+};
+
+/**
+ * Writes the frames inserted by cameras to raw files, one MMStreamWriter
+ * per camera.
+ *
+ * A camera's files are opened at its first frame and closed by Finish(),
+ * called when its sequence acquisition ends. The first camera to start
+ * after all were finished begins a new session: a subdirectory of the
+ * configured directory, named after the current time, holding files
+ * <camera>_00000.raw, ... and ImageJ import instructions for each camera.
+ *
+ * Frames are copied and queued for writing without holding the lock that
+ * guards the set of streams, so cameras do not wait for each other.
+ */
+class DiskStream
+{
+public:
+   DiskStream();
+   ~DiskStream();
+
+   // Disabling finishes all cameras
+   void SetEnabled(bool enable);
+   bool IsEnabled() const;
+   bool KeepsImagesInBuffer() const; // True unless enabled and bypassing
+
+   // Applies to cameras starting to stream after the call
+   void SetSettings(const DiskStreamSettings& settings);
+   DiskStreamSettings GetSettings() const;
+
+   /**
+    * Writes a frame if enabled. Returns false, setting errorText, if the
+    * frame could not be written; the camera's stream is then finished.
+    */
+   bool Write(const std::string& camera, const unsigned char* pixels,
+         unsigned width, unsigned height, unsigned bytesPerPixel,
+         unsigned nComponents, std::string& errorText);
+
+   /**
+    * Closes the camera's files once all its frames are written. Returns
+    * false, setting errorText, if any failed.
+    */
+   bool Finish(const std::string& camera, std::string& errorText);
+   void FinishAll();
+
+   std::string GetSessionPath() const; // Empty before the first session
+   unsigned long long GetFramesWritten() const; // In the current session
+
+private:
+   struct CameraStream
+   {
+      boost::shared_ptr<MMStreamWriter> writer;
+      unsigned width;
+      unsigned height;
+      unsigned bytesPerPixel;
+      std::string sessionPath;
+
+      // Shared while writing a frame, exclusive while stopping the writer
+      boost::shared_mutex useMutex;
+      bool finished; // Guarded by useMutex
+
+      CameraStream() : width(0), height(0), bytesPerPixel(0),
+         finished(false) {}
+   };
+   typedef boost::shared_ptr<CameraStream> CameraStreamPtr;
+
+   CameraStreamPtr StartCamera(const std::string& camera, unsigned width,
+         unsigned height, unsigned bytesPerPixel, unsigned nComponents,
+         std::string& errorText);
+   bool StartSession(std::string& errorText);
+   // Removes stream from streams_ unless replaced; requires mutex_
+   void DetachCamera(const std::string& camera, const CameraStreamPtr& stream);
+   // Stops a detached stream; must not be called with mutex_ held
+   bool FinishCamera(const CameraStreamPtr& stream, std::string& errorText);
+   static std::string FileNamePrefix(const std::string& camera);
+
+   mutable boost::mutex mutex_; // Guards all of the below
+   bool enabled_;
+   DiskStreamSettings settings_;
+   std::map<std::string, CameraStreamPtr> streams_;
+   std::string sessionPath_;
+   std::string lastSessionId_;
+   unsigned sessionIdRepeats_;
+   unsigned long long finishedFrames_; // Of finished cameras in the session
+};
+
+} // namespace mm
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameAccounting.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-camera accounting of received, dropped and late frames.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "FrameAccounting.h"
+
+#include "../MMDevice/DeviceUtils.h"
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <cstdlib>
+
+
+const double FrameAccounting::lateIntervalFactor = 1.5;
+
+namespace
+{
+
+bool GetTagValue(const Metadata& md, const char* key, std::string& value)
+{
+   if (!md.HasTag(key))
+      return false;
+   value = md.GetSingleTag(key).GetValue();
+   return !value.empty();
+}
+
+} // anonymous namespace
+
+void FrameAccounting::FrameReceived(const std::string& camera, Metadata& md)
+{
+   std::string frameNumberStr, timestampStr;
+   const bool haveFrameNumber =
+      GetTagValue(md, MM::g_Keyword_Metadata_HardwareFrameNumber, frameNumberStr);
+   const bool haveTimestamp =
+      GetTagValue(md, MM::g_Keyword_Metadata_HardwareTimestamp_us, timestampStr);
+
+   MMThreadGuard guard(lock_);
+   CameraState& state = cameras_[camera];
+
+   // A frame sent again after its drop cleared the buffer has already been
+   // counted; it is no longer dropped
+   const bool resent = state.resendExpected && (!haveFrameNumber ||
+         std::strtoll(frameNumberStr.c_str(), 0, 10) == state.lastFrameNumber);
+   state.resendExpected = false;
+   state.lastFrameDropped = false;
+   if (resent)
+   {
+      --state.counts.droppedByBuffer;
+      if (haveFrameNumber)
+      {
+         md.PutImageTag(MM::g_Keyword_Metadata_FrameGap, "0");
+         md.PutImageTag(MM::g_Keyword_Metadata_FramesDroppedByDevice,
+               CDeviceUtils::FormatNumber(state.counts.droppedByDevice));
+      }
+      if (haveTimestamp)
+      {
+         md.PutImageTag(MM::g_Keyword_Metadata_FrameLate, "0");
+         md.PutImageTag(MM::g_Keyword_Metadata_FramesLate,
+               CDeviceUtils::FormatNumber(state.counts.late));
+      }
+      md.PutImageTag(MM::g_Keyword_Metadata_FramesDroppedByBuffer,
+            CDeviceUtils::FormatNumber(state.counts.droppedByBuffer));
+      return;
+   }
+
+   ++state.counts.received;
+
+   long long gap = 0;
+   if (haveFrameNumber)
+   {
+      const long long frameNumber = std::strtoll(frameNumberStr.c_str(), 0, 10);
+      if (state.haveFrameNumber)
+      {
+         if (frameNumber > state.lastFrameNumber)
+            gap = frameNumber - state.lastFrameNumber - 1;
+         else
+         {
+            // The counter was reset (e.g. the camera was restarted); the
+            // interval to the previous frame means nothing
+            ++state.counts.discontinuities;
+            state.haveTimestamp = false;
+         }
+      }
+      state.counts.droppedByDevice += static_cast<long>(gap);
+      state.haveFrameNumber = true;
+      state.lastFrameNumber = frameNumber;
+
+      md.PutImageTag(MM::g_Keyword_Metadata_FrameGap,
+            CDeviceUtils::FormatNumber(static_cast<long>(gap)));
+      md.PutImageTag(MM::g_Keyword_Metadata_FramesDroppedByDevice,
+            CDeviceUtils::FormatNumber(state.counts.droppedByDevice));
+   }
+
+   if (haveTimestamp)
+   {
+      const double timestampUs = std::atof(timestampStr.c_str());
+      bool late = false;
+      if (state.haveTimestamp)
+      {
+         const double intervalUs = timestampUs - state.lastTimestampUs;
+         if (intervalUs <= 0.0)
+         {
+            ++state.counts.discontinuities;
+            state.meanIntervalUs = 0.0;
+         }
+         else
+         {
+            // Frames lost by the device account for a long interval, so
+            // compare per-frame intervals
+            const double perFrameUs = intervalUs / static_cast<double>(gap + 1);
+            late = state.meanIntervalUs > 0.0 &&
+               perFrameUs > lateIntervalFactor * state.meanIntervalUs;
+            if (late)
+               ++state.counts.late;
+
+            // Exponential moving average, so that the expected interval
+            // follows changes in frame rate
+            if (state.meanIntervalUs == 0.0)
+               state.meanIntervalUs = perFrameUs;
+            else
+               state.meanIntervalUs += (perFrameUs - state.meanIntervalUs) / 16.0;
+         }
+      }
+      state.haveTimestamp = true;
+      state.lastTimestampUs = timestampUs;
+
+      md.PutImageTag(MM::g_Keyword_Metadata_FrameLate, late ? "1" : "0");
+      md.PutImageTag(MM::g_Keyword_Metadata_FramesLate,
+            CDeviceUtils::FormatNumber(state.counts.late));
+   }
+
+   md.PutImageTag(MM::g_Keyword_Metadata_FramesDroppedByBuffer,
+         CDeviceUtils::FormatNumber(state.counts.droppedByBuffer));
+}
+
+void FrameAccounting::FrameDroppedByBuffer(const std::string& camera)
+{
+   MMThreadGuard guard(lock_);
+   CameraState& state = cameras_[camera];
+   ++state.counts.droppedByBuffer;
+   state.lastFrameDropped = true;
+}
+
+void FrameAccounting::FramesDiscardedByBuffer(const std::string& camera,
+      long count)
+{
+   MMThreadGuard guard(lock_);
+   cameras_[camera].counts.droppedByBuffer += count;
+}
+
+void FrameAccounting::BufferClearedAfterOverflow()
+{
+   MMThreadGuard guard(lock_);
+   for (std::map<std::string, CameraState>::iterator it = cameras_.begin();
+         it != cameras_.end(); ++it)
+      it->second.resendExpected = it->second.lastFrameDropped;
+}
+
+FrameCounts FrameAccounting::GetCounts(const std::string& camera) const
+{
+   MMThreadGuard guard(lock_);
+   std::map<std::string, CameraState>::const_iterator it = cameras_.find(camera);
+   if (it == cameras_.end())
+      return FrameCounts();
+   return it->second.counts;
+}
+
+void FrameAccounting::Reset()
+{
+   MMThreadGuard guard(lock_);
+   cameras_.clear();
+}
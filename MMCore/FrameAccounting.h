@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameAccounting.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-camera accounting of received, dropped and late frames.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/DeviceThreads.h"
+
+#include <map>
+#include <string>
+
+class Metadata;
+
+// Running totals for the frames a camera has sent since the last reset.
+struct FrameCounts
+{
+   long received;         // All frames that reached the Core
+   long droppedByDevice;  // Gaps in the camera's hardware frame counter
+   long droppedByBuffer;  // Received but discarded on buffer overflow
+   long late;             // Arrived well after the expected interval
+   long discontinuities;  // Frame counter or timestamp went backwards
+
+   FrameCounts() : received(0), droppedByDevice(0), droppedByBuffer(0),
+      late(0), discontinuities(0) {}
+};
+
+// Detects lost and late frames from the hardware frame counter and
+// timestamp that a camera may supply in the image metadata
+// (MM::g_Keyword_Metadata_HardwareFrameNumber and
+// MM::g_Keyword_Metadata_HardwareTimestamp_us), and records the result
+// both in per-camera totals and in each frame's metadata.
+class FrameAccounting
+{
+public:
+   FrameAccounting() {}
+
+   // Update the totals for a frame from camera, and add the per-frame
+   // accounting tags to md
+   void FrameReceived(const std::string& camera, Metadata& md);
+   void FrameDroppedByBuffer(const std::string& camera);
+
+   // Count frames from camera that were discarded unread when the buffer
+   // was cleared after an overflow
+   void FramesDiscardedByBuffer(const std::string& camera, long count);
+
+   // Called after the buffer has been cleared following an overflow. A
+   // camera whose last frame was dropped is expected to send it again
+   // (as CCameraBase::InsertImage() does), and that frame is not counted
+   // twice.
+   void BufferClearedAfterOverflow();
+
+   FrameCounts GetCounts(const std::string& camera) const;
+   void Reset();
+
+   // A frame is late if it arrives this many mean frame intervals after its
+   // predecessor
+   static const double lateIntervalFactor;
+
+private:
+   struct CameraState
+   {
+      FrameCounts counts;
+      bool haveFrameNumber;
+      long long lastFrameNumber;
+      bool haveTimestamp;
+      double lastTimestampUs;
+      double meanIntervalUs; // 0 until the first interval is seen
+      bool lastFrameDropped;
+      bool resendExpected;
+
+      CameraState() : haveFrameNumber(false), lastFrameNumber(0),
+         haveTimestamp(false), lastTimestampUs(0.0), meanIntervalUs(0.0),
+         lastFrameDropped(false), resendExpected(false) {}
+   };
+
+   mutable MMThreadLock lock_;
+   std::map<std::string, CameraState> cameras_;
+};
@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameCodec.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Fast lossless codec for image frames held in the circular
+//                buffer.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "FrameCodec.h"
+
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+
+namespace mm {
+
+namespace
+{
+
+// Number of residuals sharing one bit-width header byte
+const size_t blockSize = 32;
+
+template <typename T>
+inline T ZigZag(T residual)
+{
+   const unsigned shift = 8 * sizeof(T) - 1;
+   return static_cast<T>((residual << 1) ^ (0 - (residual >> shift)));
+}
+
+template <typename T>
+inline T UnZigZag(T value)
+{
+   return static_cast<T>((value >> 1) ^ (0 - (value & 1)));
+}
+
+inline unsigned BitWidth(unsigned value)
+{
+   unsigned bits = 0;
+   while (value)
+   {
+      ++bits;
+      value >>= 1;
+   }
+   return bits;
+}
+
+// Write one block of residuals using the given bit width. Exactly
+// blockSize * bits / 8 bytes are written.
+template <typename T>
+inline unsigned char* PackBlock(const T* values, unsigned bits,
+      unsigned char* dst)
+{
+   boost::uint64_t acc = 0;
+   unsigned accBits = 0;
+   for (size_t i = 0; i < blockSize; ++i)
+   {
+      acc |= static_cast<boost::uint64_t>(values[i]) << accBits;
+      accBits += bits;
+      while (accBits >= 8)
+      {
+         *dst++ = static_cast<unsigned char>(acc);
+         acc >>= 8;
+         accBits -= 8;
+      }
+   }
+   return dst;
+}
+
+template <typename T>
+inline const unsigned char* UnpackBlock(const unsigned char* src,
+      unsigned bits, T* values)
+{
+   const boost::uint64_t mask = (static_cast<boost::uint64_t>(1) << bits) - 1;
+   boost::uint64_t acc = 0;
+   unsigned accBits = 0;
+   for (size_t i = 0; i < blockSize; ++i)
+   {
+      while (accBits < bits)
+      {
+         acc |= static_cast<boost::uint64_t>(*src++) << accBits;
+         accBits += 8;
+      }
+      values[i] = static_cast<T>(acc & mask);
+      acc >>= bits;
+      accBits -= bits;
+   }
+   return src;
+}
+
+template <typename T>
+size_t CompressPixels(const T* pixels, unsigned width, unsigned rows,
+      unsigned char* dst)
+{
+   unsigned char* const start = dst;
+   T block[blockSize];
+   size_t fill = 0;
+   unsigned blockOr = 0;
+
+   for (unsigned y = 0; y < rows; ++y)
+   {
+      const T* row = pixels + static_cast<size_t>(y) * width;
+      T prev = y > 0 ? row[-static_cast<long>(width)] : 0;
+      for (unsigned x = 0; x < width; ++x)
+      {
+         const T value = ZigZag<T>(static_cast<T>(row[x] - prev));
+         prev = row[x];
+         block[fill++] = value;
+         blockOr |= value;
+         if (fill == blockSize)
+         {
+            const unsigned bits = BitWidth(blockOr);
+            *dst++ = static_cast<unsigned char>(bits);
+            dst = PackBlock(block, bits, dst);
+            fill = 0;
+            blockOr = 0;
+         }
+      }
+   }
+   if (fill > 0)
+   {
+      for (size_t i = fill; i < blockSize; ++i)
+         block[i] = 0;
+      const unsigned bits = BitWidth(blockOr);
+      *dst++ = static_cast<unsigned char>(bits);
+      dst = PackBlock(block, bits, dst);
+   }
+   return static_cast<size_t>(dst - start);
+}
+
+template <typename T>
+bool DecompressPixels(const unsigned char* src, size_t srcBytes,
+      unsigned width, unsigned rows, T* pixels)
+{
+   const unsigned char* const srcEnd = src + srcBytes;
+   const size_t count = static_cast<size_t>(width) * rows;
+   T block[blockSize];
+
+   T prev = 0;
+   for (size_t i = 0; i < count; i += blockSize)
+   {
+      if (src >= srcEnd)
+         return false;
+      const unsigned bits = *src++;
+      if (bits > 8 * sizeof(T) ||
+            static_cast<size_t>(srcEnd - src) < blockSize * bits / 8)
+         return false;
+      src = UnpackBlock(src, bits, block);
+
+      const size_t n = (count - i < blockSize) ? count - i : blockSize;
+      for (size_t j = 0; j < n; ++j)
+      {
+         const size_t index = i + j;
+         if (index % width == 0)
+            prev = index >= width ? pixels[index - width] : 0;
+         prev = static_cast<T>(prev + UnZigZag<T>(block[j]));
+         pixels[index] = prev;
+      }
+   }
+   return src == srcEnd;
+}
+
+} // anonymous namespace
+
+
+bool FrameCodec::IsSupportedDepth(unsigned byteDepth)
+{
+   return byteDepth == 1 || byteDepth == 2;
+}
+
+size_t FrameCodec::MaxStripeBytes(unsigned width, unsigned rows,
+      unsigned byteDepth)
+{
+   const size_t pixels = static_cast<size_t>(width) * rows;
+   if (!IsSupportedDepth(byteDepth))
+      return pixels * byteDepth;
+   const size_t blocks = (pixels + blockSize - 1) / blockSize;
+   return blocks * (1 + blockSize * byteDepth);
+}
+
+size_t FrameCodec::CompressStripe(const unsigned char* image, unsigned width,
+      unsigned firstRow, unsigned rows, unsigned byteDepth, unsigned char* dst)
+{
+   const size_t offset = static_cast<size_t>(firstRow) * width * byteDepth;
+   switch (byteDepth)
+   {
+      case 1:
+         return CompressPixels(image + offset, width, rows, dst);
+      case 2:
+         return CompressPixels(
+               reinterpret_cast<const boost::uint16_t*>(image + offset),
+               width, rows, dst);
+      default:
+      {
+         const size_t bytes = static_cast<size_t>(width) * rows * byteDepth;
+         memcpy(dst, image + offset, bytes);
+         return bytes;
+      }
+   }
+}
+
+bool FrameCodec::DecompressStripe(const unsigned char* src, size_t srcBytes,
+      unsigned width, unsigned firstRow, unsigned rows, unsigned byteDepth,
+      unsigned char* image)
+{
+   const size_t offset = static_cast<size_t>(firstRow) * width * byteDepth;
+   switch (byteDepth)
+   {
+      case 1:
+         return DecompressPixels(src, srcBytes, width, rows, image + offset);
+      case 2:
+         return DecompressPixels(src, srcBytes, width, rows,
+               reinterpret_cast<boost::uint16_t*>(image + offset));
+      default:
+      {
+         const size_t bytes = static_cast<size_t>(width) * rows * byteDepth;
+         if (srcBytes != bytes)
+            return false;
+         memcpy(image + offset, src, bytes);
+         return true;
+      }
+   }
+}
+
+unsigned FrameCodec::StripeFirstRow(unsigned height, unsigned stripeCount,
+      unsigned stripe)
+{
+   return static_cast<unsigned>(
+         static_cast<unsigned long long>(height) * stripe / stripeCount);
+}
+
+size_t FrameCodec::HeaderBytes(unsigned stripeCount)
+{
+   return (1 + static_cast<size_t>(stripeCount)) * sizeof(boost::uint32_t);
+}
+
+size_t FrameCodec::WriteHeader(unsigned stripeCount,
+      const size_t* stripeBytes, unsigned char* dst)
+{
+   boost::uint32_t value = stripeCount;
+   memcpy(dst, &value, sizeof(value));
+   for (unsigned i = 0; i < stripeCount; ++i)
+   {
+      value = static_cast<boost::uint32_t>(stripeBytes[i]);
+      memcpy(dst + (1 + i) * sizeof(value), &value, sizeof(value));
+   }
+   return HeaderBytes(stripeCount);
+}
+
+bool FrameCodec::DecompressFrame(const unsigned char* src, size_t srcBytes,
+      unsigned width, unsigned height, unsigned byteDepth,
+      unsigned char* image)
+{
+   boost::uint32_t stripeCount;
+   if (srcBytes < sizeof(stripeCount))
+      return false;
+   memcpy(&stripeCount, src, sizeof(stripeCount));
+   if (stripeCount == 0 || stripeCount > height ||
+         srcBytes < HeaderBytes(stripeCount))
+      return false;
+
+   const unsigned char* stripe = src + HeaderBytes(stripeCount);
+   const unsigned char* const srcEnd = src + srcBytes;
+   for (unsigned i = 0; i < stripeCount; ++i)
+   {
+      boost::uint32_t stripeBytes;
+      memcpy(&stripeBytes, src + (1 + i) * sizeof(stripeBytes),
+            sizeof(stripeBytes));
+      if (static_cast<size_t>(srcEnd - stripe) < stripeBytes)
+         return false;
+
+      const unsigned firstRow = StripeFirstRow(height, stripeCount, i);
+      const unsigned rows = StripeFirstRow(height, stripeCount, i + 1) -
+         firstRow;
+      if (!DecompressStripe(stripe, stripeBytes, width, firstRow, rows,
+               byteDepth, image))
+         return false;
+      stripe += stripeBytes;
+   }
+   return stripe == srcEnd;
+}
+
+} // namespace mm
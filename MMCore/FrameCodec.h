@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameCodec.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Fast lossless codec for image frames held in the circular
+//                buffer.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+
+namespace mm {
+
+/**
+ * Lossless compression of 8- and 16-bit grayscale pixel data.
+ *
+ * Each pixel is predicted from its left neighbor (the pixel above for the
+ * first pixel of a row) and the zigzag-encoded residuals are bit-packed in
+ * blocks of 32, each block using the smallest bit width that holds all of its
+ * residuals. This removes the empty high-order bit planes of noisy,
+ * photon-limited data at memory-bandwidth-class speed; it is not meant to
+ * compete with entropy coders on ratio.
+ *
+ * An image is encoded as independent horizontal stripes so that stripes can
+ * be compressed in parallel (see TaskSet_CompressFrame). Other pixel types are
+ * stored verbatim. The encoded frame starts with a header giving the stripe
+ * count and the encoded size of each stripe; the format is only meant for
+ * in-memory use (it uses native byte order).
+ */
+class FrameCodec
+{
+public:
+   /**
+    * Whether pixel data of the given depth is compressed (as opposed to
+    * stored verbatim).
+    */
+   static bool IsSupportedDepth(unsigned byteDepth);
+
+   /**
+    * Upper bound for the encoded size of a stripe of the given dimensions.
+    */
+   static size_t MaxStripeBytes(unsigned width, unsigned rows,
+         unsigned byteDepth);
+
+   /**
+    * Encode rows [firstRow, firstRow + rows) of an image into dst, which
+    * must hold at least MaxStripeBytes(width, rows, byteDepth) bytes.
+    * Returns the number of bytes written.
+    */
+   static size_t CompressStripe(const unsigned char* image, unsigned width,
+         unsigned firstRow, unsigned rows, unsigned byteDepth,
+         unsigned char* dst);
+
+   /**
+    * Decode a stripe produced by CompressStripe() into the corresponding rows
+    * of image. Returns false if the encoded data is inconsistent.
+    */
+   static bool DecompressStripe(const unsigned char* src, size_t srcBytes,
+         unsigned width, unsigned firstRow, unsigned rows, unsigned byteDepth,
+         unsigned char* image);
+
+   /**
+    * First row of the given stripe when the image is split into stripeCount
+    * stripes (stripe == stripeCount gives the image height).
+    */
+   static unsigned StripeFirstRow(unsigned height, unsigned stripeCount,
+         unsigned stripe);
+
+   /**
+    * Size of the frame header for the given number of stripes.
+    */
+   static size_t HeaderBytes(unsigned stripeCount);
+
+   /**
+    * Write the frame header. Returns the number of bytes written.
+    */
+   static size_t WriteHeader(unsigned stripeCount, const size_t* stripeBytes,
+         unsigned char* dst);
+
+   /**
+    * Decode a whole frame (header and stripes) into image, which must hold
+    * width * height * byteDepth bytes. Returns false if the encoded data is
+    * inconsistent with the given dimensions.
+    */
+   static bool DecompressFrame(const unsigned char* src, size_t srcBytes,
+         unsigned width, unsigned height, unsigned byteDepth,
+         unsigned char* image);
+};
+
+} // namespace mm
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <limits>
+
 
 namespace mm
 {
@@ -31,6 +33,13 @@ class GenericEntryFilter
 public:
    virtual ~GenericEntryFilter() {}
    virtual bool Filter(const TMetadata& metadata) const = 0;
+
+   // Return the lowest entry level that Filter() may accept. This is used to
+   // skip formatting entries that no sink will consume, so it must not be
+   // higher than the level of any entry the filter lets through. Filters that
+   // do not look at the level can rely on the default.
+   virtual int GetMinimumLevel() const
+   { return std::numeric_limits<int>::min(); }
 };
 
 
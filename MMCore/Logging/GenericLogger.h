@@ -17,8 +17,10 @@
 #pragma once
 
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 
+#include <atomic>
 #include <sstream>
 #include <string>
 
@@ -31,23 +33,56 @@ namespace internal
 {
 
 
+/**
+ * Lowest entry level accepted by any sink of a logging core.
+ *
+ * Shared between a logging core and the loggers it creates, so that entries
+ * below the level can be discarded before they are formatted.
+ */
+typedef std::atomic<int> MinimumLevelGate;
+
+
 template <typename TEntryData>
 class GenericLogger
 {
    boost::function<void (TEntryData, const char*)> impl_;
+   boost::shared_ptr<const MinimumLevelGate> minLevel_;
 
 public:
    typedef TEntryData EntryDataType;
 
-   GenericLogger(boost::function<void (TEntryData, const char*)> f) :
-      impl_(f)
+   GenericLogger(boost::function<void (TEntryData, const char*)> f,
+         boost::shared_ptr<const MinimumLevelGate> minLevel =
+            boost::shared_ptr<const MinimumLevelGate>()) :
+      impl_(f),
+      minLevel_(minLevel)
    {}
 
+   /**
+    * Return false if no sink will consume an entry with the given data.
+    *
+    * This is a cheap check (a single relaxed atomic load) that can be used to
+    * avoid formatting entries that would be discarded anyway.
+    */
+   bool IsLevelEnabled(TEntryData entryData) const
+   {
+      if (!minLevel_)
+         return true;
+      return static_cast<int>(entryData.GetLevel()) >=
+         minLevel_->load(std::memory_order_relaxed);
+   }
+
    void operator()(TEntryData entryData, const char* message) const
-   { impl_(entryData, message); }
+   {
+      if (IsLevelEnabled(entryData))
+         impl_(entryData, message);
+   }
 
    void operator()(TEntryData entryData, const std::string& message) const
-   { impl_(entryData, message.c_str()); }
+   {
+      if (IsLevelEnabled(entryData))
+         impl_(entryData, message.c_str());
+   }
 };
 
 
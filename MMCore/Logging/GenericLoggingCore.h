@@ -24,10 +24,12 @@
 
 #include <boost/bind.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
 #include <algorithm>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -75,8 +77,15 @@ private:
    // _and_ the queue receive loop stopped.
    std::vector< boost::shared_ptr<SinkType> > asynchronousSinks_;
 
+   // Lowest level accepted by any sink; shared with all loggers. Updated with
+   // both syncSinksMutex_ and asyncQueueMutex_ held.
+   boost::shared_ptr<MinimumLevelGate> minLevel_;
+
 public:
-   GenericLoggingCore() { StartAsyncReceiveLoop(); }
+   GenericLoggingCore() :
+      minLevel_(boost::make_shared<MinimumLevelGate>(
+               std::numeric_limits<int>::max()))
+   { StartAsyncReceiveLoop(); }
    ~GenericLoggingCore() { StopAsyncReceiveLoop(); }
 
    /**
@@ -90,7 +99,8 @@ public:
       // guaranteed to be safe to call at any time.
       return internal::GenericLogger<EntryDataType>(
             boost::bind(&GenericLoggingCore::SendEntryToShared,
-               this->shared_from_this(), metadata, _1, _2));
+               this->shared_from_this(), metadata, _1, _2),
+            minLevel_);
    }
 
    /**
@@ -98,23 +108,25 @@ public:
     */
    void AddSink(boost::shared_ptr<SinkType> sink, SinkMode mode)
    {
+      // Both locks are needed to update the minimum level
+      boost::lock_guard<boost::mutex> lockSyncs(syncSinksMutex_);
+      boost::lock_guard<boost::mutex> lockAsyncQ(asyncQueueMutex_);
       switch (mode)
       {
          case SinkModeSynchronous:
          {
-            boost::lock_guard<boost::mutex> lock(syncSinksMutex_);
             synchronousSinks_.push_back(sink);
             break;
          }
          case SinkModeAsynchronous:
          {
-            boost::lock_guard<boost::mutex> lock(asyncQueueMutex_);
             StopAsyncReceiveLoop();
             asynchronousSinks_.push_back(sink);
             StartAsyncReceiveLoop();
             break;
          }
       }
+      UpdateMinimumLevel();
    }
 
    /**
@@ -125,11 +137,13 @@ public:
     */
    void RemoveSink(boost::shared_ptr<SinkType> sink, SinkMode mode)
    {
+      // Both locks are needed to update the minimum level
+      boost::lock_guard<boost::mutex> lockSyncs(syncSinksMutex_);
+      boost::lock_guard<boost::mutex> lockAsyncQ(asyncQueueMutex_);
       switch (mode)
       {
          case SinkModeSynchronous:
          {
-            boost::lock_guard<boost::mutex> lock(syncSinksMutex_);
             typename std::vector< boost::shared_ptr<SinkType> >::iterator it =
                std::find(synchronousSinks_.begin(), synchronousSinks_.end(),
                      sink);
@@ -139,7 +153,6 @@ public:
          }
          case SinkModeAsynchronous:
          {
-            boost::lock_guard<boost::mutex> lock(asyncQueueMutex_);
             StopAsyncReceiveLoop();
             typename std::vector< boost::shared_ptr<SinkType> >::iterator it =
                std::find(asynchronousSinks_.begin(), asynchronousSinks_.end(),
@@ -150,6 +163,7 @@ public:
             break;
          }
       }
+      UpdateMinimumLevel();
    }
 
    /**
@@ -209,6 +223,7 @@ public:
          }
       }
 
+      UpdateMinimumLevel();
       StartAsyncReceiveLoop();
    }
 
@@ -253,6 +268,7 @@ public:
             (*foundIt)->SetFilter(filter);
       }
 
+      UpdateMinimumLevel();
       StartAsyncReceiveLoop();
    }
 
@@ -297,6 +313,28 @@ private:
       }
    }
 
+   // Must be called with both syncSinksMutex_ and asyncQueueMutex_ held.
+   // Lowering the level takes effect immediately for all loggers; entries
+   // already being formatted when the level is raised are filtered by the
+   // sinks as before.
+   void UpdateMinimumLevel()
+   {
+      int level = std::numeric_limits<int>::max();
+      for (typename std::vector< boost::shared_ptr<SinkType> >::iterator
+            it = synchronousSinks_.begin(), end = synchronousSinks_.end();
+            it != end; ++it)
+      {
+         level = (std::min)(level, (*it)->GetMinimumLevel());
+      }
+      for (typename std::vector< boost::shared_ptr<SinkType> >::iterator
+            it = asynchronousSinks_.begin(), end = asynchronousSinks_.end();
+            it != end; ++it)
+      {
+         level = (std::min)(level, (*it)->GetMinimumLevel());
+      }
+      minLevel_->store(level, std::memory_order_relaxed);
+   }
+
    void StartAsyncReceiveLoop()
    {
       asyncQueue_.RunReceiveLoop(
@@ -23,6 +23,8 @@
 #include <boost/container/vector.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <limits>
+
 
 namespace mm
 {
@@ -52,6 +54,14 @@ public:
    // logger. See the LoggingCore member function AtomicSetSinkFilters().
    void SetFilter(boost::shared_ptr< GenericEntryFilter<TMetadata> > filter)
    { filter_ = filter; }
+
+   // Lowest entry level that this sink may consume
+   int GetMinimumLevel() const
+   {
+      if (!filter_)
+         return std::numeric_limits<int>::min();
+      return filter_->GetMinimumLevel();
+   }
 };
 
 
@@ -48,11 +48,19 @@ typedef internal::GenericLogStream<Logger> LogStream;
 // In C++ pre-11, the above statement will fail for some data types of x (e.g.
 // const char*). So, to make the left hand side of << an lvalue, we need to use
 // a trick.
+//
+// The level is checked before the stream is constructed, so that none of the
+// operands are evaluated or formatted when no sink would receive the entry.
+// The check is made in an outer for loop rather than an if-else, so that the
+// macro remains a single statement with no else to mis-bind when it is used
+// in an unbraced if statement.
 
 #define LOG_WITH_LEVEL(logger, level) \
-   for (::mm::logging::LogStream strm((logger), (level)); \
-         !strm.Used(); strm.MarkUsed()) \
-      strm
+   for (bool mmLogLevelEnabled = (logger).IsLevelEnabled(level); \
+         mmLogLevelEnabled; mmLogLevelEnabled = false) \
+      for (::mm::logging::LogStream strm((logger), (level)); \
+            !strm.Used(); strm.MarkUsed()) \
+         strm
 
 #define LOG_TRACE(logger) LOG_WITH_LEVEL((logger), ::mm::logging::LogLevelTrace)
 #define LOG_DEBUG(logger) LOG_WITH_LEVEL((logger), ::mm::logging::LogLevelDebug)
@@ -48,6 +48,8 @@
 #include "CoreCallback.h"
 #include "CoreProperty.h"
 #include "CoreUtils.h"
+#include "DetectionCache.h"
+#include "DiskStream.h"
 #include "DeviceManager.h"
 #include "Devices/DeviceInstances.h"
 #include "Host.h"
@@ -55,8 +57,14 @@
 #include "MMCore.h"
 #include "MMEventCallback.h"
 #include "PluginManager.h"
+#include "PreviewStream.h"
+#include "SystemState.h"
+#include "TriggerLatency.h"
+#include "WorkerThreadBudget.h"
 
+#include <boost/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <algorithm>
 #include <assert.h>
@@ -113,7 +121,7 @@ using namespace std;
  * (Keep the 3 numbers on one line to make it easier to look at diffs when
  * merging/rebasing.)
  */
-const int MMCore_versionMajor = 10, MMCore_versionMinor = 2, MMCore_versionPatch = 0;
+const int MMCore_versionMajor = 11, MMCore_versionMinor = 0, MMCore_versionPatch = 0;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -132,6 +140,8 @@ CMMCore::CMMCore() :
    everSnapped_(false),
    pollingIntervalMs_(10),
    timeoutMs_(5000),
+   deviceCallProfiling_(false),
+   stateCacheTrusted_(false),
    autoShutter_(true),
    callback_(0),
    configGroups_(0),
@@ -153,6 +163,15 @@ CMMCore::CMMCore() :
 
    const unsigned seqBufMegabytes = (sizeof(void*) > 4) ? 250 : 25;
    cbuf_ = new CircularBuffer(seqBufMegabytes);
+   previewStream_.reset(new mm::PreviewStream());
+   previewStream_->SetBuffer(cbuf_);
+   diskStream_.reset(new mm::DiskStream());
+   triggerLatency_.reset(new mm::TriggerLatency());
+   detectionCache_.reset(new mm::DetectionCache());
+   workerThreadBudget_.reset(new mm::WorkerThreadBudget(
+            std::max(1u, boost::thread::hardware_concurrency())));
+   nextROISubscriptionId_ = 0;
+   multiROIDemux_ = false;
 
    nullAffine_ = new std::vector<double>(6);
    for (int i = 0; i < 6; i++) {
@@ -182,6 +201,10 @@ CMMCore::~CMMCore()
    delete callback_;
    delete configGroups_;
    delete properties_;
+   previewStream_.reset();
+   diskStream_.reset();
+   triggerLatency_.reset();
+   detectionCache_.reset();
    delete cbuf_;
    delete pixelSizeGroup_;
    delete pPostedErrorsLock_;
@@ -715,6 +738,7 @@ void CMMCore::loadDevice(const char* label, const char* moduleName, const char*
       boost::shared_ptr<DeviceInstance> pDevice =
          deviceManager_->LoadDevice(module, deviceName, label, this,
                deviceLogger, coreLogger);
+      pDevice->GetCallProfile().SetEnabled(deviceCallProfiling_);
       pDevice->SetCallback(callback_);
    }
    catch (const CMMError& e)
@@ -791,6 +815,7 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
    try {
       mm::DeviceModuleLockGuard guard(pDevice);
       LOG_DEBUG(coreLogger_) << "Will unload device " << label;
+      workerThreadBudget_->Release(pDevice->GetRawPtr());
       deviceManager_->UnloadDevice(pDevice);
       LOG_DEBUG(coreLogger_) << "Did unload device " << label;
    }
@@ -825,6 +850,7 @@ void CMMCore::unloadAllDevices() throw (CMMError)
 
       LOG_DEBUG(coreLogger_) << "Will unload all devices";
       deviceManager_->UnloadAllDevices();
+      workerThreadBudget_->ReleaseAll();
       LOG_INFO(coreLogger_) << "Did unload all devices";
 
 	   properties_->Refresh();
@@ -978,6 +1004,38 @@ void CMMCore::updateSystemStateCache()
    LOG_INFO(coreLogger_) << "Did update system state cache";
 }
 
+/**
+ * Sets whether the system state cache is trusted to reflect the hardware.
+ *
+ * While the cache is trusted, setConfig() only sets the properties that
+ * differ between the current preset (according to the cache) and the new
+ * one, and loadSystemState() skips properties that already have the saved
+ * value. The cache is not trusted by default, because it only follows
+ * changes made through setProperty() and property change notifications:
+ * calls such as setPosition() or setXYPosition(), and devices moved by
+ * hand, leave it stale. Only trust the cache when all relevant state is
+ * changed through properties, and call updateSystemStateCache() before
+ * trusting it. A failure to apply a preset makes the cache untrusted.
+ *
+ * @param trusted   true to let setConfig() and loadSystemState() skip
+ *                  properties that the cache shows to be unchanged
+ */
+void CMMCore::setStateCacheTrusted(bool trusted)
+{
+   MMThreadGuard scg(stateCacheLock_);
+   stateCacheTrusted_ = trusted;
+}
+
+/**
+ * Returns whether the system state cache is trusted to reflect the hardware.
+ * See setStateCacheTrusted().
+ */
+bool CMMCore::isStateCacheTrusted() const
+{
+   MMThreadGuard scg(stateCacheLock_);
+   return stateCacheTrusted_;
+}
+
 /**
  * Returns device type.
  */
@@ -1174,6 +1232,34 @@ bool CMMCore::deviceBusy(const char* label) throw (CMMError)
 }
 
 
+/**
+ * Sets the number of threads that devices together may use for data-parallel
+ * work, such as copying or processing frames. The default is the number of
+ * hardware threads; lower it to leave cores for the application.
+ *
+ * Devices ask for their share when they set up their thread pools, usually
+ * during initialization. Each gets what the devices that asked before it
+ * have left over, but at least 1 thread (its own), and returns its share
+ * when unloaded. A new budget applies to devices that ask afterwards.
+ *
+ * @param threadCount   the number of threads, at least 1
+ */
+void CMMCore::setDeviceWorkerThreadBudget(int threadCount) throw (CMMError)
+{
+   if (threadCount < 1)
+      throw CMMError("Worker thread budget must be at least 1");
+   workerThreadBudget_->SetTotal(threadCount);
+}
+
+/**
+ * Returns the number of threads that devices together may use for
+ * data-parallel work.
+ */
+int CMMCore::getDeviceWorkerThreadBudget()
+{
+   return workerThreadBudget_->GetTotal();
+}
+
 /**
  * Waits (blocks the calling thread) for specified time in milliseconds.
  * @param intervalMs the time to sleep in milliseconds
@@ -1265,33 +1351,132 @@ void CMMCore::waitForSystem() throw (CMMError)
 bool CMMCore::deviceTypeBusy(MM::DeviceType devType) throw (CMMError)
 {
    vector<string> devices = deviceManager_->GetDeviceList(devType);
-   for (size_t i=0; i<devices.size(); i++)
-   {
-      try {
-         boost::shared_ptr<DeviceInstance> pDevice =
-            deviceManager_->GetDevice(devices[i]);
-         mm::DeviceModuleLockGuard guard(pDevice);
-         if (pDevice->Busy())
-            return true;
-      }
-      catch (...) {
-         // trap all exceptions
-         assert(!"Plugin manager can't access device it reported as available.");
-      }
-   }
-   return false;
+   return !getBusyDevices(devices, true).empty();
 }
 
 
 /**
  * Blocks until all devices of the specific type become ready (not-busy).
+ * Fails if any of them is still busy after the timeout (see
+ * setTimeoutMs()).
  * @param devType    a constant specifying the device type
  */
 void CMMCore::waitForDeviceType(MM::DeviceType devType) throw (CMMError)
 {
    vector<string> devices = deviceManager_->GetDeviceList(devType);
-   for (size_t i=0; i<devices.size(); i++)
-      waitForDevice(devices[i].c_str());
+   LOG_DEBUG(coreLogger_) << "Waiting for " << devices.size() << " devices...";
+
+   MM::TimeoutMs timeout(GetMMTimeNow(),timeoutMs_);
+
+   // Devices that have become ready are not polled again
+   while (!(devices = getBusyDevices(devices, false)).empty())
+   {
+      if (timeout.expired(GetMMTimeNow()))
+      {
+         std::ostringstream mez;
+         mez << "wait timed out after " << timeoutMs_ << " ms. ";
+         logError(devices[0].c_str(), mez.str().c_str());
+         throw CMMError("Wait for device " + ToQuotedString(devices[0]) + " timed out after " +
+               ToString(timeoutMs_) + "ms",
+               MMERR_DevicePollingTimeout);
+      }
+
+      sleep(pollingIntervalMs_);
+   }
+   LOG_DEBUG(coreLogger_) << "Finished waiting for devices";
+}
+
+/*
+ * Returns the devices among labels that are busy. The peripherals of a hub
+ * that can report their busy state all at once are checked with a single
+ * query to the hub, hubs in the order of their first peripheral in labels;
+ * other devices are then asked one by one. If firstOnly is set, polling
+ * stops at the first busy device, which is the only one returned.
+ */
+std::vector<std::string> CMMCore::getBusyDevices(const std::vector<std::string>& labels,
+      bool firstOnly)
+{
+   std::vector<bool> busy(labels.size(), false);
+   std::vector<boost::shared_ptr<DeviceInstance> > devices(labels.size());
+   std::vector<boost::shared_ptr<HubInstance> > hubs;
+   std::map<boost::shared_ptr<HubInstance>, std::vector<size_t> > peripheralsByHub;
+   for (size_t i = 0; i < labels.size(); ++i)
+   {
+      try
+      {
+         devices[i] = deviceManager_->GetDevice(labels[i]);
+         if (devices[i]->GetType() == MM::HubDevice)
+            continue;
+         boost::shared_ptr<HubInstance> pHub = deviceManager_->GetParentDevice(devices[i]);
+         if (pHub)
+         {
+            std::vector<size_t>& peripherals = peripheralsByHub[pHub];
+            if (peripherals.empty())
+               hubs.push_back(pHub);
+            peripherals.push_back(i);
+         }
+      }
+      catch (...)
+      {
+         // trap all exceptions
+         assert(!"Plugin manager can't access device it reported as available.");
+      }
+   }
+
+   // Peripherals covered by their hub's snapshot
+   std::vector<bool> done(labels.size(), false);
+   for (std::vector<boost::shared_ptr<HubInstance> >::const_iterator
+         it = hubs.begin(); it != hubs.end(); ++it)
+   {
+      boost::shared_ptr<HubInstance> pHub = *it;
+      const std::vector<size_t>& peripherals = peripheralsByHub[pHub];
+      mm::DeviceModuleLockGuard guard(pHub);
+      try
+      {
+         if (!pHub->SnapPeripheralBusyStates())
+            continue;
+      }
+      catch (const CMMError& e)
+      {
+         LOG_ERROR(coreLogger_) << e.getFullMsg();
+         continue;
+      }
+      for (size_t j = 0; j < peripherals.size(); ++j)
+      {
+         const size_t i = peripherals[j];
+         bool peripheralBusy = false;
+         if (pHub->GetPeripheralBusy(devices[i], peripheralBusy))
+         {
+            if (peripheralBusy && firstOnly)
+               return std::vector<std::string>(1, labels[i]);
+            busy[i] = peripheralBusy;
+            done[i] = true;
+         }
+      }
+   }
+
+   for (size_t i = 0; i < labels.size(); ++i)
+   {
+      if (done[i] || !devices[i])
+         continue;
+      try
+      {
+         mm::DeviceModuleLockGuard guard(devices[i]);
+         busy[i] = devices[i]->Busy();
+      }
+      catch (...)
+      {
+         assert(!"Plugin manager can't access device it reported as available.");
+      }
+      if (busy[i] && firstOnly)
+         return std::vector<std::string>(1, labels[i]);
+   }
+
+   std::vector<std::string> busyLabels;
+   for (size_t i = 0; i < labels.size(); ++i)
+      if (busy[i])
+         busyLabels.push_back(labels[i]);
+   return busyLabels;
 }
 
 /**
@@ -2655,9 +2840,13 @@ void* CMMCore::getImage() throw (CMMError)
       }
 
       void* pBuf(0);
+      unsigned width, height, depth;
       try {
          mm::DeviceModuleLockGuard guard(camera);
          pBuf = const_cast<unsigned char*> (camera->GetImageBuffer());
+         width = camera->GetImageWidth();
+         height = camera->GetImageHeight();
+         depth = camera->GetImageBytesPerPixel();
 
          boost::shared_ptr<ImageProcessorInstance> imageProcessor =
             currentImageProcessor_.lock();
@@ -2673,7 +2862,7 @@ void* CMMCore::getImage() throw (CMMError)
       }
 
       if (pBuf != 0)
-         return pBuf;
+         return getDemuxedImage(pBuf, 0, width, height, depth);
       else
       {
          logError("CMMCore::getImage()", getCoreErrorText(MMERR_CameraBufferReadFailed).c_str());
@@ -2702,9 +2891,15 @@ void* CMMCore::getImage(unsigned channelNr) throw (CMMError)
    else
    {
       void* pBuf(0);
+      unsigned width, height, depth;
+      const bool demux = cbuf_->IsDemuxActive();
       try {
          mm::DeviceModuleLockGuard guard(camera);
-         pBuf = const_cast<unsigned char*> (camera->GetImageBuffer(channelNr));
+         // Multi-ROI channels are all in the camera's single image
+         pBuf = const_cast<unsigned char*> (camera->GetImageBuffer(demux ? 0 : channelNr));
+         width = camera->GetImageWidth();
+         height = camera->GetImageHeight();
+         depth = camera->GetImageBytesPerPixel();
 
          boost::shared_ptr<ImageProcessorInstance> imageProcessor =
             currentImageProcessor_.lock();
@@ -2720,7 +2915,7 @@ void* CMMCore::getImage(unsigned channelNr) throw (CMMError)
       }
 
       if (pBuf != 0)
-         return pBuf;
+         return getDemuxedImage(pBuf, channelNr, width, height, depth);
       else
       {
          logError("CMMCore::getImage()", getCoreErrorText(MMERR_CameraBufferReadFailed).c_str());
@@ -2739,6 +2934,9 @@ long CMMCore::getImageBufferSize()
    boost::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
    if (camera) {
       mm::DeviceModuleLockGuard guard(camera);
+      unsigned width, height, count;
+      if (getBufferDemuxImageSize(width, height, count))
+         return (long) width * height * camera->GetImageBytesPerPixel();
       return camera->GetImageBufferSize();
    }
    else
@@ -2783,6 +2981,7 @@ void CMMCore::startSequenceAcquisition(long numImages, double intervalMs, bool s
 			cbuf_->Clear();
          mm::DeviceModuleLockGuard guard(camera);
 
+         triggerLatency_->ClearPendingTriggers(camera->GetLabel());
          LOG_DEBUG(coreLogger_) << "Will start sequence acquisition from default camera";
 			int nRet = camera->StartSequenceAcquisition(numImages, intervalMs, stopOnOverflow);
 			if (nRet != DEVICE_OK)
@@ -2819,6 +3018,7 @@ void CMMCore::startSequenceAcquisition(const char* label, long numImages, double
       throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
                      MMERR_NotAllowedDuringSequenceAcquisition);
 
+   triggerLatency_->ClearPendingTriggers(label);
    LOG_DEBUG(coreLogger_) <<
       "Will start sequence acquisition from camera " << label;
    int nRet = pCam->StartSequenceAcquisition(numImages, intervalMs, stopOnOverflow);
@@ -2894,6 +3094,15 @@ void CMMCore::stopSequenceAcquisition(const char* label) throw (CMMError)
       logError(label, getDeviceErrorText(nRet, pCam).c_str());
       throw CMMError(getDeviceErrorText(nRet, pCam).c_str(), MMERR_DEVICE_GENERIC);
    }
+   // An aborted burst leaves triggers whose frames will not arrive
+   triggerLatency_->ClearPendingTriggers(label);
+
+   std::string streamError;
+   if (!diskStream_->Finish(label, streamError))
+   {
+      logError(label, streamError.c_str());
+      throw CMMError(streamError);
+   }
 
    LOG_DEBUG(coreLogger_) << "Did stop sequence acquisition from camera " << label;
 }
@@ -2921,6 +3130,7 @@ void CMMCore::startContinuousSequenceAcquisition(double intervalMs) throw (CMMEr
          throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
       }
       cbuf_->Clear();
+      triggerLatency_->ClearPendingTriggers(camera->GetLabel());
       LOG_DEBUG(coreLogger_) << "Will start continuous sequence acquisition from current camera";
       int nRet = camera->StartSequenceAcquisition(intervalMs);
       if (nRet != DEVICE_OK)
@@ -2950,6 +3160,15 @@ void CMMCore::stopSequenceAcquisition() throw (CMMError)
          logError(getDeviceName(camera).c_str(), getDeviceErrorText(nRet, camera).c_str());
          throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
       }
+      // An aborted burst leaves triggers whose frames will not arrive
+      triggerLatency_->ClearPendingTriggers(camera->GetLabel());
+
+      std::string streamError;
+      if (!diskStream_->Finish(camera->GetLabel(), streamError))
+      {
+         logError(getDeviceName(camera).c_str(), streamError.c_str());
+         throw CMMError(streamError);
+      }
    }
    else
    {
@@ -2979,17 +3198,434 @@ bool CMMCore::isSequenceRunning() throw ()
 };
 
 /**
- * Check if the specified camera is acquiring the sequence
- * Returns false when the sequence is done
+ * Check if the specified camera is acquiring the sequence
+ * Returns false when the sequence is done
+ */
+bool CMMCore::isSequenceRunning(const char* label) throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> pCam =
+      deviceManager_->GetDeviceOfType<CameraInstance>(label);
+
+   mm::DeviceModuleLockGuard guard(pCam);
+   return pCam->IsCapturing();
+};
+
+/**
+ * Indicates whether the camera supports the burst API: bursts of frames
+ * whose start, end and individual frames are each triggered internally by
+ * the camera, externally by TTL pulses, or by software.
+ *
+ * To acquire a burst, set the trigger types and frame delays, arm the camera
+ * with prepareForBurst(), and send the software triggers, if any. The frames
+ * are inserted into the circular buffer, and the camera is busy acquiring (as
+ * reported by isSequenceRunning()) until the burst has ended.
+ *
+ * @param cameraLabel the camera label
+ */
+bool CMMCore::isBurstAPISupported(const char* cameraLabel) throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   return camera->SupportsBurstAPI();
+}
+
+/**
+ * Sets the delay before the exposure of each frame of a burst.
+ * @param cameraLabel the camera label
+ * @param delayMs     the delay in milliseconds
+ */
+void CMMCore::setPreFrameDelay(const char* cameraLabel, double delayMs)
+   throw (CMMError)
+{
+   if (delayMs < 0.0)
+      throw CMMError("Frame delay must not be negative");
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetPreFrameDelay(delayMs);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
+
+/**
+ * Sets the delay after the exposure of each frame of a burst.
+ * @param cameraLabel the camera label
+ * @param delayMs     the delay in milliseconds
+ */
+void CMMCore::setPostFrameDelay(const char* cameraLabel, double delayMs)
+   throw (CMMError)
+{
+   if (delayMs < 0.0)
+      throw CMMError("Frame delay must not be negative");
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetPostFrameDelay(delayMs);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
+
+/**
+ * Sets what starts a burst: "internal" (the camera starts as soon as it is
+ * armed by prepareForBurst()), "external" (a TTL pulse) or "software"
+ * (sendBurstStartTrigger()).
+ * @param cameraLabel the camera label
+ * @param type        the trigger type
+ */
+void CMMCore::setBurstStartTriggerType(const char* cameraLabel,
+      const char* type) throw (CMMError)
+{
+   CheckTriggerType(type);
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetBurstStartTriggerType(type);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+   triggerLatency_->SetBurstStartTriggerType(camera->GetLabel(), type);
+}
+
+/**
+ * Sets what ends a burst: "internal" (the camera stops after the number of
+ * images given to prepareForBurst()), "external" (a TTL pulse) or "software"
+ * (sendBurstEndTrigger()).
+ * @param cameraLabel the camera label
+ * @param type        the trigger type
+ */
+void CMMCore::setBurstEndTriggerType(const char* cameraLabel,
+      const char* type) throw (CMMError)
+{
+   CheckTriggerType(type);
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetBurstEndTriggerType(type);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
+
+/**
+ * Sets what starts each frame of a burst: "internal" (the camera takes
+ * frames back to back, separated by the pre- and post-frame delays),
+ * "external" (a TTL pulse) or "software" (sendFrameStartTrigger()).
+ * @param cameraLabel the camera label
+ * @param type        the trigger type
+ */
+void CMMCore::setFrameStartTriggerType(const char* cameraLabel,
+      const char* type) throw (CMMError)
+{
+   CheckTriggerType(type);
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetFrameStartTriggerType(type);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+   triggerLatency_->SetFrameStartTriggerType(camera->GetLabel(), type);
+}
+
+/**
+ * Sets what ends the exposure of each frame of a burst: "internal" (the
+ * camera exposure setting), "external" (a TTL pulse) or "software".
+ * @param cameraLabel the camera label
+ * @param type        the trigger type
+ */
+void CMMCore::setExposureEndTriggerType(const char* cameraLabel,
+      const char* type) throw (CMMError)
+{
+   CheckTriggerType(type);
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetExposureEndTriggerType(type);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
+
+/**
+ * Sets how external frame start and exposure end triggers are combined:
+ * "distinct" (separate TTL pulses), "exposure" (the TTL pulse width sets the
+ * exposure) or "combined" (each TTL pulse ends one exposure and starts the
+ * next).
+ * @param cameraLabel the camera label
+ * @param mode        the frame exposure mode
+ */
+void CMMCore::setFrameExposureMode(const char* cameraLabel, const char* mode)
+   throw (CMMError)
+{
+   if (!mode)
+      throw CMMError("Null frame exposure mode", MMERR_NullPointerException);
+   if (strcmp(mode, MM::g_FrameExposureMode_Distinct) != 0 &&
+         strcmp(mode, MM::g_FrameExposureMode_Exposure) != 0 &&
+         strcmp(mode, MM::g_FrameExposureMode_Combined) != 0)
+      throw CMMError("Frame exposure mode " + ToQuotedString(mode) +
+            " must be \"" + MM::g_FrameExposureMode_Distinct + "\", \"" +
+            MM::g_FrameExposureMode_Exposure + "\" or \"" +
+            MM::g_FrameExposureMode_Combined + "\"", MMERR_InvalidContents);
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetFrameExposureMode(mode);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
+
+/**
+ * Arms the current camera for a burst.
+ * @see prepareForBurst(const char*, int)
+ */
+void CMMCore::prepareForBurst(int numImages) throw (CMMError)
+{
+   prepareForBurst(getCurrentCameraLabel().c_str(), numImages);
+}
+
+/**
+ * Arms the camera for a burst with the trigger types and delays set before.
+ * For the current camera, the circular buffer is initialized first, as in
+ * startSequenceAcquisition(). Throws if the camera does not support the
+ * combination of trigger types.
+ *
+ * @param cameraLabel the camera label
+ * @param numImages   the number of images in the burst, or -1 to acquire
+ *                    until the burst end trigger
+ */
+void CMMCore::prepareForBurst(const char* cameraLabel, int numImages)
+   throw (CMMError)
+{
+   if (numImages < 1 && numImages != -1)
+      throw CMMError("Number of burst images must be positive, or -1 to "
+            "acquire until the burst end trigger");
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   {
+      MMThreadGuard g(*pPostedErrorsLock_);
+      postedErrors_.clear();
+   }
+
+   mm::DeviceModuleLockGuard guard(camera);
+   if (camera->IsCapturing())
+      throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
+            MMERR_NotAllowedDuringSequenceAcquisition);
+
+   if (camera == currentCameraDevice_.lock())
+   {
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(),
+               camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+      {
+         logError(cameraLabel, getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(),
+               MMERR_CircularBufferFailedToInitialize);
+      }
+      cbuf_->Clear();
+   }
+
+   // The trigger types may not have been set through the Core (e.g. the
+   // camera's defaults), so take those the camera will use
+   std::string triggerType;
+   if (camera->GetBurstStartTriggerType(triggerType) == DEVICE_OK)
+      triggerLatency_->SetBurstStartTriggerType(cameraLabel, triggerType);
+   if (camera->GetFrameStartTriggerType(triggerType) == DEVICE_OK)
+      triggerLatency_->SetFrameStartTriggerType(cameraLabel, triggerType);
+
+   LOG_DEBUG(coreLogger_) << "Will prepare camera " << cameraLabel <<
+      " for a burst of " << numImages << " images";
+   // With an internal burst start trigger, frames may arrive before the
+   // camera returns
+   triggerLatency_->BurstPrepared(cameraLabel, GetMMTimeNow().getMsec());
+   int ret = camera->PrepareForBurst(numImages);
+   if (ret != DEVICE_OK)
+   {
+      triggerLatency_->TriggerFailed(cameraLabel);
+      throw CMMError(getDeviceErrorText(ret, camera));
+   }
+   LOG_DEBUG(coreLogger_) << "Did prepare camera " << cameraLabel <<
+      " for a burst";
+}
+
+/**
+ * Starts the burst of the current camera.
+ * @see sendBurstStartTrigger(const char*)
+ */
+void CMMCore::sendBurstStartTrigger() throw (CMMError)
+{
+   sendBurstStartTrigger(getCurrentCameraLabel().c_str());
+}
+
+/**
+ * Starts the burst that the camera has been armed for, if its burst start
+ * trigger type is "software".
+ * @param cameraLabel the camera label
+ */
+void CMMCore::sendBurstStartTrigger(const char* cameraLabel) throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   triggerLatency_->BurstStartTriggerSent(cameraLabel, GetMMTimeNow().getMsec());
+   int ret = camera->SendBurstStartTrigger();
+   if (ret != DEVICE_OK)
+   {
+      triggerLatency_->TriggerFailed(cameraLabel);
+      throw CMMError(getDeviceErrorText(ret, camera));
+   }
+}
+
+/**
+ * Starts a frame of the burst of the current camera.
+ * @see sendFrameStartTrigger(const char*)
+ */
+void CMMCore::sendFrameStartTrigger() throw (CMMError)
+{
+   sendFrameStartTrigger(getCurrentCameraLabel().c_str());
+}
+
+/**
+ * Starts a frame of the running burst, if the camera's frame start trigger
+ * type is "software". Blocks for the duration of the exposure, so that
+ * shutters can be closed as soon as it returns. The time from this call to
+ * the arrival of the frame is recorded as its trigger latency.
+ * @param cameraLabel the camera label
+ */
+void CMMCore::sendFrameStartTrigger(const char* cameraLabel) throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   triggerLatency_->FrameStartTriggerSent(cameraLabel, GetMMTimeNow().getMsec());
+   int ret = camera->SendFrameStartTrigger();
+   if (ret != DEVICE_OK)
+   {
+      triggerLatency_->TriggerFailed(cameraLabel);
+      throw CMMError(getDeviceErrorText(ret, camera));
+   }
+}
+
+/**
+ * Ends the burst of the current camera.
+ * @see sendBurstEndTrigger(const char*)
+ */
+void CMMCore::sendBurstEndTrigger() throw (CMMError)
+{
+   sendBurstEndTrigger(getCurrentCameraLabel().c_str());
+}
+
+/**
+ * Ends the running burst, if the camera's burst end trigger type is
+ * "software".
+ * @param cameraLabel the camera label
+ */
+void CMMCore::sendBurstEndTrigger(const char* cameraLabel) throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SendBurstEndTrigger();
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+
+   std::string streamError;
+   if (!diskStream_->Finish(cameraLabel, streamError))
+   {
+      logError(cameraLabel, streamError.c_str());
+      throw CMMError(streamError);
+   }
+}
+
+/**
+ * Returns the trigger latencies of the frames of the camera's last burst, in
+ * milliseconds: the time from each frame's trigger to its arrival in the
+ * Core. The latency of each frame is also in its metadata
+ * (TriggerLatency-ms).
+ *
+ * Only frames with a trigger sent by the Core are measured: those started by
+ * sendFrameStartTrigger() and, with internal frame start triggers, the first
+ * frame after the burst started.
+ *
+ * @param cameraLabel the camera label
+ */
+std::vector<double> CMMCore::getTriggerLatencies(const char* cameraLabel)
+   throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+   return triggerLatency_->GetLatencies(camera->GetLabel());
+}
+
+/**
+ * Returns the delay between the exposure starts of successive lines of a
+ * rolling shutter camera, in microseconds.
+ * @param cameraLabel the camera label
+ */
+double CMMCore::getRollingShutterLineOffset(const char* cameraLabel)
+   throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   double offsetUs;
+   int ret = camera->GetRollingShutterLineOffset(offsetUs);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+   return offsetUs;
+}
+
+/**
+ * Sets the delay between the exposure starts of successive lines of a
+ * rolling shutter camera, e.g. to follow a scanned light sheet.
+ * @param cameraLabel the camera label
+ * @param offsetUs    the delay in microseconds
+ */
+void CMMCore::setRollingShutterLineOffset(const char* cameraLabel,
+      double offsetUs) throw (CMMError)
+{
+   if (offsetUs < 0.0)
+      throw CMMError("Rolling shutter line offset must not be negative");
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetRollingShutterLineOffset(offsetUs);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
+
+/**
+ * Returns the number of lines of a rolling shutter camera that are exposed
+ * at the same time.
+ * @param cameraLabel the camera label
+ */
+int CMMCore::getRollingShutterActiveLines(const char* cameraLabel)
+   throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   int numLines;
+   int ret = camera->GetRollingShutterActiveLines(numLines);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+   return numLines;
+}
+
+/**
+ * Sets the number of lines of a rolling shutter camera that are exposed at
+ * the same time.
+ * @param cameraLabel the camera label
+ * @param numLines    the number of lines
  */
-bool CMMCore::isSequenceRunning(const char* label) throw (CMMError)
+void CMMCore::setRollingShutterActiveLines(const char* cameraLabel,
+      int numLines) throw (CMMError)
 {
-   boost::shared_ptr<CameraInstance> pCam =
-      deviceManager_->GetDeviceOfType<CameraInstance>(label);
+   if (numLines < 1)
+      throw CMMError("Number of rolling shutter active lines must be positive");
+   boost::shared_ptr<CameraInstance> camera = getBurstCamera(cameraLabel);
 
-   mm::DeviceModuleLockGuard guard(pCam);
-   return pCam->IsCapturing();
-};
+   mm::DeviceModuleLockGuard guard(camera);
+   int ret = camera->SetRollingShutterActiveLines(numLines);
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, camera));
+}
 
 /**
  * Gets the last image from the circular buffer.
@@ -3146,12 +3782,38 @@ void CMMCore::clearCircularBuffer() throw (CMMError)
 void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
                                                ) throw (CMMError)
 {
+   const bool compression = cbuf_ && cbuf_->IsCompressionEnabled();
+   const std::string spillPath = cbuf_ ? cbuf_->GetSpillFilePath() : std::string();
+   const unsigned spillSizeMB = cbuf_ ? cbuf_->GetSpillFileSizeMB() : 0;
+   const unsigned statsBins = cbuf_ ? cbuf_->GetStatisticsHistogramBins() : 0;
+   previewStream_->SetBuffer(0);
    delete cbuf_; // discard old buffer
+   cbuf_ = 0;
    LOG_DEBUG(coreLogger_) << "Will set circular buffer size to " <<
       sizeMB << " MB";
 	try
 	{
 		cbuf_ = new CircularBuffer(sizeMB);
+		cbuf_->SetCompressionEnabled(compression);
+      if (!spillPath.empty())
+         cbuf_->SetSpillFile(spillPath, spillSizeMB);
+      if (statsBins > 0)
+         cbuf_->SetStatisticsEnabled(true, statsBins);
+      updateMultiROIDemux();
+      for (std::map<long, ImageROISubscription>::const_iterator it =
+            roiSubscriptions_.begin(); it != roiSubscriptions_.end(); ++it)
+      {
+         const ImageROISubscription& sub = it->second;
+         ImageRegion region;
+         region.x = sub.x;
+         region.y = sub.y;
+         region.width = sub.width;
+         region.height = sub.height;
+         region.step = sub.step;
+         region.binning = sub.binning;
+         cbuf_->AddRegionCursor(it->first, sub.channel, region);
+      }
+      previewStream_->SetBuffer(cbuf_);
 	}
 	catch(bad_alloc& ex)
 	{
@@ -3238,6 +3900,577 @@ long CMMCore::getBufferFreeCapacity()
    return 0;
 }
 
+/**
+ * Enables or disables lossless compression of the frames held in the
+ * circular buffer.
+ *
+ * When enabled, 8- and 16-bit frames are compressed (in parallel) as they are
+ * inserted and decompressed when retrieved, so that the memory footprint set
+ * with setCircularBufferMemoryFootprint() holds proportionally more frames.
+ * How many depends on the image content; low-signal, noisy data typically
+ * compresses by 2-4x. The buffer capacity reported by
+ * getBufferTotalCapacity() and getBufferFreeCapacity() becomes an estimate
+ * based on the compression ratio achieved so far.
+ *
+ * In compressed mode, the pixel pointers returned by getLastImage(),
+ * popNextImage() and related functions point to decoded copies that remain
+ * valid only until a few more images have been retrieved.
+ *
+ * Changing this setting discards the contents of the buffer.
+ */
+void CMMCore::setCircularBufferCompression(bool enable) throw (CMMError)
+{
+   if (enable == cbuf_->IsCompressionEnabled())
+      return;
+   if (enable && !cbuf_->GetSpillFilePath().empty())
+      throw CMMError("Circular buffer compression cannot be used with a spill file");
+
+   LOG_DEBUG(coreLogger_) << "Will " << (enable ? "enable" : "disable") <<
+      " circular buffer compression";
+   cbuf_->SetCompressionEnabled(enable);
+
+   boost::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
+   }
+   LOG_DEBUG(coreLogger_) << "Did " << (enable ? "enable" : "disable") <<
+      " circular buffer compression";
+}
+
+/**
+ * Returns whether the circular buffer compresses the frames it holds.
+ */
+bool CMMCore::isCircularBufferCompressionEnabled()
+{
+   return cbuf_->IsCompressionEnabled();
+}
+
+/**
+ * Returns the ratio of raw to compressed size for the frames inserted since
+ * the circular buffer was last initialized (1.0 if none).
+ */
+double CMMCore::getCircularBufferCompressionRatio()
+{
+   return cbuf_->GetCompressionRatio();
+}
+
+/**
+ * Returns the average time spent compressing each frame (per camera
+ * channel), in microseconds.
+ */
+double CMMCore::getCircularBufferCompressionTimeUs()
+{
+   return cbuf_->GetCompressionTimePerFrameUs();
+}
+
+/**
+ * Sets a file to which the circular buffer moves unread frames when it
+ * fills up, extending its capacity beyond the memory footprint.
+ *
+ * Once more than half of the in-memory buffer holds unread frames, a
+ * background thread moves the oldest ones to the file (a memory-mapped file
+ * of the given size, which should be on fast local storage), so that bursts
+ * faster than the consumer can drain the buffer are absorbed rather than
+ * dropped. Frames are still retrieved in order by popNextImage(). Frames
+ * are only dropped (and the buffer reported as overflowed) once both the
+ * memory and the file are full.
+ *
+ * The file is created, with its full size reserved on disk, and deleted when
+ * it is no longer used. It is an error if a file already exists at the path.
+ * Pass an empty path or a size of 0 to stop using a spill file. Changing
+ * this setting discards the contents of the buffer. Spilling cannot be
+ * combined with compression.
+ *
+ * @param path    the file to create
+ * @param sizeMB  the size of the file in megabytes
+ */
+void CMMCore::setCircularBufferSpillFile(const char* path,
+      unsigned sizeMB) throw (CMMError)
+{
+   const std::string spillPath = path ? path : "";
+   if (!spillPath.empty() && sizeMB > 0 && cbuf_->IsCompressionEnabled())
+      throw CMMError("Circular buffer spill file cannot be used with compression");
+
+   LOG_DEBUG(coreLogger_) << "Will set circular buffer spill file to \"" <<
+      spillPath << "\" (" << sizeMB << " MB)";
+   cbuf_->SetSpillFile(spillPath, sizeMB);
+
+   boost::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
+   }
+   LOG_DEBUG(coreLogger_) << "Did set circular buffer spill file";
+}
+
+/**
+ * Returns the path of the circular buffer spill file, or an empty string if
+ * none is set.
+ */
+std::string CMMCore::getCircularBufferSpillFile()
+{
+   return cbuf_->GetSpillFilePath();
+}
+
+/**
+ * Returns the number of frames moved to the spill file since the circular
+ * buffer was last initialized.
+ */
+long CMMCore::getCircularBufferSpilledImageCount()
+{
+   return (long) cbuf_->GetSpilledImageCount();
+}
+
+/**
+ * Enables or disables computing pixel statistics for each image as it is
+ * inserted into the circular buffer.
+ *
+ * The statistics are computed in parallel right after the image is copied
+ * into the buffer, so that clients (autocontrast, saturation warnings, focus
+ * indicators) need not recompute them. The minimum, maximum, mean and
+ * standard deviation are added to the image metadata as the tags PixelMin,
+ * PixelMax, PixelMean and PixelStdDev. For the most recent image, they and
+ * the histogram are also available from getLastImageStatistics() and
+ * getLastImageHistogram(). Only 8- and 16-bit grayscale images are analyzed.
+ *
+ * @param enable         whether to compute statistics
+ * @param histogramBins  number of histogram bins, a power of 2 (e.g. 256 or
+ *                       4096); the bins evenly divide the full range of the
+ *                       pixel type, and 8-bit images use at most 256 bins
+ */
+void CMMCore::setCircularBufferStatistics(bool enable, unsigned histogramBins)
+   throw (CMMError)
+{
+   if (enable && (histogramBins == 0 || histogramBins > 65536 ||
+            (histogramBins & (histogramBins - 1)) != 0))
+      throw CMMError("Histogram bin count must be a power of 2 no greater "
+            "than 65536");
+   cbuf_->SetStatisticsEnabled(enable, histogramBins);
+}
+
+/**
+ * Returns whether per-image statistics are computed on insertion.
+ */
+bool CMMCore::isCircularBufferStatisticsEnabled()
+{
+   return cbuf_->IsStatisticsEnabled();
+}
+
+/**
+ * Returns the statistics of the most recent image in the circular buffer as
+ * the values {min, max, mean, standard deviation}.
+ *
+ * @throws CMMError if statistics are not enabled or not available
+ */
+std::vector<double> CMMCore::getLastImageStatistics(unsigned channel)
+   throw (CMMError)
+{
+   ImageStatistics stats;
+   if (!cbuf_->GetNthFromTopImageStatistics(0, channel, stats))
+      throw CMMError("Image statistics are not available");
+   std::vector<double> result;
+   result.push_back(stats.min);
+   result.push_back(stats.max);
+   result.push_back(stats.mean);
+   result.push_back(stats.stdDev);
+   return result;
+}
+
+/**
+ * Returns the histogram of the most recent image in the circular buffer,
+ * with the number of bins set by setCircularBufferStatistics().
+ *
+ * @throws CMMError if statistics are not enabled or not available
+ */
+std::vector<long> CMMCore::getLastImageHistogram(unsigned channel)
+   throw (CMMError)
+{
+   ImageStatistics stats;
+   if (!cbuf_->GetNthFromTopImageStatistics(0, channel, stats))
+      throw CMMError("Image statistics are not available");
+   return stats.histogram;
+}
+
+/**
+ * Returns a region of the most recent image in the circular buffer, without
+ * transferring the whole frame.
+ *
+ * The region may be reduced by an integer factor (step) in each dimension,
+ * by taking every step-th pixel of every step-th row or, if binning is set,
+ * by averaging step x step blocks (8- and 16-bit images only). The result is
+ * (width / step) x (height / step) pixels of the same type as the image. It
+ * is copied into a buffer owned by the core that remains valid until the
+ * next call to this function.
+ *
+ * @throws CMMError if the buffer is empty or the region lies outside the
+ * image
+ */
+void* CMMCore::getLastImageROI(unsigned channel, unsigned x, unsigned y,
+      unsigned width, unsigned height, unsigned step, bool binning,
+      Metadata& md) throw (CMMError)
+{
+   ImageRegion region;
+   region.x = x;
+   region.y = y;
+   region.width = width;
+   region.height = height;
+   region.step = step;
+   region.binning = binning;
+   if (region.OutputWidth() == 0 || region.OutputHeight() == 0)
+      throw CMMError("Image region is empty");
+
+   lastImageROI_.resize((size_t) region.OutputWidth() *
+         region.OutputHeight() * cbuf_->Depth());
+   if (!cbuf_->CopyNthFromTopRegion(0, channel, region, &lastImageROI_[0], &md))
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(),
+            MMERR_CircularBufferEmpty);
+   return &lastImageROI_[0];
+}
+
+/**
+ * Subscribes to a region of every image inserted into the circular buffer
+ * from now on.
+ *
+ * Each subscription has its own read position, independent of
+ * popNextImage() and of other subscriptions, so that e.g. a tracking or
+ * feedback loop can follow a small region of a high-rate sequence. Frames
+ * retrieved with popNextImage() before a subscription reads them are
+ * skipped (and counted; see popNextSubscribedROI()). The region is
+ * specified as for getLastImageROI().
+ *
+ * @return an id for use with popNextSubscribedROI() and
+ * removeImageROISubscription()
+ */
+long CMMCore::addImageROISubscription(unsigned channel, unsigned x,
+      unsigned y, unsigned width, unsigned height, unsigned step,
+      bool binning) throw (CMMError)
+{
+   if (step == 0 || width / step == 0 || height / step == 0)
+      throw CMMError("Image region is empty");
+
+   const long id = ++nextROISubscriptionId_;
+   ImageROISubscription& sub = roiSubscriptions_[id];
+   sub.channel = channel;
+   sub.x = x;
+   sub.y = y;
+   sub.width = width;
+   sub.height = height;
+   sub.step = step;
+   sub.binning = binning;
+
+   ImageRegion region;
+   region.x = x;
+   region.y = y;
+   region.width = width;
+   region.height = height;
+   region.step = step;
+   region.binning = binning;
+   cbuf_->AddRegionCursor(id, channel, region);
+   return id;
+}
+
+/**
+ * Removes a subscription added with addImageROISubscription().
+ */
+void CMMCore::removeImageROISubscription(long id) throw (CMMError)
+{
+   if (roiSubscriptions_.erase(id) == 0)
+      throw CMMError("No such image region subscription");
+   cbuf_->RemoveRegionCursor(id);
+}
+
+/**
+ * Returns the region of the next image for the given subscription and
+ * advances the subscription.
+ *
+ * The pixels are copied into a buffer owned by the subscription that remains
+ * valid until the next call for the same subscription. The number of images
+ * skipped since the previous call (because they were removed from the
+ * buffer first) is added to the metadata as the tag ROISkippedImages.
+ *
+ * @throws CMMError if there is no new image for the subscription
+ */
+void* CMMCore::popNextSubscribedROI(long id, Metadata& md) throw (CMMError)
+{
+   std::map<long, ImageROISubscription>::iterator it = roiSubscriptions_.find(id);
+   if (it == roiSubscriptions_.end())
+      throw CMMError("No such image region subscription");
+   ImageROISubscription& sub = it->second;
+
+   sub.pixels.resize((size_t) (sub.width / sub.step) *
+         (sub.height / sub.step) * cbuf_->Depth());
+   unsigned long skipped;
+   if (!cbuf_->ReadNextRegion(id, &sub.pixels[0], &md, skipped))
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(),
+            MMERR_CircularBufferEmpty);
+   md.PutImageTag("ROISkippedImages", skipped);
+   return &sub.pixels[0];
+}
+
+/**
+ * Returns the width of the images returned for a subscription.
+ */
+unsigned CMMCore::getImageROISubscriptionWidth(long id) throw (CMMError)
+{
+   std::map<long, ImageROISubscription>::const_iterator it = roiSubscriptions_.find(id);
+   if (it == roiSubscriptions_.end())
+      throw CMMError("No such image region subscription");
+   return it->second.width / it->second.step;
+}
+
+/**
+ * Returns the height of the images returned for a subscription.
+ */
+unsigned CMMCore::getImageROISubscriptionHeight(long id) throw (CMMError)
+{
+   std::map<long, ImageROISubscription>::const_iterator it = roiSubscriptions_.find(id);
+   if (it == roiSubscriptions_.end())
+      throw CMMError("No such image region subscription");
+   return it->second.height / it->second.step;
+}
+
+/**
+ * Enables or disables the core-generated preview stream.
+ *
+ * While enabled, a background thread turns the newest image in the circular
+ * buffer into a reduced-size 8-bit preview (see setPreviewStreamSize()), at
+ * most at the rate set with setPreviewStreamMaxRate() and only when a new
+ * image has arrived. This lets a live display fetch a small image and its
+ * statistics with getLatestPreview(), instead of transferring and reducing
+ * full frames. Only 8- and 16-bit grayscale images (the first camera
+ * channel) are previewed.
+ */
+void CMMCore::setPreviewStreamEnabled(bool enable)
+{
+   LOG_DEBUG(coreLogger_) << (enable ? "Will enable" : "Will disable") <<
+      " preview stream";
+   previewStream_->SetEnabled(enable);
+}
+
+/**
+ * Returns whether the preview stream is enabled.
+ */
+bool CMMCore::isPreviewStreamEnabled()
+{
+   return previewStream_->IsEnabled();
+}
+
+/**
+ * Sets the maximum size of preview images.
+ *
+ * Images are reduced by the smallest integer factor that makes them fit,
+ * either by averaging blocks of pixels (binning) or by taking every n-th
+ * pixel of every n-th row. The defaults are 512 x 512 and binning.
+ *
+ * @param maxWidth   maximum preview width
+ * @param maxHeight  maximum preview height
+ * @param binning    whether to average rather than subsample
+ */
+void CMMCore::setPreviewStreamSize(unsigned maxWidth, unsigned maxHeight,
+      bool binning) throw (CMMError)
+{
+   if (maxWidth == 0 || maxHeight == 0)
+      throw CMMError("Preview size must be at least 1 x 1");
+   mm::PreviewSettings settings = previewStream_->GetSettings();
+   settings.maxWidth = maxWidth;
+   settings.maxHeight = maxHeight;
+   settings.binning = binning;
+   previewStream_->SetSettings(settings);
+}
+
+/**
+ * Sets the maximum rate at which previews are produced (default 30 Hz).
+ */
+void CMMCore::setPreviewStreamMaxRate(double rateHz) throw (CMMError)
+{
+   if (!(rateHz > 0.0))
+      throw CMMError("Preview rate must be positive");
+   mm::PreviewSettings settings = previewStream_->GetSettings();
+   settings.maxRateHz = rateHz;
+   previewStream_->SetSettings(settings);
+}
+
+/**
+ * Sets how preview pixel values are mapped to 8 bits.
+ *
+ * Values up to min map to 0 and values from max to 255, with the given gamma
+ * applied in between. If max is not greater than min, each preview is scaled
+ * to its own minimum and maximum (the default).
+ */
+void CMMCore::setPreviewDisplayRange(long min, long max, double gamma)
+   throw (CMMError)
+{
+   if (!(gamma > 0.0))
+      throw CMMError("Preview gamma must be positive");
+   mm::PreviewSettings settings = previewStream_->GetSettings();
+   settings.displayMin = min;
+   settings.displayMax = max;
+   settings.gamma = gamma;
+   previewStream_->SetSettings(settings);
+}
+
+/**
+ * Returns the most recent preview image (8 bits per pixel).
+ *
+ * The returned pixels remain valid until two more new previews have been
+ * returned by this function. The metadata is that of the source image, with
+ * the preview size and statistics added as the tags PreviewWidth,
+ * PreviewHeight, PreviewFactor, PreviewMin, PreviewMax and
+ * PreviewSequenceNumber. Min and max are those of the preview pixels before
+ * mapping to 8 bits (after binning, if enabled).
+ *
+ * getLatestPreviewWidth(), getLatestPreviewHeight() and
+ * getLatestPreviewHistogram() describe the preview last returned to any
+ * thread; callers that may run concurrently should use the tags instead.
+ *
+ * @throws CMMError if the preview stream is disabled or has not produced a
+ * preview yet
+ */
+void* CMMCore::getLatestPreview(Metadata& md) throw (CMMError)
+{
+   if (!previewStream_->IsEnabled())
+      throw CMMError("Preview stream is not enabled");
+   boost::shared_ptr<mm::PreviewFrame> latest(new mm::PreviewFrame());
+   if (!previewStream_->GetLatest(*latest))
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(),
+            MMERR_CircularBufferEmpty);
+
+   MMThreadGuard guard(latestPreviewLock_);
+   if (latestPreviews_.empty() ||
+         latestPreviews_.back()->sequenceNumber != latest->sequenceNumber)
+   {
+      latestPreviews_.push_back(latest);
+      if (latestPreviews_.size() > 3)
+         latestPreviews_.pop_front();
+   }
+   const mm::PreviewFrame& preview = *latestPreviews_.back();
+   md = preview.metadata;
+   md.PutImageTag("PreviewWidth", preview.width);
+   md.PutImageTag("PreviewHeight", preview.height);
+   md.PutImageTag("PreviewFactor", preview.factor);
+   md.PutImageTag("PreviewMin", preview.min);
+   md.PutImageTag("PreviewMax", preview.max);
+   md.PutImageTag("PreviewSequenceNumber",
+         ToString(preview.sequenceNumber));
+   return const_cast<unsigned char*>(&preview.pixels[0]);
+}
+
+/**
+ * Returns the width of the image last returned by getLatestPreview().
+ */
+unsigned CMMCore::getLatestPreviewWidth()
+{
+   MMThreadGuard guard(latestPreviewLock_);
+   return latestPreviews_.empty() ? 0 : latestPreviews_.back()->width;
+}
+
+/**
+ * Returns the height of the image last returned by getLatestPreview().
+ */
+unsigned CMMCore::getLatestPreviewHeight()
+{
+   MMThreadGuard guard(latestPreviewLock_);
+   return latestPreviews_.empty() ? 0 : latestPreviews_.back()->height;
+}
+
+/**
+ * Returns the 256-bin histogram of the image last returned by
+ * getLatestPreview(). The bins span PreviewMin to PreviewMax evenly.
+ */
+std::vector<long> CMMCore::getLatestPreviewHistogram()
+{
+   MMThreadGuard guard(latestPreviewLock_);
+   if (latestPreviews_.empty())
+      return std::vector<long>();
+   return latestPreviews_.back()->histogram;
+}
+
+/**
+ * Streams the images of sequence acquisitions to raw files.
+ *
+ * Each camera's images are written, as they are inserted, to files
+ * <camera>_00000.raw, <camera>_00001.raw, ... in a new subdirectory of
+ * directory (named after the start time) for each acquisition. The files
+ * are written by a pool of threads with unbuffered, page-aligned writes, so
+ * that sustained rates are limited by the disk rather than by the file
+ * cache; each image is padded to a whole number of memory pages. A file
+ * that would exceed maxFileSizeMB is continued in the next one. The session
+ * directory also holds instructions for importing the files into ImageJ.
+ *
+ * If keepInBuffer is false, images are not inserted into the circular
+ * buffer, so acquisitions can run at the disk's rate for any length without
+ * an application draining the buffer (there is then also no preview). Such
+ * images are still counted by getCameraFrameCounts(). The channels of a
+ * multi-channel image are written as separate images.
+ *
+ * Settings apply from the next acquisition; a camera's files are closed
+ * when its acquisition stops.
+ *
+ * @param directory       the directory in which to create session directories
+ * @param writerThreads   the number of concurrent writes, at least 1
+ * @param maxFileSizeMB   the size at which to start a new file, or 0 for no limit
+ * @param keepInBuffer    whether to also insert the images into the circular buffer
+ */
+void CMMCore::enableDiskStreaming(const char* directory, int writerThreads,
+      double maxFileSizeMB, bool keepInBuffer) throw (CMMError)
+{
+   if (!directory || std::string(directory).empty())
+      throw CMMError("Streaming directory must be given");
+   if (writerThreads < 1)
+      throw CMMError("Number of streaming writer threads must be at least 1");
+   if (!(maxFileSizeMB >= 0.0))
+      throw CMMError("Maximum streaming file size must not be negative");
+
+   mm::DiskStreamSettings settings;
+   settings.directory = directory;
+   settings.writerThreads = writerThreads;
+   settings.maxFileBytes =
+      static_cast<unsigned long long>(maxFileSizeMB * 1024.0 * 1024.0);
+   settings.keepInBuffer = keepInBuffer;
+   diskStream_->SetSettings(settings);
+   diskStream_->SetEnabled(true);
+   LOG_INFO(coreLogger_) << "Enabled streaming to disk in " << directory <<
+      " (" << writerThreads << " writer threads" <<
+      (keepInBuffer ? "" : ", bypassing the circular buffer") << ")";
+}
+
+/**
+ * Stops streaming images to disk, closing any open files.
+ */
+void CMMCore::disableDiskStreaming()
+{
+   diskStream_->SetEnabled(false);
+   LOG_INFO(coreLogger_) << "Disabled streaming to disk";
+}
+
+bool CMMCore::isDiskStreamingEnabled()
+{
+   return diskStream_->IsEnabled();
+}
+
+/**
+ * Returns the directory of the current or last streaming session, or an
+ * empty string if no images have been streamed.
+ */
+std::string CMMCore::getDiskStreamingSessionPath()
+{
+   return diskStream_->GetSessionPath();
+}
+
+/**
+ * Returns the number of images written to disk in the current or last
+ * streaming session.
+ */
+long CMMCore::getDiskStreamingFramesWritten()
+{
+   return static_cast<long>(diskStream_->GetFramesWritten());
+}
+
 /**
  * Indicates whether the circular buffer is overflowed
  */
@@ -3246,6 +4479,37 @@ bool CMMCore::isBufferOverflowed() const
    return cbuf_->Overflow();
 }
 
+/**
+ * Returns the frame accounting totals for a camera since the circular buffer
+ * was last initialized (which it is at the start of each sequence
+ * acquisition), as the values {received, dropped by the device, dropped by
+ * the circular buffer, late, discontinuities}. Frames dropped by the
+ * circular buffer include those discarded unread when a camera clears the
+ * buffer after it overflows.
+ *
+ * Frames dropped by the device and late frames can only be detected for
+ * cameras that supply a hardware frame counter and timestamp in the image
+ * metadata. A discontinuity is a frame counter or timestamp that went
+ * backwards. The same totals, as of each frame, are added to the image
+ * metadata.
+ *
+ * @param cameraLabel the camera label
+ */
+std::vector<long> CMMCore::getCameraFrameCounts(const char* cameraLabel)
+   throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+   const FrameCounts counts = cbuf_->GetFrameCounts(camera->GetLabel());
+   std::vector<long> result;
+   result.push_back(counts.received);
+   result.push_back(counts.droppedByDevice);
+   result.push_back(counts.droppedByBuffer);
+   result.push_back(counts.late);
+   result.push_back(counts.discontinuities);
+   return result;
+}
+
 /**
  * Returns the label of the currently selected camera device.
  * @return camera name
@@ -3623,6 +4887,7 @@ void CMMCore::setCameraDevice(const char* cameraLabel) throw (CMMError)
       currentCameraDevice_.reset();
       LOG_INFO(coreLogger_) << "Default camera unset";
    }
+   updateMultiROIDemux();
    properties_->Refresh(); // TODO: more efficient
    std::string newCameraLabel = getCameraDevice();
    {
@@ -4082,6 +5347,9 @@ unsigned CMMCore::getImageWidth()
    }
 
    mm::DeviceModuleLockGuard guard(camera);
+   unsigned width, height, count;
+   if (getBufferDemuxImageSize(width, height, count))
+      return width;
    return camera->GetImageWidth();
 }
 
@@ -4098,6 +5366,9 @@ unsigned CMMCore::getImageHeight()
    }
 
    mm::DeviceModuleLockGuard guard(camera);
+   unsigned width, height, count;
+   if (getBufferDemuxImageSize(width, height, count))
+      return height;
    return camera->GetImageHeight();
 }
 
@@ -4164,6 +5435,9 @@ unsigned CMMCore::getNumberOfCameraChannels()
    }
 
    mm::DeviceModuleLockGuard guard(camera);
+   unsigned width, height, count;
+   if (getBufferDemuxImageSize(width, height, count))
+      return count;
    return camera->GetNumberOfChannels();
 }
 
@@ -4179,6 +5453,9 @@ string CMMCore::getCameraChannelName(unsigned int channelNr)
    }
 
    mm::DeviceModuleLockGuard guard(camera);
+   unsigned width, height, count;
+   if (getBufferDemuxImageSize(width, height, count))
+      return "ROI-" + ToString(channelNr);
    return camera->GetChannelName(channelNr);
 }
 
@@ -4308,6 +5585,7 @@ void CMMCore::setROI(int x, int y, int xSize, int ySize) throw (CMMError)
    }
    else
       throw CMMError(getCoreErrorText(MMERR_CameraNotAvailable).c_str(), MMERR_CameraNotAvailable);
+   updateMultiROIDemux();
 
    LOG_DEBUG(coreLogger_) << "Did set ROI of current camera to ("
       "left = " << x << ", top = " << y <<
@@ -4387,6 +5665,7 @@ void CMMCore::setROI(const char* label, int x, int y, int xSize, int ySize) thro
   }
   else
      throw CMMError(getCoreErrorText(MMERR_CameraNotAvailable).c_str(), MMERR_CameraNotAvailable);
+  updateMultiROIDemux();
 
   LOG_DEBUG(coreLogger_) << "Did set ROI of camera " << label <<
      " to (left = " << x << ", top = " << y <<
@@ -4444,6 +5723,7 @@ void CMMCore::clearROI() throw (CMMError)
       // discard such images.
       cbuf_->Clear();
    }
+   updateMultiROIDemux();
 }
 
 /**
@@ -4521,6 +5801,7 @@ void CMMCore::setMultiROI(std::vector<unsigned> xs, std::vector<unsigned> ys,
    {
       throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
    }
+   updateMultiROIDemux();
 }
 
 /**
@@ -4586,6 +5867,54 @@ void CMMCore::getMultiROI(std::vector<unsigned>& xs, std::vector<unsigned>& ys,
    free(heightsArr);
 }
 
+/**
+ * Enables or disables splitting multi-ROI images into one image per ROI.
+ *
+ * Cameras that support multiple ROIs (see setMultiROI()) return a single
+ * image of the bounding box of the ROIs, filled with a constant outside
+ * them. When this option is enabled, the core stores only the ROI pixels:
+ * each image inserted into the circular buffer is split into one camera
+ * channel per ROI, of the size of the largest ROI (smaller ROIs are padded
+ * with zeros at the right and bottom). The metadata of each channel gives
+ * the position and size of its ROI on the sensor (ROI-X-start, ROI-Y-start,
+ * MultiROIWidth, MultiROIHeight).
+ *
+ * The circular buffer splits images from when it is initialized (when this
+ * option is set or a sequence acquisition starts) with ROIs that fit the
+ * camera image, until the ROIs change or it is initialized without them.
+ * This includes the time after a sequence acquisition stops, while its
+ * images can still be popped. Meanwhile getImageWidth(), getImageHeight(),
+ * getImageBufferSize(), getNumberOfCameraChannels() and
+ * getCameraChannelName() describe the per-ROI images rather than the
+ * camera's own image, and getImage() after snapImage() returns the ROIs in
+ * the same way. Only single-channel cameras are supported; the option has no
+ * effect while the camera has no multiple ROIs set.
+ *
+ * Changing this setting discards the contents of the circular buffer.
+ */
+void CMMCore::setMultiROIDemuxEnabled(bool enable) throw (CMMError)
+{
+   multiROIDemux_ = enable;
+   updateMultiROIDemux();
+
+   boost::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
+      cbuf_->Clear();
+   }
+}
+
+/**
+ * Returns whether multi-ROI images are split into one image per ROI.
+ */
+bool CMMCore::isMultiROIDemuxEnabled()
+{
+   return multiROIDemux_;
+}
+
 /**
  * Sets the state (position) on the specific device. The command will fail if
  * the device does not support states.
@@ -5066,6 +6395,10 @@ void CMMCore::setPixelSizeConfig(const char* resolutionID) throw (CMMError)
  * Applies a configuration to a group. The command will fail if the
  * configuration was not previously defined.
  *
+ * If the system state cache is trusted (see setStateCacheTrusted()) and
+ * matches one of the group's presets, only the properties that differ
+ * between that preset and the new one are set.
+ *
  * @param groupName   the configuration group name
  * @param configName  the configuration preset name
  */
@@ -5085,12 +6418,41 @@ void CMMCore::setConfig(const char* groupName, const char* configName) throw (CM
             MMERR_NoConfiguration);
    }
 
-   LOG_DEBUG(coreLogger_) << "Config group " << groupName <<
-      ": will apply preset " << configName;
+   // Only the settings that differ from the current preset need to be set
+   Configuration transition;
+   const Configuration* pTransition = 0;
+   if (isStateCacheTrusted())
+   {
+      std::string current;
+      try
+      {
+         current = getCurrentConfigFromCache(groupName);
+      }
+      catch (const CMMError&)
+      {
+         // Some properties are not in the cache; apply the whole preset
+      }
+      if (!current.empty() && configGroups_->FindTransition(groupName,
+               current.c_str(), configName, transition))
+         pTransition = &transition;
+   }
+
+   if (pTransition)
+   {
+      LOG_DEBUG(coreLogger_) << "Config group " << groupName <<
+         ": will apply preset " << configName << " (" << pTransition->size() <<
+         " of " << pCfg->size() << " properties differ from the current preset)";
+   }
+   else
+   {
+      LOG_DEBUG(coreLogger_) << "Config group " << groupName <<
+         ": will apply preset " << configName;
+   }
 
    try {
-      applyConfiguration(*pCfg);
+      applyConfiguration(pTransition ? *pTransition : *pCfg);
    } catch (CMMError&) {
+      setStateCacheTrusted(false);
       throw;
    }
 
@@ -5912,6 +7274,44 @@ void CMMCore::setSLMImage(const char* deviceLabel, imgRGB32 pixels) throw (CMMEr
    }
 }
 
+/**
+ * Write an image to the SLM from a buffer holding exactly one image of
+ * getSLMWidth() x getSLMHeight() x getSLMBytesPerPixel() bytes.
+ *
+ * The pixels are passed to the device without copying. In the Java
+ * wrapper, the buffer is a direct java.nio.ByteBuffer, so that patterns
+ * can be switched without marshaling an array for each one.
+ *
+ * @param slmLabel name of the SLM
+ * @param pixelBuffer the image
+ * @param bufferBytes size of the buffer, which must match the image size
+ */
+void CMMCore::setSLMImage(const char* slmLabel, const unsigned char* pixelBuffer,
+      long bufferBytes) throw (CMMError)
+{
+   boost::shared_ptr<SLMInstance> pSLM =
+      deviceManager_->GetDeviceOfType<SLMInstance>(slmLabel);
+   if (!pixelBuffer)
+      throw CMMError("Null image");
+
+   mm::DeviceModuleLockGuard guard(pSLM);
+   const long imageBytes = getSLMImageBytes(pSLM);
+   if (bufferBytes != imageBytes)
+   {
+      throw CMMError("Image buffer of " + ToString(bufferBytes) +
+            " bytes does not match the image size of SLM " +
+            ToQuotedString(slmLabel) + " (" + ToString(imageBytes) + " bytes)");
+   }
+
+   // MM::SLM::SetImage() does not modify the pixels
+   int ret = pSLM->SetImage(const_cast<unsigned char*>(pixelBuffer));
+   if (ret != DEVICE_OK)
+   {
+      logError(slmLabel, getDeviceErrorText(ret, pSLM).c_str());
+      throw CMMError(getDeviceErrorText(ret, pSLM));
+   }
+}
+
 /**
  * Set all SLM pixels to a single 8-bit intensity.
  */
@@ -6135,6 +7535,66 @@ void CMMCore::loadSLMSequence(const char* deviceLabel, std::vector<unsigned char
       throw CMMError(getDeviceErrorText(ret, pSLM));
 }
 
+/**
+ * Load a sequence of images into the SLM from a single buffer holding the
+ * images one after the other, each of getSLMWidth() x getSLMHeight() x
+ * getSLMBytesPerPixel() bytes.
+ *
+ * The images are added to the device's sequence in place, under a single
+ * acquisition of the device adapter's lock. In the Java wrapper, the buffer
+ * is a direct java.nio.ByteBuffer, so that the sequence is not copied before
+ * it reaches the device.
+ *
+ * @param slmLabel name of the SLM
+ * @param pixelBuffer the images
+ * @param bufferBytes size of the buffer, which must be a whole number of
+ *        images
+ */
+void CMMCore::loadSLMSequence(const char* slmLabel,
+      const unsigned char* pixelBuffer, long bufferBytes) throw (CMMError)
+{
+   boost::shared_ptr<SLMInstance> pSLM =
+      deviceManager_->GetDeviceOfType<SLMInstance>(slmLabel);
+   if (!pixelBuffer)
+      throw CMMError("Null image sequence");
+
+   mm::DeviceModuleLockGuard guard(pSLM);
+   const long imageBytes = getSLMImageBytes(pSLM);
+   if (imageBytes <= 0 || bufferBytes <= 0 || bufferBytes % imageBytes != 0)
+   {
+      throw CMMError("Image sequence buffer of " + ToString(bufferBytes) +
+            " bytes is not a whole number of images of SLM " +
+            ToQuotedString(slmLabel) + " (" + ToString(imageBytes) +
+            " bytes each)");
+   }
+   const long imageCount = bufferBytes / imageBytes;
+
+   // Fail before replacing the device's sequence, where the device can tell
+   long maxLength;
+   int ret = pSLM->GetSLMSequenceMaxLength(maxLength);
+   if (ret == DEVICE_OK && imageCount > maxLength)
+   {
+      throw CMMError("Image sequence of " + ToString(imageCount) +
+            " images is longer than the maximum sequence length of SLM " +
+            ToQuotedString(slmLabel) + " (" + ToString(maxLength) + ")");
+   }
+
+   ret = pSLM->ClearSLMSequence();
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, pSLM));
+
+   for (long i = 0; i < imageCount; ++i)
+   {
+      ret = pSLM->AddToSLMSequence(pixelBuffer + i * imageBytes);
+      if (ret != DEVICE_OK)
+         throw CMMError(getDeviceErrorText(ret, pSLM));
+   }
+
+   ret = pSLM->SendSLMSequence();
+   if (ret != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(ret, pSLM));
+}
+
 /* GALVO CODE */
 
 /**
@@ -6415,6 +7875,10 @@ string CMMCore::getGalvoChannel(const char* deviceLabel) throw (CMMError)
  * Saves the current system state to a text file of the MM specific format.
  * The file records only read-write properties.
  * The file format is directly readable by the complementary loadSystemState() command.
+ *
+ * The values are taken from the system state cache rather than queried from
+ * the devices; call updateSystemStateCache() first if the devices may have
+ * changed without notifying the Core.
  */
 void CMMCore::saveSystemState(const char* fileName) throw (CMMError)
 {
@@ -6431,11 +7895,23 @@ void CMMCore::saveSystemState(const char* fileName) throw (CMMError)
    }
 
    // save system state
-   Configuration config = getSystemState();
+   Configuration config = getSystemStateCache();
    for (size_t i=0; i<config.size(); i++)
    {
       PropertySetting s = config.getSetting(i);
-      if (!isPropertyReadOnly(s.getDeviceLabel().c_str(), s.getPropertyName().c_str()))
+      bool readOnly = s.getReadOnly();
+      if (!readOnly)
+      {
+         try
+         {
+            readOnly = isPropertyReadOnly(s.getDeviceLabel().c_str(), s.getPropertyName().c_str());
+         }
+         catch (const CMMError&)
+         {
+            continue; // Cached setting of a device no longer loaded
+         }
+      }
+      if (!readOnly)
       {
          os << MM::g_CFGCommand_Property << ',' << s.getDeviceLabel()
             << ',' << s.getPropertyName() << ',' << s.getPropertyValue() << endl;
@@ -6449,8 +7925,17 @@ void CMMCore::saveSystemState(const char* fileName) throw (CMMError)
  * read-write properties.
  *
  * Format specification: the same as in loadSystemConfiguration() command
+ *
+ * While the system state cache is trusted (see setStateCacheTrusted()),
+ * only properties whose value differs from the cache are set; otherwise
+ * every property is set. Properties are set grouped by device, hubs first
+ * and Core properties last, and in file order within each device. Each
+ * property is compared with the cache just before it would be set, so that
+ * values changed by earlier writes are still restored.
+ *
+ * @return the number of properties skipped because they were unchanged
  */
-void CMMCore::loadSystemState(const char* fileName) throw (CMMError)
+long CMMCore::loadSystemState(const char* fileName) throw (CMMError)
 {
    if (!fileName)
       throw CMMError("Null filename");
@@ -6464,6 +7949,9 @@ void CMMCore::loadSystemState(const char* fileName) throw (CMMError)
             MMERR_FileOpenFailed);
    }
 
+   // Read the settings first, so that they can be ordered and compared with
+   // the cache before any is applied
+   std::vector<PropertySetting> settings;
    // Process commands
    const int maxLineLength = 4 * MM::MaxStrLength + 4; // accommodate up to 4 strings and delimiters
    char line[maxLineLength+1];
@@ -6500,20 +7988,58 @@ void CMMCore::loadSystemState(const char* fileName) throw (CMMError)
                throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
                      ToQuotedString(line) + ")",
                      MMERR_InvalidCFGEntry);
-            try
-            {
-               // apply the command
-               setProperty(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
-            }
-            catch (CMMError&)
-            {
-               // Don't give up yet.
-               // TODO Yes, do give up, unless cleanly recoverable.
-            }
+            settings.push_back(PropertySetting(tokens[1].c_str(),
+                     tokens[2].c_str(), tokens[3].c_str()));
          }
       }
    }
+
+   struct Restore
+   {
+      static mm::SystemStateRank Rank(CMMCore* core, const std::string& label)
+      {
+         try
+         {
+            MM::DeviceType type = core->getDeviceType(label.c_str());
+            if (type == MM::HubDevice)
+               return mm::SystemStateRankHub;
+            if (type == MM::CoreDevice)
+               return mm::SystemStateRankCore;
+         }
+         catch (const CMMError&)
+         {
+            // Not loaded; setting its properties will fail
+         }
+         return mm::SystemStateRankDevice;
+      }
+
+      static bool IsCurrent(CMMCore* core, const PropertySetting& setting)
+      {
+         const std::string label = setting.getDeviceLabel();
+         const std::string propName = setting.getPropertyName();
+         MMThreadGuard scg(core->stateCacheLock_);
+         return core->stateCacheTrusted_ &&
+            core->stateCache_.isPropertyIncluded(label.c_str(), propName.c_str()) &&
+            core->stateCache_.getSetting(label.c_str(), propName.c_str()).getPropertyValue() ==
+            setting.getPropertyValue();
+      }
+
+      static void Apply(CMMCore* core, const PropertySetting& setting)
+      {
+         core->setProperty(setting.getDeviceLabel().c_str(),
+               setting.getPropertyName().c_str(),
+               setting.getPropertyValue().c_str());
+      }
+   };
+   const mm::SystemStateCounts counts = mm::ApplySystemState(settings,
+         boost::bind(&Restore::Rank, this, _1),
+         boost::bind(&Restore::IsCurrent, this, _1),
+         boost::bind(&Restore::Apply, this, _1));
+   LOG_INFO(coreLogger_) << "Loaded system state from " << fileName << ": " <<
+      counts.written << " properties set, " << counts.skipped <<
+      " unchanged properties skipped";
    updateAllowedChannelGroups();
+   return counts.skipped;
 }
 
 
@@ -6976,6 +8502,7 @@ void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
    }
 
    updateAllowedChannelGroups();
+   configGroups_->PlanTransitions();
 
    // file parsing finished, try to set startup configuration
    if (isConfigDefined(MM::g_CFGGroup_System, MM::g_CFGGroup_System_Startup))
@@ -7433,6 +8960,18 @@ void CMMCore::CheckPropertyBlockName(const char* blockName) throw (CMMError)
             MMERR_InvalidContents);
 }
 
+void CMMCore::CheckTriggerType(const char* type) throw (CMMError)
+{
+   if (!type)
+      throw CMMError("Null trigger type", MMERR_NullPointerException);
+   if (strcmp(type, MM::g_TriggerType_Internal) != 0 &&
+         strcmp(type, MM::g_TriggerType_External) != 0 &&
+         strcmp(type, MM::g_TriggerType_Software) != 0)
+      throw CMMError("Trigger type " + ToQuotedString(type) + " must be \"" +
+            MM::g_TriggerType_Internal + "\", \"" + MM::g_TriggerType_External +
+            "\" or \"" + MM::g_TriggerType_Software + "\"", MMERR_InvalidContents);
+}
+
 bool CMMCore::IsCoreDeviceLabel(const char* label) const throw (CMMError)
 {
    if (!label)
@@ -7626,6 +9165,11 @@ bool CMMCore::supportsDeviceDetection(char* label)
  * Used to automate discovery of correct serial port
  * Also configures the serial port correctly
  *
+ * If the detection cache is enabled (see enableDetectionCache()) and the
+ * device was found before on the same port and port hardware, the device
+ * is not probed: MM::CanCommunicate is returned and the port settings
+ * found then are applied. Other results are not cached.
+ *
  * For legacy reasons, an exception is not thrown if there is an error.
  * Instead, MM::Unimplemented is returned if label is not a valid device.
  *
@@ -7646,6 +9190,9 @@ MM::DeviceDetectionStatus CMMCore::detectDevice(char* label)
    std::vector< std::string> propertiesToRestore;
    std::map< std::string, std::string> valuesToRestore;
    std::string port;
+   std::string module;
+   std::string deviceName;
+   std::string fingerprint; // Empty unless the result can be cached
 
    try
    {
@@ -7694,6 +9241,24 @@ MM::DeviceDetectionStatus CMMCore::detectDevice(char* label)
                   " of port " << port << " while testing for device " << label;
 	    }
          }
+
+         if (detectionCache_->IsOpen())
+         {
+            module = pDevice->GetAdapterModule()->GetName();
+            deviceName = pDevice->GetName();
+            fingerprint = getPortHardwareId(port);
+            mm::DetectionCacheEntry cached;
+            if (!fingerprint.empty() && detectionCache_->Lookup(module,
+                     deviceName, port, fingerprint, cached))
+            {
+               LOG_INFO(coreLogger_) << "Device detection: using cached result " <<
+                  cached.status << " for device " << label << " on port " << port;
+               for (size_t i = 0; i < cached.portSettings.size(); ++i)
+                  setProperty(port.c_str(), cached.portSettings[i].first.c_str(),
+                        cached.portSettings[i].second.c_str());
+               return cached.status;
+            }
+         }
       }
 
       // run device detection routine
@@ -7726,9 +9291,288 @@ MM::DeviceDetectionStatus CMMCore::detectDevice(char* label)
       }
    }
 
+   // A device that did not answer may just be switched off, so only finding
+   // it is remembered (storing another result removes the entry)
+   if (!fingerprint.empty())
+   {
+      mm::DetectionCacheEntry entry;
+      entry.fingerprint = fingerprint;
+      entry.status = result;
+      if (result == MM::CanCommunicate)
+      {
+         for (std::vector<std::string>::iterator sit = propertiesToRestore.begin();
+               sit != propertiesToRestore.end(); ++sit)
+         {
+            try
+            {
+               entry.portSettings.push_back(std::make_pair(*sit,
+                        getProperty(port.c_str(), sit->c_str())));
+            }
+            catch (const CMMError&)
+            {
+               // Not all ports have all the settings
+            }
+         }
+      }
+      std::string cacheError;
+      if (!detectionCache_->Store(module, deviceName, port, entry, cacheError))
+      {
+         LOG_ERROR(coreLogger_) << cacheError;
+      }
+   }
+
+   return result;
+}
+
+/**
+ * Runs detectDevice() for several devices, in parallel where they use
+ * different ports and device adapters.
+ *
+ * Detection of devices that share a port or an adapter module runs one at
+ * a time, in the order given, since their calls cannot overlap anyway.
+ *
+ * @param deviceLabels  the labels of the devices to detect
+ * @return the MM::DeviceDetectionStatus of each device, in the same order
+ */
+std::vector<long> CMMCore::detectDevices(
+      const std::vector<std::string>& deviceLabels) throw (CMMError)
+{
+   std::vector< std::vector<std::string> > resources;
+   for (std::vector<std::string>::const_iterator it = deviceLabels.begin();
+         it != deviceLabels.end(); ++it)
+   {
+      CheckDeviceLabel(it->c_str());
+      boost::shared_ptr<DeviceInstance> pDevice =
+         deviceManager_->GetDevice(*it);
+      std::vector<std::string> used;
+      used.push_back("module:" + pDevice->GetAdapterModule()->GetName());
+      {
+         mm::DeviceModuleLockGuard guard(pDevice);
+         if (pDevice->HasProperty(MM::g_Keyword_Port))
+         {
+            try
+            {
+               const std::string port = pDevice->GetProperty(MM::g_Keyword_Port);
+               if (!port.empty())
+                  used.push_back("port:" + port);
+            }
+            catch (const CMMError&)
+            {
+               // As in detectDevice(), treat as having no port
+            }
+         }
+      }
+      resources.push_back(used);
+   }
+
+   const std::vector< std::vector<size_t> > groups =
+      mm::GroupIndependentDetections(resources);
+   LOG_INFO(coreLogger_) << "Device detection: " << deviceLabels.size() <<
+      " devices in " << groups.size() << " independent groups";
+
+   std::vector<long> results(deviceLabels.size(), MM::Unimplemented);
+   struct Detect
+   {
+      static void One(CMMCore* core, const std::vector<std::string>* labels,
+            std::vector<long>* results, size_t index)
+      {
+         std::vector<char> label((*labels)[index].begin(),
+               (*labels)[index].end());
+         label.push_back('\0');
+         (*results)[index] = core->detectDevice(&label[0]);
+      }
+   };
+   mm::RunDetectionGroups(groups, boost::bind(&Detect::One, this,
+            &deviceLabels, &results, _1));
+   return results;
+}
+
+/**
+ * Enables caching of device detection results in the given file.
+ *
+ * detectDevice() and detectDevices() then skip devices that were found
+ * before on a port whose hardware has not changed since; devices that were
+ * not found are always probed again. The hardware is recognized by the
+ * HardwareId property of the port (on Linux, the USB vendor, product and
+ * serial number of USB serial adapters); devices on ports without it are
+ * always probed.
+ *
+ * The fingerprint is that of the port, not of the device or its firmware:
+ * replacing the device behind the same USB serial adapter, or updating its
+ * firmware, is not noticed. Call clearDetectionCache() after such changes.
+ *
+ * @param path  the cache file; created if it does not exist
+ */
+void CMMCore::enableDetectionCache(const char* path) throw (CMMError)
+{
+   if (!path || !*path)
+      throw CMMError("Path of the device detection cache is empty",
+            MMERR_InvalidContents);
+   std::string errorText;
+   if (!detectionCache_->Open(path, errorText))
+      throw CMMError(errorText, MMERR_FileOpenFailed);
+   LOG_INFO(coreLogger_) << "Device detection cache enabled: " << path;
+}
+
+/**
+ * Stops using the device detection cache. The file is kept.
+ */
+void CMMCore::disableDetectionCache()
+{
+   detectionCache_->Close();
+}
+
+/**
+ * Forgets all cached device detection results, so that all devices are
+ * probed again.
+ */
+void CMMCore::clearDetectionCache() throw (CMMError)
+{
+   std::string errorText;
+   if (!detectionCache_->Clear(errorText))
+      throw CMMError(errorText, MMERR_FileOpenFailed);
+}
+
+/**
+ * Enable or disable timing of the calls that the Core makes into devices.
+ *
+ * While enabled, every call into a device is timed and recorded in a
+ * histogram for the device and method (the MM::Device member function, such
+ * as "SnapImage" or "SetPositionUm"). The time spent waiting for the device
+ * adapter's lock before a call is recorded separately. Recording does not
+ * take locks; it costs a few clock readings per call.
+ *
+ * Devices loaded while profiling is enabled are profiled as well. Disabling
+ * profiling keeps the histograms recorded so far.
+ *
+ * @param enable whether to time device calls
+ */
+void CMMCore::enableDeviceCallProfiling(bool enable)
+{
+   deviceCallProfiling_ = enable;
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = labels.begin();
+         it != labels.end(); ++it)
+      deviceManager_->GetDevice(*it)->GetCallProfile().SetEnabled(enable);
+   LOG_INFO(coreLogger_) << "Device call profiling " <<
+      (enable ? "enabled" : "disabled");
+}
+
+/**
+ * Returns whether device call profiling is enabled.
+ */
+bool CMMCore::isDeviceCallProfilingEnabled()
+{
+   return deviceCallProfiling_;
+}
+
+/**
+ * Clears the device call histograms of all devices.
+ */
+void CMMCore::resetDeviceCallProfiles()
+{
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = labels.begin();
+         it != labels.end(); ++it)
+      deviceManager_->GetDevice(*it)->GetCallProfile().Reset();
+}
+
+/**
+ * Returns the methods of a device that have been called while profiling
+ * was enabled, since the last reset.
+ *
+ * @param deviceLabel the device
+ */
+std::vector<std::string> CMMCore::getProfiledDeviceMethods(const char* deviceLabel)
+   throw (CMMError)
+{
+   boost::shared_ptr<DeviceInstance> pDevice =
+      deviceManager_->GetDevice(deviceLabel);
+   const std::vector<mm::DeviceCallProfile::MethodSnapshot> methods =
+      pDevice->GetCallProfile().GetSnapshot();
+   std::vector<std::string> result;
+   for (std::vector<mm::DeviceCallProfile::MethodSnapshot>::const_iterator it =
+         methods.begin(); it != methods.end(); ++it)
+      result.push_back(it->method);
+   return result;
+}
+
+/**
+ * Returns latency statistics of the calls to a method of a device.
+ *
+ * The result holds, in order: the number of calls; the mean, median, 99th
+ * percentile and maximum time spent inside the device adapter; the number
+ * of calls that waited for the device adapter's lock; and the mean, median,
+ * 99th percentile and maximum time spent waiting. Times are in milliseconds;
+ * percentiles are accurate to about 12%. A method that has not been called
+ * has all zeros.
+ *
+ * @param deviceLabel the device
+ * @param method the method, as returned by getProfiledDeviceMethods()
+ */
+std::vector<double> CMMCore::getDeviceCallLatencies(const char* deviceLabel,
+      const char* method) throw (CMMError)
+{
+   boost::shared_ptr<DeviceInstance> pDevice =
+      deviceManager_->GetDevice(deviceLabel);
+   if (!method)
+      throw CMMError("Null method name");
+
+   std::vector<double> result(10, 0.0);
+   const std::vector<mm::DeviceCallProfile::MethodSnapshot> methods =
+      pDevice->GetCallProfile().GetSnapshot();
+   for (std::vector<mm::DeviceCallProfile::MethodSnapshot>::const_iterator it =
+         methods.begin(); it != methods.end(); ++it)
+   {
+      if (it->method != method)
+         continue;
+      const mm::LatencyHistogram::Snapshot* histograms[] =
+         { &it->adapter, &it->lockWait };
+      for (int h = 0; h < 2; ++h)
+      {
+         const mm::LatencyHistogram::Snapshot& histogram = *histograms[h];
+         result[5 * h] = static_cast<double>(histogram.count);
+         result[5 * h + 1] = histogram.MeanNs() / 1e6;
+         result[5 * h + 2] = histogram.PercentileNs(0.5) / 1e6;
+         result[5 * h + 3] = histogram.PercentileNs(0.99) / 1e6;
+         result[5 * h + 4] = histogram.maxNs / 1e6;
+      }
+   }
    return result;
 }
 
+/**
+ * Saves the device call histograms of all devices to a tab-separated text
+ * file, with a header line naming the columns. Each called method has two
+ * lines: one for the time spent in the device adapter and one for the time
+ * spent waiting for its lock, with count, mean, median, 99th percentile and
+ * maximum in microseconds, followed by the non-empty histogram buckets.
+ *
+ * @param path the file to write
+ */
+void CMMCore::saveDeviceCallProfiles(const char* path) throw (CMMError)
+{
+   if (!path)
+      throw CMMError("Null file name");
+   std::ofstream out(path, std::ios::trunc);
+   if (!out)
+      throw CMMError("Cannot open file " + ToQuotedString(path) +
+            " for writing", MMERR_FileOpenFailed);
+
+   mm::DeviceCallProfile::WriteHeader(out);
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = labels.begin();
+         it != labels.end(); ++it)
+   {
+      mm::DeviceCallProfile::Write(out, *it,
+            deviceManager_->GetDevice(*it)->GetCallProfile().GetSnapshot());
+   }
+   out.close();
+   if (!out)
+      throw CMMError("Failed to write file " + ToQuotedString(path),
+            MMERR_FileOpenFailed);
+}
+
 /**
  * Performs auto-detection and loading of child devices that are attached to a Hub device.
  * For example, if a motorized microscope is represented by a Hub device, it is capable of
@@ -7806,4 +9650,127 @@ std::vector<std::string> CMMCore::getMACAddresses(void)
    return retv;
 }
 
+// Sets the regions into which the circular buffer splits multi-ROI images
+// from the current camera's ROIs, or clears them if splitting is disabled
+// or does not apply.
+void CMMCore::updateMultiROIDemux()
+{
+   std::vector<ImageRegion> regions;
+   unsigned originX = 0, originY = 0;
+
+   boost::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (multiROIDemux_ && camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      unsigned count = 0;
+      if (camera->GetNumberOfChannels() == 1 && camera->SupportsMultiROI() &&
+            camera->IsMultiROISet() &&
+            camera->GetMultiROICount(count) == DEVICE_OK && count > 0)
+      {
+         std::vector<unsigned> xs(count), ys(count), widths(count), heights(count);
+         unsigned n = count;
+         if (camera->GetMultiROI(&xs[0], &ys[0], &widths[0], &heights[0], &n) ==
+               DEVICE_OK && n > 0 && n <= count)
+         {
+            originX = *std::min_element(xs.begin(), xs.begin() + n);
+            originY = *std::min_element(ys.begin(), ys.begin() + n);
+            for (unsigned i = 0; i < n; ++i)
+            {
+               ImageRegion region;
+               region.x = xs[i] - originX;
+               region.y = ys[i] - originY;
+               region.width = widths[i];
+               region.height = heights[i];
+               regions.push_back(region);
+            }
+         }
+         else
+         {
+            LOG_WARNING(coreLogger_) << "Cannot get multiple ROIs from " <<
+               camera->GetLabel() << "; images will not be split";
+         }
+      }
+   }
+   cbuf_->SetDemuxRegions(regions, originX, originY);
+}
+
+// Gets the size and number of the per-ROI images if the circular buffer
+// splits frames into them. This does not depend on a sequence acquisition
+// running, so that it also describes frames popped after it has stopped.
+bool CMMCore::getBufferDemuxImageSize(unsigned& width, unsigned& height,
+      unsigned& count)
+{
+   if (!cbuf_->IsDemuxActive())
+      return false;
+   return cbuf_->GetDemuxImageSize(width, height, count);
+}
+
+// Returns the given ROI of a snapped multi-ROI image if the circular buffer
+// splits images (so that it matches getImageWidth() and the other getters),
+// otherwise the image itself
+void* CMMCore::getDemuxedImage(void* pixels, unsigned channel, unsigned width,
+      unsigned height, unsigned depth) throw (CMMError)
+{
+   unsigned demuxWidth, demuxHeight, count;
+   if (!getBufferDemuxImageSize(demuxWidth, demuxHeight, count))
+      return pixels;
+   const std::vector<ImageRegion> regions = cbuf_->GetDemuxRegions();
+   if (channel >= regions.size())
+      throw CMMError("Camera channel " + ToString(channel) + " does not exist");
+   const ImageRegion& region = regions[channel];
+   if (region.x + region.width > width || region.y + region.height > height)
+      throw CMMError("Image does not contain ROI " + ToString(channel) +
+            "; the multiple ROIs have changed since the last sequence acquisition");
+
+   demuxedImage_.assign((size_t) demuxWidth * demuxHeight * depth, 0);
+   CopyImageRegion(static_cast<const unsigned char*>(pixels), width, height,
+         depth, region, &demuxedImage_[0], demuxWidth);
+   return &demuxedImage_[0];
+}
+
+// Returns the camera, or throws if it does not support the burst API
+boost::shared_ptr<CameraInstance> CMMCore::getBurstCamera(const char* cameraLabel)
+   throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   if (!camera->SupportsBurstAPI())
+      throw CMMError("Camera " + ToQuotedString(cameraLabel) +
+            " does not support burst acquisition", MMERR_DEVICE_GENERIC);
+   return camera;
+}
+
+std::string CMMCore::getCurrentCameraLabel() throw (CMMError)
+{
+   boost::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (!camera)
+      throw CMMError(getCoreErrorText(MMERR_CameraNotAvailable).c_str(),
+            MMERR_CameraNotAvailable);
+   return camera->GetLabel();
+}
+
+// Returns the HardwareId property of the port, or an empty string
+std::string CMMCore::getPortHardwareId(const std::string& port)
+{
+   try
+   {
+      boost::shared_ptr<DeviceInstance> pPort = deviceManager_->GetDevice(port);
+      mm::DeviceModuleLockGuard guard(pPort);
+      if (!pPort->HasProperty(MM::g_Keyword_HardwareId))
+         return std::string();
+      return pPort->GetProperty(MM::g_Keyword_HardwareId);
+   }
+   catch (const CMMError&)
+   {
+      return std::string();
+   }
+}
 
+// Bytes in one image of the SLM; call with the module lock held
+long CMMCore::getSLMImageBytes(boost::shared_ptr<SLMInstance> pSLM)
+{
+   return static_cast<long>(pSLM->GetWidth()) * pSLM->GetHeight() *
+      pSLM->GetBytesPerPixel();
+}
@@ -110,6 +110,12 @@ class CMMCore;
 namespace mm {
    class DeviceManager;
    class LogManager;
+   class PreviewStream;
+   class DiskStream;
+   class TriggerLatency;
+   class DetectionCache;
+   class WorkerThreadBudget;
+   struct PreviewFrame;
 } // namespace mm
 
 typedef unsigned int* imgRGB32;
@@ -164,7 +170,7 @@ public:
    Configuration getConfigState(const char* group, const char* config) throw (CMMError);
    Configuration getConfigGroupState(const char* group) throw (CMMError);
    void saveSystemState(const char* fileName) throw (CMMError);
-   void loadSystemState(const char* fileName) throw (CMMError);
+   long loadSystemState(const char* fileName) throw (CMMError);
    void saveSystemConfiguration(const char* fileName) throw (CMMError);
    void loadSystemConfiguration(const char* fileName) throw (CMMError);
    void registerCallback(MMEventCallback* cb);
@@ -253,6 +259,9 @@ public:
    void setTimeoutMs(long timeoutMs) {if (timeoutMs > 0) timeoutMs_ = timeoutMs;}
    long getTimeoutMs() { return timeoutMs_;}
 
+   void setDeviceWorkerThreadBudget(int threadCount) throw (CMMError);
+   int getDeviceWorkerThreadBudget();
+
    void sleep(double intervalMs) const;
    ///@}
 
@@ -290,6 +299,8 @@ public:
          const char* propName) const throw (CMMError);
    std::string getCurrentConfigFromCache(const char* groupName) throw (CMMError);
    Configuration getConfigGroupStateFromCache(const char* group) throw (CMMError);
+   void setStateCacheTrusted(bool trusted);
+   bool isStateCacheTrusted() const;
    ///@}
 
    /** \name Configuration groups. */
@@ -367,6 +378,8 @@ public:
    void getMultiROI(std::vector<unsigned>& xs, std::vector<unsigned>& ys,
            std::vector<unsigned>& widths,
            std::vector<unsigned>& heights) throw (CMMError);
+   void setMultiROIDemuxEnabled(bool enable) throw (CMMError);
+   bool isMultiROIDemuxEnabled();
 
    void setExposure(double exp) throw (CMMError);
    void setExposure(const char* cameraLabel, double dExp) throw (CMMError);
@@ -423,10 +436,35 @@ public:
    long getBufferTotalCapacity();
    long getBufferFreeCapacity();
    bool isBufferOverflowed() const;
+   std::vector<long> getCameraFrameCounts(const char* cameraLabel)
+      throw (CMMError);
    void setCircularBufferMemoryFootprint(unsigned sizeMB) throw (CMMError);
    unsigned getCircularBufferMemoryFootprint();
    void initializeCircularBuffer() throw (CMMError);
    void clearCircularBuffer() throw (CMMError);
+   void setCircularBufferCompression(bool enable) throw (CMMError);
+   bool isCircularBufferCompressionEnabled();
+   double getCircularBufferCompressionRatio();
+   double getCircularBufferCompressionTimeUs();
+   void setCircularBufferSpillFile(const char* path, unsigned sizeMB) throw (CMMError);
+   std::string getCircularBufferSpillFile();
+   long getCircularBufferSpilledImageCount();
+   void setCircularBufferStatistics(bool enable, unsigned histogramBins)
+      throw (CMMError);
+   bool isCircularBufferStatisticsEnabled();
+   std::vector<double> getLastImageStatistics(unsigned channel)
+      throw (CMMError);
+   std::vector<long> getLastImageHistogram(unsigned channel) throw (CMMError);
+   void* getLastImageROI(unsigned channel, unsigned x, unsigned y,
+         unsigned width, unsigned height, unsigned step, bool binning,
+         Metadata& md) throw (CMMError);
+   long addImageROISubscription(unsigned channel, unsigned x, unsigned y,
+         unsigned width, unsigned height, unsigned step, bool binning)
+      throw (CMMError);
+   void removeImageROISubscription(long id) throw (CMMError);
+   void* popNextSubscribedROI(long id, Metadata& md) throw (CMMError);
+   unsigned getImageROISubscriptionWidth(long id) throw (CMMError);
+   unsigned getImageROISubscriptionHeight(long id) throw (CMMError);
 
    bool isExposureSequenceable(const char* cameraLabel) throw (CMMError);
    void startExposureSequence(const char* cameraLabel) throw (CMMError);
@@ -436,6 +474,71 @@ public:
          std::vector<double> exposureSequence_ms) throw (CMMError);
    ///@}
 
+   /** \name Burst acquisition and triggering.
+    * For cameras supporting the burst API, whose bursts of frames can be
+    * started, ended and triggered internally, by TTL pulses or by software.
+    */
+   ///@{
+   bool isBurstAPISupported(const char* cameraLabel) throw (CMMError);
+   void setPreFrameDelay(const char* cameraLabel, double delayMs)
+      throw (CMMError);
+   void setPostFrameDelay(const char* cameraLabel, double delayMs)
+      throw (CMMError);
+   void setBurstStartTriggerType(const char* cameraLabel, const char* type)
+      throw (CMMError);
+   void setBurstEndTriggerType(const char* cameraLabel, const char* type)
+      throw (CMMError);
+   void setFrameStartTriggerType(const char* cameraLabel, const char* type)
+      throw (CMMError);
+   void setExposureEndTriggerType(const char* cameraLabel, const char* type)
+      throw (CMMError);
+   void setFrameExposureMode(const char* cameraLabel, const char* mode)
+      throw (CMMError);
+   void prepareForBurst(int numImages) throw (CMMError);
+   void prepareForBurst(const char* cameraLabel, int numImages)
+      throw (CMMError);
+   void sendBurstStartTrigger() throw (CMMError);
+   void sendBurstStartTrigger(const char* cameraLabel) throw (CMMError);
+   void sendFrameStartTrigger() throw (CMMError);
+   void sendFrameStartTrigger(const char* cameraLabel) throw (CMMError);
+   void sendBurstEndTrigger() throw (CMMError);
+   void sendBurstEndTrigger(const char* cameraLabel) throw (CMMError);
+   std::vector<double> getTriggerLatencies(const char* cameraLabel)
+      throw (CMMError);
+   double getRollingShutterLineOffset(const char* cameraLabel)
+      throw (CMMError);
+   void setRollingShutterLineOffset(const char* cameraLabel, double offsetUs)
+      throw (CMMError);
+   int getRollingShutterActiveLines(const char* cameraLabel) throw (CMMError);
+   void setRollingShutterActiveLines(const char* cameraLabel, int numLines)
+      throw (CMMError);
+   ///@}
+
+   /** \name Live preview. */
+   ///@{
+   void setPreviewStreamEnabled(bool enable);
+   bool isPreviewStreamEnabled();
+   void setPreviewStreamSize(unsigned maxWidth, unsigned maxHeight,
+         bool binning) throw (CMMError);
+   void setPreviewStreamMaxRate(double rateHz) throw (CMMError);
+   void setPreviewDisplayRange(long min, long max, double gamma)
+      throw (CMMError);
+   void* getLatestPreview(Metadata& md) throw (CMMError);
+   unsigned getLatestPreviewWidth();
+   unsigned getLatestPreviewHeight();
+   std::vector<long> getLatestPreviewHistogram();
+   ///@}
+
+   /** \name Streaming to disk. */
+   ///@{
+   void enableDiskStreaming(const char* directory, int writerThreads,
+         double maxFileSizeMB, bool keepInBuffer) throw (CMMError);
+   void disableDiskStreaming();
+   bool isDiskStreamingEnabled();
+   std::string getDiskStreamingSessionPath();
+   long getDiskStreamingFramesWritten();
+   ///@}
+
    /** \name Autofocus control. */
    ///@{
    double getLastFocusScore();
@@ -560,6 +663,8 @@ public:
    void setSLMImage(const char* slmLabel,
          unsigned char * pixels) throw (CMMError);
    void setSLMImage(const char* slmLabel, imgRGB32 pixels) throw (CMMError);
+   void setSLMImage(const char* slmLabel, const unsigned char* pixelBuffer,
+         long bufferBytes) throw (CMMError);
    void setSLMPixelsTo(const char* slmLabel,
          unsigned char intensity) throw (CMMError);
    void setSLMPixelsTo(const char* slmLabel,
@@ -579,6 +684,8 @@ public:
    void stopSLMSequence(const char* slmLabel) throw (CMMError);
    void loadSLMSequence(const char* slmLabel,
          std::vector<unsigned char*> imageSequence) throw (CMMError);
+   void loadSLMSequence(const char* slmLabel,
+         const unsigned char* pixelBuffer, long bufferBytes) throw (CMMError);
    ///@}
 
    /** \name Galvo control.
@@ -615,6 +722,11 @@ public:
    ///@{
    bool supportsDeviceDetection(char* deviceLabel);
    MM::DeviceDetectionStatus detectDevice(char* deviceLabel);
+   std::vector<long> detectDevices(const std::vector<std::string>& deviceLabels)
+      throw (CMMError);
+   void enableDetectionCache(const char* path) throw (CMMError);
+   void disableDetectionCache();
+   void clearDetectionCache() throw (CMMError);
    ///@}
 
    /** \name Hub and peripheral devices. */
@@ -629,6 +741,22 @@ public:
    std::vector<std::string> getLoadedPeripheralDevices(const char* hubLabel) throw (CMMError);
    ///@}
 
+   /** \name Device call profiling.
+    *
+    * Latency histograms of the calls that the Core makes into each device,
+    * for finding the devices that take up an acquisition's time budget.
+    */
+   ///@{
+   void enableDeviceCallProfiling(bool enable);
+   bool isDeviceCallProfilingEnabled();
+   void resetDeviceCallProfiles();
+   std::vector<std::string> getProfiledDeviceMethods(const char* deviceLabel)
+      throw (CMMError);
+   std::vector<double> getDeviceCallLatencies(const char* deviceLabel,
+         const char* method) throw (CMMError);
+   void saveDeviceCallProfiles(const char* path) throw (CMMError);
+   ///@}
+
    /** \name Miscellaneous. */
    ///@{
    std::string getUserId() const;
@@ -664,6 +792,8 @@ private:
    std::string channelGroup_;
    long pollingIntervalMs_;
    long timeoutMs_;
+   bool deviceCallProfiling_;
+   bool stateCacheTrusted_; // Synchronized by stateCacheLock_
    bool autoShutter_;
    std::vector<double> *nullAffine_;
    MM::Core* callback_;                 // core services for devices
@@ -672,6 +802,35 @@ private:
    MMEventCallback* externalCallback_;  // notification hook to the higher layer (e.g. GUI)
    PixelSizeConfigGroup* pixelSizeGroup_;
    CircularBuffer* cbuf_;
+   boost::shared_ptr<mm::PreviewStream> previewStream_;
+   boost::shared_ptr<mm::DiskStream> diskStream_;
+   boost::shared_ptr<mm::TriggerLatency> triggerLatency_;
+   boost::shared_ptr<mm::DetectionCache> detectionCache_;
+   boost::shared_ptr<mm::WorkerThreadBudget> workerThreadBudget_;
+   // The last few previews returned by getLatestPreview(), newest last, so
+   // that pixels being copied by one caller survive a call by another
+   MMThreadLock latestPreviewLock_;
+   std::deque< boost::shared_ptr<mm::PreviewFrame> > latestPreviews_;
+
+   // Regions of buffered images read by getLastImageROI() and
+   // popNextSubscribedROI(), which return pointers to these buffers
+   struct ImageROISubscription
+   {
+      unsigned channel;
+      unsigned x;
+      unsigned y;
+      unsigned width;
+      unsigned height;
+      unsigned step;
+      bool binning;
+      std::vector<unsigned char> pixels;
+   };
+   std::map<long, ImageROISubscription> roiSubscriptions_;
+   long nextROISubscriptionId_;
+   std::vector<unsigned char> lastImageROI_;
+
+   bool multiROIDemux_;
+   std::vector<unsigned char> demuxedImage_; // Returned by getImage()
 
    std::vector< boost::weak_ptr<DeviceInstance> > imageSynchroDevices_;
    boost::shared_ptr<CPluginManager> pluginManager_;
@@ -699,11 +858,14 @@ private:
    static void CheckConfigGroupName(const char* groupName) throw (CMMError);
    static void CheckConfigPresetName(const char* presetName) throw (CMMError);
    static void CheckPropertyBlockName(const char* blockName) throw (CMMError);
+   static void CheckTriggerType(const char* type) throw (CMMError);
    bool IsCoreDeviceLabel(const char* label) const throw (CMMError);
 
    void applyConfiguration(const Configuration& config) throw (CMMError);
    int applyProperties(std::vector<PropertySetting>& props, std::string& lastError);
    void waitForDevice(boost::shared_ptr<DeviceInstance> pDev) throw (CMMError);
+   std::vector<std::string> getBusyDevices(const std::vector<std::string>& labels,
+         bool firstOnly);
    Configuration getConfigGroupState(const char* group, bool fromCache) throw (CMMError);
    std::string getDeviceErrorText(int deviceCode, boost::shared_ptr<DeviceInstance> pDevice);
    std::string getDeviceName(boost::shared_ptr<DeviceInstance> pDev);
@@ -712,6 +874,16 @@ private:
    void assignDefaultRole(boost::shared_ptr<DeviceInstance> pDev);
    void updateCoreProperty(const char* propName, MM::DeviceType devType) throw (CMMError);
    void loadSystemConfigurationImpl(const char* fileName) throw (CMMError);
+   void updateMultiROIDemux();
+   boost::shared_ptr<CameraInstance> getBurstCamera(const char* cameraLabel)
+      throw (CMMError);
+   std::string getCurrentCameraLabel() throw (CMMError);
+   std::string getPortHardwareId(const std::string& port);
+   long getSLMImageBytes(boost::shared_ptr<SLMInstance> pSLM);
+   bool getBufferDemuxImageSize(unsigned& width, unsigned& height,
+         unsigned& count);
+   void* getDemuxedImage(void* pixels, unsigned channel, unsigned width,
+         unsigned height, unsigned depth) throw (CMMError);
 };
 
 #endif //_MMCORE_H_
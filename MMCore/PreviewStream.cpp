@@ -0,0 +1,288 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PreviewStream.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Reduced-size 8-bit preview of the most recent frame in the
+//                circular buffer, for live display.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "PreviewStream.h"
+
+#include "CircularBuffer.h"
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace mm {
+
+namespace
+{
+
+const size_t histogramBins = 256;
+
+// Reduce the image by the given factor in each dimension. The inner loops
+// run over contiguous pixels so that they can be vectorized by the compiler.
+template <typename T>
+void Reduce(const T* src, unsigned width, unsigned factor, bool binning,
+      unsigned previewWidth, unsigned previewHeight, unsigned short* dst)
+{
+   if (!binning)
+   {
+      for (unsigned py = 0; py < previewHeight; ++py)
+      {
+         const T* row = src + static_cast<size_t>(py) * factor * width;
+         unsigned short* out = dst + static_cast<size_t>(py) * previewWidth;
+         for (unsigned px = 0; px < previewWidth; ++px)
+            out[px] = row[static_cast<size_t>(px) * factor];
+      }
+      return;
+   }
+
+   std::vector<boost::uint64_t> sums(previewWidth);
+   const boost::uint64_t area = static_cast<boost::uint64_t>(factor) * factor;
+   for (unsigned py = 0; py < previewHeight; ++py)
+   {
+      std::fill(sums.begin(), sums.end(), 0);
+      for (unsigned r = 0; r < factor; ++r)
+      {
+         const T* row = src + (static_cast<size_t>(py) * factor + r) * width;
+         for (unsigned px = 0; px < previewWidth; ++px)
+         {
+            const T* block = row + static_cast<size_t>(px) * factor;
+            boost::uint32_t sum = 0;
+            for (unsigned i = 0; i < factor; ++i)
+               sum += block[i];
+            sums[px] += sum;
+         }
+      }
+      unsigned short* out = dst + static_cast<size_t>(py) * previewWidth;
+      for (unsigned px = 0; px < previewWidth; ++px)
+         out[px] = static_cast<unsigned short>(sums[px] / area);
+   }
+}
+
+} // anonymous namespace
+
+
+PreviewStream::PreviewStream() :
+   buffer_(0),
+   stop_(false),
+   haveLatest_(false),
+   sequenceNumber_(0)
+{
+}
+
+PreviewStream::~PreviewStream()
+{
+   SetEnabled(false);
+}
+
+void PreviewStream::SetEnabled(bool enable)
+{
+   if (enable == IsEnabled())
+      return;
+
+   if (enable)
+   {
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         stop_ = false;
+         haveLatest_ = false;
+      }
+      thread_ = boost::make_shared<boost::thread>(
+            boost::bind(&PreviewStream::ThreadFunc, this));
+   }
+   else
+   {
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         stop_ = true;
+      }
+      cv_.notify_one();
+      thread_->join();
+      thread_.reset();
+   }
+}
+
+bool PreviewStream::IsEnabled() const
+{
+   return thread_.get() != 0;
+}
+
+void PreviewStream::SetBuffer(CircularBuffer* buffer)
+{
+   boost::lock_guard<boost::mutex> lock(bufferMutex_);
+   buffer_ = buffer;
+}
+
+void PreviewStream::SetSettings(const PreviewSettings& settings)
+{
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      settings_ = settings;
+   }
+   cv_.notify_one();
+}
+
+PreviewSettings PreviewStream::GetSettings() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   return settings_;
+}
+
+bool PreviewStream::GetLatest(PreviewFrame& frame) const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   if (!haveLatest_)
+      return false;
+   frame = latest_;
+   return true;
+}
+
+void PreviewStream::ThreadFunc()
+{
+   PreviewFrame work;
+   // Compressed and spilled frames are decoded here rather than in the
+   // buffer's pool, which holds the images returned to the application
+   mm::ImgBuffer decoded(0, 0, 1);
+   long lastCounter = -1;
+
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   while (!stop_)
+   {
+      const double rate = settings_.maxRateHz > 0.0 ? settings_.maxRateHz : 1.0;
+      cv_.timed_wait(lock, boost::posix_time::microseconds(
+               static_cast<boost::int64_t>(1e6 / rate)));
+      if (stop_)
+         break;
+
+      const PreviewSettings settings = settings_;
+      lock.unlock();
+      const bool produced = ComputeFromBuffer(settings, lastCounter, decoded,
+            work);
+      lock.lock();
+
+      if (produced)
+      {
+         work.sequenceNumber = ++sequenceNumber_;
+         std::swap(latest_, work);
+         haveLatest_ = true;
+      }
+   }
+}
+
+// Called on the preview thread without mutex_ held
+bool PreviewStream::ComputeFromBuffer(const PreviewSettings& settings,
+      long& lastCounter, mm::ImgBuffer& decoded, PreviewFrame& frame)
+{
+   boost::lock_guard<boost::mutex> lock(bufferMutex_);
+   if (!buffer_)
+      return false;
+
+   const long counter = buffer_->GetImageCounter();
+   if (counter == lastCounter)
+      return false;
+   const mm::ImgBuffer* img = buffer_->GetTopImageBuffer(0, decoded);
+   if (!img)
+      return false;
+   lastCounter = counter;
+
+   if (!Compute(img->GetPixels(), img->Width(), img->Height(), img->Depth(),
+            settings, frame))
+      return false;
+   frame.metadata = img->GetMetadata();
+   return true;
+}
+
+bool PreviewStream::Compute(const unsigned char* pixels, unsigned width,
+      unsigned height, unsigned byteDepth, const PreviewSettings& settings,
+      PreviewFrame& frame)
+{
+   if ((byteDepth != 1 && byteDepth != 2) || width == 0 || height == 0)
+      return false;
+
+   const unsigned maxWidth = std::max(1u, settings.maxWidth);
+   const unsigned maxHeight = std::max(1u, settings.maxHeight);
+   const unsigned factor = std::max(1u, std::max(
+            (width + maxWidth - 1) / maxWidth,
+            (height + maxHeight - 1) / maxHeight));
+   const unsigned previewWidth = std::max(1u, width / factor);
+   const unsigned previewHeight = std::max(1u, height / factor);
+   const size_t count = static_cast<size_t>(previewWidth) * previewHeight;
+
+   frame.width = previewWidth;
+   frame.height = previewHeight;
+   frame.sourceWidth = width;
+   frame.sourceHeight = height;
+   frame.factor = factor;
+   frame.values.resize(count);
+   frame.pixels.resize(count);
+
+   const bool binning = settings.binning && factor > 1;
+   if (byteDepth == 1)
+      Reduce(pixels, width, factor, binning, previewWidth, previewHeight,
+            &frame.values[0]);
+   else
+      Reduce(reinterpret_cast<const boost::uint16_t*>(pixels), width, factor,
+            binning, previewWidth, previewHeight, &frame.values[0]);
+
+   const unsigned short* values = &frame.values[0];
+   unsigned short minValue = values[0], maxValue = values[0];
+   for (size_t i = 1; i < count; ++i)
+   {
+      minValue = std::min(minValue, values[i]);
+      maxValue = std::max(maxValue, values[i]);
+   }
+   frame.min = minValue;
+   frame.max = maxValue;
+
+   frame.histogram.assign(histogramBins, 0);
+   const unsigned long range = static_cast<unsigned long>(maxValue) - minValue + 1;
+   for (size_t i = 0; i < count; ++i)
+      ++frame.histogram[(values[i] - minValue) * histogramBins / range];
+
+   // Map to 8 bits with a lookup table covering the values present
+   long low = settings.displayMin, high = settings.displayMax;
+   if (high <= low)
+   {
+      low = minValue;
+      high = maxValue;
+   }
+   std::vector<unsigned char> lut(range);
+   for (unsigned long i = 0; i < range; ++i)
+   {
+      const long value = static_cast<long>(minValue + i);
+      if (value <= low)
+         lut[i] = 0;
+      else if (value >= high)
+         lut[i] = 255;
+      else
+      {
+         double level = static_cast<double>(value - low) / (high - low);
+         if (settings.gamma != 1.0 && settings.gamma > 0.0)
+            level = std::pow(level, settings.gamma);
+         lut[i] = static_cast<unsigned char>(255.0 * level + 0.5);
+      }
+   }
+   unsigned char* out = &frame.pixels[0];
+   for (size_t i = 0; i < count; ++i)
+      out[i] = lut[values[i] - minValue];
+   return true;
+}
+
+} // namespace mm
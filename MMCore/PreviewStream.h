@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PreviewStream.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Reduced-size 8-bit preview of the most recent frame in the
+//                circular buffer, for live display.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/ImageMetadata.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+
+class CircularBuffer;
+
+namespace mm {
+
+class ImgBuffer;
+
+struct PreviewSettings
+{
+   unsigned maxWidth;
+   unsigned maxHeight;
+   double maxRateHz;
+   bool binning; // Average blocks of pixels (otherwise subsample)
+   // Pixel values mapped to 0 and 255; if displayMax <= displayMin, the
+   // preview's own min and max are used
+   long displayMin;
+   long displayMax;
+   double gamma;
+
+   PreviewSettings() :
+      maxWidth(512), maxHeight(512), maxRateHz(30.0), binning(true),
+      displayMin(0), displayMax(0), gamma(1.0)
+   {}
+};
+
+struct PreviewFrame
+{
+   std::vector<unsigned char> pixels; // 8-bit, width * height
+   unsigned width;
+   unsigned height;
+   unsigned sourceWidth;
+   unsigned sourceHeight;
+   unsigned factor; // Source pixels per preview pixel, in each dimension
+   // Preview pixels before mapping to 8 bits, and their statistics. The
+   // histogram has 256 equal bins spanning [min, max].
+   std::vector<unsigned short> values;
+   long min;
+   long max;
+   std::vector<long> histogram;
+   Metadata metadata; // Of the source frame
+   unsigned long long sequenceNumber;
+
+   PreviewFrame() :
+      width(0), height(0), sourceWidth(0), sourceHeight(0), factor(1),
+      min(0), max(0), sequenceNumber(0)
+   {}
+};
+
+/**
+ * Produces previews of the newest frame in the circular buffer on a
+ * background thread, at most at the configured rate and only when a new
+ * frame has arrived. Nothing is done on the thread inserting frames.
+ *
+ * Uncompressed frames are read in place, as with CMMCore::getLastImage(), so
+ * a preview may be torn if the buffer wraps around while it is computed.
+ * Compressed and spilled frames are decoded into a buffer of the thread's
+ * own, leaving the buffer's pool of retrieved images untouched.
+ * Only 8- and 16-bit grayscale frames are previewed.
+ */
+class PreviewStream
+{
+public:
+   PreviewStream();
+   ~PreviewStream();
+
+   void SetEnabled(bool enable);
+   bool IsEnabled() const;
+
+   // The buffer may be replaced or set to null at any time; it must not be
+   // destroyed while set here.
+   void SetBuffer(CircularBuffer* buffer);
+
+   void SetSettings(const PreviewSettings& settings);
+   PreviewSettings GetSettings() const;
+
+   // Returns false if no preview has been produced since the stream was
+   // enabled
+   bool GetLatest(PreviewFrame& frame) const;
+
+   // Compute a preview synchronously; returns false if the pixel type is not
+   // supported. Scratch buffers in frame are reused.
+   static bool Compute(const unsigned char* pixels, unsigned width,
+         unsigned height, unsigned byteDepth, const PreviewSettings& settings,
+         PreviewFrame& frame);
+
+private:
+   void ThreadFunc();
+   bool ComputeFromBuffer(const PreviewSettings& settings, long& lastCounter,
+         ImgBuffer& decoded, PreviewFrame& frame);
+
+   boost::shared_ptr<boost::thread> thread_;
+
+   // Guards the frame source; held by the thread while reading a frame
+   boost::mutex bufferMutex_;
+   CircularBuffer* buffer_;
+
+   mutable boost::mutex mutex_; // Guards all of the below
+   boost::condition_variable cv_;
+   PreviewSettings settings_;
+   bool stop_;
+   bool haveLatest_;
+   PreviewFrame latest_;
+   unsigned long long sequenceNumber_;
+
+   PreviewStream(const PreviewStream&);
+   PreviewStream& operator=(const PreviewStream&);
+};
+
+} // namespace mm
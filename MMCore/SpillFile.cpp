@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SpillFile.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Memory-mapped scratch file backing the circular buffer's
+//                overflow tier.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SpillFile.h"
+
+#include "CoreUtils.h"
+
+#include <boost/interprocess/exceptions.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mm {
+
+namespace {
+
+enum CreateResult
+{
+   CreateOk,
+   CreateExists,
+   CreateFailed,
+   AllocateFailed,
+};
+
+// Creates the file, failing if it already exists, and reserves its blocks on
+// disk. A file that is merely extended is sparse on most file systems, and a
+// full disk would then show up as a fault when a page of the mapping is
+// first written back.
+CreateResult CreateReservedFile(const std::string& path,
+      unsigned long long size, std::string& reason)
+{
+#ifdef _WIN32
+   HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+         0, NULL, CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+   {
+      const DWORD err = ::GetLastError();
+      reason = "error " + ToString(err);
+      return (err == ERROR_FILE_EXISTS || err == ERROR_ALREADY_EXISTS) ?
+         CreateExists : CreateFailed;
+   }
+   // Setting the end of a non-sparse file allocates its clusters, failing if
+   // the volume is full. Marking the data valid avoids zero-filling on first
+   // write, but needs a privilege most users lack, so it is optional.
+   LARGE_INTEGER end;
+   end.QuadPart = (LONGLONG) size;
+   bool ok = ::SetFilePointerEx(file, end, NULL, FILE_BEGIN) &&
+      ::SetEndOfFile(file);
+   if (ok)
+      ::SetFileValidData(file, end.QuadPart);
+   else
+      reason = "error " + ToString(::GetLastError());
+   ::CloseHandle(file);
+#else
+   const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+   if (fd < 0)
+   {
+      const int err = errno;
+      reason = std::strerror(err);
+      return err == EEXIST ? CreateExists : CreateFailed;
+   }
+   int err;
+#ifdef __APPLE__
+   fstore_t store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, (off_t) size, 0 };
+   err = ::fcntl(fd, F_PREALLOCATE, &store) == -1 ? errno : 0;
+   if (err == 0 && ::ftruncate(fd, (off_t) size) != 0)
+      err = errno;
+#else
+   err = ::posix_fallocate(fd, 0, (off_t) size);
+#endif
+   const bool ok = err == 0;
+   if (!ok)
+      reason = std::strerror(err);
+   ::close(fd);
+#endif
+   if (!ok)
+   {
+      boost::interprocess::file_mapping::remove(path.c_str());
+      return AllocateFailed;
+   }
+   return CreateOk;
+}
+
+} // anonymous namespace
+
+SpillFile::SpillFile(const std::string& path, unsigned long long size) throw (CMMError) :
+   path_(path),
+   size_(size)
+{
+   if (size == 0)
+      throw CMMError("Spill file size must be greater than zero");
+
+   std::string reason;
+   switch (CreateReservedFile(path, size, reason))
+   {
+      case CreateOk:
+         break;
+      case CreateExists:
+         throw CMMError("Spill file " + ToQuotedString(path) +
+               " already exists");
+      case CreateFailed:
+         throw CMMError("Cannot create spill file " + ToQuotedString(path) +
+               " (" + reason + ")");
+      case AllocateFailed:
+         throw CMMError("Cannot allocate " + ToString(size) +
+               " bytes for spill file " + ToQuotedString(path) +
+               " (" + reason + ")");
+   }
+
+   try
+   {
+      boost::interprocess::file_mapping mapping(path.c_str(),
+            boost::interprocess::read_write);
+      boost::interprocess::mapped_region region(mapping,
+            boost::interprocess::read_write);
+      mapping_.swap(mapping);
+      region_.swap(region);
+   }
+   catch (const boost::interprocess::interprocess_exception& e)
+   {
+      boost::interprocess::file_mapping::remove(path.c_str());
+      throw CMMError("Cannot map spill file " + ToQuotedString(path) +
+            " (" + e.what() + ")");
+   }
+}
+
+SpillFile::~SpillFile()
+{
+   boost::interprocess::mapped_region().swap(region_);
+   boost::interprocess::file_mapping().swap(mapping_);
+   boost::interprocess::file_mapping::remove(path_.c_str());
+}
+
+} // namespace mm
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SpillFile.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Memory-mapped scratch file backing the circular buffer's
+//                overflow tier.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Error.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <string>
+
+#ifdef _MSC_VER
+#pragma warning( disable : 4290 ) // exception declaration warning
+#endif
+
+namespace mm {
+
+/**
+ * A file of fixed size, created on construction, mapped into memory for its
+ * whole lifetime, and deleted on destruction.
+ *
+ * Construction fails if a file already exists at the path, so that no file
+ * other than the one created here is ever overwritten or deleted. The disk
+ * space is reserved up front, so that a full disk is reported here rather
+ * than as a fault while writing to the mapping.
+ *
+ * The file is meant to live on fast local storage; the OS writes dirty pages
+ * back in the background, so writing to the mapping costs little more than a
+ * memory copy until the page cache fills up.
+ */
+class SpillFile
+{
+   std::string path_;
+   unsigned long long size_;
+   boost::interprocess::file_mapping mapping_;
+   boost::interprocess::mapped_region region_;
+
+public:
+   SpillFile(const std::string& path, unsigned long long size) throw (CMMError);
+   ~SpillFile();
+
+   const std::string& GetPath() const { return path_; }
+   unsigned long long GetSize() const { return size_; }
+   unsigned char* GetData() const
+   { return static_cast<unsigned char*>(region_.get_address()); }
+
+private:
+   SpillFile(const SpillFile&);
+   SpillFile& operator=(const SpillFile&);
+};
+
+} // namespace mm
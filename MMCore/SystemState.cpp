@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SystemState.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Ordering and skipping of property writes when restoring a
+//                saved system state.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SystemState.h"
+
+#include "Error.h"
+
+#include <map>
+
+namespace mm {
+
+SystemStateCounts ApplySystemState(const std::vector<PropertySetting>& settings,
+      const boost::function<SystemStateRank (const std::string&)>& rank,
+      const boost::function<bool (const PropertySetting&)>& isCurrent,
+      const boost::function<void (const PropertySetting&)>& apply)
+{
+   std::map<std::string, SystemStateRank> deviceRanks;
+   std::vector<std::string> deviceOrder;
+   for (std::vector<PropertySetting>::const_iterator it = settings.begin();
+         it != settings.end(); ++it)
+   {
+      const std::string label = it->getDeviceLabel();
+      if (deviceRanks.count(label))
+         continue;
+      deviceRanks[label] = rank(label);
+      deviceOrder.push_back(label);
+   }
+
+   SystemStateCounts counts;
+   for (int r = SystemStateRankHub; r <= SystemStateRankCore; ++r)
+   {
+      for (std::vector<std::string>::const_iterator dev = deviceOrder.begin();
+            dev != deviceOrder.end(); ++dev)
+      {
+         if (deviceRanks[*dev] != r)
+            continue;
+         for (std::vector<PropertySetting>::const_iterator it = settings.begin();
+               it != settings.end(); ++it)
+         {
+            if (it->getDeviceLabel() != *dev)
+               continue;
+            if (isCurrent(*it))
+            {
+               ++counts.skipped;
+               continue;
+            }
+            try
+            {
+               apply(*it);
+               ++counts.written;
+            }
+            catch (const CMMError&)
+            {
+               // Don't give up yet.
+               // TODO Yes, do give up, unless cleanly recoverable.
+            }
+         }
+      }
+   }
+   return counts;
+}
+
+} // namespace mm
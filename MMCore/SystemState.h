@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SystemState.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Ordering and skipping of property writes when restoring a
+//                saved system state.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Configuration.h"
+
+#include <boost/function.hpp>
+
+#include <string>
+#include <vector>
+
+namespace mm {
+
+// Order in which the properties of devices are restored
+enum SystemStateRank
+{
+   SystemStateRankHub = 0,
+   SystemStateRankDevice,
+   SystemStateRankCore
+};
+
+struct SystemStateCounts
+{
+   SystemStateCounts() : written(0), skipped(0) {}
+   long written;
+   long skipped;
+};
+
+/**
+ * Applies the settings of a saved system state, skipping those that are
+ * already current.
+ *
+ * Settings are applied grouped by device: hubs first, so that their
+ * peripherals see the restored hub state, then the other devices, then the
+ * Core. Devices of the same rank keep the order of their first settings and
+ * each device's settings keep their order. isCurrent is asked just before a
+ * setting would be applied, so values changed by earlier writes are still
+ * restored. A setting for which apply throws CMMError is passed over.
+ */
+SystemStateCounts ApplySystemState(const std::vector<PropertySetting>& settings,
+      const boost::function<SystemStateRank (const std::string&)>& rank,
+      const boost::function<bool (const PropertySetting&)>& isCurrent,
+      const boost::function<void (const PropertySetting&)>& apply);
+
+} // namespace mm
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TaskSet_CompressFrame.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Task set for parallelized lossless frame compression.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "TaskSet_CompressFrame.h"
+
+#include "FrameCodec.h"
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+TaskSet_CompressFrame::ATask::ATask(boost::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount)
+    : Task(semDone, taskIndex, totalTaskCount),
+    image_(NULL),
+    width_(0),
+    height_(0),
+    byteDepth_(0),
+    bytes_(0)
+{
+}
+
+void TaskSet_CompressFrame::ATask::SetUp(const unsigned char* image, unsigned width, unsigned height,
+        unsigned byteDepth, size_t usedTaskCount)
+{
+    image_ = image;
+    width_ = width;
+    height_ = height;
+    byteDepth_ = byteDepth;
+    bytes_ = 0;
+    usedTaskCount_ = usedTaskCount;
+}
+
+void TaskSet_CompressFrame::ATask::Execute()
+{
+    if (taskIndex_ >= usedTaskCount_)
+        return;
+
+    const unsigned stripeCount = static_cast<unsigned>(usedTaskCount_);
+    const unsigned stripe = static_cast<unsigned>(taskIndex_);
+    const unsigned firstRow = mm::FrameCodec::StripeFirstRow(height_, stripeCount, stripe);
+    const unsigned rows = mm::FrameCodec::StripeFirstRow(height_, stripeCount, stripe + 1) - firstRow;
+
+    // The scratch buffer only grows, so steady-state compression does not
+    // allocate
+    const size_t maxBytes = mm::FrameCodec::MaxStripeBytes(width_, rows, byteDepth_);
+    if (scratch_.size() < maxBytes)
+        scratch_.resize(maxBytes);
+
+    bytes_ = mm::FrameCodec::CompressStripe(image_, width_, firstRow, rows, byteDepth_, &scratch_[0]);
+}
+
+TaskSet_CompressFrame::TaskSet_CompressFrame(boost::shared_ptr<ThreadPool> pool)
+    : TaskSet(pool)
+{
+    CreateTasks<ATask>();
+}
+
+void TaskSet_CompressFrame::SetUp(const unsigned char* image, unsigned width, unsigned height, unsigned byteDepth)
+{
+    assert(image != NULL);
+    assert(width > 0 && height > 0);
+
+    // Same heuristic as TaskSet_CopyMemory: one stripe per 1MB of input. The
+    // stripe count is part of the encoded frame, so decoding does not depend
+    // on the pool size.
+    const size_t bytes = static_cast<size_t>(width) * height * byteDepth;
+    usedTaskCount_ = std::min<size_t>(std::min<size_t>(1 + bytes / 1000000, tasks_.size()), height);
+
+    BOOST_FOREACH(Task* task, tasks_)
+        static_cast<ATask*>(task)->SetUp(image, width, height, byteDepth, usedTaskCount_);
+
+    if (usedTaskCount_ == 1)
+        tasks_[0]->Execute();
+}
+
+void TaskSet_CompressFrame::Execute()
+{
+    if (usedTaskCount_ == 1)
+        return; // Already done in SetUp, nothing to execute
+
+    TaskSet::Execute();
+}
+
+void TaskSet_CompressFrame::Wait()
+{
+    if (usedTaskCount_ == 1)
+        return; // Already done in SetUp, nothing to wait for
+
+    semaphore_->Wait(usedTaskCount_);
+}
+
+size_t TaskSet_CompressFrame::GetCompressedBytes() const
+{
+    size_t bytes = mm::FrameCodec::HeaderBytes(static_cast<unsigned>(usedTaskCount_));
+    for (size_t n = 0; n < usedTaskCount_; ++n)
+        bytes += static_cast<const ATask*>(tasks_[n])->GetBytes();
+    return bytes;
+}
+
+void TaskSet_CompressFrame::CopyCompressed(unsigned char* dst) const
+{
+    std::vector<size_t> stripeBytes(usedTaskCount_);
+    for (size_t n = 0; n < usedTaskCount_; ++n)
+        stripeBytes[n] = static_cast<const ATask*>(tasks_[n])->GetBytes();
+
+    dst += mm::FrameCodec::WriteHeader(static_cast<unsigned>(usedTaskCount_), &stripeBytes[0], dst);
+    for (size_t n = 0; n < usedTaskCount_; ++n)
+    {
+        memcpy(dst, static_cast<const ATask*>(tasks_[n])->GetData(), stripeBytes[n]);
+        dst += stripeBytes[n];
+    }
+}
+
+size_t TaskSet_CompressFrame::Compress(const unsigned char* image, unsigned width, unsigned height, unsigned byteDepth)
+{
+    SetUp(image, width, height, byteDepth);
+    Execute();
+    Wait();
+    return GetCompressedBytes();
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TaskSet_CompressFrame.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Task set for parallelized lossless frame compression.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "TaskSet.h"
+
+#include <vector>
+
+// Compresses one image into FrameCodec format, one stripe per task. Each task
+// encodes into its own scratch buffer; the result is assembled by the caller
+// with CopyCompressed() once the set has completed.
+class TaskSet_CompressFrame : public TaskSet
+{
+private:
+    class ATask : public Task
+    {
+    public:
+        explicit ATask(boost::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount);
+
+        void SetUp(const unsigned char* image, unsigned width, unsigned height,
+                unsigned byteDepth, size_t usedTaskCount);
+
+        virtual void Execute()/* override*/;
+
+        const unsigned char* GetData() const { return scratch_.empty() ? NULL : &scratch_[0]; }
+        size_t GetBytes() const { return bytes_; }
+
+    private:
+        const unsigned char* image_;
+        unsigned width_;
+        unsigned height_;
+        unsigned byteDepth_;
+        std::vector<unsigned char> scratch_;
+        size_t bytes_;
+    };
+
+public:
+    explicit TaskSet_CompressFrame(boost::shared_ptr<ThreadPool> pool);
+
+    void SetUp(const unsigned char* image, unsigned width, unsigned height, unsigned byteDepth);
+
+    virtual void Execute()/* override*/;
+    virtual void Wait()/* override*/;
+
+    // Size of the encoded frame; valid after Wait()
+    size_t GetCompressedBytes() const;
+    // Write the encoded frame (GetCompressedBytes() bytes) to dst
+    void CopyCompressed(unsigned char* dst) const;
+
+    // Helper blocking method calling SetUp, Execute and Wait; returns
+    // GetCompressedBytes()
+    size_t Compress(const unsigned char* image, unsigned width, unsigned height, unsigned byteDepth);
+};
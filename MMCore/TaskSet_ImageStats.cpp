@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TaskSet_ImageStats.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Task set for parallelized image statistics.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "TaskSet_ImageStats.h"
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+
+// One pass over the pixels, accumulating into locals so that the loop does
+// not store through the output references on every pixel.
+template <typename T>
+void Accumulate(const T* pixels, size_t count, unsigned shift,
+        unsigned& minValue, unsigned& maxValue, boost::uint64_t& sum,
+        boost::uint64_t& sumSq, boost::uint32_t* histogram)
+{
+    T lo = pixels[0], hi = pixels[0];
+    boost::uint64_t s = 0, sq = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const T v = pixels[i];
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        s += v;
+        sq += static_cast<boost::uint32_t>(v) * v;
+        ++histogram[v >> shift];
+    }
+    minValue = lo;
+    maxValue = hi;
+    sum = s;
+    sumSq = sq;
+}
+
+unsigned HistogramShift(unsigned byteDepth, unsigned bins)
+{
+    unsigned shift = 0;
+    while ((bins << shift) < (1u << (8 * byteDepth)))
+        ++shift;
+    return shift;
+}
+
+} // anonymous namespace
+
+TaskSet_ImageStats::ATask::ATask(boost::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount)
+    : Task(semDone, taskIndex, totalTaskCount),
+    image_(NULL),
+    pixelCount_(0),
+    byteDepth_(0),
+    min_(0),
+    max_(0),
+    sum_(0),
+    sumSq_(0)
+{
+}
+
+void TaskSet_ImageStats::ATask::SetUp(const unsigned char* image, size_t pixelCount, unsigned byteDepth,
+        unsigned histogramBins, size_t usedTaskCount)
+{
+    image_ = image;
+    pixelCount_ = pixelCount;
+    byteDepth_ = byteDepth;
+    histogram_.resize(histogramBins);
+    usedTaskCount_ = usedTaskCount;
+}
+
+void TaskSet_ImageStats::ATask::Execute()
+{
+    if (taskIndex_ >= usedTaskCount_)
+        return;
+
+    size_t chunkPixels = pixelCount_ / usedTaskCount_;
+    const size_t chunkOffset = taskIndex_ * chunkPixels;
+    if (taskIndex_ == usedTaskCount_ - 1)
+        chunkPixels += pixelCount_ % usedTaskCount_;
+
+    std::fill(histogram_.begin(), histogram_.end(), 0);
+    const unsigned shift = HistogramShift(byteDepth_, static_cast<unsigned>(histogram_.size()));
+    if (byteDepth_ == 1)
+        Accumulate(image_ + chunkOffset, chunkPixels, shift, min_, max_, sum_, sumSq_, &histogram_[0]);
+    else
+        Accumulate(reinterpret_cast<const boost::uint16_t*>(image_) + chunkOffset, chunkPixels, shift,
+                min_, max_, sum_, sumSq_, &histogram_[0]);
+}
+
+TaskSet_ImageStats::TaskSet_ImageStats(boost::shared_ptr<ThreadPool> pool)
+    : TaskSet(pool),
+    pixelCount_(0)
+{
+    CreateTasks<ATask>();
+}
+
+bool TaskSet_ImageStats::IsSupportedDepth(unsigned byteDepth)
+{
+    return byteDepth == 1 || byteDepth == 2;
+}
+
+void TaskSet_ImageStats::SetUp(const unsigned char* image, size_t pixelCount, unsigned byteDepth,
+        unsigned histogramBins)
+{
+    assert(image != NULL);
+    assert(pixelCount > 0);
+    assert(IsSupportedDepth(byteDepth));
+    assert(histogramBins > 0 && histogramBins <= (1u << (8 * byteDepth)));
+
+    // Same heuristic as TaskSet_CopyMemory: one task per 1MB
+    pixelCount_ = pixelCount;
+    const size_t bytes = pixelCount * byteDepth;
+    usedTaskCount_ = std::min<size_t>(std::min<size_t>(1 + bytes / 1000000, tasks_.size()), pixelCount);
+
+    BOOST_FOREACH(Task* task, tasks_)
+        static_cast<ATask*>(task)->SetUp(image, pixelCount, byteDepth, histogramBins, usedTaskCount_);
+
+    if (usedTaskCount_ == 1)
+        tasks_[0]->Execute();
+}
+
+void TaskSet_ImageStats::Execute()
+{
+    if (usedTaskCount_ == 1)
+        return; // Already done in SetUp, nothing to execute
+
+    TaskSet::Execute();
+}
+
+void TaskSet_ImageStats::Wait()
+{
+    if (usedTaskCount_ == 1)
+        return; // Already done in SetUp, nothing to wait for
+
+    semaphore_->Wait(usedTaskCount_);
+}
+
+void TaskSet_ImageStats::GetStatistics(ImageStatistics& stats) const
+{
+    const ATask* first = static_cast<const ATask*>(tasks_[0]);
+    stats.min = first->GetMin();
+    stats.max = first->GetMax();
+    stats.histogram.assign(first->GetHistogram().size(), 0);
+
+    double sum = 0.0, sumSq = 0.0;
+    for (size_t n = 0; n < usedTaskCount_; ++n)
+    {
+        const ATask* task = static_cast<const ATask*>(tasks_[n]);
+        stats.min = std::min(stats.min, task->GetMin());
+        stats.max = std::max(stats.max, task->GetMax());
+        sum += static_cast<double>(task->GetSum());
+        sumSq += static_cast<double>(task->GetSumOfSquares());
+        const std::vector<boost::uint32_t>& histogram = task->GetHistogram();
+        for (size_t i = 0; i < histogram.size(); ++i)
+            stats.histogram[i] += histogram[i];
+    }
+
+    const double count = static_cast<double>(pixelCount_);
+    stats.mean = sum / count;
+    stats.stdDev = std::sqrt(std::max(0.0, sumSq / count - stats.mean * stats.mean));
+}
+
+void TaskSet_ImageStats::Compute(const unsigned char* image, size_t pixelCount, unsigned byteDepth,
+        unsigned histogramBins, ImageStatistics& stats)
+{
+    SetUp(image, pixelCount, byteDepth, histogramBins);
+    Execute();
+    Wait();
+    GetStatistics(stats);
+}
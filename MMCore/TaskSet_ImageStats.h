@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TaskSet_ImageStats.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Task set for parallelized image statistics.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "TaskSet.h"
+
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
+// Pixel statistics of one 8- or 16-bit grayscale image. The histogram bins
+// evenly divide the full range of the pixel type (e.g. 4096 bins of 16
+// values each for 16-bit pixels).
+struct ImageStatistics
+{
+    unsigned min;
+    unsigned max;
+    double mean;
+    double stdDev;
+    std::vector<long> histogram;
+
+    ImageStatistics() : min(0), max(0), mean(0.0), stdDev(0.0) {}
+};
+
+// Computes ImageStatistics over horizontal stripes in parallel and merges
+// the partial results.
+class TaskSet_ImageStats : public TaskSet
+{
+private:
+    class ATask : public Task
+    {
+    public:
+        explicit ATask(boost::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount);
+
+        void SetUp(const unsigned char* image, size_t pixelCount, unsigned byteDepth,
+                unsigned histogramBins, size_t usedTaskCount);
+
+        virtual void Execute()/* override*/;
+
+        unsigned GetMin() const { return min_; }
+        unsigned GetMax() const { return max_; }
+        boost::uint64_t GetSum() const { return sum_; }
+        boost::uint64_t GetSumOfSquares() const { return sumSq_; }
+        const std::vector<boost::uint32_t>& GetHistogram() const { return histogram_; }
+
+    private:
+        const unsigned char* image_;
+        size_t pixelCount_;
+        unsigned byteDepth_;
+        unsigned min_;
+        unsigned max_;
+        boost::uint64_t sum_;
+        boost::uint64_t sumSq_;
+        std::vector<boost::uint32_t> histogram_;
+    };
+
+public:
+    explicit TaskSet_ImageStats(boost::shared_ptr<ThreadPool> pool);
+
+    static bool IsSupportedDepth(unsigned byteDepth);
+
+    void SetUp(const unsigned char* image, size_t pixelCount, unsigned byteDepth, unsigned histogramBins);
+
+    virtual void Execute()/* override*/;
+    virtual void Wait()/* override*/;
+
+    // Merge the partial results; valid after Wait()
+    void GetStatistics(ImageStatistics& stats) const;
+
+    // Helper blocking method calling SetUp, Execute, Wait and GetStatistics
+    void Compute(const unsigned char* image, size_t pixelCount, unsigned byteDepth,
+            unsigned histogramBins, ImageStatistics& stats);
+
+private:
+    size_t pixelCount_;
+};
@@ -0,0 +1,118 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TriggerLatency.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-camera measurement of the time from the trigger of a
+//                burst frame to its arrival in the Core.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "TriggerLatency.h"
+
+#include "../MMDevice/DeviceUtils.h"
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+namespace mm {
+
+const std::size_t TriggerLatency::maxRecordedLatencies = 100000;
+
+void TriggerLatency::SetBurstStartTriggerType(const std::string& camera,
+      const std::string& type)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   cameras_[camera].burstStartTriggerType = type;
+}
+
+void TriggerLatency::SetFrameStartTriggerType(const std::string& camera,
+      const std::string& type)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   cameras_[camera].frameStartTriggerType = type;
+}
+
+void TriggerLatency::BurstPrepared(const std::string& camera, double nowMs)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   CameraState& state = cameras_[camera];
+   state.pendingTriggers.clear();
+   state.latencies.clear();
+   // The camera starts the burst, and its first frame, when armed
+   if (state.burstStartTriggerType == MM::g_TriggerType_Internal &&
+         state.frameStartTriggerType == MM::g_TriggerType_Internal)
+      state.pendingTriggers.push_back(nowMs);
+}
+
+void TriggerLatency::BurstStartTriggerSent(const std::string& camera,
+      double nowMs)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   CameraState& state = cameras_[camera];
+   if (state.frameStartTriggerType == MM::g_TriggerType_Internal)
+      state.pendingTriggers.push_back(nowMs);
+}
+
+void TriggerLatency::FrameStartTriggerSent(const std::string& camera,
+      double nowMs)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   cameras_[camera].pendingTriggers.push_back(nowMs);
+}
+
+void TriggerLatency::TriggerFailed(const std::string& camera)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   CameraState& state = cameras_[camera];
+   if (!state.pendingTriggers.empty())
+      state.pendingTriggers.pop_back();
+}
+
+void TriggerLatency::ClearPendingTriggers(const std::string& camera)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   std::map<std::string, CameraState>::iterator it = cameras_.find(camera);
+   if (it != cameras_.end())
+      it->second.pendingTriggers.clear();
+}
+
+void TriggerLatency::FrameReceived(const std::string& camera, double nowMs,
+      Metadata& md)
+{
+   double latencyMs;
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      std::map<std::string, CameraState>::iterator it = cameras_.find(camera);
+      if (it == cameras_.end() || it->second.pendingTriggers.empty())
+         return;
+      CameraState& state = it->second;
+      latencyMs = nowMs - state.pendingTriggers.front();
+      state.pendingTriggers.pop_front();
+      if (state.latencies.size() >= maxRecordedLatencies)
+         state.latencies.pop_front();
+      state.latencies.push_back(latencyMs);
+   }
+   md.PutImageTag(MM::g_Keyword_Metadata_TriggerLatency_ms,
+         CDeviceUtils::FormatNumber(latencyMs));
+}
+
+std::vector<double> TriggerLatency::GetLatencies(const std::string& camera) const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   std::map<std::string, CameraState>::const_iterator it = cameras_.find(camera);
+   if (it == cameras_.end())
+      return std::vector<double>();
+   return std::vector<double>(it->second.latencies.begin(),
+         it->second.latencies.end());
+}
+
+} // namespace mm
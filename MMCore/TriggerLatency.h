@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TriggerLatency.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-camera measurement of the time from the trigger of a
+//                burst frame to its arrival in the Core.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <boost/thread.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class Metadata;
+
+namespace mm {
+
+/**
+ * Pairs the frames that cameras insert with the triggers that started them,
+ * and records the latency of each in the frame's metadata
+ * (MM::g_Keyword_Metadata_TriggerLatency_ms) and in a per-camera list.
+ *
+ * A frame's trigger is the software frame start trigger sent for it or, with
+ * internal frame start triggers, the start of the burst for its first frame:
+ * the software burst start trigger, or arming with an internal burst start
+ * trigger. Frames started by a TTL or by the camera's own timing have no
+ * known trigger time and are not measured. All times are in milliseconds.
+ */
+class TriggerLatency
+{
+public:
+   TriggerLatency() {}
+
+   // The trigger types (MM::g_TriggerType_Internal, etc.) in effect; the
+   // Core sets them when they are set and when a burst is prepared
+   void SetBurstStartTriggerType(const std::string& camera, const std::string& type);
+   void SetFrameStartTriggerType(const std::string& camera, const std::string& type);
+
+   // Starts a new list of latencies
+   void BurstPrepared(const std::string& camera, double nowMs);
+   void BurstStartTriggerSent(const std::string& camera, double nowMs);
+   void FrameStartTriggerSent(const std::string& camera, double nowMs);
+   // Withdraws the trigger last sent, which the camera did not accept
+   void TriggerFailed(const std::string& camera);
+   // Forgets the triggers of frames that have not arrived, when the camera
+   // stops or starts another acquisition, so that they are not paired with
+   // later frames
+   void ClearPendingTriggers(const std::string& camera);
+
+   // Adds the latency tag to md if the frame has a known trigger
+   void FrameReceived(const std::string& camera, double nowMs, Metadata& md);
+
+   // Latencies of the frames of the last burst, oldest first
+   std::vector<double> GetLatencies(const std::string& camera) const;
+
+   // Only the latest latencies are kept for long bursts
+   static const std::size_t maxRecordedLatencies;
+
+private:
+   struct CameraState
+   {
+      std::string burstStartTriggerType;
+      std::string frameStartTriggerType;
+      std::deque<double> pendingTriggers;
+      std::deque<double> latencies;
+   };
+
+   mutable boost::mutex mutex_;
+   std::map<std::string, CameraState> cameras_;
+};
+
+} // namespace mm
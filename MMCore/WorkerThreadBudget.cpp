@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          WorkerThreadBudget.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Division of the worker threads for data-parallel work among
+//                devices.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "WorkerThreadBudget.h"
+
+namespace mm {
+
+WorkerThreadBudget::WorkerThreadBudget(unsigned total) :
+   total_(total)
+{
+}
+
+unsigned WorkerThreadBudget::Lease(const void* holder)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   leases_.erase(holder);
+
+   unsigned leasedToOthers = 0;
+   for (std::map<const void*, unsigned>::const_iterator it = leases_.begin(),
+         end = leases_.end(); it != end; ++it)
+      leasedToOthers += it->second;
+
+   const unsigned total = total_;
+   const unsigned lease = leasedToOthers < total ? total - leasedToOthers : 1;
+   leases_[holder] = lease;
+   return lease;
+}
+
+void WorkerThreadBudget::Release(const void* holder)
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   leases_.erase(holder);
+}
+
+void WorkerThreadBudget::ReleaseAll()
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   leases_.clear();
+}
+
+unsigned WorkerThreadBudget::GetLeased() const
+{
+   boost::lock_guard<boost::mutex> lock(mutex_);
+   unsigned leased = 0;
+   for (std::map<const void*, unsigned>::const_iterator it = leases_.begin(),
+         end = leases_.end(); it != end; ++it)
+      leased += it->second;
+   return leased;
+}
+
+} // namespace mm
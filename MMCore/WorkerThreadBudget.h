@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          WorkerThreadBudget.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Division of the worker threads for data-parallel work among
+//                devices.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <map>
+
+namespace mm {
+
+/**
+ * Hands out the system-wide number of worker threads to devices as leases,
+ * so that devices together do not use more threads than the total.
+ *
+ * A device's lease is what remains of the total after the leases of all
+ * other devices, but at least 1 (a pool of 1 thread runs its work on the
+ * calling thread and starts no workers). Asking again replaces the device's
+ * previous lease; a lease is returned when its device is unloaded. Changing
+ * the total affects leases handed out afterwards.
+ */
+class WorkerThreadBudget
+{
+public:
+   explicit WorkerThreadBudget(unsigned total);
+
+   void SetTotal(unsigned total) { total_ = total; }
+   unsigned GetTotal() const { return total_; }
+
+   unsigned Lease(const void* holder);
+   void Release(const void* holder);
+   void ReleaseAll();
+
+   // Threads currently leased to all holders together
+   unsigned GetLeased() const;
+
+private:
+   std::atomic<unsigned> total_;
+
+   mutable boost::mutex mutex_;
+   std::map<const void*, unsigned> leases_;
+};
+
+} // namespace mm
@@ -86,6 +86,74 @@ TEST(APIErrorTests, DetectDeviceWithInvalidDevice)
    EXPECT_EQ(MM::Unimplemented, c.detectDevice("Core"));
 }
 
+TEST(APIErrorTests, SetDeviceWorkerThreadBudgetWithInvalidCount)
+{
+   CMMCore c;
+   const int budget = c.getDeviceWorkerThreadBudget();
+   EXPECT_LE(1, budget);
+   EXPECT_THROW(c.setDeviceWorkerThreadBudget(0), CMMError);
+   EXPECT_THROW(c.setDeviceWorkerThreadBudget(-2), CMMError);
+   EXPECT_EQ(budget, c.getDeviceWorkerThreadBudget());
+   c.setDeviceWorkerThreadBudget(3);
+   EXPECT_EQ(3, c.getDeviceWorkerThreadBudget());
+}
+
+TEST(APIErrorTests, BurstAPIWithInvalidArgs)
+{
+   CMMCore c;
+   EXPECT_THROW(c.isBurstAPISupported(nullptr), CMMError);
+   EXPECT_THROW(c.isBurstAPISupported("Blah"), CMMError);
+   EXPECT_THROW(c.setBurstStartTriggerType("Blah", "software"), CMMError);
+   EXPECT_THROW(c.setBurstStartTriggerType("Blah", nullptr), CMMError);
+   EXPECT_THROW(c.setFrameStartTriggerType("Blah", "Software"), CMMError);
+   EXPECT_THROW(c.setFrameExposureMode("Blah", "bulb"), CMMError);
+   EXPECT_THROW(c.setPreFrameDelay("Blah", -1.0), CMMError);
+   EXPECT_THROW(c.prepareForBurst(0), CMMError);
+   EXPECT_THROW(c.prepareForBurst(-1), CMMError); // No current camera
+   EXPECT_THROW(c.prepareForBurst("Blah", -2), CMMError);
+   EXPECT_THROW(c.sendBurstStartTrigger(), CMMError);
+   EXPECT_THROW(c.sendFrameStartTrigger(), CMMError);
+   EXPECT_THROW(c.sendBurstEndTrigger(), CMMError);
+   EXPECT_THROW(c.getTriggerLatencies("Blah"), CMMError);
+   EXPECT_THROW(c.setRollingShutterActiveLines("Blah", 0), CMMError);
+}
+
+TEST(APIErrorTests, DeviceDetectionWithInvalidArgs)
+{
+   CMMCore c;
+   std::vector<std::string> labels;
+   EXPECT_TRUE(c.detectDevices(labels).empty());
+   labels.push_back("Blah");
+   EXPECT_THROW(c.detectDevices(labels), CMMError);
+   EXPECT_THROW(c.enableDetectionCache(nullptr), CMMError);
+   EXPECT_THROW(c.enableDetectionCache(""), CMMError);
+   EXPECT_NO_THROW(c.clearDetectionCache()); // Not enabled
+}
+
+TEST(APIErrorTests, SLMBufferUploadWithInvalidDevice)
+{
+   CMMCore c;
+   std::vector<unsigned char> pixels(16);
+   EXPECT_THROW(c.setSLMImage("Blah", &pixels[0], 16), CMMError);
+   EXPECT_THROW(c.setSLMImage(nullptr, &pixels[0], 16), CMMError);
+   EXPECT_THROW(c.loadSLMSequence("Blah", &pixels[0], 16), CMMError);
+   EXPECT_THROW(c.loadSLMSequence(nullptr, &pixels[0], 16), CMMError);
+}
+
+TEST(APIErrorTests, DeviceCallProfilingWithInvalidArgs)
+{
+   CMMCore c;
+   EXPECT_FALSE(c.isDeviceCallProfilingEnabled());
+   c.enableDeviceCallProfiling(true);
+   EXPECT_TRUE(c.isDeviceCallProfilingEnabled());
+   EXPECT_NO_THROW(c.resetDeviceCallProfiles());
+   EXPECT_THROW(c.getProfiledDeviceMethods("Blah"), CMMError);
+   EXPECT_THROW(c.getProfiledDeviceMethods(nullptr), CMMError);
+   EXPECT_THROW(c.getDeviceCallLatencies("Blah", "Snap"), CMMError);
+   EXPECT_THROW(c.getDeviceCallLatencies(nullptr, "Snap"), CMMError);
+   EXPECT_THROW(c.saveDeviceCallProfiles(nullptr), CMMError);
+}
+
 int main(int argc, char **argv)
 {
    ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,289 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+#include "FrameCodec.h"
+
+#include <boost/cstdint.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+namespace
+{
+
+// Low-signal image: a slow gradient plus a few bits of noise
+std::vector<unsigned char> MakeImage(unsigned width, unsigned height,
+      unsigned byteDepth, unsigned noiseBits, unsigned seed)
+{
+   std::srand(seed);
+   std::vector<unsigned char> image(width * height * byteDepth);
+   for (unsigned y = 0; y < height; ++y)
+   {
+      for (unsigned x = 0; x < width; ++x)
+      {
+         unsigned value = 100 + x / 8 + y / 8 +
+            (std::rand() & ((1u << noiseBits) - 1));
+         unsigned char* pixel = &image[(y * width + x) * byteDepth];
+         if (byteDepth == 2)
+         {
+            boost::uint16_t v = static_cast<boost::uint16_t>(value);
+            memcpy(pixel, &v, 2);
+         }
+         else
+         {
+            for (unsigned b = 0; b < byteDepth; ++b)
+               pixel[b] = static_cast<unsigned char>(value >> (8 * b));
+         }
+      }
+   }
+   return image;
+}
+
+Metadata CameraMetadata()
+{
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   return md;
+}
+
+bool RoundTrips(unsigned width, unsigned height, unsigned byteDepth,
+      const std::vector<unsigned char>& image, unsigned stripeCount,
+      size_t* compressedBytes = 0)
+{
+   std::vector<size_t> stripeBytes(stripeCount);
+   std::vector<unsigned char> encoded(
+         mm::FrameCodec::HeaderBytes(stripeCount) +
+         mm::FrameCodec::MaxStripeBytes(width, height, byteDepth) +
+         stripeCount * 64);
+   std::vector<unsigned char> stripes(encoded.size());
+   size_t total = 0;
+   for (unsigned i = 0; i < stripeCount; ++i)
+   {
+      unsigned first = mm::FrameCodec::StripeFirstRow(height, stripeCount, i);
+      unsigned rows = mm::FrameCodec::StripeFirstRow(height, stripeCount, i + 1) - first;
+      stripeBytes[i] = mm::FrameCodec::CompressStripe(&image[0], width, first,
+            rows, byteDepth, &stripes[total]);
+      total += stripeBytes[i];
+   }
+   size_t header = mm::FrameCodec::WriteHeader(stripeCount, &stripeBytes[0],
+         &encoded[0]);
+   memcpy(&encoded[header], &stripes[0], total);
+   if (compressedBytes)
+      *compressedBytes = header + total;
+
+   std::vector<unsigned char> decoded(image.size(), 0xcd);
+   if (!mm::FrameCodec::DecompressFrame(&encoded[0], header + total, width,
+            height, byteDepth, &decoded[0]))
+      return false;
+   return decoded == image;
+}
+
+} // anonymous namespace
+
+
+TEST(FrameCodecTests, RoundTripAllDepths)
+{
+   const unsigned depths[] = { 1, 2, 4, 8 };
+   for (unsigned d = 0; d < 4; ++d)
+   {
+      std::vector<unsigned char> image = MakeImage(67, 31, depths[d], 5, d);
+      EXPECT_TRUE(RoundTrips(67, 31, depths[d], image, 1));
+      EXPECT_TRUE(RoundTrips(67, 31, depths[d], image, 3));
+   }
+}
+
+TEST(FrameCodecTests, RoundTripFullRangeNoise)
+{
+   std::vector<unsigned char> image = MakeImage(128, 16, 2, 16, 42);
+   size_t bytes;
+   EXPECT_TRUE(RoundTrips(128, 16, 2, image, 2, &bytes));
+   EXPECT_LE(bytes, mm::FrameCodec::HeaderBytes(2) +
+         mm::FrameCodec::MaxStripeBytes(128, 16, 2));
+}
+
+TEST(FrameCodecTests, CompressesLowSignalData)
+{
+   std::vector<unsigned char> image = MakeImage(256, 256, 2, 6, 7);
+   size_t bytes;
+   EXPECT_TRUE(RoundTrips(256, 256, 2, image, 1, &bytes));
+   EXPECT_LT(bytes * 2, image.size());
+}
+
+TEST(FrameCodecTests, RejectsTruncatedData)
+{
+   std::vector<unsigned char> image = MakeImage(32, 32, 2, 8, 3);
+   size_t stripeBytes;
+   std::vector<unsigned char> encoded(mm::FrameCodec::HeaderBytes(1) +
+         mm::FrameCodec::MaxStripeBytes(32, 32, 2));
+   stripeBytes = mm::FrameCodec::CompressStripe(&image[0], 32, 0, 32, 2,
+         &encoded[mm::FrameCodec::HeaderBytes(1)]);
+   mm::FrameCodec::WriteHeader(1, &stripeBytes, &encoded[0]);
+   std::vector<unsigned char> decoded(image.size());
+   EXPECT_FALSE(mm::FrameCodec::DecompressFrame(&encoded[0],
+            mm::FrameCodec::HeaderBytes(1) + stripeBytes - 1, 32, 32, 2,
+            &decoded[0]));
+}
+
+
+TEST(CircularBufferCompressionTests, InsertAndRetrieve)
+{
+   const unsigned width = 512, height = 512;
+   CircularBuffer buffer(4);
+   buffer.SetCompressionEnabled(true);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   EXPECT_TRUE(buffer.IsCompressionEnabled());
+
+   Metadata md = CameraMetadata();
+   std::vector< std::vector<unsigned char> > images;
+   for (unsigned i = 0; i < 8; ++i)
+   {
+      images.push_back(MakeImage(width, height, 2, 6, i));
+      ASSERT_TRUE(buffer.InsertImage(&images[i][0], width, height, 2, &md));
+   }
+   EXPECT_EQ(8u, buffer.GetRemainingImageCount());
+   EXPECT_GT(buffer.GetCompressionRatio(), 1.5);
+
+   const mm::ImgBuffer* top = buffer.GetTopImageBuffer(0);
+   ASSERT_TRUE(top != 0);
+   EXPECT_EQ(0, memcmp(top->GetPixels(), &images[7][0], images[7].size()));
+   EXPECT_EQ("7", top->GetMetadata().GetSingleTag(
+            MM::g_Keyword_Metadata_ImageNumber).GetValue());
+   // Repeated retrieval of the same image is served from the decoded copy
+   EXPECT_EQ(top, buffer.GetTopImageBuffer(0));
+
+   for (unsigned i = 0; i < 8; ++i)
+   {
+      const mm::ImgBuffer* img = buffer.GetNextImageBuffer(0);
+      ASSERT_TRUE(img != 0);
+      EXPECT_EQ(0, memcmp(img->GetPixels(), &images[i][0], images[i].size()));
+   }
+   EXPECT_TRUE(buffer.GetNextImageBuffer(0) == 0);
+}
+
+TEST(CircularBufferCompressionTests, DecodesIntoCallerScratch)
+{
+   const unsigned width = 128, height = 128;
+   CircularBuffer buffer(4);
+   buffer.SetCompressionEnabled(true);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+
+   Metadata md = CameraMetadata();
+   std::vector<unsigned char> image = MakeImage(width, height, 2, 6, 3);
+   ASSERT_TRUE(buffer.InsertImage(&image[0], width, height, 2, &md));
+   const mm::ImgBuffer* pooled = buffer.GetTopImageBuffer(0);
+   ASSERT_TRUE(pooled != 0);
+
+   mm::ImgBuffer scratch(0, 0, 1);
+   for (unsigned i = 0; i < 16; ++i)
+   {
+      const mm::ImgBuffer* img = buffer.GetTopImageBuffer(0, scratch);
+      ASSERT_EQ(&scratch, img);
+      EXPECT_EQ(0, memcmp(img->GetPixels(), &image[0], image.size()));
+   }
+   EXPECT_EQ("0", scratch.GetMetadata().GetSingleTag(
+            MM::g_Keyword_Metadata_ImageNumber).GetValue());
+   // The image already returned from the pool is still cached there
+   EXPECT_EQ(pooled, buffer.GetTopImageBuffer(0));
+}
+
+TEST(CircularBufferCompressionTests, HoldsMoreThanUncompressed)
+{
+   const unsigned width = 512, height = 512;
+   std::vector<unsigned char> image = MakeImage(width, height, 2, 4, 1);
+   Metadata md = CameraMetadata();
+
+   CircularBuffer raw(4);
+   ASSERT_TRUE(raw.Initialize(1, width, height, 2));
+   unsigned rawCount = 0;
+   while (raw.InsertImage(&image[0], width, height, 2, &md))
+      ++rawCount;
+   EXPECT_EQ(raw.GetSize(), rawCount);
+
+   CircularBuffer compressed(4);
+   compressed.SetCompressionEnabled(true);
+   ASSERT_TRUE(compressed.Initialize(1, width, height, 2));
+   unsigned compressedCount = 0;
+   while (compressed.InsertImage(&image[0], width, height, 2, &md))
+      ++compressedCount;
+   EXPECT_TRUE(compressed.Overflow());
+   EXPECT_GE(compressedCount, 2 * rawCount);
+   EXPECT_EQ(0u, compressed.GetFreeSize());
+
+   // Space is reclaimed as frames are read
+   for (unsigned i = 0; i < compressedCount / 2; ++i)
+      ASSERT_TRUE(compressed.GetNextImageBuffer(0) != 0);
+   compressed.Clear();
+   EXPECT_TRUE(compressed.InsertImage(&image[0], width, height, 2, &md));
+}
+
+TEST(CircularBufferCompressionTests, WrapsAroundArena)
+{
+   const unsigned width = 256, height = 256;
+   CircularBuffer buffer(1);
+   buffer.SetCompressionEnabled(true);
+   ASSERT_TRUE(buffer.Initialize(2, width, height, 2));
+   Metadata md = CameraMetadata();
+
+   // Keep the buffer partially full while cycling through the arena many
+   // times, checking FIFO order and content
+   std::vector< std::vector<unsigned char> > images;
+   for (unsigned i = 0; i < 16; ++i)
+      images.push_back(MakeImage(width, 2 * height, 2, 3 + i % 8, i));
+
+   unsigned inserted = 0, popped = 0;
+   for (unsigned round = 0; round < 200; ++round)
+   {
+      while (buffer.InsertMultiChannel(&images[inserted % 16][0], 2, width,
+               height, 2, &md))
+         ++inserted;
+      unsigned toPop = 1 + round % 3;
+      for (unsigned i = 0; i < toPop && popped < inserted; ++i)
+      {
+         const mm::ImgBuffer* img = buffer.GetNextImageBuffer(0);
+         ASSERT_TRUE(img != 0);
+         ASSERT_EQ(0, memcmp(img->GetPixels(), &images[popped % 16][0],
+                  width * height * 2));
+         ++popped;
+      }
+   }
+   EXPECT_GT(inserted, 200u);
+}
+
+TEST(CircularBufferCompressionTests, FailedChannelReleasesFrameSpace)
+{
+   const unsigned width = 256, height = 256;
+   const size_t channelBytes = width * height * 2;
+   CircularBuffer buffer(1);
+   buffer.SetCompressionEnabled(true);
+   ASSERT_TRUE(buffer.Initialize(2, width, height, 2));
+   Metadata md = CameraMetadata();
+
+   std::vector<unsigned char> compressible = MakeImage(width, 2 * height, 2, 1, 1);
+   while (buffer.InsertMultiChannel(&compressible[0], 2, width, height, 2, &md))
+      ;
+   ASSERT_GT(buffer.GetCompressionRatio(), 5.0);
+   ASSERT_TRUE(buffer.GetNextImageBuffer(0) != 0);
+   ASSERT_TRUE(buffer.GetNextImageBuffer(0) != 0);
+   const long remaining = buffer.GetRemainingImageCount();
+
+   // The first channel fits in the space freed by two frames, but the
+   // incompressible second channel does not
+   std::vector<unsigned char> mixed(compressible.begin(),
+         compressible.begin() + channelBytes);
+   std::vector<unsigned char> noise = MakeImage(width, height, 2, 16, 2);
+   mixed.insert(mixed.end(), noise.begin(), noise.end());
+   for (int i = 0; i < 4; ++i)
+      EXPECT_FALSE(buffer.InsertMultiChannel(&mixed[0], 2, width, height, 2, &md));
+   EXPECT_EQ(remaining, buffer.GetRemainingImageCount());
+
+   // The space is still available for frames the size of those read
+   EXPECT_TRUE(buffer.InsertMultiChannel(&compressible[0], 2, width, height, 2, &md));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
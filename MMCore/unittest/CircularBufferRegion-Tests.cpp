@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const unsigned width = 64, height = 48;
+
+// Pixel value depends on position and frame number
+boost::uint16_t PixelValue(unsigned frame, unsigned x, unsigned y)
+{
+   return static_cast<boost::uint16_t>(frame * 1000 + y * width + x);
+}
+
+void InsertFrame(CircularBuffer& buffer, unsigned frame)
+{
+   std::vector<boost::uint16_t> image(width * height);
+   for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x)
+         image[y * width + x] = PixelValue(frame, x, y);
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   md.PutImageTag("Frame", frame);
+   ASSERT_TRUE(buffer.InsertImage(reinterpret_cast<unsigned char*>(&image[0]),
+            width, height, 2, &md));
+}
+
+ImageRegion MakeRegion(unsigned x, unsigned y, unsigned w, unsigned h,
+      unsigned step, bool binning)
+{
+   ImageRegion region;
+   region.x = x;
+   region.y = y;
+   region.width = w;
+   region.height = h;
+   region.step = step;
+   region.binning = binning;
+   return region;
+}
+
+} // anonymous namespace
+
+
+TEST(CircularBufferRegionTests, CopiesRegion)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   InsertFrame(buffer, 1);
+   InsertFrame(buffer, 2);
+
+   const ImageRegion region = MakeRegion(5, 7, 10, 4, 1, false);
+   std::vector<boost::uint16_t> roi(region.OutputWidth() * region.OutputHeight());
+   Metadata md;
+   ASSERT_TRUE(buffer.CopyNthFromTopRegion(1, 0, region,
+            reinterpret_cast<unsigned char*>(&roi[0]), &md));
+   for (unsigned y = 0; y < 4; ++y)
+      for (unsigned x = 0; x < 10; ++x)
+         EXPECT_EQ(PixelValue(1, 5 + x, 7 + y), roi[y * 10 + x]);
+   EXPECT_EQ("1", md.GetSingleTag("Frame").GetValue());
+
+   EXPECT_FALSE(buffer.CopyNthFromTopRegion(2, 0, region,
+            reinterpret_cast<unsigned char*>(&roi[0]), 0));
+}
+
+TEST(CircularBufferRegionTests, SubsamplesAndBins)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   InsertFrame(buffer, 0);
+
+   std::vector<boost::uint16_t> roi(4 * 2);
+   ASSERT_TRUE(buffer.CopyNthFromTopRegion(0, 0, MakeRegion(8, 4, 8, 4, 2, false),
+            reinterpret_cast<unsigned char*>(&roi[0]), 0));
+   for (unsigned y = 0; y < 2; ++y)
+      for (unsigned x = 0; x < 4; ++x)
+         EXPECT_EQ(PixelValue(0, 8 + 2 * x, 4 + 2 * y), roi[y * 4 + x]);
+
+   ASSERT_TRUE(buffer.CopyNthFromTopRegion(0, 0, MakeRegion(8, 4, 8, 4, 2, true),
+            reinterpret_cast<unsigned char*>(&roi[0]), 0));
+   for (unsigned y = 0; y < 2; ++y)
+   {
+      for (unsigned x = 0; x < 4; ++x)
+      {
+         const unsigned sx = 8 + 2 * x, sy = 4 + 2 * y;
+         const unsigned sum = PixelValue(0, sx, sy) + PixelValue(0, sx + 1, sy) +
+            PixelValue(0, sx, sy + 1) + PixelValue(0, sx + 1, sy + 1);
+         EXPECT_EQ(sum / 4, roi[y * 4 + x]);
+      }
+   }
+}
+
+TEST(CircularBufferRegionTests, RejectsRegionOutsideImage)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   InsertFrame(buffer, 0);
+
+   std::vector<boost::uint16_t> roi(width * height);
+   EXPECT_THROW(buffer.CopyNthFromTopRegion(0, 0,
+            MakeRegion(width - 4, 0, 8, 8, 1, false),
+            reinterpret_cast<unsigned char*>(&roi[0]), 0), CMMError);
+}
+
+TEST(CircularBufferRegionTests, CursorReadsEachNewFrame)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   InsertFrame(buffer, 0); // Before the cursor was added; not seen
+
+   buffer.AddRegionCursor(7, 0, MakeRegion(1, 2, 2, 2, 1, false));
+   for (unsigned frame = 1; frame <= 3; ++frame)
+      InsertFrame(buffer, frame);
+
+   std::vector<boost::uint16_t> roi(4);
+   unsigned long skipped;
+   for (unsigned frame = 1; frame <= 3; ++frame)
+   {
+      Metadata md;
+      ASSERT_TRUE(buffer.ReadNextRegion(7, reinterpret_cast<unsigned char*>(&roi[0]),
+               &md, skipped));
+      EXPECT_EQ(0u, skipped);
+      EXPECT_EQ(boost::lexical_cast<std::string>(frame),
+            md.GetSingleTag("Frame").GetValue());
+      EXPECT_EQ(PixelValue(frame, 1, 2), roi[0]);
+      EXPECT_EQ(PixelValue(frame, 2, 3), roi[3]);
+   }
+   EXPECT_FALSE(buffer.ReadNextRegion(7, reinterpret_cast<unsigned char*>(&roi[0]),
+            0, skipped));
+
+   // Reading the cursor does not consume frames
+   EXPECT_EQ(4, buffer.GetRemainingImageCount());
+
+   buffer.RemoveRegionCursor(7);
+   InsertFrame(buffer, 4);
+   EXPECT_FALSE(buffer.ReadNextRegion(7, reinterpret_cast<unsigned char*>(&roi[0]),
+            0, skipped));
+}
+
+TEST(CircularBufferRegionTests, CursorSkipsConsumedFrames)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   buffer.AddRegionCursor(1, 0, MakeRegion(0, 0, 4, 4, 1, false));
+   for (unsigned frame = 0; frame < 5; ++frame)
+      InsertFrame(buffer, frame);
+
+   ASSERT_TRUE(buffer.GetNextImageBuffer(0) != 0);
+   ASSERT_TRUE(buffer.GetNextImageBuffer(0) != 0);
+
+   std::vector<boost::uint16_t> roi(16);
+   unsigned long skipped;
+   Metadata md;
+   ASSERT_TRUE(buffer.ReadNextRegion(1, reinterpret_cast<unsigned char*>(&roi[0]),
+            &md, skipped));
+   EXPECT_EQ(2u, skipped);
+   EXPECT_EQ("2", md.GetSingleTag("Frame").GetValue());
+}
+
+TEST(CircularBufferRegionTests, CursorWithCompression)
+{
+   CircularBuffer buffer(1);
+   buffer.SetCompressionEnabled(true);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   buffer.AddRegionCursor(1, 0, MakeRegion(10, 10, 6, 6, 3, true));
+   InsertFrame(buffer, 5);
+
+   std::vector<boost::uint16_t> roi(4);
+   unsigned long skipped;
+   ASSERT_TRUE(buffer.ReadNextRegion(1, reinterpret_cast<unsigned char*>(&roi[0]),
+            0, skipped));
+   // Pixel values are linear in x and y, so the mean of a 3 x 3 block is the
+   // value at its center
+   EXPECT_EQ(PixelValue(5, 11, 11), roi[0]);
+   EXPECT_EQ(PixelValue(5, 14, 14), roi[3]);
+}
+
+TEST(CircularBufferRegionTests, DemuxSplitsMultiROIFrames)
+{
+   std::vector<ImageRegion> regions;
+   regions.push_back(MakeRegion(0, 0, 8, 6, 1, false));
+   regions.push_back(MakeRegion(50, 40, 8, 6, 1, false));
+
+   CircularBuffer buffer(1);
+   buffer.SetDemuxRegions(regions, 100, 200);
+   EXPECT_FALSE(buffer.IsDemuxActive());
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   EXPECT_TRUE(buffer.IsDemuxActive());
+   EXPECT_EQ(8u, buffer.Width());
+   EXPECT_EQ(6u, buffer.Height());
+   InsertFrame(buffer, 3);
+
+   for (unsigned channel = 0; channel < 2; ++channel)
+   {
+      const mm::ImgBuffer* img = buffer.GetTopImageBuffer(channel);
+      ASSERT_TRUE(img != 0);
+      ASSERT_EQ(8u, img->Width());
+      const boost::uint16_t* pixels =
+         reinterpret_cast<const boost::uint16_t*>(img->GetPixels());
+      for (unsigned y = 0; y < 6; ++y)
+         for (unsigned x = 0; x < 8; ++x)
+            EXPECT_EQ(PixelValue(3, regions[channel].x + x, regions[channel].y + y),
+                  pixels[y * 8 + x]);
+
+      Metadata md = img->GetMetadata();
+      EXPECT_EQ(boost::lexical_cast<std::string>(channel),
+            md.GetSingleTag(MM::g_Keyword_CameraChannelIndex).GetValue());
+      EXPECT_EQ(boost::lexical_cast<std::string>(100 + regions[channel].x),
+            md.GetSingleTag(MM::g_Keyword_Metadata_ROI_X).GetValue());
+      EXPECT_EQ(boost::lexical_cast<std::string>(200 + regions[channel].y),
+            md.GetSingleTag(MM::g_Keyword_Metadata_ROI_Y).GetValue());
+      EXPECT_EQ("3", md.GetSingleTag("Frame").GetValue());
+   }
+   EXPECT_TRUE(buffer.GetTopImageBuffer(2) == 0);
+
+   // New regions take effect only when the buffer is initialized again
+   buffer.SetDemuxRegions(regions, 0, 0);
+   EXPECT_FALSE(buffer.IsDemuxActive());
+}
+
+TEST(CircularBufferRegionTests, DemuxPadsSmallerROIs)
+{
+   std::vector<ImageRegion> regions;
+   regions.push_back(MakeRegion(2, 3, 10, 4, 1, false));
+   regions.push_back(MakeRegion(20, 30, 4, 2, 1, false));
+
+   CircularBuffer buffer(1);
+   buffer.SetDemuxRegions(regions, 0, 0);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   InsertFrame(buffer, 1);
+
+   const mm::ImgBuffer* img = buffer.GetTopImageBuffer(1);
+   ASSERT_TRUE(img != 0);
+   ASSERT_EQ(10u, img->Width());
+   ASSERT_EQ(4u, img->Height());
+   const boost::uint16_t* pixels =
+      reinterpret_cast<const boost::uint16_t*>(img->GetPixels());
+   EXPECT_EQ(PixelValue(1, 20, 30), pixels[0]);
+   EXPECT_EQ(PixelValue(1, 23, 31), pixels[10 + 3]);
+   EXPECT_EQ(0, pixels[4]);
+   EXPECT_EQ(0, pixels[2 * 10]);
+   EXPECT_EQ("4", img->GetMetadata().GetSingleTag("MultiROIWidth").GetValue());
+}
+
+TEST(CircularBufferRegionTests, NoDemuxWhenROIsDoNotFit)
+{
+   std::vector<ImageRegion> regions;
+   regions.push_back(MakeRegion(0, 0, 8, 8, 1, false));
+   regions.push_back(MakeRegion(width, 0, 8, 8, 1, false));
+
+   CircularBuffer buffer(1);
+   buffer.SetDemuxRegions(regions, 0, 0);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   EXPECT_FALSE(buffer.IsDemuxActive());
+   EXPECT_EQ(width, buffer.Width());
+   InsertFrame(buffer, 0);
+   EXPECT_TRUE(buffer.GetTopImageBuffer(1) == 0);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+
+#include <boost/lexical_cast.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const unsigned width = 512, height = 512;
+
+std::vector<unsigned char> MakeImage(unsigned value)
+{
+   std::vector<unsigned char> image(width * height * 2);
+   for (size_t i = 0; i < image.size(); ++i)
+      image[i] = static_cast<unsigned char>(value + i / 4096);
+   return image;
+}
+
+Metadata CameraMetadata()
+{
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   return md;
+}
+
+std::string SpillPath()
+{
+   return "CircularBufferSpill-Tests.spill";
+}
+
+bool FileExists(const std::string& path)
+{
+   std::FILE* f = std::fopen(path.c_str(), "rb");
+   if (!f)
+      return false;
+   std::fclose(f);
+   return true;
+}
+
+} // anonymous namespace
+
+
+TEST(CircularBufferSpillTests, HoldsMoreThanMemoryInOrder)
+{
+   // 4 MB holds 8 frames in memory; the file holds 32 more
+   CircularBuffer buffer(4);
+   buffer.SetSpillFile(SpillPath(), 16);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 2));
+   EXPECT_EQ(SpillPath(), buffer.GetSpillFilePath());
+   EXPECT_EQ(16u, buffer.GetSpillFileSizeMB());
+   EXPECT_EQ(40u, buffer.GetSize());
+
+   Metadata md = CameraMetadata();
+   unsigned inserted = 0;
+   while (buffer.InsertImage(&MakeImage(inserted)[0], width, height, 2, &md))
+      ++inserted;
+   EXPECT_EQ(40u, inserted);
+   EXPECT_TRUE(buffer.Overflow());
+   EXPECT_EQ(0u, buffer.GetFreeSize());
+   EXPECT_EQ(32u, buffer.GetSpilledImageCount());
+
+   // The newest frame is in memory; older ones can also be peeked at
+   const mm::ImgBuffer* top = buffer.GetTopImageBuffer(0);
+   ASSERT_TRUE(top != 0);
+   EXPECT_EQ(0, memcmp(top->GetPixels(), &MakeImage(39)[0], width * height * 2));
+   const mm::ImgBuffer* old = buffer.GetNthFromTopImageBuffer(35, 0);
+   ASSERT_TRUE(old != 0);
+   EXPECT_EQ(0, memcmp(old->GetPixels(), &MakeImage(4)[0], width * height * 2));
+
+   for (unsigned i = 0; i < inserted; ++i)
+   {
+      const mm::ImgBuffer* img = buffer.GetNextImageBuffer(0);
+      ASSERT_TRUE(img != 0);
+      ASSERT_EQ(0, memcmp(img->GetPixels(), &MakeImage(i)[0], width * height * 2));
+      EXPECT_EQ(boost::lexical_cast<std::string>(i), img->GetMetadata().
+            GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue());
+   }
+   EXPECT_TRUE(buffer.GetNextImageBuffer(0) == 0);
+}
+
+TEST(CircularBufferSpillTests, BurstsAreNotDropped)
+{
+   // 8 two-channel frames in memory, 16 in the file
+   CircularBuffer buffer(4);
+   buffer.SetSpillFile(SpillPath(), 8);
+   ASSERT_TRUE(buffer.Initialize(2, width, height / 2, 2));
+   Metadata md = CameraMetadata();
+
+   // Bursts larger than the in-memory buffer, while the reader falls behind
+   unsigned inserted = 0, popped = 0;
+   for (unsigned round = 0; round < 8; ++round)
+   {
+      for (unsigned i = 0; i < 16; ++i, ++inserted)
+      {
+         std::vector<unsigned char> image = MakeImage(inserted);
+         ASSERT_TRUE(buffer.InsertMultiChannel(&image[0], 2, width,
+                  height / 2, 2, &md));
+      }
+      for (unsigned i = 0; i < 15; ++i, ++popped)
+      {
+         const mm::ImgBuffer* img = buffer.GetNextImageBuffer(1);
+         ASSERT_TRUE(img != 0);
+         std::vector<unsigned char> expected = MakeImage(popped);
+         ASSERT_EQ(0, memcmp(img->GetPixels(), &expected[width * height],
+                  width * height));
+      }
+   }
+   EXPECT_FALSE(buffer.Overflow());
+   EXPECT_GT(buffer.GetSpilledImageCount(), 0u);
+   EXPECT_EQ(inserted - popped, buffer.GetRemainingImageCount());
+}
+
+TEST(CircularBufferSpillTests, FileIsRemoved)
+{
+   {
+      CircularBuffer buffer(4);
+      buffer.SetSpillFile(SpillPath(), 4);
+      EXPECT_TRUE(FileExists(SpillPath()));
+      buffer.SetSpillFile("", 0);
+      EXPECT_FALSE(FileExists(SpillPath()));
+      EXPECT_EQ("", buffer.GetSpillFilePath());
+
+      buffer.SetSpillFile(SpillPath(), 4);
+   }
+   EXPECT_FALSE(FileExists(SpillPath()));
+}
+
+TEST(CircularBufferSpillTests, ExistingFileIsLeftAlone)
+{
+   {
+      std::FILE* f = std::fopen(SpillPath().c_str(), "wb");
+      ASSERT_TRUE(f != 0);
+      std::fputs("user data", f);
+      std::fclose(f);
+   }
+   {
+      CircularBuffer buffer(4);
+      EXPECT_THROW(buffer.SetSpillFile(SpillPath(), 4), CMMError);
+      EXPECT_EQ("", buffer.GetSpillFilePath());
+   }
+   std::FILE* f = std::fopen(SpillPath().c_str(), "rb");
+   ASSERT_TRUE(f != 0);
+   char contents[32] = { 0 };
+   EXPECT_EQ(9u, std::fread(contents, 1, sizeof(contents), f));
+   std::fclose(f);
+   EXPECT_STREQ("user data", contents);
+   std::remove(SpillPath().c_str());
+}
+
+TEST(CircularBufferSpillTests, NotCombinedWithCompression)
+{
+   CircularBuffer buffer(4);
+   buffer.SetCompressionEnabled(true);
+   EXPECT_THROW(buffer.SetSpillFile(SpillPath(), 4), CMMError);
+   EXPECT_FALSE(FileExists(SpillPath()));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
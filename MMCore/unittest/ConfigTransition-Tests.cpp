@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "ConfigGroup.h"
+#include "MMCore.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+void DefineFilterGroup(ConfigGroupCollection& groups)
+{
+   groups.Define("Channel", "DAPI", "Wheel", "State", "0");
+   groups.Define("Channel", "DAPI", "Shutter", "State", "1");
+   groups.Define("Channel", "FITC", "Wheel", "State", "1");
+   groups.Define("Channel", "FITC", "Shutter", "State", "1");
+   groups.Define("Channel", "FITC", "Camera", "Gain", "2");
+}
+
+size_t TransitionSize(ConfigGroupCollection& groups, const char* groupName,
+      const char* fromConfig, const char* toConfig)
+{
+   Configuration transition;
+   if (!groups.FindTransition(groupName, fromConfig, toConfig, transition))
+      return static_cast<size_t>(-1);
+   return transition.size();
+}
+
+void FindTransitions(ConfigGroupCollection* groups, std::vector<size_t>* sizes)
+{
+   for (size_t i = 0; i < sizes->size(); ++i)
+      (*sizes)[i] = TransitionSize(*groups, "Channel", "DAPI", "FITC");
+}
+
+} // anonymous namespace
+
+
+TEST(ConfigTransitionTests, TransitionHasOnlyChangedSettings)
+{
+   ConfigGroupCollection groups;
+   DefineFilterGroup(groups);
+
+   Configuration transition;
+   ASSERT_TRUE(groups.FindTransition("Channel", "DAPI", "FITC", transition));
+   EXPECT_EQ(2u, transition.size());
+   EXPECT_TRUE(transition.isSettingIncluded(PropertySetting("Wheel", "State", "1")));
+   EXPECT_TRUE(transition.isSettingIncluded(PropertySetting("Camera", "Gain", "2")));
+   EXPECT_FALSE(transition.isPropertyIncluded("Shutter", "State"));
+
+   EXPECT_EQ(1u, TransitionSize(groups, "Channel", "FITC", "DAPI"));
+   EXPECT_EQ(0u, TransitionSize(groups, "Channel", "DAPI", "DAPI"));
+}
+
+TEST(ConfigTransitionTests, MissingGroupOrPreset)
+{
+   ConfigGroupCollection groups;
+   DefineFilterGroup(groups);
+   Configuration transition;
+   EXPECT_FALSE(groups.FindTransition("Blah", "DAPI", "FITC", transition));
+   EXPECT_FALSE(groups.FindTransition("Channel", "Blah", "FITC", transition));
+   EXPECT_FALSE(groups.FindTransition("Channel", "DAPI", "Blah", transition));
+}
+
+TEST(ConfigTransitionTests, ChangesReplanTransitions)
+{
+   ConfigGroupCollection groups;
+   DefineFilterGroup(groups);
+   groups.PlanTransitions();
+   ASSERT_EQ(2u, TransitionSize(groups, "Channel", "DAPI", "FITC"));
+
+   groups.Define("Channel", "FITC", "Shutter", "State", "0");
+   EXPECT_EQ(3u, TransitionSize(groups, "Channel", "DAPI", "FITC"));
+
+   groups.Delete("Channel", "FITC", "Camera", "Gain");
+   EXPECT_EQ(2u, TransitionSize(groups, "Channel", "DAPI", "FITC"));
+
+   Configuration transition;
+   groups.RenameConfig("Channel", "FITC", "GFP");
+   EXPECT_FALSE(groups.FindTransition("Channel", "DAPI", "FITC", transition));
+   EXPECT_TRUE(groups.FindTransition("Channel", "DAPI", "GFP", transition));
+
+   groups.RenameGroup("Channel", "Filter");
+   EXPECT_FALSE(groups.FindTransition("Channel", "DAPI", "GFP", transition));
+   EXPECT_TRUE(groups.FindTransition("Filter", "DAPI", "GFP", transition));
+
+   groups.Delete("Filter", "GFP");
+   EXPECT_FALSE(groups.FindTransition("Filter", "DAPI", "GFP", transition));
+
+   groups.Clear();
+   EXPECT_FALSE(groups.FindTransition("Filter", "DAPI", "DAPI", transition));
+}
+
+TEST(ConfigTransitionTests, ConcurrentLookupsPlanOnce)
+{
+   for (int round = 0; round < 20; ++round)
+   {
+      ConfigGroupCollection groups;
+      DefineFilterGroup(groups);
+      std::vector< std::vector<size_t> > sizes(4, std::vector<size_t>(50));
+      boost::thread_group threads;
+      for (size_t i = 0; i < sizes.size(); ++i)
+         threads.create_thread(boost::bind(&FindTransitions, &groups, &sizes[i]));
+      threads.join_all();
+      for (size_t i = 0; i < sizes.size(); ++i)
+         for (size_t j = 0; j < sizes[i].size(); ++j)
+            ASSERT_EQ(2u, sizes[i][j]);
+   }
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
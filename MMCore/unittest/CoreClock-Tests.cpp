@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "CoreClock.h"
+#include "CoreUtils.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cmath>
+#include <iostream>
+
+
+TEST(CoreClockTests, NeverGoesBackward)
+{
+   MM::MMTime previous = mm::CoreClock::Now();
+   for (int i = 0; i < 100000; ++i)
+   {
+      const MM::MMTime now = mm::CoreClock::Now();
+      ASSERT_GE(now.getUsec(), previous.getUsec());
+      ASSERT_GE(now.uSec_, 0);
+      ASSERT_LT(now.uSec_, 1000000);
+      previous = now;
+   }
+}
+
+TEST(CoreClockTests, AnchoredToWallClock)
+{
+   const MM::MMTime now = mm::CoreClock::Now();
+   const MM::MMTime wall =
+      GetMMTimeNow(boost::posix_time::microsec_clock::local_time());
+   // Unless the system time was adjusted while the tests ran
+   EXPECT_LT(std::abs((wall - now).getMsec()), 1000.0);
+}
+
+TEST(CoreClockTests, ConvertsToWallTime)
+{
+   const MM::MMTime time(86400L + 3600L, 250000L);
+   EXPECT_EQ(boost::posix_time::time_from_string("2000-01-02 01:00:00.250"),
+         mm::CoreClock::ToPosixTime(time));
+   EXPECT_EQ(mm::CoreClock::Epoch(), mm::CoreClock::ToPosixTime(MM::MMTime()));
+}
+
+// Cost of reading the clock, compared with the wall clock that image
+// timestamps used to be taken from
+TEST(CoreClockTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const int reads = 1000000;
+   volatile long sink = 0;
+   const ptime t0 = microsec_clock::universal_time();
+   for (int i = 0; i < reads; ++i)
+      sink += mm::CoreClock::Now().uSec_;
+   const ptime t1 = microsec_clock::universal_time();
+   for (int i = 0; i < reads; ++i)
+      sink += GetMMTimeNow(microsec_clock::local_time()).uSec_;
+   const ptime t2 = microsec_clock::universal_time();
+
+   std::cout << "CoreClock::Now(): " <<
+      1000.0 * (t1 - t0).total_microseconds() / reads << " ns/call; " <<
+      "local_time(): " <<
+      1000.0 * (t2 - t1).total_microseconds() / reads << " ns/call\n";
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,479 @@
+#include <gtest/gtest.h>
+
+#include "DetectionCache.h"
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+std::string TempFileName()
+{
+   const char* tmp = std::getenv("TMPDIR");
+   std::string pattern = std::string(tmp ? tmp : "/tmp") + "/DetectionCache-Tests-XXXXXX";
+   std::vector<char> name(pattern.begin(), pattern.end());
+   name.push_back('\0');
+   const int fd = mkstemp(&name[0]);
+   if (fd < 0)
+      return std::string();
+   close(fd);
+   std::remove(&name[0]); // Start without a file
+   return std::string(&name[0]);
+}
+
+mm::DetectionCacheEntry Entry(const std::string& fingerprint,
+      MM::DeviceDetectionStatus status)
+{
+   mm::DetectionCacheEntry entry;
+   entry.fingerprint = fingerprint;
+   entry.status = status;
+   return entry;
+}
+
+std::vector<std::string> Resources(const char* a, const char* b = 0)
+{
+   std::vector<std::string> resources(1, a);
+   if (b)
+      resources.push_back(b);
+   return resources;
+}
+
+// The adapter's end of a link: the master side of a pseudo-terminal
+class PtyPort
+{
+   int fd_;
+   std::string slaveName_;
+
+public:
+   PtyPort() : fd_(posix_openpt(O_RDWR | O_NOCTTY))
+   {
+      if (fd_ >= 0 && grantpt(fd_) == 0 && unlockpt(fd_) == 0)
+         slaveName_ = ptsname(fd_);
+   }
+   ~PtyPort() { if (fd_ >= 0) close(fd_); }
+
+   bool IsOpen() const { return !slaveName_.empty(); }
+   const std::string& SlaveName() const { return slaveName_; }
+
+   // Sends a query and waits for a reply of len bytes
+   bool Query(unsigned char query, unsigned len, long timeoutMs)
+   {
+      if (write(fd_, &query, 1) != 1)
+         return false;
+      const boost::posix_time::ptime deadline =
+         boost::posix_time::microsec_clock::universal_time() +
+         boost::posix_time::milliseconds(timeoutMs);
+      unsigned bytesRead = 0;
+      unsigned char buf[16];
+      while (bytesRead < len)
+      {
+         const long remainingMs = (deadline -
+               boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+         if (remainingMs <= 0)
+            return false;
+         pollfd pfd = { fd_, POLLIN, 0 };
+         if (poll(&pfd, 1, static_cast<int>(remainingMs)) <= 0)
+            continue;
+         const ssize_t n = read(fd_, buf, sizeof(buf));
+         if (n < 0)
+            return false;
+         bytesRead += static_cast<unsigned>(n);
+      }
+      return true;
+   }
+};
+
+// Plays a device on the slave side of a pseudo-terminal that answers every
+// query byte with "OK\n" after latencyMs, as detection probes expect
+class FirmwareSimulator
+{
+   int fd_;
+   long latencyMs_;
+   boost::mutex mutex_;
+   int queries_;
+   bool stop_;
+   boost::thread thread_;
+
+public:
+   FirmwareSimulator(const std::string& slaveName, long latencyMs) :
+      fd_(open(slaveName.c_str(), O_RDWR | O_NOCTTY)),
+      latencyMs_(latencyMs),
+      queries_(0),
+      stop_(false)
+   {
+      termios tio;
+      if (fd_ >= 0 && tcgetattr(fd_, &tio) == 0)
+      {
+         cfmakeraw(&tio);
+         tcsetattr(fd_, TCSANOW, &tio);
+      }
+      thread_ = boost::thread(&FirmwareSimulator::Run, this);
+   }
+
+   ~FirmwareSimulator()
+   {
+      {
+         boost::lock_guard<boost::mutex> g(mutex_);
+         stop_ = true;
+      }
+      thread_.join();
+      if (fd_ >= 0)
+         close(fd_);
+   }
+
+   int Queries()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return queries_;
+   }
+
+private:
+   bool Stopping()
+   {
+      boost::lock_guard<boost::mutex> g(mutex_);
+      return stop_;
+   }
+
+   void Run()
+   {
+      while (!Stopping())
+      {
+         pollfd pfd = { fd_, POLLIN, 0 };
+         if (poll(&pfd, 1, 10) <= 0)
+            continue;
+         unsigned char buf[16];
+         const ssize_t n = read(fd_, buf, sizeof(buf));
+         if (n <= 0)
+            continue;
+         boost::this_thread::sleep(boost::posix_time::milliseconds(latencyMs_));
+         for (ssize_t i = 0; i < n; ++i)
+         {
+            {
+               boost::lock_guard<boost::mutex> g(mutex_);
+               ++queries_;
+            }
+            if (write(fd_, "OK\n", 3) != 3)
+               return;
+         }
+      }
+   }
+};
+
+// Detects devices on pseudo-terminals the way CMMCore::detectDevice() does
+// with the cache enabled, and records how the probes overlapped
+class PtyDetection
+{
+public:
+   struct Device
+   {
+      std::string module;
+      std::string name;
+      size_t port;
+      std::string fingerprint;
+   };
+
+   PtyDetection(mm::DetectionCache& cache, std::vector<PtyPort*>& ports) :
+      cache_(cache), ports_(ports), running_(0), maxRunning_(0), probes_(0)
+   {}
+
+   std::vector<long> Run(const std::vector<Device>& devices)
+   {
+      std::vector< std::vector<std::string> > resources;
+      for (size_t i = 0; i < devices.size(); ++i)
+      {
+         std::vector<std::string> used;
+         used.push_back("module:" + devices[i].module);
+         used.push_back("port:" + ports_[devices[i].port]->SlaveName());
+         resources.push_back(used);
+      }
+      std::vector<long> results(devices.size(), MM::Unimplemented);
+      mm::RunDetectionGroups(mm::GroupIndependentDetections(resources),
+            boost::bind(&PtyDetection::Detect, this, &devices, &results, _1));
+      return results;
+   }
+
+   int MaxRunning() { boost::lock_guard<boost::mutex> g(mutex_); return maxRunning_; }
+   int MaxRunningOnPort(size_t port)
+   { boost::lock_guard<boost::mutex> g(mutex_); return maxRunningOnPort_[port]; }
+   int Probes() { boost::lock_guard<boost::mutex> g(mutex_); return probes_; }
+
+private:
+   void Detect(const std::vector<Device>* devices, std::vector<long>* results,
+         size_t index)
+   {
+      const Device& device = (*devices)[index];
+      const std::string port = ports_[device.port]->SlaveName();
+      mm::DetectionCacheEntry entry;
+      if (cache_.Lookup(device.module, device.name, port, device.fingerprint,
+               entry))
+      {
+         (*results)[index] = entry.status;
+         return;
+      }
+
+      {
+         boost::lock_guard<boost::mutex> g(mutex_);
+         ++probes_;
+         maxRunning_ = std::max(maxRunning_, ++running_);
+         maxRunningOnPort_[device.port] = std::max(
+               maxRunningOnPort_[device.port], ++runningOnPort_[device.port]);
+      }
+      const bool found = ports_[device.port]->Query('?', 3, 300);
+      {
+         boost::lock_guard<boost::mutex> g(mutex_);
+         --running_;
+         --runningOnPort_[device.port];
+      }
+
+      entry.fingerprint = device.fingerprint;
+      entry.status = found ? MM::CanCommunicate : MM::CanNotCommunicate;
+      std::string error;
+      cache_.Store(device.module, device.name, port, entry, error);
+      (*results)[index] = entry.status;
+   }
+
+   mm::DetectionCache& cache_;
+   std::vector<PtyPort*>& ports_;
+   boost::mutex mutex_;
+   int running_;
+   int maxRunning_;
+   std::map<size_t, int> runningOnPort_;
+   std::map<size_t, int> maxRunningOnPort_;
+   int probes_;
+};
+
+PtyDetection::Device MakeDevice(const char* module, const char* name,
+      size_t port, const char* fingerprint)
+{
+   PtyDetection::Device device;
+   device.module = module;
+   device.name = name;
+   device.port = port;
+   device.fingerprint = fingerprint;
+   return device;
+}
+
+} // anonymous namespace
+
+
+TEST(DetectionCacheTests, ClosedCacheStoresNothing)
+{
+   mm::DetectionCache cache;
+   std::string error;
+   EXPECT_FALSE(cache.IsOpen());
+   EXPECT_TRUE(cache.Store("Arduino", "Arduino-Hub", "/dev/ttyACM0",
+            Entry("usb-1", MM::CanCommunicate), error));
+   mm::DetectionCacheEntry found;
+   EXPECT_FALSE(cache.Lookup("Arduino", "Arduino-Hub", "/dev/ttyACM0",
+            "usb-1", found));
+}
+
+TEST(DetectionCacheTests, EntriesPersistUntilFingerprintChanges)
+{
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   std::string error;
+   {
+      mm::DetectionCache cache;
+      ASSERT_TRUE(cache.Open(path, error)) << error;
+      mm::DetectionCacheEntry entry = Entry("usb-Arduino_123", MM::CanCommunicate);
+      entry.portSettings.push_back(std::make_pair("BaudRate", "57600"));
+      entry.portSettings.push_back(std::make_pair("AnswerTimeout", "500.0"));
+      ASSERT_TRUE(cache.Store("Arduino", "Arduino-Hub", "/dev/ttyACM0",
+               entry, error)) << error;
+      ASSERT_TRUE(cache.Store("ASITiger", "TigerCommHub", "/dev/ttyUSB0",
+               Entry("usb-FTDI_9", MM::CanNotCommunicate), error)) << error;
+   }
+
+   mm::DetectionCache cache;
+   ASSERT_TRUE(cache.Open(path, error)) << error;
+   mm::DetectionCacheEntry found;
+   ASSERT_TRUE(cache.Lookup("Arduino", "Arduino-Hub", "/dev/ttyACM0",
+            "usb-Arduino_123", found));
+   EXPECT_EQ(MM::CanCommunicate, found.status);
+   ASSERT_EQ(2u, found.portSettings.size());
+   EXPECT_EQ("BaudRate", found.portSettings[0].first);
+   EXPECT_EQ("57600", found.portSettings[0].second);
+
+   // Devices that were not found are probed again
+   EXPECT_FALSE(cache.Lookup("ASITiger", "TigerCommHub", "/dev/ttyUSB0",
+            "usb-FTDI_9", found));
+
+   // Different hardware on the port, or a different port
+   EXPECT_FALSE(cache.Lookup("Arduino", "Arduino-Hub", "/dev/ttyACM0",
+            "usb-Arduino_456", found));
+   EXPECT_FALSE(cache.Lookup("Arduino", "Arduino-Hub", "/dev/ttyACM1",
+            "usb-Arduino_123", found));
+
+   ASSERT_TRUE(cache.Clear(error));
+   EXPECT_FALSE(cache.Lookup("Arduino", "Arduino-Hub", "/dev/ttyACM0",
+            "usb-Arduino_123", found));
+   cache.Close();
+   std::remove(path.c_str());
+}
+
+TEST(DetectionCacheTests, FieldsAreEscaped)
+{
+   const std::string odd = "a\tb\\c\nd\re";
+   EXPECT_EQ(odd, mm::DetectionCache::Unescape(mm::DetectionCache::Escape(odd)));
+   EXPECT_EQ(std::string::npos, mm::DetectionCache::Escape(odd).find('\t'));
+
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   std::string error;
+   {
+      mm::DetectionCache cache;
+      ASSERT_TRUE(cache.Open(path, error));
+      ASSERT_TRUE(cache.Store("Mod\tule", "Dev", "COM1",
+               Entry(odd, MM::CanCommunicate), error));
+   }
+   mm::DetectionCache cache;
+   ASSERT_TRUE(cache.Open(path, error));
+   mm::DetectionCacheEntry found;
+   EXPECT_TRUE(cache.Lookup("Mod\tule", "Dev", "COM1", odd, found));
+   cache.Close();
+   std::remove(path.c_str());
+}
+
+TEST(DetectionCacheTests, MalformedLinesAreSkipped)
+{
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   {
+      std::ofstream file(path.c_str());
+      file << "# comment\n"
+         << "too\tfew\tfields\n"
+         << "Mod\tDev\tCOM1\tfp\tnot-a-number\n"
+         << "Mod\tDev\tCOM2\tfp\t1\tBaudRate\n" // Setting without value
+         << "Mod\tDev\tCOM3\tfp\t1\tBaudRate\t9600\r\n";
+   }
+   mm::DetectionCache cache;
+   std::string error;
+   ASSERT_TRUE(cache.Open(path, error));
+   mm::DetectionCacheEntry found;
+   EXPECT_FALSE(cache.Lookup("Mod", "Dev", "COM1", "fp", found));
+   EXPECT_FALSE(cache.Lookup("Mod", "Dev", "COM2", "fp", found));
+   ASSERT_TRUE(cache.Lookup("Mod", "Dev", "COM3", "fp", found));
+   ASSERT_EQ(1u, found.portSettings.size());
+   EXPECT_EQ("9600", found.portSettings[0].second);
+   cache.Close();
+   std::remove(path.c_str());
+}
+
+TEST(DetectionCacheTests, GroupsShareNoResources)
+{
+   std::vector< std::vector<std::string> > resources;
+   resources.push_back(Resources("module:Arduino", "port:COM1")); // 0
+   resources.push_back(Resources("module:ASITiger", "port:COM2")); // 1
+   resources.push_back(Resources("module:Zaber", "port:COM3")); // 2
+   resources.push_back(Resources("module:Arduino", "port:COM4")); // 3
+   resources.push_back(Resources("module:Demo")); // 4
+   resources.push_back(Resources("module:Zaber2", "port:COM2")); // 5
+
+   const std::vector< std::vector<size_t> > groups =
+      mm::GroupIndependentDetections(resources);
+   ASSERT_EQ(4u, groups.size());
+   ASSERT_EQ(2u, groups[0].size());
+   EXPECT_EQ(0u, groups[0][0]);
+   EXPECT_EQ(3u, groups[0][1]);
+   ASSERT_EQ(2u, groups[1].size());
+   EXPECT_EQ(1u, groups[1][0]);
+   EXPECT_EQ(5u, groups[1][1]);
+   ASSERT_EQ(1u, groups[2].size());
+   EXPECT_EQ(2u, groups[2][0]);
+   ASSERT_EQ(1u, groups[3].size());
+   EXPECT_EQ(4u, groups[3][0]);
+
+   // Chains join transitively
+   resources.push_back(Resources("port:COM3", "port:COM4"));
+   EXPECT_EQ(3u, mm::GroupIndependentDetections(resources).size());
+
+   EXPECT_TRUE(mm::GroupIndependentDetections(
+            std::vector< std::vector<std::string> >()).empty());
+}
+
+TEST(DetectionCacheTests, DetectionsRunInParallelAndFoundDevicesAreCached)
+{
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   std::string error;
+   mm::DetectionCache cache;
+   ASSERT_TRUE(cache.Open(path, error)) << error;
+
+   PtyPort port0, port1, port2;
+   ASSERT_TRUE(port0.IsOpen() && port1.IsOpen() && port2.IsOpen());
+   std::vector<PtyPort*> ports;
+   ports.push_back(&port0);
+   ports.push_back(&port1);
+   ports.push_back(&port2);
+   // Nothing answers on port 2
+   FirmwareSimulator device0(port0.SlaveName(), 100);
+   FirmwareSimulator device1(port1.SlaveName(), 100);
+
+   std::vector<PtyDetection::Device> devices;
+   devices.push_back(MakeDevice("ModuleA", "HubA", 0, "usb-0"));
+   devices.push_back(MakeDevice("ModuleB", "HubB", 0, "usb-0"));
+   devices.push_back(MakeDevice("ModuleC", "HubC", 1, "usb-1"));
+   devices.push_back(MakeDevice("ModuleD", "HubD", 2, "usb-2"));
+
+   {
+      PtyDetection detection(cache, ports);
+      const std::vector<long> results = detection.Run(devices);
+      EXPECT_EQ(MM::CanCommunicate, results[0]);
+      EXPECT_EQ(MM::CanCommunicate, results[1]);
+      EXPECT_EQ(MM::CanCommunicate, results[2]);
+      EXPECT_EQ(MM::CanNotCommunicate, results[3]);
+      EXPECT_EQ(4, detection.Probes());
+      // Ports are probed in parallel, each by one device at a time
+      EXPECT_LE(2, detection.MaxRunning());
+      EXPECT_EQ(1, detection.MaxRunningOnPort(0));
+   }
+   EXPECT_EQ(2, device0.Queries());
+   EXPECT_EQ(1, device1.Queries());
+
+   // Found devices are not probed again; the missing one is
+   {
+      PtyDetection detection(cache, ports);
+      const std::vector<long> results = detection.Run(devices);
+      EXPECT_EQ(MM::CanCommunicate, results[0]);
+      EXPECT_EQ(MM::CanCommunicate, results[2]);
+      EXPECT_EQ(MM::CanNotCommunicate, results[3]);
+      EXPECT_EQ(1, detection.Probes());
+   }
+   EXPECT_EQ(2, device0.Queries());
+   EXPECT_EQ(1, device1.Queries());
+
+   // Other hardware on a port
+   devices[2].fingerprint = "usb-1b";
+   {
+      PtyDetection detection(cache, ports);
+      detection.Run(devices);
+      EXPECT_EQ(2, detection.Probes());
+   }
+   EXPECT_EQ(2, device1.Queries());
+
+   cache.Close();
+   std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
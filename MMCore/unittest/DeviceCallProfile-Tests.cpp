@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+
+#include "DeviceCallProfile.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+// Stands in for a raw device
+class FakeDevice
+{
+public:
+   FakeDevice() : calls(0) {}
+   int Snap() { return ++calls; }
+   int SetPosition(double) { return ++calls; }
+   int SetPosition(long) { return ++calls; }
+   int calls;
+};
+
+// Stands in for a DeviceInstance wrapper
+class FakeInstance
+{
+public:
+   mm::ProfiledCall<FakeDevice> ProfiledImpl(const char* method)
+   { return mm::ProfiledCall<FakeDevice>(&device_, profile_, method); }
+
+   int Snap() { return ProfiledImpl(__func__)->Snap(); }
+   int SetPosition(double pos) { return ProfiledImpl(__func__)->SetPosition(pos); }
+   int SetPosition(long steps) { return ProfiledImpl(__func__)->SetPosition(steps); }
+
+   FakeDevice device_;
+   mm::DeviceCallProfile profile_;
+};
+
+const mm::DeviceCallProfile::MethodSnapshot* Find(
+      const std::vector<mm::DeviceCallProfile::MethodSnapshot>& methods,
+      const std::string& name)
+{
+   for (std::size_t i = 0; i < methods.size(); ++i)
+      if (methods[i].method == name)
+         return &methods[i];
+   return 0;
+}
+
+void CallManyTimes(FakeInstance* instance, int count)
+{
+   for (int i = 0; i < count; ++i)
+      instance->Snap();
+}
+
+} // anonymous namespace
+
+
+TEST(LatencyHistogramTests, BucketsCoverAllDurations)
+{
+   using mm::LatencyHistogram;
+   for (unsigned i = 0; i + 1 < LatencyHistogram::BucketCount; ++i)
+   {
+      const unsigned long long lower = LatencyHistogram::BucketLowerBound(i);
+      const unsigned long long next = LatencyHistogram::BucketLowerBound(i + 1);
+      ASSERT_LT(lower, next);
+      EXPECT_EQ(i, LatencyHistogram::BucketIndex(lower));
+      EXPECT_EQ(i, LatencyHistogram::BucketIndex(next - 1));
+      // At most a quarter of the lower bound wide
+      EXPECT_LE(4 * (next - lower), lower < 4 ? 4 : lower);
+   }
+   EXPECT_EQ(LatencyHistogram::BucketCount - 1,
+         LatencyHistogram::BucketIndex(~0ULL));
+}
+
+TEST(LatencyHistogramTests, StatisticsAndPercentiles)
+{
+   mm::LatencyHistogram histogram;
+   for (int i = 1; i <= 100; ++i)
+      histogram.Record(i * 1000ULL);
+   mm::LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+   EXPECT_EQ(100u, snapshot.count);
+   EXPECT_EQ(100000u, snapshot.maxNs);
+   EXPECT_DOUBLE_EQ(50500.0, snapshot.MeanNs());
+   EXPECT_NEAR(50000.0, snapshot.PercentileNs(0.5), 0.13 * 50000.0);
+   EXPECT_NEAR(99000.0, snapshot.PercentileNs(0.99), 0.13 * 99000.0);
+   EXPECT_LE(snapshot.PercentileNs(1.0), 100000.0);
+
+   histogram.Reset();
+   snapshot = histogram.GetSnapshot();
+   EXPECT_EQ(0u, snapshot.count);
+   EXPECT_EQ(0.0, snapshot.PercentileNs(0.5));
+}
+
+TEST(DeviceCallProfileTests, DisabledRecordsNothing)
+{
+   FakeInstance instance;
+   EXPECT_EQ(1, instance.Snap());
+   EXPECT_TRUE(instance.profile_.GetSnapshot().empty());
+}
+
+TEST(DeviceCallProfileTests, RecordsEachMethod)
+{
+   FakeInstance instance;
+   instance.profile_.SetEnabled(true);
+   for (int i = 0; i < 3; ++i)
+      instance.Snap();
+   instance.SetPosition(1.0);
+   instance.SetPosition(2L);
+   EXPECT_EQ(5, instance.device_.calls);
+
+   std::vector<mm::DeviceCallProfile::MethodSnapshot> methods =
+      instance.profile_.GetSnapshot();
+   ASSERT_EQ(2u, methods.size());
+   EXPECT_EQ("SetPosition", methods[0].method);
+   EXPECT_EQ("Snap", methods[1].method);
+   EXPECT_EQ(2u, methods[0].adapter.count); // Overloads together
+   EXPECT_EQ(3u, methods[1].adapter.count);
+   EXPECT_EQ(0u, methods[1].lockWait.count);
+
+   instance.profile_.Reset();
+   EXPECT_TRUE(instance.profile_.GetSnapshot().empty());
+   instance.Snap();
+   methods = instance.profile_.GetSnapshot();
+   ASSERT_EQ(1u, methods.size());
+   EXPECT_EQ(1u, methods[0].adapter.count);
+}
+
+TEST(DeviceCallProfileTests, LockWaitGoesToFirstCallUnderGuard)
+{
+   FakeInstance instance;
+   FakeInstance other;
+   instance.profile_.SetEnabled(true);
+   other.profile_.SetEnabled(true);
+   {
+      mm::LockWaitTimer wait(instance.profile_);
+      wait.LockAcquired();
+      other.Snap(); // Another device's call does not take the wait
+      instance.SetPosition(1.0);
+      instance.Snap();
+   }
+   instance.Snap(); // Outside the guard
+
+   std::vector<mm::DeviceCallProfile::MethodSnapshot> methods =
+      instance.profile_.GetSnapshot();
+   ASSERT_TRUE(Find(methods, "SetPosition") != 0);
+   EXPECT_EQ(1u, Find(methods, "SetPosition")->lockWait.count);
+   EXPECT_EQ(0u, Find(methods, "Snap")->lockWait.count);
+   EXPECT_EQ(0u, Find(other.profile_.GetSnapshot(), "Snap")->lockWait.count);
+
+   // A guard without calls leaves nothing behind
+   {
+      mm::LockWaitTimer wait(instance.profile_);
+      wait.LockAcquired();
+   }
+   instance.Snap();
+   EXPECT_EQ(0u, Find(instance.profile_.GetSnapshot(), "Snap")->lockWait.count);
+}
+
+TEST(DeviceCallProfileTests, ConcurrentRecording)
+{
+   FakeInstance instance;
+   instance.profile_.SetEnabled(true);
+   const int threads = 4, calls = 10000;
+   boost::thread_group group;
+   for (int t = 0; t < threads; ++t)
+      group.create_thread(boost::bind(CallManyTimes, &instance, calls));
+   group.join_all();
+   const std::vector<mm::DeviceCallProfile::MethodSnapshot> methods =
+      instance.profile_.GetSnapshot();
+   ASSERT_EQ(1u, methods.size());
+   EXPECT_EQ(static_cast<unsigned long long>(threads * calls),
+         methods[0].adapter.count);
+}
+
+TEST(DeviceCallProfileTests, WritesTable)
+{
+   FakeInstance instance;
+   instance.profile_.SetEnabled(true);
+   instance.Snap();
+   std::ostringstream out;
+   mm::DeviceCallProfile::WriteHeader(out);
+   mm::DeviceCallProfile::Write(out, "Cam", instance.profile_.GetSnapshot());
+
+   std::istringstream in(out.str());
+   std::string header, adapter, lockWait, extra;
+   ASSERT_TRUE(std::getline(in, header));
+   ASSERT_TRUE(std::getline(in, adapter));
+   ASSERT_TRUE(std::getline(in, lockWait));
+   EXPECT_FALSE(std::getline(in, extra));
+   EXPECT_EQ(0u, header.find("Device\tMethod\tTiming\tCount"));
+   EXPECT_EQ(0u, adapter.find("Cam\tSnap\tAdapter\t1\t"));
+   EXPECT_NE(std::string::npos, adapter.find(":1"));
+   EXPECT_EQ(0u, lockWait.find("Cam\tSnap\tLockWait\t0\t"));
+}
+
+// Cost per call of the wrappers with profiling disabled and enabled
+TEST(DeviceCallProfileTests, Benchmark)
+{
+   FakeInstance instance;
+   const int calls = 1000000;
+   for (int enabled = 0; enabled < 2; ++enabled)
+   {
+      instance.profile_.SetEnabled(enabled != 0);
+      const unsigned long long t0 = mm::DeviceCallProfile::NowNs();
+      CallManyTimes(&instance, calls);
+      const unsigned long long t1 = mm::DeviceCallProfile::NowNs();
+      std::cout << "Profiling " << (enabled ? "enabled" : "disabled") <<
+         ": " << static_cast<double>(t1 - t0) / calls << " ns/call\n";
+   }
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,252 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+#include "DiskStream.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <ftw.h>
+#include <sys/stat.h>
+
+
+namespace
+{
+
+std::string MakeTempDir()
+{
+   const char* tmp = std::getenv("TMPDIR");
+   std::string pattern = std::string(tmp ? tmp : "/tmp") + "/DiskStream-Tests-XXXXXX";
+   std::vector<char> name(pattern.begin(), pattern.end());
+   name.push_back('\0');
+   return mkdtemp(&name[0]) ? std::string(&name[0]) : std::string();
+}
+
+int RemoveEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+   return std::remove(path);
+}
+
+void RemoveDir(const std::string& dir)
+{
+   nftw(dir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+long long FileSize(const std::string& path)
+{
+   struct stat st;
+   if (stat(path.c_str(), &st) != 0)
+      return -1;
+   return st.st_size;
+}
+
+mm::DiskStreamSettings Settings(const std::string& dir)
+{
+   mm::DiskStreamSettings settings;
+   settings.directory = dir;
+   settings.writerThreads = 2;
+   return settings;
+}
+
+} // anonymous namespace
+
+
+TEST(DiskStreamTests, DisabledWritesNothing)
+{
+   mm::DiskStream stream;
+   std::vector<unsigned char> frame(64 * 64);
+   std::string error;
+   EXPECT_TRUE(stream.Write("Cam", &frame[0], 64, 64, 1, 1, error));
+   EXPECT_TRUE(stream.KeepsImagesInBuffer());
+   EXPECT_EQ(0u, stream.GetFramesWritten());
+   EXPECT_EQ("", stream.GetSessionPath());
+}
+
+TEST(DiskStreamTests, WritesEachCameraToItsOwnFiles)
+{
+   const std::string dir = MakeTempDir();
+   ASSERT_FALSE(dir.empty());
+   mm::DiskStream stream;
+   stream.SetSettings(Settings(dir));
+   stream.SetEnabled(true);
+
+   const unsigned width = 512, height = 512;
+   std::vector<unsigned char> frame(width * height * 2, 7);
+   std::string error;
+   for (int i = 0; i < 10; ++i)
+   {
+      ASSERT_TRUE(stream.Write("Cam 1", &frame[0], width, height, 2, 1, error)) << error;
+      if (i % 2 == 0)
+      {
+         ASSERT_TRUE(stream.Write("Cam2", &frame[0], width, height, 2, 1, error)) << error;
+      }
+   }
+   const std::string session = stream.GetSessionPath();
+   EXPECT_EQ(0u, session.find(dir));
+
+   ASSERT_TRUE(stream.Finish("Cam 1", error));
+   ASSERT_TRUE(stream.Finish("Cam2", error));
+   EXPECT_EQ(15u, stream.GetFramesWritten());
+   EXPECT_EQ(10LL * width * height * 2, FileSize(session + "Cam_1_00000.raw"));
+   EXPECT_EQ(5LL * width * height * 2, FileSize(session + "Cam2_00000.raw"));
+
+   std::ifstream hints((session + "Cam_1_import_imagej.txt").c_str());
+   std::string text((std::istreambuf_iterator<char>(hints)),
+         std::istreambuf_iterator<char>());
+   EXPECT_NE(std::string::npos, text.find("16-bit Unsigned"));
+   EXPECT_NE(std::string::npos, text.find("Width: 512 pixels"));
+
+   // The next acquisition starts a new session
+   ASSERT_TRUE(stream.Write("Cam 1", &frame[0], width, height, 2, 1, error));
+   EXPECT_NE(session, stream.GetSessionPath());
+   stream.SetEnabled(false);
+   EXPECT_EQ(1u, stream.GetFramesWritten());
+   EXPECT_EQ(width * height * 2, FileSize(stream.GetSessionPath() + "Cam_1_00000.raw"));
+   RemoveDir(dir);
+}
+
+TEST(DiskStreamTests, ImageSizeChangeIsAnError)
+{
+   const std::string dir = MakeTempDir();
+   ASSERT_FALSE(dir.empty());
+   mm::DiskStream stream;
+   stream.SetSettings(Settings(dir));
+   stream.SetEnabled(true);
+
+   std::vector<unsigned char> frame(128 * 128);
+   std::string error;
+   ASSERT_TRUE(stream.Write("Cam", &frame[0], 128, 128, 1, 1, error));
+   EXPECT_FALSE(stream.Write("Cam", &frame[0], 64, 64, 1, 1, error));
+   EXPECT_FALSE(error.empty());
+   stream.FinishAll();
+   RemoveDir(dir);
+}
+
+TEST(DiskStreamTests, MissingDirectoryIsAnError)
+{
+   mm::DiskStream stream;
+   mm::DiskStreamSettings settings = Settings("");
+   stream.SetSettings(settings);
+   stream.SetEnabled(true);
+   std::vector<unsigned char> frame(16);
+   std::string error;
+   EXPECT_FALSE(stream.Write("Cam", &frame[0], 4, 4, 1, 1, error));
+   EXPECT_FALSE(error.empty());
+}
+
+TEST(DiskStreamTests, CamerasWriteConcurrentlyWithFinish)
+{
+   const std::string dir = MakeTempDir();
+   ASSERT_FALSE(dir.empty());
+   mm::DiskStream stream;
+   stream.SetSettings(Settings(dir));
+   stream.SetEnabled(true);
+
+   const unsigned width = 256, height = 256;
+   const int frames = 200;
+   std::vector<unsigned char> frame(width * height, 5);
+   bool ok[2] = { true, true };
+   boost::thread_group writers;
+   for (int c = 0; c < 2; ++c)
+   {
+      writers.create_thread([&, c]() {
+         const std::string camera = c == 0 ? "Cam1" : "Cam2";
+         std::string error;
+         for (int i = 0; i < frames; ++i)
+            ok[c] = stream.Write(camera, &frame[0], width, height, 1, 1, error) && ok[c];
+      });
+   }
+   // Finishing while frames arrive starts a new stream with the next frame
+   std::string error;
+   for (int i = 0; i < 20; ++i)
+      EXPECT_TRUE(stream.Finish("Cam1", error)) << error;
+   writers.join_all();
+   EXPECT_TRUE(ok[0]);
+   EXPECT_TRUE(ok[1]);
+
+   stream.FinishAll();
+   EXPECT_LE(static_cast<unsigned long long>(frames), stream.GetFramesWritten());
+   RemoveDir(dir);
+}
+
+TEST(DiskStreamTests, BypassedFramesAreCounted)
+{
+   CircularBuffer buffer(10);
+   ASSERT_TRUE(buffer.Initialize(1, 4, 4, 1));
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   for (int i = 0; i < 3; ++i)
+      buffer.AccountForBypassedFrame(&md);
+   EXPECT_EQ(3, buffer.GetFrameCounts("Cam").received);
+   EXPECT_EQ(0L, buffer.GetRemainingImageCount());
+}
+
+// Per-frame cost of streaming to disk compared with inserting into the
+// circular buffer, for 4 MP 16-bit frames. Writes to TMPDIR (or /tmp), so
+// set that to the disk of interest.
+TEST(DiskStreamTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const unsigned width = 2048, height = 2048, bytesPerPixel = 2;
+   const double frameMB = width * height * bytesPerPixel / 1e6;
+   const int frames = 100;
+   std::vector<unsigned char> frame(width * height * bytesPerPixel, 3);
+
+   {
+      CircularBuffer buffer(1000);
+      ASSERT_TRUE(buffer.Initialize(1, width, height, bytesPerPixel));
+      Metadata md;
+      md.PutImageTag("Camera", "Cam");
+      const ptime t0 = microsec_clock::universal_time();
+      for (int i = 0; i < frames; ++i)
+      {
+         if (buffer.GetRemainingImageCount() >= buffer.GetSize())
+            buffer.Clear();
+         ASSERT_TRUE(buffer.InsertImage(&frame[0], width, height, bytesPerPixel, &md));
+      }
+      const ptime t1 = microsec_clock::universal_time();
+      const double us = static_cast<double>((t1 - t0).total_microseconds());
+      std::cout << "Circular buffer insertion: " <<
+         (us > 0.0 ? frames * frameMB * 1e6 / us : 0.0) << " MB/s\n";
+   }
+
+   const unsigned threadCounts[] = { 1, 2, 4 };
+   for (int t = 0; t < 3; ++t)
+   {
+      const std::string dir = MakeTempDir();
+      ASSERT_FALSE(dir.empty());
+      mm::DiskStream stream;
+      mm::DiskStreamSettings settings = Settings(dir);
+      settings.writerThreads = threadCounts[t];
+      stream.SetSettings(settings);
+      stream.SetEnabled(true);
+
+      std::string error;
+      const ptime t0 = microsec_clock::universal_time();
+      for (int i = 0; i < frames; ++i)
+         ASSERT_TRUE(stream.Write("Cam", &frame[0], width, height, bytesPerPixel, 1, error)) << error;
+      ASSERT_TRUE(stream.Finish("Cam", error)) << error;
+      const ptime t1 = microsec_clock::universal_time();
+      const double us = static_cast<double>((t1 - t0).total_microseconds());
+      std::cout << "Streaming to disk, " << threadCounts[t] << " writer threads: " <<
+         (us > 0.0 ? frames * frameMB * 1e6 / us : 0.0) << " MB/s\n";
+      EXPECT_EQ(static_cast<unsigned long long>(frames), stream.GetFramesWritten());
+      RemoveDir(dir);
+   }
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+
+#include <boost/lexical_cast.hpp>
+
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const unsigned width = 64, height = 48;
+
+// Inserts a frame with the given hardware frame number and timestamp;
+// negative values are omitted from the metadata
+bool InsertFrame(CircularBuffer& buffer, const std::string& camera,
+      long frameNumber, double timestampUs)
+{
+   std::vector<unsigned char> image(width * height);
+   Metadata md;
+   md.PutImageTag("Camera", camera);
+   if (frameNumber >= 0)
+      md.PutImageTag(MM::g_Keyword_Metadata_HardwareFrameNumber, frameNumber);
+   if (timestampUs >= 0.0)
+      md.PutImageTag(MM::g_Keyword_Metadata_HardwareTimestamp_us, timestampUs);
+   return buffer.InsertImage(&image[0], width, height, 1, &md);
+}
+
+std::string TopTag(const CircularBuffer& buffer, const char* key)
+{
+   const mm::ImgBuffer* img = buffer.GetNthFromTopImageBuffer(0, 0);
+   if (!img)
+      return "no image";
+   Metadata md = img->GetMetadata();
+   if (!md.HasTag(key))
+      return "no tag";
+   return md.GetSingleTag(key).GetValue();
+}
+
+} // anonymous namespace
+
+
+TEST(FrameAccountingTests, NoHardwareCounter)
+{
+   CircularBuffer buffer(10);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   for (int i = 0; i < 5; ++i)
+      ASSERT_TRUE(InsertFrame(buffer, "Cam", -1, -1.0));
+
+   const FrameCounts counts = buffer.GetFrameCounts("Cam");
+   EXPECT_EQ(5, counts.received);
+   EXPECT_EQ(0, counts.droppedByDevice);
+   EXPECT_EQ(0, counts.late);
+   EXPECT_EQ("0", TopTag(buffer, MM::g_Keyword_Metadata_FramesDroppedByBuffer));
+   EXPECT_EQ("no tag", TopTag(buffer, MM::g_Keyword_Metadata_FrameGap));
+   EXPECT_EQ("no tag", TopTag(buffer, MM::g_Keyword_Metadata_FrameLate));
+}
+
+TEST(FrameAccountingTests, DetectsFrameCounterGaps)
+{
+   CircularBuffer buffer(10);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   const long frameNumbers[] = { 10, 11, 12, 15, 16, 20 };
+   for (int i = 0; i < 6; ++i)
+   {
+      ASSERT_TRUE(InsertFrame(buffer, "Cam", frameNumbers[i], -1.0));
+      if (frameNumbers[i] == 15)
+      {
+         EXPECT_EQ("2", TopTag(buffer, MM::g_Keyword_Metadata_FrameGap));
+      }
+      if (frameNumbers[i] == 16)
+      {
+         EXPECT_EQ("0", TopTag(buffer, MM::g_Keyword_Metadata_FrameGap));
+      }
+   }
+   EXPECT_EQ("3", TopTag(buffer, MM::g_Keyword_Metadata_FrameGap));
+   EXPECT_EQ("5", TopTag(buffer, MM::g_Keyword_Metadata_FramesDroppedByDevice));
+
+   const FrameCounts counts = buffer.GetFrameCounts("Cam");
+   EXPECT_EQ(6, counts.received);
+   EXPECT_EQ(5, counts.droppedByDevice);
+   EXPECT_EQ(0, counts.discontinuities);
+}
+
+TEST(FrameAccountingTests, DetectsLateFrames)
+{
+   CircularBuffer buffer(10);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 0, 0.0));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 1, 1000.0));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 2, 2010.0));
+   EXPECT_EQ("0", TopTag(buffer, MM::g_Keyword_Metadata_FrameLate));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 3, 5000.0));
+   EXPECT_EQ("1", TopTag(buffer, MM::g_Keyword_Metadata_FrameLate));
+   // A long interval explained by dropped frames is not late
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 6, 8100.0));
+   EXPECT_EQ("0", TopTag(buffer, MM::g_Keyword_Metadata_FrameLate));
+   EXPECT_EQ("1", TopTag(buffer, MM::g_Keyword_Metadata_FramesLate));
+
+   const FrameCounts counts = buffer.GetFrameCounts("Cam");
+   EXPECT_EQ(1, counts.late);
+   EXPECT_EQ(2, counts.droppedByDevice);
+}
+
+TEST(FrameAccountingTests, DetectsDiscontinuities)
+{
+   CircularBuffer buffer(10);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 100, 5000.0));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 101, 6000.0));
+   // Camera restarted its counter and clock
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 0, 0.0));
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 1, 1000.0));
+   // Clock jumped backwards
+   ASSERT_TRUE(InsertFrame(buffer, "Cam", 2, 500.0));
+
+   const FrameCounts counts = buffer.GetFrameCounts("Cam");
+   EXPECT_EQ(2, counts.discontinuities);
+   EXPECT_EQ(0, counts.droppedByDevice);
+   EXPECT_EQ(0, counts.late);
+}
+
+TEST(FrameAccountingTests, CountsBufferOverflowPerCamera)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   long inserted = 0;
+   while (InsertFrame(buffer, "CamA", inserted, -1.0))
+   {
+      ++inserted;
+      ASSERT_LT(inserted, 100000);
+   }
+   EXPECT_FALSE(InsertFrame(buffer, "CamA", inserted + 1, -1.0));
+
+   FrameCounts counts = buffer.GetFrameCounts("CamA");
+   EXPECT_EQ(inserted + 2, counts.received);
+   EXPECT_EQ(2, counts.droppedByBuffer);
+   EXPECT_EQ(0, counts.droppedByDevice);
+   EXPECT_EQ(0, buffer.GetFrameCounts("CamB").received);
+
+   // Clearing does not reset the totals; initializing (at the start of a
+   // sequence acquisition) does
+   buffer.Clear();
+   EXPECT_EQ(2, buffer.GetFrameCounts("CamA").droppedByBuffer);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   counts = buffer.GetFrameCounts("CamA");
+   EXPECT_EQ(0, counts.received);
+   EXPECT_EQ(0, counts.droppedByBuffer);
+
+   // The next frame records the drops seen by this camera since then
+   ASSERT_TRUE(InsertFrame(buffer, "CamB", 0, -1.0));
+   EXPECT_EQ("0", TopTag(buffer, MM::g_Keyword_Metadata_FramesDroppedByBuffer));
+}
+
+// What CCameraBase::InsertImage() does when not stopping on overflow: clear
+// the buffer and insert the frame again
+bool InsertOrClear(CircularBuffer& buffer, const std::string& camera,
+      long frameNumber)
+{
+   if (InsertFrame(buffer, camera, frameNumber, -1.0))
+      return true;
+   buffer.ClearAfterOverflow();
+   return InsertFrame(buffer, camera, frameNumber, -1.0);
+}
+
+TEST(FrameAccountingTests, OverflowClearCountsDiscardedFrames)
+{
+   CircularBuffer buffer(1);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   const long capacity = (long) buffer.GetSize();
+
+   // Frames from another camera in the buffer are accounted to it
+   ASSERT_TRUE(InsertOrClear(buffer, "CamB", 0));
+   for (long frame = 0; frame < 2 * capacity; ++frame)
+      ASSERT_TRUE(InsertOrClear(buffer, "CamA", frame));
+
+   // The full buffer is discarded when frames capacity - 1 and
+   // 2 * capacity - 1 arrive; nothing was read
+   FrameCounts counts = buffer.GetFrameCounts("CamA");
+   EXPECT_EQ(2 * capacity, counts.received);
+   EXPECT_EQ(2 * capacity - 1, counts.droppedByBuffer);
+   EXPECT_EQ(0, counts.droppedByDevice);
+   EXPECT_EQ(0, counts.discontinuities);
+   EXPECT_EQ(1, buffer.GetFrameCounts("CamB").droppedByBuffer);
+   EXPECT_EQ(1, (long) buffer.GetRemainingImageCount());
+   EXPECT_EQ(boost::lexical_cast<std::string>(2 * capacity - 1),
+         TopTag(buffer, MM::g_Keyword_Metadata_FramesDroppedByBuffer));
+
+   // Frames read before the overflow are not dropped
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+   buffer.Clear();
+   for (long frame = 0; frame < capacity; ++frame)
+      ASSERT_TRUE(InsertOrClear(buffer, "CamA", frame));
+   for (int i = 0; i < 3; ++i)
+      ASSERT_TRUE(buffer.GetNextImageBuffer(0) != 0);
+   buffer.ClearAfterOverflow();
+   EXPECT_EQ(capacity - 3, buffer.GetFrameCounts("CamA").droppedByBuffer);
+
+   // The next frame is not taken for one sent again, as none was dropped
+   ASSERT_TRUE(InsertOrClear(buffer, "CamA", capacity));
+   counts = buffer.GetFrameCounts("CamA");
+   EXPECT_EQ(capacity + 1, counts.received);
+   EXPECT_EQ(capacity - 3, counts.droppedByBuffer);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+#include "TaskSet_ImageStats.h"
+#include "ThreadPool.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+TEST(ImageStatisticsTests, MatchesDirectComputation)
+{
+   // Large enough to be split across several tasks
+   const size_t count = 2048 * 1024;
+   std::vector<boost::uint16_t> image(count);
+   std::srand(1);
+   for (size_t i = 0; i < count; ++i)
+      image[i] = static_cast<boost::uint16_t>(1000 + std::rand() % 3000);
+   image[count / 3] = 17;
+   image[count - 1] = 65535;
+
+   double sum = 0.0, sumSq = 0.0;
+   std::vector<long> histogram(4096);
+   for (size_t i = 0; i < count; ++i)
+   {
+      sum += image[i];
+      sumSq += static_cast<double>(image[i]) * image[i];
+      ++histogram[image[i] >> 4];
+   }
+   const double mean = sum / count;
+
+   TaskSet_ImageStats tasks(boost::make_shared<ThreadPool>());
+   ImageStatistics stats;
+   tasks.Compute(reinterpret_cast<const unsigned char*>(&image[0]), count, 2,
+         4096, stats);
+   EXPECT_EQ(17u, stats.min);
+   EXPECT_EQ(65535u, stats.max);
+   EXPECT_NEAR(mean, stats.mean, 1e-9 * mean);
+   EXPECT_NEAR(std::sqrt(sumSq / count - mean * mean), stats.stdDev, 1e-6);
+   EXPECT_EQ(histogram, stats.histogram);
+}
+
+TEST(ImageStatisticsTests, EightBit)
+{
+   std::vector<unsigned char> image(1000);
+   for (size_t i = 0; i < image.size(); ++i)
+      image[i] = static_cast<unsigned char>(i % 2 ? 10 : 20);
+
+   TaskSet_ImageStats tasks(boost::make_shared<ThreadPool>());
+   ImageStatistics stats;
+   tasks.Compute(&image[0], image.size(), 1, 256, stats);
+   EXPECT_EQ(10u, stats.min);
+   EXPECT_EQ(20u, stats.max);
+   EXPECT_DOUBLE_EQ(15.0, stats.mean);
+   EXPECT_DOUBLE_EQ(5.0, stats.stdDev);
+   ASSERT_EQ(256u, stats.histogram.size());
+   EXPECT_EQ(500, stats.histogram[10]);
+   EXPECT_EQ(500, stats.histogram[20]);
+}
+
+TEST(ImageStatisticsTests, StoredWithFrame)
+{
+   const unsigned width = 64, height = 32;
+   CircularBuffer buffer(1);
+   buffer.SetStatisticsEnabled(true, 4096);
+   ASSERT_TRUE(buffer.Initialize(2, width, height, 1));
+
+   // Channel 0 is all 3, channel 1 all 200
+   std::vector<unsigned char> image(2 * width * height, 3);
+   std::fill(image.begin() + width * height, image.end(), 200);
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   ASSERT_TRUE(buffer.InsertMultiChannel(&image[0], 2, width, height, 1, &md));
+
+   ImageStatistics stats;
+   ASSERT_TRUE(buffer.GetNthFromTopImageStatistics(0, 1, stats));
+   EXPECT_EQ(200u, stats.min);
+   EXPECT_EQ(200u, stats.max);
+   ASSERT_EQ(256u, stats.histogram.size()); // Limited for 8-bit images
+   EXPECT_EQ(long(width * height), stats.histogram[200]);
+   EXPECT_FALSE(buffer.GetNthFromTopImageStatistics(1, 0, stats));
+
+   const mm::ImgBuffer* img = buffer.GetTopImageBuffer(0);
+   ASSERT_TRUE(img != 0);
+   EXPECT_EQ("3", img->GetMetadata().GetSingleTag("PixelMax").GetValue());
+   EXPECT_EQ(3.0, boost::lexical_cast<double>(
+            img->GetMetadata().GetSingleTag("PixelMean").GetValue()));
+
+   buffer.SetStatisticsEnabled(false, 0);
+   EXPECT_FALSE(buffer.GetNthFromTopImageStatistics(0, 0, stats));
+   ASSERT_TRUE(buffer.InsertMultiChannel(&image[0], 2, width, height, 1, &md));
+   Metadata topMd = buffer.GetTopImageBuffer(0)->GetMetadata();
+   EXPECT_FALSE(topMd.HasTag("PixelMax"));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
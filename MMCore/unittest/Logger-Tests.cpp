@@ -56,6 +56,72 @@ TEST(LoggerTests, BasicLogStream)
 }
 
 
+namespace
+{
+
+int evaluationCount = 0;
+
+int CountEvaluation()
+{
+   return ++evaluationCount;
+}
+
+} // anonymous namespace
+
+
+TEST(LoggerTests, LevelGateSkipsDisabledEntries)
+{
+   boost::shared_ptr<LoggingCore> c =
+      boost::make_shared<LoggingCore>();
+
+   Logger lgr = c->NewLogger("mylabel");
+
+   // No sinks: nothing is enabled
+   EXPECT_FALSE(lgr.IsLevelEnabled(LogLevelFatal));
+
+   boost::shared_ptr<LogSink> sink = boost::make_shared<StdErrLogSink>();
+   sink->SetFilter(boost::make_shared<LevelFilter>(LogLevelInfo));
+   c->AddSink(sink, SinkModeSynchronous);
+   EXPECT_FALSE(lgr.IsLevelEnabled(LogLevelDebug));
+   EXPECT_TRUE(lgr.IsLevelEnabled(LogLevelInfo));
+
+   evaluationCount = 0;
+   LOG_DEBUG(lgr) << CountEvaluation();
+   EXPECT_EQ(0, evaluationCount);
+   LOG_INFO(lgr) << CountEvaluation();
+   EXPECT_EQ(1, evaluationCount);
+
+   // In an unbraced if-else, the else must bind to the caller's if
+   bool elseTaken = false;
+   if (evaluationCount == 0)
+      LOG_INFO(lgr) << CountEvaluation();
+   else
+      elseTaken = true;
+   EXPECT_TRUE(elseTaken);
+   EXPECT_EQ(1, evaluationCount);
+
+   // The level is the union over all sinks
+   boost::shared_ptr<LogSink> traceSink = boost::make_shared<StdErrLogSink>();
+   c->AddSink(traceSink, SinkModeAsynchronous);
+   EXPECT_TRUE(lgr.IsLevelEnabled(LogLevelTrace));
+   c->RemoveSink(traceSink, SinkModeAsynchronous);
+   EXPECT_FALSE(lgr.IsLevelEnabled(LogLevelDebug));
+
+   std::vector<
+      std::pair<
+         std::pair<boost::shared_ptr<LogSink>, SinkMode>,
+         boost::shared_ptr<EntryFilter>
+      >
+   > changes;
+   changes.push_back(std::make_pair(
+            std::make_pair(sink, SinkModeSynchronous),
+            boost::make_shared<LevelFilter>(LogLevelDebug)));
+   c->AtomicSetSinkFilters(changes.begin(), changes.end());
+   EXPECT_TRUE(lgr.IsLevelEnabled(LogLevelDebug));
+   EXPECT_FALSE(lgr.IsLevelEnabled(LogLevelTrace));
+}
+
+
 class LoggerTestThreadFunc
 {
    unsigned n_;
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+#include "PreviewStream.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/thread.hpp>
+
+#include <cstring>
+#include <vector>
+
+
+TEST(PreviewStreamTests, BinsToFit)
+{
+   // 16-bit ramp: value = 10 * x
+   const unsigned width = 1000, height = 600;
+   std::vector<boost::uint16_t> image(width * height);
+   for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x)
+         image[y * width + x] = static_cast<boost::uint16_t>(10 * x);
+
+   mm::PreviewSettings settings;
+   settings.maxWidth = 256;
+   settings.maxHeight = 256;
+   mm::PreviewFrame frame;
+   ASSERT_TRUE(mm::PreviewStream::Compute(
+            reinterpret_cast<const unsigned char*>(&image[0]), width, height, 2,
+            settings, frame));
+   EXPECT_EQ(4u, frame.factor);
+   EXPECT_EQ(250u, frame.width);
+   EXPECT_EQ(150u, frame.height);
+   ASSERT_EQ(250u * 150u, frame.pixels.size());
+
+   // Each preview pixel averages x = 4 * px ... 4 * px + 3
+   EXPECT_EQ(15, frame.min);
+   EXPECT_EQ(10 * 996 + 15, frame.max);
+   EXPECT_EQ(0, frame.pixels[0]);
+   EXPECT_EQ(255, frame.pixels[249]);
+   EXPECT_LT(frame.pixels[100], frame.pixels[101]);
+
+   // 250 evenly spaced values over 256 bins
+   long total = 0;
+   unsigned usedBins = 0;
+   for (size_t i = 0; i < frame.histogram.size(); ++i)
+   {
+      total += frame.histogram[i];
+      if (frame.histogram[i] > 0)
+         ++usedBins;
+   }
+   EXPECT_EQ(256u, frame.histogram.size());
+   EXPECT_EQ(250u, usedBins);
+   EXPECT_EQ(250 * 150, total);
+}
+
+TEST(PreviewStreamTests, DecimatesWithFixedRange)
+{
+   const unsigned width = 64, height = 64;
+   std::vector<unsigned char> image(width * height);
+   for (unsigned i = 0; i < image.size(); ++i)
+      image[i] = static_cast<unsigned char>((i % width) % 2 ? 200 : 50);
+
+   mm::PreviewSettings settings;
+   settings.maxWidth = 32;
+   settings.maxHeight = 32;
+   settings.binning = false;
+   settings.displayMin = 0;
+   settings.displayMax = 100;
+   mm::PreviewFrame frame;
+   ASSERT_TRUE(mm::PreviewStream::Compute(&image[0], width, height, 1,
+            settings, frame));
+   EXPECT_EQ(32u, frame.width);
+   // Every other column is skipped, leaving only the value 50
+   EXPECT_EQ(50, frame.min);
+   EXPECT_EQ(50, frame.max);
+   EXPECT_EQ(128, frame.pixels[0]);
+   EXPECT_EQ(32 * 32, frame.histogram[0]);
+
+   EXPECT_FALSE(mm::PreviewStream::Compute(&image[0], 16, 16, 4, settings,
+            frame));
+}
+
+TEST(PreviewStreamTests, FollowsCircularBuffer)
+{
+   const unsigned width = 128, height = 128;
+   CircularBuffer buffer(4);
+   ASSERT_TRUE(buffer.Initialize(1, width, height, 1));
+
+   mm::PreviewStream stream;
+   mm::PreviewSettings settings;
+   settings.maxWidth = 64;
+   settings.maxHeight = 64;
+   settings.maxRateHz = 200.0;
+   stream.SetSettings(settings);
+   stream.SetBuffer(&buffer);
+   stream.SetEnabled(true);
+
+   mm::PreviewFrame frame;
+   boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+   EXPECT_FALSE(stream.GetLatest(frame));
+
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   std::vector<unsigned char> image(width * height, 7);
+   ASSERT_TRUE(buffer.InsertImage(&image[0], width, height, 1, &md));
+   for (int i = 0; i < 200 && !stream.GetLatest(frame); ++i)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+   ASSERT_EQ(64u, frame.width);
+   EXPECT_EQ(7, frame.min);
+   EXPECT_EQ("0", frame.metadata.GetSingleTag(
+            MM::g_Keyword_Metadata_ImageNumber).GetValue());
+   const unsigned long long first = frame.sequenceNumber;
+
+   // No new preview until a new frame arrives
+   boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+   ASSERT_TRUE(stream.GetLatest(frame));
+   EXPECT_EQ(first, frame.sequenceNumber);
+
+   std::fill(image.begin(), image.end(), 9);
+   ASSERT_TRUE(buffer.InsertImage(&image[0], width, height, 1, &md));
+   for (int i = 0; i < 200 && frame.sequenceNumber == first; ++i)
+   {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      stream.GetLatest(frame);
+   }
+   EXPECT_EQ(9, frame.min);
+
+   stream.SetBuffer(0);
+   stream.SetEnabled(false);
+   EXPECT_FALSE(stream.IsEnabled());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
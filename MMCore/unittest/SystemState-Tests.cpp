@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include "MMCore.h"
+#include "SystemState.h"
+
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+
+namespace
+{
+
+std::string TempFileName()
+{
+   const char* tmp = std::getenv("TMPDIR");
+   std::string pattern = std::string(tmp ? tmp : "/tmp") + "/SystemState-Tests-XXXXXX";
+   std::vector<char> name(pattern.begin(), pattern.end());
+   name.push_back('\0');
+   const int fd = mkstemp(&name[0]);
+   if (fd < 0)
+      return std::string();
+   close(fd);
+   return std::string(&name[0]);
+}
+
+std::string ReadFile(const std::string& path)
+{
+   std::ifstream in(path.c_str());
+   std::ostringstream contents;
+   contents << in.rdbuf();
+   return contents.str();
+}
+
+// Devices whose property writes are counted. Writing the hub's Mode
+// resets the peripherals' Gain, as a hub might reinitialize them.
+class CountingDevices
+{
+public:
+   std::map<std::string, std::string> values;
+   std::vector<std::string> writes;
+
+   CountingDevices()
+   {
+      values["Hub.Mode"] = "Fast";
+      values["Camera.Gain"] = "2";
+      values["Camera.Offset"] = "10";
+      values["Stage.Speed"] = "1";
+      values["Core.Focus"] = "Stage";
+   }
+
+   mm::SystemStateCounts Apply(const std::vector<PropertySetting>& settings)
+   {
+      return mm::ApplySystemState(settings,
+            boost::bind(&CountingDevices::Rank, this, _1),
+            boost::bind(&CountingDevices::IsCurrent, this, _1),
+            boost::bind(&CountingDevices::Write, this, _1));
+   }
+
+private:
+   static std::string Key(const PropertySetting& setting)
+   { return setting.getDeviceLabel() + "." + setting.getPropertyName(); }
+
+   mm::SystemStateRank Rank(const std::string& label)
+   {
+      if (label == "Hub")
+         return mm::SystemStateRankHub;
+      if (label == "Core")
+         return mm::SystemStateRankCore;
+      return mm::SystemStateRankDevice;
+   }
+
+   bool IsCurrent(const PropertySetting& setting)
+   { return values[Key(setting)] == setting.getPropertyValue(); }
+
+   void Write(const PropertySetting& setting)
+   {
+      if (setting.getDeviceLabel() == "Missing")
+         throw CMMError("No device");
+      writes.push_back(Key(setting));
+      values[Key(setting)] = setting.getPropertyValue();
+      if (Key(setting) == "Hub.Mode")
+         values["Camera.Gain"] = "1";
+   }
+};
+
+} // anonymous namespace
+
+
+TEST(SystemStateTests, SaveWritesCachedReadWriteProperties)
+{
+   CMMCore c;
+   c.updateSystemStateCache();
+   c.setProperty("Core", "AutoShutter", "0");
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   c.saveSystemState(path.c_str());
+   const std::string saved = ReadFile(path);
+   std::remove(path.c_str());
+
+   EXPECT_NE(std::string::npos, saved.find("Property,Core,AutoShutter,0\n"));
+}
+
+TEST(SystemStateTests, LoadRestoresChangedProperties)
+{
+   CMMCore c;
+   c.updateSystemStateCache();
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   {
+      std::ofstream out(path.c_str());
+      out << "Property,Core,TimeoutMs,5000\n"; // Unchanged
+      out << "Property,Core,AutoShutter,1\n";
+   }
+
+   c.setProperty("Core", "AutoShutter", "0");
+   c.loadSystemState(path.c_str());
+   std::remove(path.c_str());
+   EXPECT_EQ("1", c.getProperty("Core", "AutoShutter"));
+   EXPECT_EQ("1", c.getPropertyFromCache("Core", "AutoShutter"));
+   EXPECT_TRUE(c.getAutoShutter());
+}
+
+TEST(SystemStateTests, LoadContinuesPastMissingDevices)
+{
+   CMMCore c;
+   c.updateSystemStateCache();
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   {
+      std::ofstream out(path.c_str());
+      out << "# Saved state\n";
+      out << "Property,Core,AutoShutter,0\n";
+      out << "Property,Blah,Position,1\n";
+   }
+   EXPECT_NO_THROW(c.loadSystemState(path.c_str()));
+   std::remove(path.c_str());
+   EXPECT_EQ("0", c.getProperty("Core", "AutoShutter"));
+}
+
+TEST(SystemStateTests, LoadRejectsMalformedLines)
+{
+   CMMCore c;
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   {
+      std::ofstream out(path.c_str());
+      out << "Property,Core,AutoShutter\n";
+   }
+   EXPECT_THROW(c.loadSystemState(path.c_str()), CMMError);
+   std::remove(path.c_str());
+   EXPECT_EQ("1", c.getProperty("Core", "AutoShutter"));
+}
+
+TEST(SystemStateTests, UnchangedPropertiesAreSkippedAndHubsApplyFirst)
+{
+   CountingDevices devices;
+   std::vector<PropertySetting> settings;
+   settings.push_back(PropertySetting("Core", "Focus", "Stage")); // Unchanged
+   settings.push_back(PropertySetting("Camera", "Gain", "2")); // Reset by Hub
+   settings.push_back(PropertySetting("Stage", "Speed", "3"));
+   settings.push_back(PropertySetting("Camera", "Offset", "10")); // Unchanged
+   settings.push_back(PropertySetting("Missing", "Position", "1"));
+   settings.push_back(PropertySetting("Hub", "Mode", "Slow"));
+
+   const mm::SystemStateCounts counts = devices.Apply(settings);
+   EXPECT_EQ(2, counts.skipped);
+   EXPECT_EQ(3, counts.written);
+   ASSERT_EQ(3u, devices.writes.size());
+   EXPECT_EQ("Hub.Mode", devices.writes[0]);
+   EXPECT_EQ("Camera.Gain", devices.writes[1]);
+   EXPECT_EQ("Stage.Speed", devices.writes[2]);
+   EXPECT_EQ("2", devices.values["Camera.Gain"]);
+
+   // Restoring again writes nothing
+   devices.writes.clear();
+   EXPECT_EQ(5, devices.Apply(settings).skipped);
+   EXPECT_TRUE(devices.writes.empty());
+}
+
+TEST(SystemStateTests, LoadReturnsSkippedCount)
+{
+   CMMCore c;
+   c.updateSystemStateCache();
+   c.setStateCacheTrusted(true);
+   const std::string path = TempFileName();
+   ASSERT_FALSE(path.empty());
+   {
+      std::ofstream out(path.c_str());
+      out << "Property,Core,TimeoutMs,5000\n"; // Unchanged
+      out << "Property,Core,AutoShutter,1\n";
+   }
+
+   c.setProperty("Core", "AutoShutter", "0");
+   EXPECT_EQ(1, c.loadSystemState(path.c_str()));
+   EXPECT_EQ(2, c.loadSystemState(path.c_str()));
+
+   // An untrusted cache is not compared with
+   c.setStateCacheTrusted(false);
+   EXPECT_EQ(0, c.loadSystemState(path.c_str()));
+   std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include "TriggerLatency.h"
+
+#include "../MMDevice/ImageMetadata.h"
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+std::string LatencyTag(const Metadata& md)
+{
+   if (!md.HasTag(MM::g_Keyword_Metadata_TriggerLatency_ms))
+      return "no tag";
+   return md.GetSingleTag(MM::g_Keyword_Metadata_TriggerLatency_ms).GetValue();
+}
+
+void SetTriggerTypes(mm::TriggerLatency& latency, const char* burstStart,
+      const char* frameStart)
+{
+   latency.SetBurstStartTriggerType("Cam", burstStart);
+   latency.SetFrameStartTriggerType("Cam", frameStart);
+}
+
+} // anonymous namespace
+
+
+TEST(TriggerLatencyTests, SoftwareFrameTriggersArePairedInOrder)
+{
+   mm::TriggerLatency latency;
+   SetTriggerTypes(latency, MM::g_TriggerType_Software, MM::g_TriggerType_Software);
+   latency.BurstPrepared("Cam", 0.0);
+   latency.BurstStartTriggerSent("Cam", 1.0);
+
+   latency.FrameStartTriggerSent("Cam", 10.0);
+   latency.FrameStartTriggerSent("Cam", 20.0);
+   Metadata md1, md2, md3;
+   latency.FrameReceived("Cam", 15.0, md1);
+   latency.FrameReceived("Cam", 27.5, md2);
+   latency.FrameReceived("Cam", 30.0, md3); // No trigger
+   EXPECT_DOUBLE_EQ(5.0, std::atof(LatencyTag(md1).c_str()));
+   EXPECT_DOUBLE_EQ(7.5, std::atof(LatencyTag(md2).c_str()));
+   EXPECT_EQ("no tag", LatencyTag(md3));
+
+   const std::vector<double> latencies = latency.GetLatencies("Cam");
+   ASSERT_EQ(2u, latencies.size());
+   EXPECT_DOUBLE_EQ(5.0, latencies[0]);
+   EXPECT_DOUBLE_EQ(7.5, latencies[1]);
+}
+
+TEST(TriggerLatencyTests, InternalFramesMeasureFirstFrameFromBurstStart)
+{
+   mm::TriggerLatency latency;
+   SetTriggerTypes(latency, MM::g_TriggerType_Software, MM::g_TriggerType_Internal);
+   latency.BurstPrepared("Cam", 0.0);
+   latency.BurstStartTriggerSent("Cam", 100.0);
+   Metadata md1, md2;
+   latency.FrameReceived("Cam", 112.0, md1);
+   latency.FrameReceived("Cam", 124.0, md2);
+   EXPECT_DOUBLE_EQ(12.0, std::atof(LatencyTag(md1).c_str()));
+   EXPECT_EQ("no tag", LatencyTag(md2));
+
+   // With an internal burst start, the burst starts when armed
+   SetTriggerTypes(latency, MM::g_TriggerType_Internal, MM::g_TriggerType_Internal);
+   latency.BurstPrepared("Cam", 200.0);
+   Metadata md3;
+   latency.FrameReceived("Cam", 203.0, md3);
+   EXPECT_DOUBLE_EQ(3.0, std::atof(LatencyTag(md3).c_str()));
+   ASSERT_EQ(1u, latency.GetLatencies("Cam").size()); // New burst
+}
+
+TEST(TriggerLatencyTests, ClearedTriggersAreNotPairedWithLaterFrames)
+{
+   mm::TriggerLatency latency;
+   SetTriggerTypes(latency, MM::g_TriggerType_Software, MM::g_TriggerType_Software);
+   latency.BurstPrepared("Cam", 0.0);
+   latency.BurstStartTriggerSent("Cam", 1.0);
+   latency.FrameStartTriggerSent("Cam", 10.0);
+   Metadata md1;
+   latency.FrameReceived("Cam", 12.0, md1);
+   latency.FrameStartTriggerSent("Cam", 20.0); // Burst aborted before frame
+
+   latency.ClearPendingTriggers("Cam");
+   Metadata md2;
+   latency.FrameReceived("Cam", 500.0, md2);
+   EXPECT_EQ("no tag", LatencyTag(md2));
+   EXPECT_EQ(1u, latency.GetLatencies("Cam").size());
+   latency.ClearPendingTriggers("Other"); // Unknown camera
+}
+
+TEST(TriggerLatencyTests, ExternalTriggersAreNotMeasured)
+{
+   mm::TriggerLatency latency;
+   SetTriggerTypes(latency, MM::g_TriggerType_External, MM::g_TriggerType_External);
+   latency.BurstPrepared("Cam", 0.0);
+   Metadata md;
+   latency.FrameReceived("Cam", 5.0, md);
+   EXPECT_EQ("no tag", LatencyTag(md));
+   EXPECT_TRUE(latency.GetLatencies("Cam").empty());
+
+   // Nor are frames of cameras never armed for a burst
+   Metadata other;
+   latency.FrameReceived("Other", 5.0, other);
+   EXPECT_EQ("no tag", LatencyTag(other));
+   EXPECT_TRUE(latency.GetLatencies("Other").empty());
+}
+
+TEST(TriggerLatencyTests, FailedTriggerIsWithdrawn)
+{
+   mm::TriggerLatency latency;
+   SetTriggerTypes(latency, MM::g_TriggerType_Internal, MM::g_TriggerType_Software);
+   latency.BurstPrepared("Cam", 0.0);
+   latency.FrameStartTriggerSent("Cam", 10.0);
+   latency.FrameStartTriggerSent("Cam", 20.0);
+   latency.TriggerFailed("Cam");
+   Metadata md1, md2;
+   latency.FrameReceived("Cam", 12.0, md1);
+   latency.FrameReceived("Cam", 22.0, md2);
+   EXPECT_DOUBLE_EQ(2.0, std::atof(LatencyTag(md1).c_str()));
+   EXPECT_EQ("no tag", LatencyTag(md2));
+}
+
+TEST(TriggerLatencyTests, KeepsLatestLatencies)
+{
+   mm::TriggerLatency latency;
+   SetTriggerTypes(latency, MM::g_TriggerType_Internal, MM::g_TriggerType_Software);
+   latency.BurstPrepared("Cam", 0.0);
+   const std::size_t count = mm::TriggerLatency::maxRecordedLatencies + 10;
+   for (std::size_t i = 0; i < count; ++i)
+   {
+      Metadata md;
+      latency.FrameStartTriggerSent("Cam", static_cast<double>(i));
+      latency.FrameReceived("Cam", i + 0.001 * i, md);
+   }
+   const std::vector<double> latencies = latency.GetLatencies("Cam");
+   ASSERT_EQ(mm::TriggerLatency::maxRecordedLatencies, latencies.size());
+   EXPECT_NEAR(0.001 * 10, latencies.front(), 1e-9);
+   EXPECT_NEAR(0.001 * (count - 1), latencies.back(), 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include "WorkerThreadBudget.h"
+
+
+TEST(WorkerThreadBudgetTests, LeasesTogetherStayWithinTotal)
+{
+   mm::WorkerThreadBudget budget(8);
+   int a, b, c;
+
+   EXPECT_EQ(8u, budget.Lease(&a));
+   EXPECT_EQ(1u, budget.Lease(&b));
+   EXPECT_EQ(9u, budget.GetLeased());
+
+   // Asking again replaces the earlier lease
+   budget.Release(&b);
+   budget.SetTotal(6);
+   EXPECT_EQ(6u, budget.Lease(&a));
+   EXPECT_EQ(6u, budget.GetLeased());
+
+   budget.Release(&a);
+   EXPECT_EQ(6u, budget.Lease(&b));
+   budget.SetTotal(10);
+   EXPECT_EQ(4u, budget.Lease(&c));
+   EXPECT_EQ(10u, budget.GetLeased());
+
+   budget.ReleaseAll();
+   EXPECT_EQ(0u, budget.GetLeased());
+   EXPECT_EQ(10u, budget.Lease(&c));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -383,6 +383,47 @@
 
 %typemap(javain) std::vector<unsigned char*> "$javainput" 
 
+
+// Map input argument: direct java.nio.ByteBuffer -> C++ const unsigned char*
+// and its size in bytes. The pixels are used in place, without copying, from
+// the buffer's position up to its limit; MMCore checks the size against the
+// SLM.
+%typemap(jni) (const unsigned char* pixelBuffer, long bufferBytes)       "jobject"
+%typemap(jtype) (const unsigned char* pixelBuffer, long bufferBytes)     "java.nio.ByteBuffer"
+%typemap(jstype) (const unsigned char* pixelBuffer, long bufferBytes)    "java.nio.ByteBuffer"
+%typemap(javain) (const unsigned char* pixelBuffer, long bufferBytes)    "$javainput"
+%typemap(in) (const unsigned char* pixelBuffer, long bufferBytes)
+{
+   void* address = $input ? JCALL1(GetDirectBufferAddress, jenv, $input) : 0;
+   if (address == 0)
+   {
+      jclass excep = jenv->FindClass("java/lang/IllegalArgumentException");
+      if (excep)
+         jenv->ThrowNew(excep, "SLM images must be passed in a direct ByteBuffer.");
+      return;
+   }
+   jclass bufferClass = jenv->FindClass("java/nio/Buffer");
+   if (bufferClass == 0)
+      return;
+   jmethodID positionMethodID = jenv->GetMethodID(bufferClass, "position", "()I");
+   jmethodID remainingMethodID = jenv->GetMethodID(bufferClass, "remaining", "()I");
+   if (positionMethodID == 0 || remainingMethodID == 0)
+      return;
+   jlong position = jenv->CallIntMethod($input, positionMethodID);
+   jlong remaining = jenv->CallIntMethod($input, remainingMethodID);
+   if (jenv->ExceptionCheck())
+      return;
+   if (position < 0 || remaining < 0 || remaining > LONG_MAX)
+   {
+      jclass excep = jenv->FindClass("java/lang/IllegalArgumentException");
+      if (excep)
+         jenv->ThrowNew(excep, "SLM image buffer is too large.");
+      return;
+   }
+   $1 = (const unsigned char*) address + position;
+   $2 = (long) remaining;
+}
+
 // Java typemap
 // change default SWIG mapping of void* return values
 // to return CObject containing array of pixel values
@@ -506,6 +547,96 @@
    }
 }
 
+// Preview images are always 8-bit, with their own size. The size is taken
+// from the returned metadata, which another thread cannot change.
+%typemap(out) void* getLatestPreview
+{
+   long lSize = std::atol(arg2->GetSingleTag("PreviewWidth").GetValue().c_str()) *
+      std::atol(arg2->GetSingleTag("PreviewHeight").GetValue().c_str());
+   jbyteArray data = JCALL1(NewByteArray, jenv, lSize);
+   if (data == 0)
+   {
+      jclass excep = jenv->FindClass("java/lang/OutOfMemoryError");
+      if (excep)
+         jenv->ThrowNew(excep, "The system ran out of memory!");
+      $result = 0;
+      return $result;
+   }
+   JCALL4(SetByteArrayRegion, jenv, data, 0, lSize, (jbyte*)result);
+   $result = data;
+}
+
+// Image regions have their own size; 16-bit pixels are returned as short[]
+// and all others as byte[]
+%typemap(out) void* getLastImageROI
+{
+   long lSize = (arg5 / arg7) * (arg6 / arg7);
+   long bytesPerPixel = (arg1)->getBytesPerPixel();
+   if (bytesPerPixel == 2)
+   {
+      jshortArray data = JCALL1(NewShortArray, jenv, lSize);
+      if (data == 0)
+      {
+         jclass excep = jenv->FindClass("java/lang/OutOfMemoryError");
+         if (excep)
+            jenv->ThrowNew(excep, "The system ran out of memory!");
+         $result = 0;
+         return $result;
+      }
+      JCALL4(SetShortArrayRegion, jenv, data, 0, lSize, (jshort*)result);
+      $result = data;
+   }
+   else
+   {
+      jbyteArray data = JCALL1(NewByteArray, jenv, lSize * bytesPerPixel);
+      if (data == 0)
+      {
+         jclass excep = jenv->FindClass("java/lang/OutOfMemoryError");
+         if (excep)
+            jenv->ThrowNew(excep, "The system ran out of memory!");
+         $result = 0;
+         return $result;
+      }
+      JCALL4(SetByteArrayRegion, jenv, data, 0, lSize * bytesPerPixel, (jbyte*)result);
+      $result = data;
+   }
+}
+
+%typemap(out) void* popNextSubscribedROI
+{
+   long lSize = (arg1)->getImageROISubscriptionWidth(arg2) *
+      (arg1)->getImageROISubscriptionHeight(arg2);
+   long bytesPerPixel = (arg1)->getBytesPerPixel();
+   if (bytesPerPixel == 2)
+   {
+      jshortArray data = JCALL1(NewShortArray, jenv, lSize);
+      if (data == 0)
+      {
+         jclass excep = jenv->FindClass("java/lang/OutOfMemoryError");
+         if (excep)
+            jenv->ThrowNew(excep, "The system ran out of memory!");
+         $result = 0;
+         return $result;
+      }
+      JCALL4(SetShortArrayRegion, jenv, data, 0, lSize, (jshort*)result);
+      $result = data;
+   }
+   else
+   {
+      jbyteArray data = JCALL1(NewByteArray, jenv, lSize * bytesPerPixel);
+      if (data == 0)
+      {
+         jclass excep = jenv->FindClass("java/lang/OutOfMemoryError");
+         if (excep)
+            jenv->ThrowNew(excep, "The system ran out of memory!");
+         $result = 0;
+         return $result;
+      }
+      JCALL4(SetByteArrayRegion, jenv, data, 0, lSize * bytesPerPixel, (jbyte*)result);
+      $result = data;
+   }
+}
+
 // Java typemap
 // change default SWIG mapping of void* return values
 // to return CObject containing array of pixel values
@@ -900,6 +1031,9 @@
 
 
 %{
+#include <climits>
+#include <cstdlib>
+
 #include "../MMDevice/MMDeviceConstants.h"
 #include "../MMCore/Configuration.h"
 #include "../MMDevice/ImageMetadata.h"
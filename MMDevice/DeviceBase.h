@@ -1041,6 +1041,46 @@ protected:
       return DEVICE_NO_CALLBACK_REGISTERED;
    }
 
+   /**
+   * Waits until data can be read from the com port, or the timeout elapses.
+   * Returns DEVICE_UNSUPPORTED_COMMAND if the port cannot wait for data.
+   */
+   int WaitForComPortData(const char* portLabel, unsigned long timeoutMs, bool& dataAvailable)
+   {
+      if (callback_)
+         return callback_->WaitForSerialData(this, portLabel, timeoutMs, dataAvailable);
+      return DEVICE_NO_CALLBACK_REGISTERED;
+   }
+
+   /**
+   * Reads exactly length bytes from the com port, waiting up to timeoutMs
+   * for them to arrive. Returns DEVICE_SERIAL_TIMEOUT if they do not.
+   */
+   int ReadExactlyFromComPort(const char* portLabel, unsigned char* buf, unsigned long length, unsigned long timeoutMs, unsigned long& read)
+   {
+      if (callback_)
+         return callback_->ReadExactlyFromSerial(this, portLabel, buf, length, timeoutMs, read);
+      return DEVICE_NO_CALLBACK_REGISTERED;
+   }
+
+   /**
+   * Registers a callback to be notified when data arrives on the com port.
+   * It must be unsubscribed before it is destroyed.
+   */
+   int SubscribeToComPortData(const char* portLabel, MM::SerialDataCallback* callback)
+   {
+      if (callback_)
+         return callback_->SubscribeToSerialData(this, portLabel, callback);
+      return DEVICE_NO_CALLBACK_REGISTERED;
+   }
+
+   int UnsubscribeFromComPortData(const char* portLabel, MM::SerialDataCallback* callback)
+   {
+      if (callback_)
+         return callback_->UnsubscribeFromSerialData(this, portLabel, callback);
+      return DEVICE_NO_CALLBACK_REGISTERED;
+   }
+
    /**
    * Clears the serial port buffers
    */
@@ -1154,6 +1194,20 @@ protected:
       return MM::MMTime(0.0);
    }
 
+   /**
+   * Gets the number of threads to use for data-parallel work (e.g. the
+   * size of an MMThreadPool), taking this device's share of the system's
+   * budget. Returns 0, meaning one per hardware thread, if there is no
+   * callback.
+   */
+   unsigned GetWorkerThreadBudget()
+   {
+      if (callback_)
+         return callback_->GetWorkerThreadBudget(this);
+
+      return 0;
+   }
+
    /**
    * Check if we have callback mechanism set up.
    */
@@ -1508,6 +1562,100 @@ public:
       return DEVICE_UNSUPPORTED_COMMAND;
    }
 
+   /**
+    * Cameras implementing the burst API override this and the functions
+    * below.
+    */
+   virtual bool SupportsBurstAPI()
+   {
+      return false;
+   }
+
+   virtual int SetPreFrameDelay(double /* delay_ms */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetPostFrameDelay(double /* delay_ms */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetBurstStartTriggerType(const char* /* type */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetBurstEndTriggerType(const char* /* type */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetFrameStartTriggerType(const char* /* type */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetExposureEndTriggerType(const char* /* type */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int GetBurstStartTriggerType(char* /* type */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int GetFrameStartTriggerType(char* /* type */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetFrameExposureMode(const char* /* mode */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int PrepareForBurst(int /* numImages */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SendBurstStartTrigger()
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SendFrameStartTrigger()
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SendBurstEndTrigger()
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int GetRollingShutterLineOffset(double& /* offset_us */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetRollingShutterLineOffset(double /* offset_us */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int GetRollingShutterActiveLines(int& /* numLines */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int SetRollingShutterActiveLines(int /* numLines */)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
 protected:
    /////////////////////////////////////////////
    // utility methods for use by derived classes
@@ -2051,6 +2199,20 @@ class CShutterBase : public CDeviceBase<MM::Shutter, U>
 template <class U>
 class CSerialBase : public CDeviceBase<MM::Serial, U>
 {
+   virtual int WaitForData(unsigned long /*timeoutMs*/, bool& /*dataAvailable*/)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int AddDataCallback(MM::SerialDataCallback* /*callback*/)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
+
+   virtual int RemoveDataCallback(MM::SerialDataCallback* /*callback*/)
+   {
+      return DEVICE_UNSUPPORTED_COMMAND;
+   }
 };
 
 /**
@@ -2203,6 +2365,16 @@ public:
       installedDevices.clear();
    }
 
+   /**
+   * To let the Core check the busy state of all peripherals with one query,
+   * override this method to query the controller and the next one to report
+   * each peripheral's state from the reply.
+   * If not overridden, the Core calls each peripheral's Busy().
+   */
+   virtual int SnapPeripheralBusyStates() {return DEVICE_UNSUPPORTED_COMMAND;}
+
+   virtual bool GetPeripheralBusy(MM::Device* /* peripheral */, bool& /* busy */) {return false;}
+
 protected:
    void AddInstalledDevice(MM::Device* pdev) {installedDevices.push_back(pdev);}
 
@@ -2235,7 +2407,7 @@ public:
    */
    virtual int SetPosition(long pos)
    {
-      return this->SetProperty(MM::g_Keyword_State, CDeviceUtils::ConvertToString(pos));
+      return this->SetProperty(MM::g_Keyword_State, CDeviceUtils::FormatNumber(pos));
    }
 
    /**
@@ -2466,7 +2638,7 @@ public:
     */
    int OnStateChanged(long position) {
       int ret;
-      ret = this->OnPropertyChanged(MM::g_Keyword_State,CDeviceUtils::ConvertToString(position));
+      ret = this->OnPropertyChanged(MM::g_Keyword_State,CDeviceUtils::FormatNumber(position));
       if (ret != DEVICE_OK) {
          return ret;
       }
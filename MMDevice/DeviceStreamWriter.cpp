@@ -0,0 +1,405 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceStreamWriter.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMDevice - Device adapter kit
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Streaming of fixed-size frames to raw files with unbuffered,
+//                page-aligned writes
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DeviceStreamWriter.h"
+
+#include "FixSnprintf.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+   #define WIN32_LEAN_AND_MEAN
+   #include <windows.h>
+   #include <direct.h> // _mkdir
+   #include <malloc.h> // _aligned_malloc
+#else
+   #include <fcntl.h>
+   #include <sys/stat.h>
+   #include <sys/types.h>
+   #include <unistd.h>
+#endif
+
+
+// A file opened for unbuffered writes at given offsets. Closed when the last
+// pending write holding it has finished.
+class MMStreamWriter::File
+{
+public:
+   explicit File(const std::string& path)
+   {
+#ifdef _WIN32
+      handle_ = ::CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL,
+            CREATE_ALWAYS, FILE_FLAG_NO_BUFFERING, NULL);
+#else
+      const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+      const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH;
+#ifdef O_DIRECT
+      handle_ = ::open(path.c_str(), flags | O_DIRECT, mode);
+      // Some file systems (e.g. tmpfs) do not support direct I/O
+      if (handle_ < 0 && errno == EINVAL)
+         handle_ = ::open(path.c_str(), flags, mode);
+#else
+      handle_ = ::open(path.c_str(), flags, mode);
+#ifdef F_NOCACHE
+      if (handle_ >= 0)
+         ::fcntl(handle_, F_NOCACHE, 1);
+#endif
+#endif
+#endif
+   }
+
+   ~File()
+   {
+      if (!IsOpen())
+         return;
+#ifdef _WIN32
+      ::CloseHandle(handle_);
+#else
+      ::close(handle_);
+#endif
+   }
+
+   bool IsOpen() const
+   {
+#ifdef _WIN32
+      return handle_ != INVALID_HANDLE_VALUE;
+#else
+      return handle_ >= 0;
+#endif
+   }
+
+   // Safe to call from several threads at once, for distinct ranges
+   bool WriteAt(const void* data, std::size_t bytes, unsigned long long offset)
+   {
+#ifdef _WIN32
+      if (bytes > (std::numeric_limits<DWORD>::max)())
+         return false;
+      OVERLAPPED position;
+      std::memset(&position, 0, sizeof(position));
+      position.Offset = static_cast<DWORD>(offset);
+      position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+      DWORD written = 0;
+      return ::WriteFile(handle_, data, static_cast<DWORD>(bytes), &written,
+            &position) == TRUE && written == bytes;
+#else
+      const char* p = static_cast<const char*>(data);
+      while (bytes > 0)
+      {
+         const ssize_t written = ::pwrite(handle_, p, bytes,
+               static_cast<off_t>(offset));
+         if (written < 0 && errno == EINTR)
+            continue;
+         if (written <= 0)
+            return false;
+         p += written;
+         bytes -= written;
+         offset += written;
+      }
+      return true;
+#endif
+   }
+
+private:
+#ifdef _WIN32
+   HANDLE handle_;
+#else
+   int handle_;
+#endif
+};
+
+
+namespace
+{
+
+void* AllocatePageAligned(std::size_t bytes, std::size_t alignment)
+{
+#ifdef _WIN32
+   return ::_aligned_malloc(bytes, alignment);
+#else
+   void* p = 0;
+   if (::posix_memalign(&p, alignment, bytes) != 0)
+      return 0;
+   return p;
+#endif
+}
+
+void FreePageAligned(void* p)
+{
+#ifdef _WIN32
+   ::_aligned_free(p);
+#else
+   ::free(p);
+#endif
+}
+
+} // anonymous namespace
+
+
+MMStreamWriter::MMStreamWriter() :
+   frameBytes_(0),
+   frameBytesAligned_(0),
+   framesPerFile_(0),
+   framesQueued_(0),
+   framesWritten_(0),
+   fileCount_(0),
+   active_(false),
+   stopping_(false)
+{
+}
+
+MMStreamWriter::~MMStreamWriter()
+{
+   Stop();
+}
+
+bool MMStreamWriter::Start(const std::string& directory,
+      const std::string& prefix, std::size_t frameBytes,
+      unsigned writerThreads, unsigned long long maxFileBytes,
+      unsigned queueFrames)
+{
+   Stop();
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   error_.clear();
+   if (frameBytes == 0)
+   {
+      error_ = "Frame size for streaming must not be zero";
+      return false;
+   }
+
+   directory_ = directory;
+   if (!directory_.empty() && directory_[directory_.size() - 1] != '/' &&
+         directory_[directory_.size() - 1] != '\\')
+      directory_ += '/';
+   prefix_ = prefix;
+
+   const std::size_t pageBytes = GetPageBytes();
+   frameBytes_ = frameBytes;
+   frameBytesAligned_ = (frameBytes + pageBytes - 1) / pageBytes * pageBytes;
+   framesPerFile_ = maxFileBytes > 0 ? maxFileBytes / frameBytesAligned_ :
+      (std::numeric_limits<unsigned long long>::max)();
+   if (framesPerFile_ == 0)
+      framesPerFile_ = 1;
+
+   if (writerThreads == 0)
+      writerThreads = 1;
+   if (queueFrames == 0)
+      queueFrames = 4 * writerThreads;
+   for (unsigned i = 0; i < queueFrames; ++i)
+   {
+      void* buffer = AllocatePageAligned(frameBytesAligned_, pageBytes);
+      if (!buffer)
+      {
+         FreeBuffers();
+         error_ = "Failed to allocate page-aligned buffers for streaming";
+         return false;
+      }
+      // The padding stays zero; only the frame bytes are overwritten
+      std::memset(buffer, 0, frameBytesAligned_);
+      buffers_.push_back(buffer);
+      freeBuffers_.push_back(i);
+   }
+
+   framesQueued_ = 0;
+   framesWritten_ = 0;
+   fileCount_ = 0;
+   stopping_ = false;
+   active_ = true;
+   for (unsigned i = 0; i < writerThreads; ++i)
+      writers_.push_back(std::thread(&MMStreamWriter::WriterFunc, this));
+   return true;
+}
+
+bool MMStreamWriter::WriteFrame(const void* frame)
+{
+   PendingWrite job;
+   {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!active_)
+      {
+         if (error_.empty())
+            error_ = "Streaming has not been started";
+         return false;
+      }
+      bufferFree_.wait(lock,
+            [this]() { return !freeBuffers_.empty() || !error_.empty(); });
+      if (!error_.empty())
+         return false;
+
+      const unsigned long long index = framesQueued_ % framesPerFile_;
+      if (index == 0)
+      {
+         const std::string fileName = GetFileName(fileCount_);
+         currentFile_ = std::make_shared<File>(fileName);
+         if (!currentFile_->IsOpen())
+         {
+            currentFile_.reset();
+            error_ = "Failed to create file '" + fileName + "'";
+            return false;
+         }
+         ++fileCount_;
+      }
+
+      job.buffer = freeBuffers_.back();
+      freeBuffers_.pop_back();
+      job.file = currentFile_;
+      job.offset = index * frameBytesAligned_;
+      ++framesQueued_;
+   }
+
+   std::memcpy(buffers_[job.buffer], frame, frameBytes_);
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(job);
+   }
+   writeQueued_.notify_one();
+   return true;
+}
+
+bool MMStreamWriter::Stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!active_)
+         return error_.empty();
+      stopping_ = true;
+   }
+   writeQueued_.notify_all();
+   for (std::size_t i = 0; i < writers_.size(); ++i)
+      writers_[i].join();
+   writers_.clear();
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   currentFile_.reset();
+   FreeBuffers();
+   active_ = false;
+   stopping_ = false;
+   return error_.empty();
+}
+
+bool MMStreamWriter::IsActive() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return active_;
+}
+
+std::string MMStreamWriter::GetErrorMessage() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return error_;
+}
+
+unsigned long long MMStreamWriter::GetFramesWritten() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return framesWritten_;
+}
+
+unsigned MMStreamWriter::GetFileCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return fileCount_;
+}
+
+std::string MMStreamWriter::GetFileName(unsigned index) const
+{
+   char suffix[32];
+   snprintf(suffix, sizeof(suffix), "_%05u.raw", index);
+   return directory_ + prefix_ + suffix;
+}
+
+std::size_t MMStreamWriter::GetPageBytes()
+{
+   std::size_t pageBytes;
+#ifdef _WIN32
+   SYSTEM_INFO sysInfo;
+   ::GetSystemInfo(&sysInfo);
+   pageBytes = sysInfo.dwPageSize;
+#else
+   const long bytes = ::sysconf(_SC_PAGESIZE);
+   pageBytes = bytes > 0 ? static_cast<std::size_t>(bytes) : 0;
+#endif
+   return pageBytes > 0 ? pageBytes : 4096;
+}
+
+bool MMStreamWriter::CreateDirectories(const std::string& path)
+{
+   for (std::size_t pos = 1; pos <= path.size(); ++pos)
+   {
+      if (pos < path.size() && path[pos] != '/' && path[pos] != '\\')
+         continue;
+      const std::string parent = path.substr(0, pos);
+#ifdef _WIN32
+      if (parent.size() == 2 && parent[1] == ':')
+         continue; // Drive letter
+      const int err = ::_mkdir(parent.c_str());
+#else
+      const int err = ::mkdir(parent.c_str(), 0777);
+#endif
+      if (err != 0 && errno != EEXIST)
+         return false;
+   }
+   return true;
+}
+
+void MMStreamWriter::WriterFunc()
+{
+   for (;;)
+   {
+      PendingWrite job;
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         writeQueued_.wait(lock,
+               [this]() { return stopping_ || !pending_.empty(); });
+         if (pending_.empty())
+            return; // Stopping, and everything has been written
+         job = pending_.front();
+         pending_.pop_front();
+      }
+
+      const bool ok = job.file->WriteAt(buffers_[job.buffer],
+            frameBytesAligned_, job.offset);
+      job.file.reset();
+
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         if (ok)
+            ++framesWritten_;
+         else if (error_.empty())
+            error_ = "Failed to write frame to '" + prefix_ + "' files in '" +
+               directory_ + "'";
+         freeBuffers_.push_back(job.buffer);
+      }
+      bufferFree_.notify_all();
+   }
+}
+
+void MMStreamWriter::FreeBuffers()
+{
+   for (std::size_t i = 0; i < buffers_.size(); ++i)
+      FreePageAligned(buffers_[i]);
+   buffers_.clear();
+   freeBuffers_.clear();
+   pending_.clear();
+}
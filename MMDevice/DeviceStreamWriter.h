@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceStreamWriter.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMDevice - Device adapter kit
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Streaming of fixed-size frames to raw files with unbuffered,
+//                page-aligned writes
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes a sequence of equally sized frames to raw files, bypassing the
+ * operating system's file cache (O_DIRECT, FILE_FLAG_NO_BUFFERING) where
+ * the file system supports it.
+ *
+ * Each frame is copied into a page-aligned buffer and padded to a whole
+ * number of pages, so frame n of a file starts at byte n * GetFrameBytesOnDisk().
+ * The copies are written by a set of writer threads, so WriteFrame() returns
+ * as soon as the frame has been copied; it blocks only when all buffers are
+ * waiting to be written. Files are started anew ("rolled over") when they
+ * would exceed the configured size, and are named
+ * <directory>/<prefix>_00000.raw, <prefix>_00001.raw, ...
+ *
+ * WriteFrame() may be called from any thread but not concurrently with
+ * Start() or Stop().
+ */
+class MMStreamWriter
+{
+public:
+   MMStreamWriter();
+   ~MMStreamWriter(); // Stops, waiting for queued frames
+
+   /**
+    * Begins a new sequence. The directory must exist. writerThreads (at
+    * least 1) is the number of concurrent writes; queueFrames is the number
+    * of frames that may wait to be written (0 chooses 4 per thread).
+    * maxFileBytes of 0 means no limit. Returns false on error (see
+    * GetErrorMessage()).
+    */
+   bool Start(const std::string& directory, const std::string& prefix,
+         std::size_t frameBytes, unsigned writerThreads,
+         unsigned long long maxFileBytes, unsigned queueFrames = 0);
+
+   /**
+    * Queues a frame of the size given to Start(). Returns false if the
+    * writer is not started or a write has failed.
+    */
+   bool WriteFrame(const void* frame);
+
+   /**
+    * Writes all queued frames and closes the files. Returns false if any
+    * write failed.
+    */
+   bool Stop();
+
+   bool IsActive() const;
+   std::string GetErrorMessage() const;
+
+   std::size_t GetFrameBytes() const { return frameBytes_; }
+   std::size_t GetFrameBytesOnDisk() const { return frameBytesAligned_; }
+   unsigned long long GetFramesPerFile() const { return framesPerFile_; }
+   unsigned long long GetFramesWritten() const; // Completed writes
+   unsigned GetFileCount() const;
+   std::string GetFileName(unsigned index) const;
+
+   static std::size_t GetPageBytes();
+   // Creates the directory and any missing parents
+   static bool CreateDirectories(const std::string& path);
+
+private:
+   MMStreamWriter(const MMStreamWriter&);
+   MMStreamWriter& operator=(const MMStreamWriter&);
+
+   class File;
+   struct PendingWrite
+   {
+      std::size_t buffer;
+      std::shared_ptr<File> file;
+      unsigned long long offset;
+   };
+
+   void WriterFunc();
+   void FreeBuffers();
+
+   std::string directory_;
+   std::string prefix_;
+   std::size_t frameBytes_;
+   std::size_t frameBytesAligned_;
+   unsigned long long framesPerFile_;
+
+   std::vector<std::thread> writers_;
+   std::vector<void*> buffers_;
+
+   mutable std::mutex mutex_; // Guards all of the below
+   std::condition_variable bufferFree_;
+   std::condition_variable writeQueued_;
+   std::vector<std::size_t> freeBuffers_;
+   std::deque<PendingWrite> pending_;
+   std::shared_ptr<File> currentFile_;
+   unsigned long long framesQueued_;
+   unsigned long long framesWritten_;
+   unsigned fileCount_;
+   bool active_;
+   bool stopping_;
+   std::string error_;
+};
@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceThreadPool.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMDevice - Device adapter kit
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Worker threads for data-parallel work (per-pixel processing,
+//                large frame copies) in device adapters
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DeviceThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+
+// One ParallelFor() call. Workers and the caller claim chunks through
+// nextChunk until none are left; the caller then waits for finishedChunks.
+struct MMThreadPool::Job
+{
+   Job(std::size_t c, std::size_t chunks,
+         const std::function<void(std::size_t, std::size_t)>& b) :
+      count(c), chunkCount(chunks), body(b), nextChunk(0), finishedChunks(0)
+   {}
+
+   const std::size_t count;
+   const std::size_t chunkCount;
+   const std::function<void(std::size_t, std::size_t)>& body;
+
+   std::atomic<std::size_t> nextChunk;
+   std::size_t finishedChunks; // Guarded by mutex
+   std::mutex mutex;
+   std::condition_variable finished;
+};
+
+MMThreadPool::MMThreadPool(unsigned threadCount) :
+   threadCount_(threadCount > 0 ? threadCount :
+         std::max(1u, std::thread::hardware_concurrency())),
+   stopping_(false)
+{
+   for (unsigned i = 1; i < threadCount_; ++i)
+      workers_.push_back(std::thread(&MMThreadPool::WorkerFunc, this));
+}
+
+MMThreadPool::~MMThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+   }
+   workAvailable_.notify_all();
+   for (std::size_t i = 0; i < workers_.size(); ++i)
+      workers_[i].join();
+}
+
+void MMThreadPool::ParallelFor(std::size_t count, std::size_t minChunk,
+      const std::function<void(std::size_t, std::size_t)>& body)
+{
+   if (count == 0)
+      return;
+   minChunk = std::max<std::size_t>(minChunk, 1);
+   const std::size_t chunkCount = std::min<std::size_t>(threadCount_,
+         (count + minChunk - 1) / minChunk);
+   if (chunkCount <= 1)
+   {
+      body(0, count);
+      return;
+   }
+
+   std::shared_ptr<Job> job = std::make_shared<Job>(count, chunkCount, body);
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(job);
+   }
+   workAvailable_.notify_all();
+
+   while (RunChunk(*job))
+      ;
+
+   std::unique_lock<std::mutex> lock(job->mutex);
+   job->finished.wait(lock,
+         [&job]() { return job->finishedChunks == job->chunkCount; });
+}
+
+void MMThreadPool::MemCopy(void* dst, const void* src, std::size_t bytes)
+{
+   char* d = static_cast<char*>(dst);
+   const char* s = static_cast<const char*>(src);
+   ParallelFor(bytes, memCopyChunkBytes,
+         [d, s](std::size_t begin, std::size_t end)
+         {
+            std::memcpy(d + begin, s + begin, end - begin);
+         });
+}
+
+// Runs the next unclaimed chunk of job; returns false if there was none
+bool MMThreadPool::RunChunk(Job& job)
+{
+   const std::size_t chunk = job.nextChunk++;
+   if (chunk >= job.chunkCount)
+      return false;
+
+   // Spread the remainder over the first chunks
+   const std::size_t base = job.count / job.chunkCount;
+   const std::size_t extra = job.count % job.chunkCount;
+   const std::size_t begin = chunk * base + std::min(chunk, extra);
+   const std::size_t end = begin + base + (chunk < extra ? 1 : 0);
+   job.body(begin, end);
+
+   bool done;
+   {
+      std::lock_guard<std::mutex> lock(job.mutex);
+      done = ++job.finishedChunks == job.chunkCount;
+   }
+   if (done)
+      job.finished.notify_all();
+   return true;
+}
+
+void MMThreadPool::WorkerFunc()
+{
+   for (;;)
+   {
+      std::shared_ptr<Job> job;
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         workAvailable_.wait(lock,
+               [this]() { return stopping_ || !queue_.empty(); });
+         if (stopping_)
+            return;
+         job = queue_.front();
+         // Once every chunk is claimed, nobody else needs to see the job
+         if (job->nextChunk.load() + 1 >= job->chunkCount)
+            queue_.pop_front();
+      }
+      while (RunChunk(*job))
+         ;
+   }
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceThreadPool.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMDevice - Device adapter kit
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Worker threads for data-parallel work (per-pixel processing,
+//                large frame copies) in device adapters
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads that split loops and memory copies into
+ * chunks and run them in parallel.
+ *
+ * Size the pool with the worker budget provided by the Core
+ * (CDeviceBase::GetWorkerThreadBudget()), so that adapters together do not
+ * oversubscribe the machine, and create it once (e.g. in Initialize()), not
+ * per frame. A pool of size n runs work on n - 1 workers plus the calling
+ * thread, so a pool of size 1 starts no threads and runs everything inline.
+ *
+ * ParallelFor() and MemCopy() may be called from several threads at once;
+ * the calls share the workers.
+ */
+class MMThreadPool
+{
+public:
+   /**
+    * Creates a pool running work on threadCount threads (including the
+    * caller's). 0 means one per hardware thread.
+    */
+   explicit MMThreadPool(unsigned threadCount = 0);
+   ~MMThreadPool();
+
+   unsigned GetThreadCount() const { return threadCount_; }
+
+   /**
+    * Calls body(begin, end) for consecutive ranges covering [0, count), in
+    * parallel, and returns when all have finished. Ranges are at least
+    * minChunk long (except the last), so that small loops are not split
+    * into pieces that cost more to dispatch than to run. body must not
+    * throw.
+    */
+   void ParallelFor(std::size_t count, std::size_t minChunk,
+         const std::function<void(std::size_t, std::size_t)>& body);
+
+   /**
+    * memcpy(), split across the pool for large copies. Copies smaller than
+    * about 1 MB (per thread) are not worth splitting and are done directly.
+    */
+   void MemCopy(void* dst, const void* src, std::size_t bytes);
+
+   static const std::size_t memCopyChunkBytes = 1000000;
+
+private:
+   MMThreadPool(const MMThreadPool&);
+   MMThreadPool& operator=(const MMThreadPool&);
+
+   struct Job;
+
+   void WorkerFunc();
+   static bool RunChunk(Job& job);
+
+   const unsigned threadCount_;
+   std::vector<std::thread> workers_;
+
+   std::mutex mutex_;
+   std::condition_variable workAvailable_;
+   std::deque< std::shared_ptr<Job> > queue_;
+   bool stopping_;
+};
@@ -19,6 +19,7 @@
 // CVS:           $Id$
 
 #include "DeviceUtils.h"
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -58,15 +59,103 @@ unsigned CDeviceUtils::GetMaxStringLength()
    return MM::MaxStrLength;
 }
 
+namespace {
+
+const char digitPairs[] =
+   "00010203040506070809"
+   "10111213141516171819"
+   "20212223242526272829"
+   "30313233343536373839"
+   "40414243444546474849"
+   "50515253545556575859"
+   "60616263646566676869"
+   "70717273747576777879"
+   "80818283848586878889"
+   "90919293949596979899";
+
+// Writes the decimal digits of val, two at a time, ending just before end.
+// Returns a pointer to the first digit.
+char* FormatUnsigned(unsigned long long val, char* end)
+{
+   while (val >= 100)
+   {
+      const unsigned pair = (unsigned) (val % 100) * 2;
+      val /= 100;
+      *--end = digitPairs[pair + 1];
+      *--end = digitPairs[pair];
+   }
+   if (val >= 10)
+   {
+      *--end = digitPairs[val * 2 + 1];
+      *--end = digitPairs[val * 2];
+   }
+   else
+      *--end = (char) ('0' + val);
+   return end;
+}
+
+// Formats val as "%ld" into buf, which must hold at least 21 characters
+void FormatLong(long val, char* buf)
+{
+   char digits[24];
+   char* end = digits + sizeof(digits);
+   const unsigned long long magnitude = val < 0 ?
+      0ULL - (unsigned long long) val : (unsigned long long) val;
+   char* p = FormatUnsigned(magnitude, end);
+   if (val < 0)
+      *buf++ = '-';
+   memcpy(buf, p, end - p);
+   buf[end - p] = 0;
+}
+
+// Formats val as "%.2f" into buf, which holds size characters (at least 24)
+void FormatFixed2(double val, char* buf, size_t size)
+{
+   // Within this range val * 100 is accurate to better than 1e-5, so its
+   // rounding to an integer agrees with that of the exact value unless it is
+   // within 1e-4 of a tie. Zero (possibly negative), ties, large values, NaN
+   // and infinities are left to snprintf.
+   const double maxFast = 1e9;
+   if (val > -maxFast && val < maxFast && val != 0.0)
+   {
+      const bool negative = val < 0.0;
+      const double scaled = (negative ? -val : val) * 100.0;
+      const double whole = floor(scaled);
+      const double frac = scaled - whole;
+      if (fabs(frac - 0.5) > 1e-4)
+      {
+         const unsigned long long cents =
+            (unsigned long long) whole + (frac > 0.5 ? 1 : 0);
+         char digits[24];
+         char* end = digits + sizeof(digits);
+         char* p = end;
+         const unsigned pair = (unsigned) (cents % 100) * 2;
+         *--p = digitPairs[pair + 1];
+         *--p = digitPairs[pair];
+         *--p = '.';
+         p = FormatUnsigned(cents / 100, p);
+         if (negative)
+            *--p = '-';
+         memcpy(buf, p, end - p);
+         buf[end - p] = 0;
+         return;
+      }
+   }
+   snprintf(buf, size, "%.2f", val);
+}
+
+} // anonymous namespace
+
 /**
  * Convert long value to string.
  *
  * This function is not thread-safe, and the return value is only valid until
- * the next call to ConvertToString().
+ * the next call to ConvertToString(). Use FormatNumber() instead where the
+ * conversion may happen on more than one thread.
  */
 const char* CDeviceUtils::ConvertToString(long lnVal)
 {
-   snprintf(m_pszBuffer, MM::MaxStrLength-1, "%ld", lnVal); 
+   FormatLong(lnVal, m_pszBuffer);
    return m_pszBuffer;
 }
 
@@ -89,7 +178,7 @@ const char* CDeviceUtils::ConvertToString(int intVal)
  */
 const char* CDeviceUtils::ConvertToString(double dVal)
 {
-   snprintf(m_pszBuffer, MM::MaxStrLength-1, "%.2f", dVal); 
+   FormatFixed2(dVal, m_pszBuffer, MM::MaxStrLength - 1);
    return m_pszBuffer;
 }
 
@@ -105,6 +194,54 @@ const char* CDeviceUtils::ConvertToString(bool val)
    return m_pszBuffer;
 }
 
+/**
+ * Convert long value to string, as ConvertToString() does.
+ *
+ * Thread-safe: the string is held in the returned object.
+ */
+CDeviceUtils::NumberString CDeviceUtils::FormatNumber(long val)
+{
+   NumberString str;
+   FormatLong(val, str.buf_);
+   return str;
+}
+
+/**
+ * Convert int value to string, as ConvertToString() does.
+ *
+ * Thread-safe: the string is held in the returned object.
+ */
+CDeviceUtils::NumberString CDeviceUtils::FormatNumber(int val)
+{
+   return FormatNumber((long) val);
+}
+
+/**
+ * Convert double value to string with two decimals, as ConvertToString()
+ * does.
+ *
+ * Thread-safe: the string is held in the returned object.
+ */
+CDeviceUtils::NumberString CDeviceUtils::FormatNumber(double val)
+{
+   NumberString str;
+   FormatFixed2(val, str.buf_, sizeof(str.buf_));
+   return str;
+}
+
+/**
+ * Convert boolean value to "1" or "0", as ConvertToString() does.
+ *
+ * Thread-safe: the string is held in the returned object.
+ */
+CDeviceUtils::NumberString CDeviceUtils::FormatNumber(bool val)
+{
+   NumberString str;
+   str.buf_[0] = val ? '1' : '0';
+   str.buf_[1] = 0;
+   return str;
+}
+
 
 // from a vectors of chars make a string like "0x00 0x01 0x02....
 std::string CDeviceUtils::HexRep(std::vector<unsigned char>  values)
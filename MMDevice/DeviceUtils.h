@@ -24,6 +24,7 @@
 #define _DEVICEUTILS_H_
 
 #include "../MMDevice/MMDeviceConstants.h"
+#include <ostream>
 #include <vector>
 #include <string>
 #ifdef _WIN32
@@ -55,12 +56,35 @@ int gettimeofday(struct timeval *tv__, struct timezone *tz__);
 class CDeviceUtils
 {
 public:
+   /**
+    * A number formatted as by ConvertToString(), held in a buffer of its own.
+    * Converts implicitly to const char*, so that it can be passed wherever
+    * the result of ConvertToString() was; the pointer is valid for the
+    * lifetime of this object (for a temporary, until the end of the full
+    * expression).
+    */
+   class NumberString
+   {
+   public:
+      const char* c_str() const { return buf_; }
+      operator const char*() const { return buf_; }
+
+   private:
+      friend class CDeviceUtils;
+      // Large enough for any double in fixed notation
+      char buf_[320];
+   };
+
    static bool CopyLimitedString(char* pszTarget, const char* pszSource);
    static unsigned GetMaxStringLength();
    static const char* ConvertToString(long lnVal);
    static const char* ConvertToString(double dVal);
    static const char* ConvertToString(int val);
    static const char* ConvertToString(bool val);
+   static NumberString FormatNumber(long val);
+   static NumberString FormatNumber(double val);
+   static NumberString FormatNumber(int val);
+   static NumberString FormatNumber(bool val);
    static void Tokenize(const std::string& str, std::vector<std::string>& tokens, const std::string& delimiters = ",");
    static void SleepMs(long ms);
    static void NapMicros(unsigned long microsecs);
@@ -70,4 +94,10 @@ private:
    static char m_pszBuffer[MM::MaxStrLength];
 };
 
+inline std::ostream& operator<<(std::ostream& os,
+      const CDeviceUtils::NumberString& str)
+{
+   return os << str.c_str();
+}
+
 #endif //_DEVICEUTILS_H_
@@ -31,9 +31,9 @@
 
 #include "MMDeviceConstants.h"
 
+#include <memory>
 #include <string>
 #include <vector>
-#include <map>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
@@ -278,6 +278,15 @@ private:
 
 /**
  * Container for all metadata associated with a single image.
+ *
+ * Copies are cheap: tags live in shared storage that is duplicated (still
+ * sharing the immutable tags themselves) only when one of the copies sharing
+ * it is modified. The storage is a vector sorted by key, which for the few
+ * dozen tags of a typical image is faster to search and copy than a map.
+ * Keys are stored by value alongside their tags.
+ *
+ * Distinct Metadata objects may be used on different threads even if they
+ * share storage; a single object must not be modified concurrently.
  */
 class Metadata
 {
@@ -285,73 +294,61 @@ public:
 
    Metadata() {} // empty constructor
 
-   ~Metadata() // destructor
-   {
-      Clear();
-   }
+   ~Metadata() {}
 
-   Metadata(const Metadata& original) // copy constructor
-   {
-      for (TagConstIter it = original.tags_.begin(); it != original.tags_.end(); it++)
-      {
-         SetTag(*it->second);
-      }
-   }
+   Metadata(const Metadata& original) : // copy constructor
+      storage_(original.storage_)
+   {}
 
    void Clear()
    {
-      for (TagConstIter it=tags_.begin(); it != tags_.end(); it++)
-         delete it->second;
-      tags_.clear();
+      storage_.reset();
    }
 
    std::vector<std::string> GetKeys() const
    {
       std::vector<std::string> keyList;
-      for (TagConstIter it = tags_.begin(), end = tags_.end(); it != end; ++it)
-         keyList.push_back(it->first);
+      if (storage_)
+      {
+         keyList.reserve(storage_->size());
+         for (TagConstIter it = storage_->begin(); it != storage_->end(); it++)
+            keyList.push_back(it->key);
+      }
       return keyList;
    }
 
-   bool HasTag(const char* key)
+   bool HasTag(const char* key) const
    {
-      TagConstIter it = tags_.find(key);
-      if (it != tags_.end())
-         return true;
-      else
-         return false;
+      return Find(key) != 0;
    }
-   
+
    MetadataSingleTag GetSingleTag(const char* key) const throw (MetadataKeyError)
    {
-      MetadataTag* tag = FindTag(key);
-      const MetadataSingleTag* stag = tag->ToSingleTag();
+      const MetadataSingleTag* stag = FindTag(key)->ToSingleTag();
+      if (!stag)
+         throw MetadataKeyError();
       return *stag;
    }
 
    MetadataArrayTag GetArrayTag(const char* key) const throw (MetadataKeyError)
    {
-      MetadataTag* tag = FindTag(key);
-      const MetadataArrayTag* atag = tag->ToArrayTag();
+      const MetadataArrayTag* atag = FindTag(key)->ToArrayTag();
+      if (!atag)
+         throw MetadataKeyError();
       return *atag;
    }
 
    void SetTag(MetadataTag& tag)
    {
-      MetadataTag* newTag = tag.Clone();
-      const std::string key(tag.GetQualifiedName());
-      RemoveTag(key.c_str());
-      tags_[key] = newTag;
+      Insert(tag.GetQualifiedName(), TagPtr(tag.Clone()));
    }
 
    void RemoveTag(const char* key)
    {
-      TagIter it = tags_.find(key);
-      if (it != tags_.end())
-      {
-         delete it->second;
-         tags_.erase(it); // Non-const iterator needed in pre-C++11 code
-      }
+      if (!Find(key))
+         return;
+      Detach();
+      storage_->erase(LowerBound(*storage_, key));
    }
 
    /*
@@ -360,11 +357,23 @@ public:
    template <class anytype>
    void PutTag(std::string key, std::string deviceLabel, anytype value)
    {
-      std::stringstream os;
+      std::ostringstream os;
       os << value;
-      MetadataSingleTag* newTag = new MetadataSingleTag(key.c_str(), deviceLabel.c_str(), true);
-      newTag->SetValue(os.str().c_str());
-      tags_[newTag->GetQualifiedName()] = newTag;
+      PutTag(key, deviceLabel, os.str());
+   }
+
+   void PutTag(std::string key, std::string deviceLabel, const std::string& value)
+   {
+      MetadataSingleTag* newTag =
+         new MetadataSingleTag(key.c_str(), deviceLabel.c_str(), true);
+      TagPtr tag(newTag);
+      newTag->SetValue(value.c_str());
+      Insert(newTag->GetQualifiedName(), tag);
+   }
+
+   void PutTag(std::string key, std::string deviceLabel, const char* value)
+   {
+      PutTag(key, deviceLabel, std::string(value));
    }
 
    /*
@@ -388,23 +397,22 @@ public:
 #ifndef SWIG
    Metadata& operator=(const Metadata& rhs)
    {
-      Clear();
-      
-      for (TagConstIter it=rhs.tags_.begin(); it != rhs.tags_.end(); it++)
-      {
-         SetTag(*it->second);
-      }
-
+      storage_ = rhs.storage_;
       return *this;
    }
 #endif
 
    void Merge(const Metadata& newTags)
-   {     
-      for (TagConstIter it=newTags.tags_.begin(); it != newTags.tags_.end(); it++)
+   {
+      if (!newTags.storage_ || newTags.storage_ == storage_)
+         return;
+      if (!storage_)
       {
-         SetTag(*it->second);
+         storage_ = newTags.storage_;
+         return;
       }
+      for (TagConstIter it = newTags.storage_->begin(); it != newTags.storage_->end(); it++)
+         Insert(*it);
    }
 
    std::string Serialize() const
@@ -412,15 +420,18 @@ public:
       std::string str;
 
       std::ostringstream os;
-      os << tags_.size();
+      os << (storage_ ? storage_->size() : 0);
       str.append(os.str()).append("\n");
 
-      for (TagConstIter it = tags_.begin(); it != tags_.end(); it++)
+      if (storage_)
       {
-         const std::string id((it->second->ToArrayTag()) ? "a" : "s");
-         str.append(id).append("\n");
+         for (TagConstIter it = storage_->begin(); it != storage_->end(); it++)
+         {
+            const std::string id((it->tag->ToArrayTag()) ? "a" : "s");
+            str.append(id).append("\n");
 
-         str.append(it->second->Serialize());
+            str.append(it->tag->Serialize());
+         }
       }
 
       return str;
@@ -444,14 +455,14 @@ public:
       {
          const std::string id(readLine(is));
 
-         MetadataTag* newTag;
+         TagPtr newTag;
          if (id.compare("s") == 0)
          {
-            newTag = new MetadataSingleTag();
+            newTag.reset(new MetadataSingleTag());
          }
          else if (id.compare("a") == 0)
          {
-            newTag = new MetadataArrayTag();
+            newTag.reset(new MetadataArrayTag());
          }
          else
          {
@@ -459,7 +470,7 @@ public:
          }
 
          newTag->Restore(is);
-         tags_[newTag->GetQualifiedName()] = newTag;
+         Insert(newTag->GetQualifiedName(), newTag);
       }
       return true;
    }
@@ -468,32 +479,113 @@ public:
    {
       std::ostringstream os;
 
-      os << tags_.size();
-      for (TagConstIter it = tags_.begin(); it != tags_.end(); it++)
+      os << (storage_ ? storage_->size() : 0);
+      if (storage_)
       {
-         std::string id("s");
-         if (it->second->ToArrayTag())
-            id = "a";
-         std::string ser = it->second->Serialize();
-         os << id << " : " << ser << std::endl;
+         for (TagConstIter it = storage_->begin(); it != storage_->end(); it++)
+         {
+            std::string id("s");
+            if (it->tag->ToArrayTag())
+               id = "a";
+            std::string ser = it->tag->Serialize();
+            os << id << " : " << ser << std::endl;
+         }
       }
 
       return os.str();
    }
 
+#ifndef SWIG
 private:
-   MetadataTag* FindTag(const char* key) const
+   // Stored tags are never modified, so storage copies can share them
+   typedef std::shared_ptr<MetadataTag> TagPtr;
+
+   struct Entry
    {
-      TagConstIter it = tags_.find(key);
-      if (it != tags_.end())
-         return it->second;
-      else
+      // Owned by the entry: a key pointing into storage of the module that
+      // inserted the tag would dangle once that module is unloaded
+      std::string key;
+      TagPtr tag;
+   };
+
+   typedef std::vector<Entry> Storage;
+   typedef Storage::iterator TagIter;
+   typedef Storage::const_iterator TagConstIter;
+
+   template <class K>
+   static TagConstIter LowerBound(const Storage& storage, const K& key)
+   {
+      TagConstIter first = storage.begin();
+      size_t count = storage.size();
+      while (count > 0)
+      {
+         const size_t half = count / 2;
+         TagConstIter middle = first + half;
+         if (middle->key.compare(key) < 0)
+         {
+            first = middle + 1;
+            count -= half + 1;
+         }
+         else
+            count = half;
+      }
+      return first;
+   }
+
+   template <class K>
+   static TagIter LowerBound(Storage& storage, const K& key)
+   {
+      const Storage& constStorage = storage;
+      return storage.begin() + (LowerBound(constStorage, key) - constStorage.begin());
+   }
+
+   const Entry* Find(const char* key) const
+   {
+      if (!storage_)
+         return 0;
+      TagConstIter it = LowerBound(*storage_, key);
+      if (it != storage_->end() && it->key.compare(key) == 0)
+         return &*it;
+      return 0;
+   }
+
+   MetadataTag* FindTag(const char* key) const throw (MetadataKeyError)
+   {
+      const Entry* entry = Find(key);
+      if (!entry)
          throw MetadataKeyError();
+      return entry->tag.get();
    }
 
-   std::map<std::string, MetadataTag*> tags_;
-   typedef std::map<std::string, MetadataTag*>::iterator TagIter;
-   typedef std::map<std::string, MetadataTag*>::const_iterator TagConstIter;
+   // Make storage_ exclusively ours before modifying it
+   void Detach()
+   {
+      if (!storage_)
+         storage_ = std::make_shared<Storage>();
+      else if (storage_.use_count() > 1)
+         storage_ = std::make_shared<Storage>(*storage_);
+   }
+
+   void Insert(const Entry& entry)
+   {
+      Detach();
+      TagIter it = LowerBound(*storage_, entry.key);
+      if (it != storage_->end() && it->key == entry.key)
+         it->tag = entry.tag;
+      else
+         storage_->insert(it, entry);
+   }
+
+   void Insert(const std::string& key, const TagPtr& tag)
+   {
+      Entry entry;
+      entry.key = key;
+      entry.tag = tag;
+      Insert(entry);
+   }
+
+   std::shared_ptr<Storage> storage_;
+#endif
 };
 
 #endif //_IMAGE_METADATA_H_
\ No newline at end of file
@@ -27,7 +27,7 @@
 // Header version
 // If any of the class definitions changes, the interface version
 // must be incremented
-#define DEVICE_INTERFACE_VERSION 70
+#define DEVICE_INTERFACE_VERSION 78
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -578,6 +578,83 @@ namespace MM {
       virtual int AddToExposureSequence(double exposureTime_ms) = 0;
       // Signal that we are done sending sequence values so that the adapter can send the whole sequence to the device
       virtual int SendExposureSequence() const = 0;
+
+      // Burst API
+      // A burst is a run of frames whose start, end and individual frames are
+      // each triggered internally by the camera, externally by a TTL pulse,
+      // or by software through the Send...Trigger() functions (see
+      // g_TriggerType_Internal, etc.). The trigger types and delays are set
+      // first, then PrepareForBurst() arms the camera. Frames are inserted
+      // into the circular buffer as in a sequence acquisition, and
+      // IsCapturing() returns true from PrepareForBurst() until the burst
+      // has ended.
+
+      /**
+       * Returns true if the camera implements the burst API. Cameras that
+       * do not leave the functions below returning
+       * DEVICE_UNSUPPORTED_COMMAND.
+       */
+      virtual bool SupportsBurstAPI() = 0;
+      /**
+       * Sets the delays before and after the exposure of each frame. With
+       * the exposure, they set the frame rate of internally triggered frames.
+       */
+      virtual int SetPreFrameDelay(double delay_ms) = 0;
+      virtual int SetPostFrameDelay(double delay_ms) = 0;
+      /**
+       * Sets what starts a burst. "internal" means the camera starts the
+       * burst as soon as it is armed.
+       */
+      virtual int SetBurstStartTriggerType(const char* type) = 0;
+      /**
+       * Sets what ends a burst. "internal" means the camera ends the burst
+       * after the number of images given to PrepareForBurst().
+       */
+      virtual int SetBurstEndTriggerType(const char* type) = 0;
+      /**
+       * Sets what starts each frame. "internal" means the camera starts
+       * frames back to back, separated by the pre- and post-frame delays.
+       */
+      virtual int SetFrameStartTriggerType(const char* type) = 0;
+      /**
+       * Sets what ends the exposure of each frame. "internal" means the
+       * exposure set with SetExposure().
+       */
+      virtual int SetExposureEndTriggerType(const char* type) = 0;
+      /**
+       * Gets the burst start and frame start trigger types currently in
+       * effect, which need not have been set through the functions above.
+       * The buffer is MM::MaxStrLength characters long.
+       */
+      virtual int GetBurstStartTriggerType(char* type) = 0;
+      virtual int GetFrameStartTriggerType(char* type) = 0;
+      /**
+       * Sets how external frame start and exposure end triggers are
+       * combined (see g_FrameExposureMode_Distinct, etc.).
+       */
+      virtual int SetFrameExposureMode(const char* mode) = 0;
+      /**
+       * Arms the camera for a burst of numImages frames, or of frames until
+       * the burst end trigger if numImages is -1. Returns an error if the
+       * combination of trigger types is not supported.
+       */
+      virtual int PrepareForBurst(int numImages) = 0;
+      /**
+       * Software triggers, for the trigger types set to "software".
+       * SendFrameStartTrigger() blocks for the duration of the exposure, so
+       * that shutters can be closed as soon as it returns.
+       */
+      virtual int SendBurstStartTrigger() = 0;
+      virtual int SendFrameStartTrigger() = 0;
+      virtual int SendBurstEndTrigger() = 0;
+      /**
+       * Rolling shutter (light sheet) readout: the delay between the
+       * starts of successive lines, and the number of lines exposed at once.
+       */
+      virtual int GetRollingShutterLineOffset(double& offset_us) = 0;
+      virtual int SetRollingShutterLineOffset(double offset_us) = 0;
+      virtual int GetRollingShutterActiveLines(int& numLines) = 0;
+      virtual int SetRollingShutterActiveLines(int numLines) = 0;
    };
 
    /**
@@ -815,6 +892,24 @@ namespace MM {
       virtual int GetGateOpen(bool& open) = 0;
    };
 
+   /**
+    * Notification of data arriving on a serial port.
+    * See Serial::AddDataCallback().
+    */
+   class SerialDataCallback
+   {
+   public:
+      virtual ~SerialDataCallback() {}
+
+      /**
+       * Called when bytes arrive on the port, on the port's I/O thread.
+       * Implementations must return quickly; typically they wake a thread
+       * that reads the data. They may write to the port and may remove
+       * themselves.
+       */
+      virtual void OnSerialDataArrived(const char* portName) = 0;
+   };
+
    /**
     * Serial port API.
     */
@@ -835,6 +930,24 @@ namespace MM {
       virtual int Write(const unsigned char* buf, unsigned long bufLen) = 0;
       virtual int Read(unsigned char* buf, unsigned long bufLen, unsigned long& charsRead) = 0;
       virtual int Purge() = 0;
+
+      /**
+       * Blocks until unread data is available or timeoutMs has elapsed,
+       * without polling. Returns DEVICE_UNSUPPORTED_COMMAND if the port
+       * cannot wait for data, and an error if it has stopped operating and
+       * holds no unread data.
+       */
+      virtual int WaitForData(unsigned long timeoutMs, bool& dataAvailable) = 0;
+      /**
+       * Registers a callback to be invoked whenever data arrives. Returns
+       * DEVICE_UNSUPPORTED_COMMAND if the port cannot notify of data.
+       */
+      virtual int AddDataCallback(SerialDataCallback* callback) = 0;
+      /**
+       * Unregisters a callback. Once this returns, the callback is not running
+       * and will not be called again.
+       */
+      virtual int RemoveDataCallback(SerialDataCallback* callback) = 0;
    };
 
    /**
@@ -1236,6 +1349,27 @@ namespace MM {
        * Must not be called from device adapters.
        */
       virtual Device* GetInstalledDevice(int devIdx) = 0;
+
+      /**
+       * Queries the busy state of all peripherals at once, for example with
+       * a single status command to the controller, so that
+       * GetPeripheralBusy() can report it without further communication.
+       *
+       * Called by the Core when it checks whether the hub's loaded
+       * peripherals are busy, followed by GetPeripheralBusy() for each of
+       * them. Return DEVICE_UNSUPPORTED_COMMAND if not supported; the Core
+       * then calls each peripheral's Busy().
+       */
+      virtual int SnapPeripheralBusyStates() = 0;
+
+      /**
+       * Reports the busy state of a peripheral found by the last
+       * SnapPeripheralBusyStates().
+       *
+       * Returns false if the state of peripheral is not known to the hub,
+       * in which case the Core calls its Busy().
+       */
+      virtual bool GetPeripheralBusy(Device* peripheral, bool& busy) = 0;
    };
 
    /**
@@ -1277,6 +1411,27 @@ namespace MM {
       virtual int ReadFromSerial(const Device* caller, const char* port, unsigned char* buf, unsigned long length, unsigned long& read) = 0;
       virtual int PurgeSerial(const Device* caller, const char* portName) = 0;
       virtual MM::PortType GetSerialPortType(const char* portName) const = 0;
+      /**
+       * Wait until data is available to ReadFromSerial(), instead of polling.
+       * Returns DEVICE_UNSUPPORTED_COMMAND if the port does not support
+       * waiting, in which case the caller should fall back to polling.
+       */
+      virtual int WaitForSerialData(const Device* caller, const char* portName, unsigned long timeoutMs, bool& dataAvailable) = 0;
+      /**
+       * Read exactly length bytes, blocking until they have arrived or
+       * timeoutMs has elapsed, in which case DEVICE_SERIAL_TIMEOUT is
+       * returned. bytesRead is set to the number of bytes actually read.
+       * Sleeps on WaitForSerialData() between reads where the port supports
+       * it, so callers need not poll.
+       */
+      virtual int ReadExactlyFromSerial(const Device* caller, const char* portName, unsigned char* buf, unsigned long length, unsigned long timeoutMs, unsigned long& bytesRead) = 0;
+      /**
+       * Subscribe to notification of data arriving on a port. The callback
+       * must be unsubscribed before it is destroyed (at the latest in the
+       * subscribing device's Shutdown()).
+       */
+      virtual int SubscribeToSerialData(const Device* caller, const char* portName, MM::SerialDataCallback* callback) = 0;
+      virtual int UnsubscribeFromSerialData(const Device* caller, const char* portName, MM::SerialDataCallback* callback) = 0;
 
       virtual int OnPropertiesChanged(const Device* caller) = 0;
       /**
@@ -1311,9 +1466,24 @@ namespace MM {
       virtual unsigned long GetClockTicksUs(const Device* caller) = 0;
       virtual MM::MMTime GetCurrentMMTime() = 0;
 
+      /**
+       * Number of threads a device should use for data-parallel work, such
+       * as the size of an MMThreadPool. The user sets a budget for the whole
+       * system and each call takes the caller's share of it (replacing the
+       * share from an earlier call), so that devices running at the same
+       * time do not each use every core. Call it once, when creating the
+       * pool.
+       */
+      virtual unsigned GetWorkerThreadBudget(const Device* caller) = 0;
+
       // sequence acquisition
       virtual int AcqFinished(const Device* caller, int statusCode) = 0;
       virtual int PrepareForAcq(const Device* caller) = 0;
+      // Cameras that can should put the hardware frame counter and timestamp
+      // of each image in its metadata, as
+      // g_Keyword_Metadata_HardwareFrameNumber and
+      // g_Keyword_Metadata_HardwareTimestamp_us, so that the Core can detect
+      // frames lost before they reached it.
       virtual int InsertImage(const Device* caller, const ImgBuffer& buf) = 0;
       virtual int InsertImage(const Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const char* serializedMetadata, const bool doProcess = true) = 0;
       virtual int InsertImage(const Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const Metadata* md = 0, const bool doProcess = true) = 0;
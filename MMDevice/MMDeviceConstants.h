@@ -117,6 +117,7 @@ namespace MM {
    const char* const g_Keyword_DelayBetweenCharsMs = "DelayBetweenCharsMs";
    const char* const g_Keyword_Port             = "Port";
    const char* const g_Keyword_AnswerTimeout    = "AnswerTimeout";
+   const char* const g_Keyword_HardwareId       = "HardwareId";
    const char* const g_Keyword_Speed            = "Speed";
    const char* const g_Keyword_CoreDevice       = "Core";
    const char* const g_Keyword_CoreInitialize   = "Initialize";
@@ -150,6 +151,26 @@ namespace MM {
    const char* const g_Keyword_Metadata_ROI_X       = "ROI-X-start";
    const char* const g_Keyword_Metadata_ROI_Y       = "ROI-Y-start";
    const char* const g_Keyword_Metadata_TimeInCore  = "TimeReceivedByCore";
+   // Optionally supplied by cameras, for detection of dropped frames
+   const char* const g_Keyword_Metadata_HardwareFrameNumber = "HardwareFrameNumber";
+   const char* const g_Keyword_Metadata_HardwareTimestamp_us = "HardwareTimestamp-us";
+   // Added by the Core from the above
+   const char* const g_Keyword_Metadata_FrameGap    = "FrameGap";
+   const char* const g_Keyword_Metadata_FrameLate   = "FrameLate";
+   const char* const g_Keyword_Metadata_FramesLate  = "FramesLate";
+   const char* const g_Keyword_Metadata_FramesDroppedByDevice = "FramesDroppedByDevice";
+   const char* const g_Keyword_Metadata_FramesDroppedByBuffer = "FramesDroppedByBuffer";
+   // Time from the trigger of a frame to its arrival in the Core
+   const char* const g_Keyword_Metadata_TriggerLatency_ms = "TriggerLatency-ms";
+
+   // camera burst API trigger types: no signal, a TTL pulse, or an API call
+   const char* const g_TriggerType_Internal = "internal";
+   const char* const g_TriggerType_External = "external";
+   const char* const g_TriggerType_Software = "software";
+   // camera burst API frame exposure modes, for external frame triggers
+   const char* const g_FrameExposureMode_Distinct = "distinct"; // Start and end TTLs
+   const char* const g_FrameExposureMode_Exposure = "exposure"; // Bulb (TTL width)
+   const char* const g_FrameExposureMode_Combined = "combined"; // One TTL ends and starts
 
    // configuration file format constants
    const char* const g_FieldDelimiters = ",";
@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include "ImageMetadata.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+std::string Value(const Metadata& md, const char* key)
+{
+   return md.GetSingleTag(key).GetValue();
+}
+
+} // anonymous namespace
+
+
+TEST(MetadataTests, PutAndGet)
+{
+   Metadata md;
+   EXPECT_FALSE(md.HasTag("Exposure"));
+   md.PutImageTag("Exposure", 10.5);
+   md.PutImageTag<std::string>("Camera", "Cam");
+   md.PutImageTag("Binning", "2");
+   md.PutTag("Position", "Stage", 3);
+
+   EXPECT_TRUE(md.HasTag("Exposure"));
+   EXPECT_EQ("10.5", Value(md, "Exposure"));
+   EXPECT_EQ("Cam", Value(md, "Camera"));
+   EXPECT_EQ("2", Value(md, "Binning"));
+   EXPECT_EQ("3", Value(md, "Stage-Position"));
+   EXPECT_EQ(4u, md.GetKeys().size());
+
+   md.PutImageTag("Exposure", 20);
+   EXPECT_EQ("20", Value(md, "Exposure"));
+   EXPECT_EQ(4u, md.GetKeys().size());
+}
+
+TEST(MetadataTests, MissingOrMismatchedTagThrows)
+{
+   Metadata md;
+   EXPECT_THROW(md.GetSingleTag("Nothing"), MetadataKeyError);
+
+   md.PutImageTag("Single", 1);
+   MetadataArrayTag array("Array", "_", true);
+   array.AddValue("a");
+   md.SetTag(array);
+   EXPECT_THROW(md.GetArrayTag("Single"), MetadataKeyError);
+   EXPECT_THROW(md.GetSingleTag("Array"), MetadataKeyError);
+   EXPECT_EQ("a", md.GetArrayTag("Array").GetValue(0));
+}
+
+TEST(MetadataTests, KeysAreSorted)
+{
+   Metadata md;
+   md.PutImageTag("c", 1);
+   md.PutImageTag("a", 1);
+   md.PutImageTag("b", 1);
+   std::vector<std::string> keys = md.GetKeys();
+   ASSERT_EQ(3u, keys.size());
+   EXPECT_EQ("a", keys[0]);
+   EXPECT_EQ("b", keys[1]);
+   EXPECT_EQ("c", keys[2]);
+}
+
+TEST(MetadataTests, CopiesAreIndependent)
+{
+   Metadata original;
+   original.PutImageTag("A", 1);
+   original.PutImageTag("B", 2);
+
+   Metadata copy(original);
+   copy.PutImageTag("A", 10);
+   copy.PutImageTag("C", 3);
+   copy.RemoveTag("B");
+
+   EXPECT_EQ("1", Value(original, "A"));
+   EXPECT_EQ("2", Value(original, "B"));
+   EXPECT_FALSE(original.HasTag("C"));
+   EXPECT_EQ("10", Value(copy, "A"));
+   EXPECT_FALSE(copy.HasTag("B"));
+
+   Metadata assigned;
+   assigned = original;
+   original.Clear();
+   EXPECT_EQ(0u, original.GetKeys().size());
+   EXPECT_EQ("1", Value(assigned, "A"));
+}
+
+TEST(MetadataTests, SetTagCopiesTheTag)
+{
+   Metadata md;
+   MetadataSingleTag tag("Key", "Dev", true);
+   tag.SetValue("before");
+   md.SetTag(tag);
+   tag.SetValue("after");
+   EXPECT_EQ("before", Value(md, "Dev-Key"));
+}
+
+TEST(MetadataTests, Merge)
+{
+   Metadata base;
+   base.PutImageTag("A", 1);
+   base.PutImageTag("B", 2);
+
+   Metadata extra;
+   extra.PutImageTag("B", 20);
+   extra.PutImageTag("C", 30);
+
+   Metadata merged(base);
+   merged.Merge(extra);
+   EXPECT_EQ("1", Value(merged, "A"));
+   EXPECT_EQ("20", Value(merged, "B"));
+   EXPECT_EQ("30", Value(merged, "C"));
+   EXPECT_EQ("2", Value(base, "B"));
+   EXPECT_FALSE(base.HasTag("C"));
+
+   Metadata empty;
+   empty.Merge(extra);
+   extra.PutImageTag("D", 40);
+   EXPECT_FALSE(empty.HasTag("D"));
+   EXPECT_EQ(2u, empty.GetKeys().size());
+
+   merged.Merge(merged);
+   EXPECT_EQ(3u, merged.GetKeys().size());
+}
+
+TEST(MetadataTests, SerializeRoundTrip)
+{
+   Metadata md;
+   md.PutImageTag("Width", 512);
+   md.PutTag("Label", "Objective", "10X");
+   MetadataArrayTag array("Values", "_", false);
+   array.AddValue("x");
+   array.AddValue("y");
+   md.SetTag(array);
+
+   Metadata restored;
+   ASSERT_TRUE(restored.Restore(md.Serialize().c_str()));
+   EXPECT_EQ(md.Serialize(), restored.Serialize());
+   EXPECT_EQ("512", Value(restored, "Width"));
+   EXPECT_EQ("10X", Value(restored, "Objective-Label"));
+   EXPECT_EQ(2u, restored.GetArrayTag("Values").GetSize());
+}
+
+TEST(MetadataTests, CopiesCanBeModifiedOnSeparateThreads)
+{
+   Metadata original;
+   for (int i = 0; i < 20; ++i)
+      original.PutImageTag("Tag" + std::to_string(i), i);
+
+   std::vector<int> failures(8, 0);
+   boost::thread_group threads;
+   for (size_t t = 0; t < failures.size(); ++t)
+   {
+      threads.create_thread([&original, &failures, t]()
+      {
+         for (int i = 0; i < 2000; ++i)
+         {
+            Metadata copy(original);
+            copy.PutImageTag("Tag0", t);
+            copy.PutImageTag("Thread", t);
+            Metadata merged;
+            merged.Merge(copy);
+            merged.PutImageTag("Iteration", i);
+            if (Value(merged, "Tag0") != std::to_string(t) ||
+                  Value(merged, "Tag19") != "19")
+               ++failures[t];
+         }
+      });
+   }
+   threads.join_all();
+
+   for (size_t t = 0; t < failures.size(); ++t)
+      EXPECT_EQ(0, failures[t]);
+   EXPECT_EQ("0", Value(original, "Tag0"));
+   EXPECT_FALSE(original.HasTag("Thread"));
+}
+
+// The life of one frame's metadata from camera to application: the camera
+// adapter's tags are copied into the Core's metadata, merged with the Core's
+// own tags, copied once per channel into the circular buffer and copied
+// again when the application pops the image.
+TEST(MetadataTests, PerFrameBenchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   Metadata cameraTags;
+   for (int i = 0; i < 12; ++i)
+      cameraTags.PutTag("Property" + std::to_string(i), "Camera", i * 1.5);
+
+   Metadata systemState;
+   for (int i = 0; i < 40; ++i)
+      systemState.PutTag("Property" + std::to_string(i), "Device" + std::to_string(i % 8), i);
+
+   const int frames = 20000;
+   const int channels = 2;
+   size_t checksum = 0;
+
+   const ptime t0 = microsec_clock::universal_time();
+   for (int frame = 0; frame < frames; ++frame)
+   {
+      Metadata md(cameraTags);
+      md.PutImageTag("ImageNumber", frame);
+      md.PutImageTag("ElapsedTime-ms", frame * 0.05);
+
+      Metadata core;
+      core.PutImageTag("Camera", "Camera");
+      core.PutImageTag("Binning", 1);
+      core.Merge(systemState);
+      core.Merge(md);
+
+      for (int ch = 0; ch < channels; ++ch)
+      {
+         Metadata stored(core);
+         stored.PutImageTag("CameraChannelIndex", ch);
+         Metadata popped;
+         popped = stored;
+         checksum += popped.HasTag("ImageNumber");
+      }
+   }
+   const ptime t1 = microsec_clock::universal_time();
+
+   const Metadata sample(systemState);
+   const int serializations = 2000;
+   for (int i = 0; i < serializations; ++i)
+      checksum += sample.Serialize().size();
+   const ptime t2 = microsec_clock::universal_time();
+
+   EXPECT_LT(0u, checksum);
+   std::cout << "per frame (" << channels << " channels, " <<
+      systemState.GetKeys().size() + cameraTags.GetKeys().size() + 5 <<
+      " tags): " << (t1 - t0).total_microseconds() * 1000 / frames << " ns\n";
+   std::cout << "Serialize (" << sample.GetKeys().size() << " tags): " <<
+      (t2 - t1).total_microseconds() * 1000 / serializations << " ns\n";
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
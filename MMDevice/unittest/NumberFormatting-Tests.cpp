@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include "DeviceUtils.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+std::string Printf(const char* format, long val)
+{
+   char buf[64];
+   snprintf(buf, sizeof(buf), format, val);
+   return buf;
+}
+
+std::string Printf(const char* format, double val)
+{
+   char buf[400];
+   snprintf(buf, sizeof(buf), format, val);
+   return buf;
+}
+
+double RandomDouble()
+{
+   const double magnitude = std::pow(10.0, std::rand() % 14 - 4);
+   const double val = magnitude * std::rand() / RAND_MAX;
+   return std::rand() % 2 ? val : -val;
+}
+
+} // anonymous namespace
+
+
+TEST(NumberFormattingTests, IntegersMatchPrintf)
+{
+   const long values[] = { 0, 1, -1, 9, 10, 99, 100, 101, 12345, -987654,
+      LONG_MAX, LONG_MIN };
+   for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+   {
+      EXPECT_EQ(Printf("%ld", values[i]),
+            std::string(CDeviceUtils::FormatNumber(values[i])));
+      EXPECT_EQ(Printf("%ld", values[i]),
+            std::string(CDeviceUtils::ConvertToString(values[i])));
+   }
+   EXPECT_EQ("-42", std::string(CDeviceUtils::FormatNumber(-42)));
+   EXPECT_EQ("1", std::string(CDeviceUtils::FormatNumber(true)));
+   EXPECT_EQ("0", std::string(CDeviceUtils::FormatNumber(false)));
+}
+
+TEST(NumberFormattingTests, DoublesMatchPrintf)
+{
+   const double values[] = { 0.0, -0.0, 0.004, -0.004, 0.005, 0.015, 0.125,
+      1.005, 2.675, 99.995, 123.456, -123.456, 1e9, 1e9 - 0.001, 1.5e20,
+      -1e300, 1e308 };
+   for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+   {
+      EXPECT_EQ(Printf("%.2f", values[i]),
+            std::string(CDeviceUtils::FormatNumber(values[i])))
+         << "for " << values[i];
+   }
+
+   std::srand(1);
+   for (int i = 0; i < 1000000; ++i)
+   {
+      const double val = RandomDouble();
+      ASSERT_EQ(Printf("%.2f", val),
+            std::string(CDeviceUtils::FormatNumber(val)))
+         << "for " << Printf("%.17g", val);
+   }
+}
+
+TEST(NumberFormattingTests, ThreadSafe)
+{
+   struct Worker
+   {
+      long base;
+      bool ok;
+      void operator()()
+      {
+         ok = true;
+         for (long i = 0; i < 100000; ++i)
+         {
+            if (Printf("%ld", base + i) != std::string(CDeviceUtils::FormatNumber(base + i)))
+               ok = false;
+         }
+      }
+   };
+
+   std::vector<Worker> workers(4);
+   boost::thread_group threads;
+   for (size_t i = 0; i < workers.size(); ++i)
+   {
+      workers[i].base = (long) i * 1000000;
+      threads.create_thread(boost::ref(workers[i]));
+   }
+   threads.join_all();
+   for (size_t i = 0; i < workers.size(); ++i)
+      EXPECT_TRUE(workers[i].ok);
+}
+
+// Not a correctness test; reports the cost of each conversion compared with
+// snprintf, which ConvertToString() used to call
+TEST(NumberFormattingTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const int iterations = 1000000;
+   std::vector<double> doubles(1024);
+   for (size_t i = 0; i < doubles.size(); ++i)
+      doubles[i] = 1e4 * std::rand() / RAND_MAX;
+
+   size_t sink = 0;
+   char buf[MM::MaxStrLength];
+   const ptime t0 = microsec_clock::universal_time();
+   for (int i = 0; i < iterations; ++i)
+   {
+      snprintf(buf, MM::MaxStrLength - 1, "%ld", (long) i);
+      sink += buf[0];
+   }
+   const ptime t1 = microsec_clock::universal_time();
+   for (int i = 0; i < iterations; ++i)
+      sink += CDeviceUtils::FormatNumber((long) i).c_str()[0];
+   const ptime t2 = microsec_clock::universal_time();
+   for (int i = 0; i < iterations; ++i)
+   {
+      snprintf(buf, MM::MaxStrLength - 1, "%.2f", doubles[i % doubles.size()]);
+      sink += buf[0];
+   }
+   const ptime t3 = microsec_clock::universal_time();
+   for (int i = 0; i < iterations; ++i)
+      sink += CDeviceUtils::FormatNumber(doubles[i % doubles.size()]).c_str()[0];
+   const ptime t4 = microsec_clock::universal_time();
+
+   const double nsPerCall = 1000.0 / iterations;
+   std::cout << "long:   snprintf " <<
+      (t1 - t0).total_microseconds() * nsPerCall << " ns, FormatNumber " <<
+      (t2 - t1).total_microseconds() * nsPerCall << " ns\n";
+   std::cout << "double: snprintf " <<
+      (t3 - t2).total_microseconds() * nsPerCall << " ns, FormatNumber " <<
+      (t4 - t3).total_microseconds() * nsPerCall << " ns\n";
+   EXPECT_NE(0u, sink);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
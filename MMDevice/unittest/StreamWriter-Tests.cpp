@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include "DeviceStreamWriter.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+std::string MakeTempDir()
+{
+   char name[] = "/tmp/StreamWriter-Tests-XXXXXX";
+   const char* dir = mkdtemp(name);
+   return dir ? std::string(dir) + "/" : std::string();
+}
+
+int RemoveEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+   return std::remove(path);
+}
+
+void RemoveDir(const std::string& dir)
+{
+   nftw(dir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+std::vector<unsigned char> ReadFile(const std::string& path)
+{
+   std::ifstream file(path.c_str(), std::ios::binary);
+   return std::vector<unsigned char>(std::istreambuf_iterator<char>(file),
+         std::istreambuf_iterator<char>());
+}
+
+std::vector<unsigned char> Frame(std::size_t bytes, unsigned index)
+{
+   std::vector<unsigned char> frame(bytes);
+   for (std::size_t i = 0; i < bytes; ++i)
+      frame[i] = static_cast<unsigned char>(index * 7 + i);
+   return frame;
+}
+
+} // anonymous namespace
+
+
+TEST(StreamWriterTests, FramesArePageAligned)
+{
+   const std::string dir = MakeTempDir();
+   ASSERT_FALSE(dir.empty());
+   const std::size_t frameBytes = 1000;
+   const unsigned frames = 50;
+
+   MMStreamWriter writer;
+   ASSERT_TRUE(writer.Start(dir, "cam", frameBytes, 3, 0));
+   const std::size_t onDisk = writer.GetFrameBytesOnDisk();
+   EXPECT_EQ(0u, onDisk % MMStreamWriter::GetPageBytes());
+   EXPECT_LE(frameBytes, onDisk);
+   for (unsigned i = 0; i < frames; ++i)
+      ASSERT_TRUE(writer.WriteFrame(&Frame(frameBytes, i)[0]));
+   ASSERT_TRUE(writer.Stop());
+   EXPECT_EQ(frames, writer.GetFramesWritten());
+   EXPECT_EQ(1u, writer.GetFileCount());
+
+   const std::vector<unsigned char> data = ReadFile(dir + "cam_00000.raw");
+   ASSERT_EQ(frames * onDisk, data.size());
+   for (unsigned i = 0; i < frames; ++i)
+   {
+      const std::vector<unsigned char> expected = Frame(frameBytes, i);
+      ASSERT_TRUE(std::equal(expected.begin(), expected.end(),
+               data.begin() + i * onDisk)) << "frame " << i;
+      for (std::size_t j = frameBytes; j < onDisk; ++j)
+         ASSERT_EQ(0, data[i * onDisk + j]);
+   }
+   RemoveDir(dir);
+}
+
+TEST(StreamWriterTests, RollsOverFiles)
+{
+   const std::string dir = MakeTempDir();
+   ASSERT_FALSE(dir.empty());
+   const std::size_t frameBytes = MMStreamWriter::GetPageBytes() * 2;
+
+   MMStreamWriter writer;
+   ASSERT_TRUE(writer.Start(dir, "cam", frameBytes, 2, 3 * frameBytes + 1, 2));
+   EXPECT_EQ(3u, writer.GetFramesPerFile());
+   for (unsigned i = 0; i < 10; ++i)
+      ASSERT_TRUE(writer.WriteFrame(&Frame(frameBytes, i)[0]));
+   ASSERT_TRUE(writer.Stop());
+   ASSERT_EQ(4u, writer.GetFileCount());
+
+   for (unsigned f = 0; f < 4; ++f)
+   {
+      const std::vector<unsigned char> data = ReadFile(writer.GetFileName(f));
+      const unsigned framesInFile = f < 3 ? 3 : 1;
+      ASSERT_EQ(framesInFile * frameBytes, data.size());
+      for (unsigned i = 0; i < framesInFile; ++i)
+      {
+         const std::vector<unsigned char> expected = Frame(frameBytes, f * 3 + i);
+         EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                  data.begin() + i * frameBytes));
+      }
+   }
+
+   // Restarting begins a new sequence in the same place
+   ASSERT_TRUE(writer.Start(dir, "cam", frameBytes, 1, 0));
+   ASSERT_TRUE(writer.WriteFrame(&Frame(frameBytes, 99)[0]));
+   ASSERT_TRUE(writer.Stop());
+   EXPECT_EQ(frameBytes, ReadFile(dir + "cam_00000.raw").size());
+   RemoveDir(dir);
+}
+
+TEST(StreamWriterTests, ReportsErrors)
+{
+   MMStreamWriter writer;
+   unsigned char frame[16] = { 0 };
+   EXPECT_FALSE(writer.WriteFrame(frame));
+   EXPECT_FALSE(writer.GetErrorMessage().empty());
+
+   EXPECT_FALSE(writer.Start("/tmp", "cam", 0, 1, 0));
+
+   ASSERT_TRUE(writer.Start("/nonexistent-dir/for/StreamWriter-Tests", "cam",
+            sizeof(frame), 1, 0));
+   EXPECT_TRUE(writer.GetErrorMessage().empty());
+   EXPECT_FALSE(writer.WriteFrame(frame));
+   EXPECT_NE(std::string::npos, writer.GetErrorMessage().find("cam_00000.raw"));
+   EXPECT_FALSE(writer.WriteFrame(frame));
+   EXPECT_FALSE(writer.Stop());
+   EXPECT_FALSE(writer.IsActive());
+}
+
+TEST(StreamWriterTests, CreateDirectories)
+{
+   const std::string dir = MakeTempDir();
+   ASSERT_FALSE(dir.empty());
+   const std::string nested = dir + "a/b/c/";
+   EXPECT_TRUE(MMStreamWriter::CreateDirectories(nested));
+   EXPECT_TRUE(MMStreamWriter::CreateDirectories(nested)); // Already exists
+   struct stat st;
+   ASSERT_EQ(0, stat((dir + "a/b/c").c_str(), &st));
+   EXPECT_TRUE(S_ISDIR(st.st_mode));
+   RemoveDir(dir);
+}
+
+// Sustained write rate of 4 MP 16-bit frames by number of writer threads.
+// Writes to TMPDIR (or /tmp), so set that to the disk of interest.
+TEST(StreamWriterTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const char* tmp = std::getenv("TMPDIR");
+   std::string root = tmp ? tmp : "/tmp";
+   root += "/StreamWriter-Benchmark-XXXXXX";
+   std::vector<char> name(root.begin(), root.end());
+   name.push_back('\0');
+   ASSERT_TRUE(mkdtemp(&name[0]) != 0);
+   const std::string dir = std::string(&name[0]) + "/";
+
+   const std::size_t frameBytes = 2048 * 2048 * 2;
+   const unsigned frames = 100;
+   const std::vector<unsigned char> frame = Frame(frameBytes, 1);
+   const unsigned threadCounts[] = { 1, 2, 4 };
+   for (int t = 0; t < 3; ++t)
+   {
+      MMStreamWriter writer;
+      ASSERT_TRUE(writer.Start(dir, "bench", frameBytes, threadCounts[t],
+               256ULL * 1024 * 1024));
+      const ptime t0 = microsec_clock::universal_time();
+      for (unsigned i = 0; i < frames; ++i)
+         ASSERT_TRUE(writer.WriteFrame(&frame[0]));
+      ASSERT_TRUE(writer.Stop());
+      const ptime t1 = microsec_clock::universal_time();
+
+      const double us = static_cast<double>((t1 - t0).total_microseconds());
+      std::cout << threadCounts[t] << " writer threads: " <<
+         (us > 0.0 ? frames * frameBytes / us : 0.0) << " MB/s, " <<
+         (us > 0.0 ? frames * 1e6 / us : 0.0) << " frames/s\n";
+   }
+   RemoveDir(dir);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
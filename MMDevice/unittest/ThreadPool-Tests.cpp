@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "DeviceThreadPool.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+TEST(ThreadPoolTests, DefaultSizeIsHardwareConcurrency)
+{
+   MMThreadPool pool;
+   EXPECT_EQ(std::max(1u, boost::thread::hardware_concurrency()),
+         pool.GetThreadCount());
+   MMThreadPool single(1);
+   EXPECT_EQ(1u, single.GetThreadCount());
+}
+
+TEST(ThreadPoolTests, ParallelForCoversRangeOnce)
+{
+   const unsigned sizes[] = { 1, 2, 3, 8 };
+   for (int s = 0; s < 4; ++s)
+   {
+      MMThreadPool pool(sizes[s]);
+      const std::size_t counts[] = { 0, 1, 7, 100, 1001, 65537 };
+      for (int c = 0; c < 6; ++c)
+      {
+         const std::size_t count = counts[c];
+         std::vector< std::atomic<int> > hits(count);
+         for (std::size_t i = 0; i < count; ++i)
+            hits[i] = 0;
+         std::atomic<int> calls(0);
+         pool.ParallelFor(count, 16,
+               [&](std::size_t begin, std::size_t end)
+               {
+                  ++calls;
+                  EXPECT_LT(begin, end);
+                  for (std::size_t i = begin; i < end; ++i)
+                     ++hits[i];
+               });
+         for (std::size_t i = 0; i < count; ++i)
+            ASSERT_EQ(1, hits[i]) << "count " << count << ", index " << i;
+         EXPECT_LE(calls.load(), static_cast<int>(sizes[s]));
+      }
+   }
+}
+
+TEST(ThreadPoolTests, SmallRangeRunsInline)
+{
+   MMThreadPool pool(4);
+   const boost::thread::id caller = boost::this_thread::get_id();
+   int calls = 0;
+   pool.ParallelFor(10, 100,
+         [&](std::size_t begin, std::size_t end)
+         {
+            ++calls;
+            EXPECT_EQ(0u, begin);
+            EXPECT_EQ(10u, end);
+            EXPECT_EQ(caller, boost::this_thread::get_id());
+         });
+   EXPECT_EQ(1, calls);
+}
+
+TEST(ThreadPoolTests, UsesWorkers)
+{
+   MMThreadPool pool(4);
+   // Chunks that wait for each other can only finish if they run at once
+   std::atomic<int> arrived(0);
+   pool.ParallelFor(4, 1,
+         [&](std::size_t, std::size_t)
+         {
+            ++arrived;
+            while (arrived.load() < 4)
+               boost::this_thread::yield();
+         });
+   EXPECT_EQ(4, arrived.load());
+}
+
+TEST(ThreadPoolTests, ConcurrentCallers)
+{
+   MMThreadPool pool(4);
+   const int callers = 6;
+   const std::size_t count = 100000;
+   std::vector< std::vector<int> > results(callers, std::vector<int>(count));
+   boost::thread_group threads;
+   for (int t = 0; t < callers; ++t)
+   {
+      std::vector<int>* result = &results[t];
+      threads.create_thread([&pool, result, t]()
+            {
+               for (int rep = 0; rep < 50; ++rep)
+               {
+                  pool.ParallelFor(count, 1000,
+                        [result, t, rep](std::size_t begin, std::size_t end)
+                        {
+                           for (std::size_t i = begin; i < end; ++i)
+                              (*result)[i] = t * 1000 + rep;
+                        });
+               }
+            });
+   }
+   threads.join_all();
+   for (int t = 0; t < callers; ++t)
+      for (std::size_t i = 0; i < count; ++i)
+         ASSERT_EQ(t * 1000 + 49, results[t][i]);
+}
+
+TEST(ThreadPoolTests, MemCopy)
+{
+   MMThreadPool pool(4);
+   const std::size_t sizes[] = { 0, 1, 4095, MMThreadPool::memCopyChunkBytes,
+      3 * MMThreadPool::memCopyChunkBytes + 17, 20000003 };
+   for (int s = 0; s < 6; ++s)
+   {
+      const std::size_t bytes = sizes[s];
+      std::vector<unsigned char> src(bytes + 2);
+      for (std::size_t i = 0; i < src.size(); ++i)
+         src[i] = static_cast<unsigned char>(i * 31 + (i >> 12));
+      std::vector<unsigned char> dst(bytes + 2, 0xee);
+      // Unaligned on both sides, as for the PVCAM stream writer
+      pool.MemCopy(&dst[1], &src[1], bytes);
+      EXPECT_EQ(0xee, dst[0]);
+      EXPECT_EQ(0xee, dst[bytes + 1]);
+      EXPECT_EQ(0, std::memcmp(&dst[1], &src[1], bytes)) << bytes << " bytes";
+   }
+}
+
+// Throughput of MemCopy() of camera-sized frames and of a per-pixel loop,
+// by pool size
+TEST(ThreadPoolTests, Benchmark)
+{
+   using boost::posix_time::microsec_clock;
+   using boost::posix_time::ptime;
+
+   const std::size_t frameBytes = 2048 * 2048 * 2 * 4; // Four 4 MP 16-bit frames
+   std::vector<unsigned char> src(frameBytes, 1);
+   std::vector<unsigned char> dst(frameBytes);
+   std::vector<unsigned short> pixels(frameBytes / 2, 100);
+
+   const unsigned maxThreads = std::max(1u, boost::thread::hardware_concurrency());
+   for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+   {
+      MMThreadPool pool(threads);
+      pool.MemCopy(&dst[0], &src[0], frameBytes); // Warm up
+
+      const int reps = 20;
+      const ptime t0 = microsec_clock::universal_time();
+      for (int i = 0; i < reps; ++i)
+         pool.MemCopy(&dst[0], &src[0], frameBytes);
+      const ptime t1 = microsec_clock::universal_time();
+      for (int i = 0; i < reps; ++i)
+      {
+         unsigned short* p = &pixels[0];
+         pool.ParallelFor(pixels.size(), 65536,
+               [p](std::size_t begin, std::size_t end)
+               {
+                  for (std::size_t j = begin; j < end; ++j)
+                     p[j] = static_cast<unsigned short>((p[j] * 3) >> 1);
+               });
+      }
+      const ptime t2 = microsec_clock::universal_time();
+
+      const double copyUs = static_cast<double>((t1 - t0).total_microseconds()) / reps;
+      const double loopUs = static_cast<double>((t2 - t1).total_microseconds()) / reps;
+      std::cout << threads << " threads: MemCopy " << copyUs << " us (" <<
+         (copyUs > 0.0 ? frameBytes / copyUs : 0.0) << " MB/s), per-pixel loop " <<
+         loopUs << " us (" <<
+         (loopUs > 0.0 ? pixels.size() / loopUs : 0.0) << " Mpixel/s)\n";
+      EXPECT_EQ(0, std::memcmp(&dst[0], &src[0], frameBytes));
+
+      if (threads < maxThreads && threads * 2 > maxThreads)
+         threads = maxThreads / 2; // Also measure the full pool
+   }
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}